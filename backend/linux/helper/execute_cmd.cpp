@@ -6,20 +6,22 @@ unsigned long ExecuteCmd::execute(const std::string &cmd, const std::string &cwd
 {
     mutex_.lock();
     curCmdId_++;
+    // commands may be started from several server threads, so don't read curCmdId_ outside the lock
+    const unsigned long cmdId = curCmdId_;
     CmdDescr *cmdDescr = new CmdDescr();
     cmdDescr->bFinished = false;
     cmdDescr->bSuccess = false;
-    cmdDescr->cmdId = curCmdId_;
+    cmdDescr->cmdId = cmdId;
     executingCmds_.push_back(cmdDescr);
     mutex_.unlock();
 
     if (!cwd.empty()) {
-        boost::thread(runCmd, curCmdId_, "cd \"" + cwd + "\" && " + cmd);
+        boost::thread(runCmd, cmdId, "cd \"" + cwd + "\" && " + cmd);
     } else {
-        boost::thread(runCmd, curCmdId_, cmd);
+        boost::thread(runCmd, cmdId, cmd);
     }
 
-    return curCmdId_;
+    return cmdId;
 }
 
 void ExecuteCmd::getStatus(unsigned long cmdId, bool &bFinished, std::string &log)
@@ -9,8 +9,22 @@
 #include "logger.h"
 #include "utils.h"
 
+namespace {
+
+// iptables arguments with the split tunneling cgroup match inserted between the head (chain) and the tail (target)
+std::vector<std::string> cgroupRule(std::vector<std::string> head, bool isInverted, const std::vector<std::string> &tail)
+{
+    std::vector<std::string> match = CGroups::instance().iptablesMatch(isInverted);
+    head.insert(head.end(), match.begin(), match.end());
+    head.insert(head.end(), tail.begin(), tail.end());
+    return head;
+}
+
+} // namespace
+
 bool FirewallController::enable(bool ipv6, const std::string &rules)
 {
+    std::lock_guard<std::recursive_mutex> guard(mutex_);
     int fd;
 
     if (ipv6) {
@@ -37,7 +51,8 @@ bool FirewallController::enable(bool ipv6, const std::string &rules)
         Utils::executeCommand("iptables-restore", {"-n", "/etc/windscribe/rules.v4"});
     }
 
-    // reapply split tunneling rules if necessary
+    // reapply split tunneling rules if necessary, the restored rules may have replaced them
+    splitTunnelIpsApplied_.clear();
     setSplitTunnelIpExceptions(splitTunnelIps_);
     setSplitTunnelAppExceptions();
 
@@ -46,6 +61,7 @@ bool FirewallController::enable(bool ipv6, const std::string &rules)
 
 void FirewallController::getRules(bool ipv6, std::string *outRules)
 {
+    std::lock_guard<std::recursive_mutex> guard(mutex_);
     std::string filename;
 
     if (ipv6) {
@@ -64,17 +80,20 @@ void FirewallController::getRules(bool ipv6, std::string *outRules)
 
 bool FirewallController::enabled(const std::string &tag)
 {
+    std::lock_guard<std::recursive_mutex> guard(mutex_);
     return Utils::executeCommand("iptables", {"--check", "INPUT", "-j", "windscribe_input", "-m", "comment", "--comment", tag.c_str()}) == 0;
 }
 
 void FirewallController::disable()
 {
+    std::lock_guard<std::recursive_mutex> guard(mutex_);
     Utils::executeCommand("rm", {"-f", "/etc/windscribe/rules.v4"});
     Utils::executeCommand("rm", {"-f", "/etc/windscribe/rules.v6"});
 }
 
 void FirewallController::setSplitTunnelingEnabled(bool isConnected, bool isEnabled, bool isExclude, const std::string &defaultAdapter)
 {
+    std::lock_guard<std::recursive_mutex> guard(mutex_);
     connected_ = isConnected;
     splitTunnelEnabled_ = isEnabled;
     splitTunnelExclude_ = isExclude;
@@ -87,10 +106,11 @@ void FirewallController::setSplitTunnelingEnabled(bool isConnected, bool isEnabl
 
 void FirewallController::removeExclusiveIpRules()
 {
-    for (auto ip : splitTunnelIps_) {
+    for (auto ip : splitTunnelIpsApplied_) {
         Utils::executeCommand("iptables", {"-D", "windscribe_input", "-s", ip.c_str(), "-j", "ACCEPT", "-m", "comment", "--comment", kTag});
         Utils::executeCommand("iptables", {"-D", "windscribe_output", "-d", ip.c_str(), "-j", "ACCEPT", "-m", "comment", "--comment", kTag});
     }
+    splitTunnelIpsApplied_.clear();
 }
 
 void FirewallController::removeInclusiveIpRules()
@@ -101,9 +121,9 @@ void FirewallController::removeInclusiveIpRules()
 
 void FirewallController::removeExclusiveAppRules()
 {
-    Utils::executeCommand("iptables", {"-D", "OUTPUT", "-t", "mangle", "-m", "cgroup", "--cgroup", CGroups::instance().netClassId(), "-j", "MARK", "--set-mark", CGroups::instance().mark(), "-m", "comment", "--comment", kTag});
+    Utils::executeCommand("iptables", cgroupRule({"-D", "OUTPUT", "-t", "mangle"}, false, {"-j", "MARK", "--set-mark", CGroups::instance().mark(), "-m", "comment", "--comment", kTag}));
     if (!prevAdapter_.empty()) {
-        Utils::executeCommand("iptables", {"-D", "POSTROUTING", "-t", "nat", "-m", "cgroup", "--cgroup", CGroups::instance().netClassId(), "-o", prevAdapter_.c_str(), "-j", "MASQUERADE", "-m", "comment", "--comment", kTag});
+        Utils::executeCommand("iptables", cgroupRule({"-D", "POSTROUTING", "-t", "nat"}, false, {"-o", prevAdapter_.c_str(), "-j", "MASQUERADE", "-m", "comment", "--comment", kTag}));
     }
 
     Utils::executeCommand("iptables", {"-D", "windscribe_input", "-j", "ACCEPT", "-m", "comment", "--comment", kTag});
@@ -112,9 +132,9 @@ void FirewallController::removeExclusiveAppRules()
 
 void FirewallController::removeInclusiveAppRules()
 {
-    Utils::executeCommand("iptables", {"-D", "OUTPUT", "-t", "mangle", "-m", "cgroup", "!", "--cgroup", CGroups::instance().netClassId(), "-j", "MARK", "--set-mark", CGroups::instance().mark(), "-m", "comment", "--comment", kTag});
+    Utils::executeCommand("iptables", cgroupRule({"-D", "OUTPUT", "-t", "mangle"}, true, {"-j", "MARK", "--set-mark", CGroups::instance().mark(), "-m", "comment", "--comment", kTag}));
     if (!prevAdapter_.empty()) {
-        Utils::executeCommand("iptables", {"-D", "POSTROUTING", "-t", "nat", "-m", "cgroup", "!", "--cgroup", CGroups::instance().netClassId(), "-o", prevAdapter_.c_str(), "-j", "MASQUERADE", "-m", "comment", "--comment", kTag});
+        Utils::executeCommand("iptables", cgroupRule({"-D", "POSTROUTING", "-t", "nat"}, true, {"-o", prevAdapter_.c_str(), "-j", "MASQUERADE", "-m", "comment", "--comment", kTag}));
     }
 }
 
@@ -129,19 +149,19 @@ void FirewallController::setSplitTunnelAppExceptions()
     if (splitTunnelExclude_) {
         removeInclusiveAppRules();
 
-        addRule({"POSTROUTING",  "-t", "nat", "-m", "cgroup", "--cgroup", CGroups::instance().netClassId(), "-o", defaultAdapter_.c_str(), "-j", "MASQUERADE", "-m", "comment", "--comment", kTag});
-        addRule({"OUTPUT", "-t", "mangle", "-m", "cgroup", "--cgroup", CGroups::instance().netClassId(), "-j", "MARK", "--set-mark", CGroups::instance().mark(), "-m", "comment", "--comment", kTag});
+        addRule(cgroupRule({"POSTROUTING",  "-t", "nat"}, false, {"-o", defaultAdapter_.c_str(), "-j", "MASQUERADE", "-m", "comment", "--comment", kTag}));
+        addRule(cgroupRule({"OUTPUT", "-t", "mangle"}, false, {"-j", "MARK", "--set-mark", CGroups::instance().mark(), "-m", "comment", "--comment", kTag}));
 
         // allow packets from excluded apps, if firewall is on
         if (enabled()) {
-            addRule({"windscribe_input", "-m", "cgroup", "--cgroup", CGroups::instance().netClassId(), "-j", "ACCEPT", "-m", "comment", "--comment", kTag});
-            addRule({"windscribe_output", "-m", "cgroup", "--cgroup", CGroups::instance().netClassId(), "-j", "ACCEPT", "-m", "comment", "--comment", kTag});
+            addRule(cgroupRule({"windscribe_input"}, false, {"-j", "ACCEPT", "-m", "comment", "--comment", kTag}));
+            addRule(cgroupRule({"windscribe_output"}, false, {"-j", "ACCEPT", "-m", "comment", "--comment", kTag}));
         }
     } else {
         removeExclusiveAppRules();
 
-        addRule({"POSTROUTING", "-t", "nat", "-m", "cgroup", "!", "--cgroup", CGroups::instance().netClassId(), "-o", defaultAdapter_.c_str(), "-j", "MASQUERADE", "-m", "comment", "--comment", kTag});
-        addRule({"OUTPUT", "-t", "mangle", "-m", "cgroup", "!", "--cgroup", CGroups::instance().netClassId(), "-j", "MARK", "--set-mark", CGroups::instance().mark(), "-m", "comment", "--comment", kTag});
+        addRule(cgroupRule({"POSTROUTING", "-t", "nat"}, true, {"-o", defaultAdapter_.c_str(), "-j", "MASQUERADE", "-m", "comment", "--comment", kTag}));
+        addRule(cgroupRule({"OUTPUT", "-t", "mangle"}, true, {"-j", "MARK", "--set-mark", CGroups::instance().mark(), "-m", "comment", "--comment", kTag}));
 
         // For inclusive, allow all packets
         if (enabled()) {
@@ -153,6 +173,7 @@ void FirewallController::setSplitTunnelAppExceptions()
 
 void FirewallController::setSplitTunnelIpExceptions(const std::vector<std::string> &ips)
 {
+    std::lock_guard<std::recursive_mutex> guard(mutex_);
     if (!connected_ || !splitTunnelEnabled_ || !enabled()) {
         removeInclusiveIpRules();
         removeExclusiveIpRules();
@@ -165,17 +186,23 @@ void FirewallController::setSplitTunnelIpExceptions(const std::vector<std::strin
         removeInclusiveIpRules();
 
         // For exclusive, remove rules for addresses no longer in "ips"
-        for (auto ip : splitTunnelIps_) {
-            if (std::find(ips.begin(), ips.end(), ip) == ips.end()) {
-                Utils::executeCommand("iptables", {"-D", "windscribe_input", "-s", ip.c_str(), "-j", "ACCEPT", "-m", "comment", "--comment", kTag});
-                Utils::executeCommand("iptables", {"-D", "windscribe_output", "-d", ip.c_str(), "-j", "ACCEPT", "-m", "comment", "--comment", kTag});
+        std::set<std::string> ipsSet(ips.begin(), ips.end());
+        for (auto it = splitTunnelIpsApplied_.begin(); it != splitTunnelIpsApplied_.end();) {
+            if (ipsSet.find(*it) == ipsSet.end()) {
+                Utils::executeCommand("iptables", {"-D", "windscribe_input", "-s", it->c_str(), "-j", "ACCEPT", "-m", "comment", "--comment", kTag});
+                Utils::executeCommand("iptables", {"-D", "windscribe_output", "-d", it->c_str(), "-j", "ACCEPT", "-m", "comment", "--comment", kTag});
+                it = splitTunnelIpsApplied_.erase(it);
+            } else {
+                ++it;
             }
         }
 
-        // Add rules for new IPs
-        for (auto ip : ips) {
-            addRule({"windscribe_input", "-s", ip.c_str(), "-j", "ACCEPT", "-m", "comment", "--comment", kTag});
-            addRule({"windscribe_output", "-d", ip.c_str(), "-j", "ACCEPT", "-m", "comment", "--comment", kTag});
+        // Add rules for new IPs only, so that a hostname refresh doesn't re-check every rule
+        for (auto ip : ipsSet) {
+            if (splitTunnelIpsApplied_.insert(ip).second) {
+                addRule({"windscribe_input", "-s", ip.c_str(), "-j", "ACCEPT", "-m", "comment", "--comment", kTag});
+                addRule({"windscribe_output", "-d", ip.c_str(), "-j", "ACCEPT", "-m", "comment", "--comment", kTag});
+            }
         }
     } else {
         removeExclusiveIpRules();
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <mutex>
+#include <set>
 #include <string>
 #include <vector>
 
+// Thread-safe: the commands of the server's worker threads and the hostname refreshes of the DnsResolver callback
+// thread change the rules concurrently, so every public method holds mutex_.
 class FirewallController
 {
 public:
@@ -30,10 +34,14 @@ private:
     FirewallController() : connected_(false), splitTunnelEnabled_(false), splitTunnelExclude_(true) {};
     ~FirewallController() { disable(); };
 
+    // recursive, since the public methods call each other
+    std::recursive_mutex mutex_;
     bool connected_;
     bool splitTunnelEnabled_;
     bool splitTunnelExclude_;
     std::vector<std::string> splitTunnelIps_;
+    // IPs for which the exclusive mode rules are currently installed
+    std::set<std::string> splitTunnelIpsApplied_;
     std::string defaultAdapter_;
     std::string prevAdapter_;
     std::string netclassid_;
@@ -29,6 +29,12 @@ CMD_ANSWER processCommand(int cmdId, const std::string packet)
     return (command->second)(ia);
 }
 
+int commandState(int cmdId)
+{
+    const auto state = kCommandStates.find(cmdId);
+    return state == kCommandStates.end() ? 0 : state->second;
+}
+
 CMD_ANSWER startOpenvpn(boost::archive::text_iarchive &ia)
 {
     CMD_ANSWER answer;
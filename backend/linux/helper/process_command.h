@@ -4,6 +4,7 @@
 #include <boost/archive/text_iarchive.hpp>
 #include <boost/serialization/vector.hpp>
 #include <map>
+#include <set>
 #include <string>
 
 #include "helper_commands.h"
@@ -51,4 +52,29 @@ static const std::map<const int, std::function<CMD_ANSWER(boost::archive::text_i
       { HELPER_CMD_START_WSTUNNEL, startWstunnel },
 };
 
+// the shared state a command touches; the server runs the commands that share any of it one at a time, and any
+// others concurrently
+enum CommandState {
+    kStateNetfilter = 1,     // iptables rules, edited by the firewall, split tunneling, WireGuard and the DNS scripts
+    kStateWireGuard = 2,     // WireGuardController, which is not thread-safe
+    kStateOpenVpnConfig = 4, // /etc/windscribe/config.ovpn
+};
+
+// the commands which aren't listed only touch internally synchronized state (the ExecuteCmd list, external processes)
+static const std::map<int, int> kCommandStates = {
+      { HELPER_CMD_START_OPENVPN, kStateOpenVpnConfig },
+      { HELPER_CMD_SPLIT_TUNNELING_SETTINGS, kStateNetfilter },
+      { HELPER_CMD_SEND_CONNECT_STATUS, kStateNetfilter },
+      { HELPER_CMD_START_WIREGUARD, kStateWireGuard | kStateNetfilter },
+      { HELPER_CMD_STOP_WIREGUARD, kStateWireGuard | kStateNetfilter },
+      { HELPER_CMD_CONFIGURE_WIREGUARD, kStateWireGuard | kStateNetfilter },
+      { HELPER_CMD_GET_WIREGUARD_STATUS, kStateWireGuard },
+      { HELPER_CMD_SET_DNS_LEAK_PROTECT_ENABLED, kStateNetfilter },
+      { HELPER_CMD_CLEAR_FIREWALL_RULES, kStateNetfilter },
+      { HELPER_CMD_CHECK_FIREWALL_STATE, kStateNetfilter },
+      { HELPER_CMD_SET_FIREWALL_RULES, kStateNetfilter },
+      { HELPER_CMD_GET_FIREWALL_RULES, kStateNetfilter },
+};
+
 CMD_ANSWER processCommand(int cmdId, const std::string packet);
+int commandState(int cmdId);
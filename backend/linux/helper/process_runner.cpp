@@ -0,0 +1,269 @@
+#include "process_runner.h"
+
+#include <array>
+#include <fcntl.h>
+#include <future>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+extern char **environ;
+
+struct ProcessRunner::Child
+{
+    explicit Child(boost::asio::io_service &service) : output(service), pidfd(service), timer(service), pollTimer(service) {}
+
+    std::vector<std::string> argv;
+    bool appendFromStdErr = true;
+    int timeoutMs = 0;
+    Callback callback;
+
+    pid_t pid = -1;
+    boost::asio::posix::stream_descriptor output;
+    boost::asio::posix::stream_descriptor pidfd;
+    boost::asio::deadline_timer timer;
+    boost::asio::deadline_timer pollTimer;
+    std::array<char, 4096> buf;
+    std::string log;
+    bool isReading = false;
+    bool isEof = false;
+    bool isExited = false;
+    int exitStatus = 0;
+    bool isTimedOut = false;
+    bool isFinished = false;
+};
+
+namespace {
+
+int openPidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+}
+
+ProcessRunner::ProcessRunner() : work_(new boost::asio::io_service::work(service_))
+{
+    thread_ = std::thread([this]() { service_.run(); });
+}
+
+ProcessRunner::~ProcessRunner()
+{
+    work_.reset();
+    service_.stop();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+int ProcessRunner::run(const std::vector<std::string> &argv, std::string *pOutputStr, bool appendFromStdErr, int timeoutMs)
+{
+    if (pOutputStr) {
+        pOutputStr->clear();
+    }
+    if (std::this_thread::get_id() == thread_.get_id()) {
+        // waiting here would block the thread which has to report the completion
+        Logger::instance().out("ProcessRunner::run() called from the runner thread, ignoring %s", argv.empty() ? "" : argv[0].c_str());
+        return -1;
+    }
+
+    auto result = std::make_shared<std::promise<std::pair<int, std::string>>>();
+    std::future<std::pair<int, std::string>> future = result->get_future();
+    auto child = std::make_shared<Child>(service_);
+    child->argv = argv;
+    child->appendFromStdErr = appendFromStdErr;
+    child->timeoutMs = timeoutMs;
+    child->callback = [result](int status, const std::string &output) {
+        result->set_value(std::make_pair(status, output));
+    };
+    service_.post([this, child]() { start(child); });
+
+    try {
+        std::pair<int, std::string> ret = future.get();
+        if (pOutputStr) {
+            *pOutputStr = ret.second;
+        }
+        return ret.first;
+    } catch (const std::future_error &) {
+        // the runner was destroyed before the child finished, i.e. the helper is shutting down
+        return -1;
+    }
+}
+
+void ProcessRunner::start(std::shared_ptr<Child> child)
+{
+    if (child->argv.empty()) {
+        child->callback(-1, std::string());
+        return;
+    }
+
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        Logger::instance().out("ProcessRunner: pipe2() failed (%d)", errno);
+        child->callback(-1, std::string());
+        return;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    if (child->appendFromStdErr) {
+        posix_spawn_file_actions_adddup2(&actions, fds[1], STDERR_FILENO);
+    } else {
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    }
+
+    // the helper's threads may have signals blocked, don't let the child inherit that
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t mask;
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+
+    std::vector<char *> argv;
+    for (auto &arg : child->argv) {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    int err = posix_spawnp(&child->pid, argv[0], &actions, &attr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    close(fds[1]);
+
+    if (err != 0) {
+        Logger::instance().out("ProcessRunner: could not start %s (%d)", argv[0], err);
+        close(fds[0]);
+        // what /bin/sh reports for a command it can't find or run, as the command used to go through the shell
+        child->callback(W_EXITCODE(err == ENOENT ? 127 : 126, 0), std::string());
+        return;
+    }
+
+    child->output.assign(fds[0]);
+    readOutput(child);
+
+    if (child->timeoutMs > 0) {
+        child->timer.expires_from_now(boost::posix_time::milliseconds(child->timeoutMs));
+        child->timer.async_wait([this, child](const boost::system::error_code &ec) { onTimeout(child, ec); });
+    }
+
+    int pidfd = openPidfd(child->pid);
+    if (pidfd >= 0) {
+        child->pidfd.assign(pidfd);
+        waitExit(child);
+    } else {
+        pollExit(child);
+    }
+}
+
+void ProcessRunner::readOutput(std::shared_ptr<Child> child)
+{
+    child->isReading = true;
+    child->output.async_read_some(boost::asio::buffer(child->buf), [this, child](const boost::system::error_code &ec, std::size_t bytesRead) {
+        child->isReading = false;
+        if (!ec) {
+            child->log.append(child->buf.data(), bytesRead);
+        } else if (ec != boost::asio::error::operation_aborted) {
+            child->isEof = true;
+        }
+
+        if (child->isExited) {
+            finish(child);
+        } else if (!child->isEof) {
+            readOutput(child);
+        }
+    });
+}
+
+void ProcessRunner::waitExit(std::shared_ptr<Child> child)
+{
+    // a pidfd becomes readable once the process has terminated
+    child->pidfd.async_wait(boost::asio::posix::stream_descriptor::wait_read, [this, child](const boost::system::error_code &ec) {
+        if (ec == boost::asio::error::operation_aborted) {
+            return;
+        }
+        int status = 0;
+        while (waitpid(child->pid, &status, 0) < 0 && errno == EINTR) {}
+        onExited(child, status);
+    });
+}
+
+void ProcessRunner::pollExit(std::shared_ptr<Child> child)
+{
+    int status = 0;
+    if (waitpid(child->pid, &status, WNOHANG) == child->pid) {
+        onExited(child, status);
+        return;
+    }
+    child->pollTimer.expires_from_now(boost::posix_time::milliseconds(kWaitPollIntervalMs));
+    child->pollTimer.async_wait([this, child](const boost::system::error_code &ec) {
+        if (ec != boost::asio::error::operation_aborted) {
+            pollExit(child);
+        }
+    });
+}
+
+void ProcessRunner::onExited(std::shared_ptr<Child> child, int status)
+{
+    child->isExited = true;
+    child->exitStatus = status;
+
+    // don't wait for EOF, since a daemonized grandchild may keep the pipe open; let the pending read
+    // complete first so that nothing it already received is lost
+    if (child->isReading) {
+        boost::system::error_code ec;
+        child->output.cancel(ec);
+    } else {
+        finish(child);
+    }
+}
+
+void ProcessRunner::finish(std::shared_ptr<Child> child)
+{
+    if (child->isFinished) {
+        return;
+    }
+    child->isFinished = true;
+
+    // pick up whatever the child wrote right before exiting
+    if (!child->isEof) {
+        int fd = child->output.native_handle();
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        ssize_t bytesRead;
+        while ((bytesRead = read(fd, child->buf.data(), child->buf.size())) > 0) {
+            child->log.append(child->buf.data(), bytesRead);
+        }
+    }
+
+    boost::system::error_code ec;
+    child->output.close(ec);
+    child->pidfd.close(ec);
+    child->timer.cancel(ec);
+
+    // the wait status as waitpid() reports it, not just the exit code: a killed child, or one that timed out, is
+    // reported with its signal
+    child->callback(child->exitStatus, child->log);
+}
+
+void ProcessRunner::onTimeout(std::shared_ptr<Child> child, const boost::system::error_code &ec)
+{
+    if (ec == boost::asio::error::operation_aborted || child->isFinished) {
+        return;
+    }
+    Logger::instance().out("ProcessRunner: %s did not finish in %d ms, killing it", child->argv[0].c_str(), child->timeoutMs);
+    child->isTimedOut = true;
+    // the child is not reaped until its exit is reported, so the pid can't have been reused yet
+    kill(child->pid, SIGKILL);
+}
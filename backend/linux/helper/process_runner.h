@@ -0,0 +1,51 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+
+// Runs external tools without a shell: children are started with posix_spawn from an argv vector and their
+// completion is awaited through a pidfd on a private io_service, so any number of commands can be in flight.
+class ProcessRunner
+{
+public:
+    static ProcessRunner &instance()
+    {
+        static ProcessRunner i;
+        return i;
+    }
+
+    // argv[0] is looked up in PATH; blocks the calling thread until the child exits or, if timeoutMs > 0, until the
+    // timeout expires and the child is killed. Returns the wait status of the child, which is 0 only if it exited with
+    // 0, as pstreams did; a child which could not be started is reported as /bin/sh would, with exit code 127 or 126
+    int run(const std::vector<std::string> &argv, std::string *pOutputStr, bool appendFromStdErr, int timeoutMs = 0);
+
+private:
+    ProcessRunner();
+    ~ProcessRunner();
+    ProcessRunner(const ProcessRunner &) = delete;
+    ProcessRunner &operator=(const ProcessRunner &) = delete;
+
+    // without pidfd support (kernels older than 5.3) the child is polled with waitpid(WNOHANG) at this interval
+    static constexpr int kWaitPollIntervalMs = 10;
+
+    // invoked on the runner's thread
+    typedef std::function<void(int status, const std::string &output)> Callback;
+
+    struct Child;
+
+    boost::asio::io_service service_;
+    std::unique_ptr<boost::asio::io_service::work> work_;
+    std::thread thread_;
+
+    void start(std::shared_ptr<Child> child);
+    void readOutput(std::shared_ptr<Child> child);
+    void waitExit(std::shared_ptr<Child> child);
+    void pollExit(std::shared_ptr<Child> child);
+    void onExited(std::shared_ptr<Child> child, int status);
+    void finish(std::shared_ptr<Child> child);
+    void onTimeout(std::shared_ptr<Child> child, const boost::system::error_code &ec);
+};
@@ -0,0 +1,412 @@
+#include "netlink_routes.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <linux/fib_rules.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../logger.h"
+
+NetlinkRoutes::NetlinkRoutes() : fd_(-1), seq_(1), firstSeq_(1), lastMessageOffset_(0), failed_(0)
+{
+}
+
+NetlinkRoutes::~NetlinkRoutes()
+{
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+bool NetlinkRoutes::addRoute(const std::string &ip, const std::string &gateway, uint32_t table)
+{
+    return queueRoute(RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL, ip, gateway, table);
+}
+
+bool NetlinkRoutes::deleteRoute(const std::string &ip, const std::string &gateway, uint32_t table)
+{
+    return queueRoute(RTM_DELROUTE, 0, ip, gateway, table);
+}
+
+void NetlinkRoutes::addRule(uint32_t table, uint32_t priority)
+{
+    queueRule(RTM_NEWRULE, NLM_F_CREATE | NLM_F_EXCL, AF_INET, table, priority);
+    queueRule(RTM_NEWRULE, NLM_F_CREATE | NLM_F_EXCL, AF_INET6, table, priority);
+}
+
+void NetlinkRoutes::deleteRule(uint32_t table, uint32_t priority)
+{
+    queueRule(RTM_DELRULE, 0, AF_INET, table, priority);
+    queueRule(RTM_DELRULE, 0, AF_INET6, table, priority);
+}
+
+void NetlinkRoutes::flushTable(uint32_t table)
+{
+    // requests of a batch must have consecutive sequence numbers, so send the pending ones before the dump
+    sendBatch();
+    if (!openSocket()) {
+        return;
+    }
+
+    struct {
+        nlmsghdr hdr;
+        rtmsg rtm;
+    } req;
+    memset(&req, 0, sizeof(req));
+    req.hdr.nlmsg_len = sizeof(req);
+    req.hdr.nlmsg_type = RTM_GETROUTE;
+    req.hdr.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.hdr.nlmsg_seq = seq_++;
+    // both families
+    req.rtm.rtm_family = AF_UNSPEC;
+    const uint32_t dumpSeq = req.hdr.nlmsg_seq;
+
+    if (send(fd_, &req, sizeof(req), 0) < 0) {
+        Logger::instance().out("NetlinkRoutes::flushTable(), send failed: %s", strerror(errno));
+        return;
+    }
+
+    // collect the routes first, the deletions are queued after the dump is complete
+    std::vector<std::pair<std::string, uint8_t>> routes;
+    std::vector<char> buf(32 * 1024);
+    bool done = false;
+    while (!done) {
+        ssize_t len = recv(fd_, buf.data(), buf.size(), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            Logger::instance().out("NetlinkRoutes::flushTable(), recv failed: %s", strerror(errno));
+            return;
+        }
+        for (nlmsghdr *nh = (nlmsghdr *)buf.data(); NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_seq != dumpSeq) {
+                continue;
+            }
+            if (nh->nlmsg_type == NLMSG_DONE || nh->nlmsg_type == NLMSG_ERROR) {
+                done = true;
+                break;
+            }
+            if (nh->nlmsg_type != RTM_NEWROUTE) {
+                continue;
+            }
+            rtmsg *rtm = (rtmsg *)NLMSG_DATA(nh);
+            if (rtm->rtm_family != AF_INET && rtm->rtm_family != AF_INET6) {
+                continue;
+            }
+            uint32_t routeTable = rtm->rtm_table;
+            std::string dst = rtm->rtm_family == AF_INET ? "0.0.0.0" : "::";
+            int attrLen = RTM_PAYLOAD(nh);
+            for (rtattr *rta = RTM_RTA(rtm); RTA_OK(rta, attrLen); rta = RTA_NEXT(rta, attrLen)) {
+                if (rta->rta_type == RTA_TABLE) {
+                    routeTable = *(uint32_t *)RTA_DATA(rta);
+                } else if (rta->rta_type == RTA_DST) {
+                    char str[INET6_ADDRSTRLEN];
+                    if (inet_ntop(rtm->rtm_family, RTA_DATA(rta), str, sizeof(str))) {
+                        dst = str;
+                    }
+                }
+            }
+            if (routeTable == table) {
+                routes.push_back(std::make_pair(dst, rtm->rtm_dst_len));
+            }
+        }
+    }
+
+    for (const auto &route : routes) {
+        queueRoute(RTM_DELROUTE, 0, route.first + "/" + std::to_string(route.second), "", table);
+    }
+}
+
+int NetlinkRoutes::commit(std::set<std::string> *failedAdds, std::set<std::string> *failedDeletes)
+{
+    sendBatch();
+    if (failedAdds) {
+        failedAdds->insert(failedAdds_.begin(), failedAdds_.end());
+    }
+    if (failedDeletes) {
+        failedDeletes->insert(failedDeletes_.begin(), failedDeletes_.end());
+    }
+    int ret = failed_;
+    failed_ = 0;
+    failedAdds_.clear();
+    failedDeletes_.clear();
+    return ret;
+}
+
+bool NetlinkRoutes::openSocket()
+{
+    if (fd_ >= 0) {
+        return true;
+    }
+
+    fd_ = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd_ < 0) {
+        Logger::instance().out("NetlinkRoutes: could not open netlink socket: %s", strerror(errno));
+        return false;
+    }
+
+    sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    if (bind(fd_, (sockaddr *)&addr, sizeof(addr)) < 0) {
+        Logger::instance().out("NetlinkRoutes: could not bind netlink socket: %s", strerror(errno));
+        close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    // the buffer size is only a hint (capped by rmem_max) unless forced, which the helper running as root can do
+    int size = kReceiveBufferSize;
+    if (setsockopt(fd_, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0) {
+        setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+
+    // never block the caller forever if an ack gets lost
+    timeval tv;
+    tv.tv_sec = kReceiveTimeoutMs / 1000;
+    tv.tv_usec = (kReceiveTimeoutMs % 1000) * 1000;
+    setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+#ifdef NETLINK_CAP_ACK
+    // don't echo the whole request back in error acks
+    int one = 1;
+    setsockopt(fd_, SOL_NETLINK, NETLINK_CAP_ACK, &one, sizeof(one));
+#endif
+    return true;
+}
+
+bool NetlinkRoutes::queueRoute(uint16_t type, uint16_t flags, const std::string &ip, const std::string &gateway, uint32_t table)
+{
+    uint8_t family;
+    unsigned char dst[16];
+    uint8_t prefixLen;
+    if (!parsePrefix(ip, family, dst, prefixLen)) {
+        Logger::instance().out("NetlinkRoutes: skipping invalid prefix %s", ip.c_str());
+        return false;
+    }
+
+    uint8_t gwFamily = family;
+    unsigned char gw[16];
+    if (!gateway.empty() && !parseAddress(gateway, gwFamily, gw)) {
+        Logger::instance().out("NetlinkRoutes: skipping route to %s, invalid gateway %s", ip.c_str(), gateway.c_str());
+        return false;
+    }
+    // "ip route" could not do that either: the kernel takes no IPv4 gateways for IPv6 routes
+    if (gwFamily != family) {
+        Logger::instance().out("NetlinkRoutes: skipping route to %s, gateway %s is of the other address family", ip.c_str(),
+                               gateway.c_str());
+        return false;
+    }
+
+    std::string description = (type == RTM_NEWROUTE ? "add " : "del ") + ip;
+    if (!gateway.empty()) {
+        description += " via " + gateway;
+    }
+    description += " table " + std::to_string(table);
+
+    size_t offset = appendMessage(type, flags, sizeof(rtmsg), ip, description);
+    rtmsg *rtm = (rtmsg *)(batch_.data() + offset);
+    rtm->rtm_family = family;
+    rtm->rtm_dst_len = prefixLen;
+    rtm->rtm_table = table < 256 ? table : RT_TABLE_UNSPEC;
+    if (type == RTM_NEWROUTE) {
+        rtm->rtm_protocol = RTPROT_STATIC;
+        rtm->rtm_scope = RT_SCOPE_UNIVERSE;
+        rtm->rtm_type = RTN_UNICAST;
+    } else {
+        rtm->rtm_scope = RT_SCOPE_NOWHERE;
+    }
+
+    appendAttr(RTA_DST, dst, addressSize(family));
+    if (!gateway.empty()) {
+        appendAttr(RTA_GATEWAY, gw, addressSize(family));
+    }
+    appendAttr(RTA_TABLE, &table, sizeof(table));
+    return true;
+}
+
+void NetlinkRoutes::queueRule(uint16_t type, uint16_t flags, uint8_t family, uint32_t table, uint32_t priority)
+{
+    std::string description = std::string(family == AF_INET6 ? "-6 " : "") +
+                              (type == RTM_NEWRULE ? "add rule priority " : "del rule priority ") + std::to_string(priority) +
+                              " table " + std::to_string(table);
+
+    size_t offset = appendMessage(type, flags, sizeof(fib_rule_hdr), std::string(), description);
+    fib_rule_hdr *frh = (fib_rule_hdr *)(batch_.data() + offset);
+    frh->family = family;
+    frh->action = FR_ACT_TO_TBL;
+    frh->table = table < 256 ? table : RT_TABLE_UNSPEC;
+
+    appendAttr(FRA_PRIORITY, &priority, sizeof(priority));
+    appendAttr(FRA_TABLE, &table, sizeof(table));
+}
+
+size_t NetlinkRoutes::appendMessage(uint16_t type, uint16_t flags, size_t payloadSize, const std::string &ip,
+                                    const std::string &description)
+{
+    if (requests_.size() >= kMaxBatchMessages) {
+        sendBatch();
+    }
+    if (batch_.empty()) {
+        firstSeq_ = seq_;
+    }
+
+    lastMessageOffset_ = batch_.size();
+    batch_.resize(batch_.size() + NLMSG_SPACE(payloadSize), 0);
+
+    nlmsghdr *hdr = (nlmsghdr *)(batch_.data() + lastMessageOffset_);
+    hdr->nlmsg_len = NLMSG_LENGTH(payloadSize);
+    hdr->nlmsg_type = type;
+    hdr->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | flags;
+    hdr->nlmsg_seq = seq_++;
+    requests_.push_back(Request{type, ip, description});
+
+    return lastMessageOffset_ + NLMSG_HDRLEN;
+}
+
+void NetlinkRoutes::appendAttr(uint16_t type, const void *data, size_t size)
+{
+    size_t offset = batch_.size();
+    batch_.resize(offset + RTA_SPACE(size), 0);
+
+    rtattr *rta = (rtattr *)(batch_.data() + offset);
+    rta->rta_type = type;
+    rta->rta_len = RTA_LENGTH(size);
+    memcpy(RTA_DATA(rta), data, size);
+
+    nlmsghdr *hdr = (nlmsghdr *)(batch_.data() + lastMessageOffset_);
+    hdr->nlmsg_len = NLMSG_ALIGN(hdr->nlmsg_len) + RTA_SPACE(size);
+}
+
+void NetlinkRoutes::sendBatch()
+{
+    if (batch_.empty()) {
+        return;
+    }
+
+    size_t count = requests_.size();
+    if (!openSocket() || send(fd_, batch_.data(), batch_.size(), 0) < 0) {
+        if (fd_ >= 0) {
+            Logger::instance().out("NetlinkRoutes: send failed: %s", strerror(errno));
+        }
+        for (const auto &request : requests_) {
+            setFailed(request);
+        }
+        batch_.clear();
+        requests_.clear();
+        return;
+    }
+
+    // every request carries NLM_F_ACK, so exactly one ack or error is expected per message
+    std::vector<char> buf(16 * 1024);
+    std::vector<bool> isAcked(count, false);
+    size_t acked = 0;
+    while (acked < count) {
+        ssize_t len = recv(fd_, buf.data(), buf.size(), 0);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            Logger::instance().out("NetlinkRoutes: recv failed: %s", strerror(errno));
+            // the state of the unacked requests is unknown, they count as failed
+            for (size_t i = 0; i < count; ++i) {
+                if (!isAcked[i]) {
+                    setFailed(requests_[i]);
+                }
+            }
+            break;
+        }
+        for (nlmsghdr *nh = (nlmsghdr *)buf.data(); NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_type != NLMSG_ERROR) {
+                continue;
+            }
+            // skip stale acks of a previous batch which was not received completely
+            size_t ind = nh->nlmsg_seq - firstSeq_;
+            if (ind >= count || isAcked[ind]) {
+                continue;
+            }
+            isAcked[ind] = true;
+            acked++;
+            int error = -((nlmsgerr *)NLMSG_DATA(nh))->error;
+            if (error == 0) {
+                continue;
+            }
+            const std::string &description = requests_[ind].description;
+            // adding an existing route or removing a missing one leaves the table in the requested state,
+            // and IPv6 may be disabled altogether
+            if (error == EEXIST || error == ESRCH || error == ENOENT || error == EAFNOSUPPORT) {
+                Logger::instance().out("NetlinkRoutes: %s: %s (ignored)", description.c_str(), strerror(error));
+            } else {
+                Logger::instance().out("NetlinkRoutes: %s failed: %s", description.c_str(), strerror(error));
+                setFailed(requests_[ind]);
+            }
+        }
+    }
+
+    batch_.clear();
+    requests_.clear();
+}
+
+void NetlinkRoutes::setFailed(const Request &request)
+{
+    failed_++;
+    if (request.type == RTM_NEWROUTE) {
+        failedAdds_.insert(request.ip);
+    } else if (request.type == RTM_DELROUTE) {
+        failedDeletes_.insert(request.ip);
+    }
+}
+
+bool NetlinkRoutes::parsePrefix(const std::string &ip, uint8_t &family, unsigned char *addr, uint8_t &prefixLen)
+{
+    std::string host = ip;
+    int n = -1;
+
+    size_t slash = ip.find('/');
+    if (slash != std::string::npos) {
+        host = ip.substr(0, slash);
+        std::string len = ip.substr(slash + 1);
+        if (len.empty() || len.size() > 3 || len.find_first_not_of("0123456789") != std::string::npos) {
+            return false;
+        }
+        n = std::stoi(len);
+    }
+
+    if (!parseAddress(host, family, addr)) {
+        return false;
+    }
+    const int maxLen = (int)addressSize(family) * 8;
+    if (n > maxLen) {
+        return false;
+    }
+    prefixLen = n < 0 ? maxLen : n;
+
+    // the kernel rejects prefixes with host bits set
+    for (int i = 0; i < (int)addressSize(family); ++i) {
+        const int bits = prefixLen - i * 8;
+        if (bits <= 0) {
+            addr[i] = 0;
+        } else if (bits < 8) {
+            addr[i] &= (unsigned char)(0xFF << (8 - bits));
+        }
+    }
+    return true;
+}
+
+bool NetlinkRoutes::parseAddress(const std::string &ip, uint8_t &family, unsigned char *addr)
+{
+    if (inet_pton(AF_INET, ip.c_str(), addr) == 1) {
+        family = AF_INET;
+        return true;
+    }
+    if (inet_pton(AF_INET6, ip.c_str(), addr) == 1) {
+        family = AF_INET6;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <netinet/in.h>
+#include <set>
+#include <string>
+#include <vector>
+
+// Programs IPv4/IPv6 routes and policy rules directly via rtnetlink instead of forking "ip route" for each change.
+// Requests are queued and sent to the kernel in batches of RTM_NEWROUTE/RTM_DELROUTE messages on commit().
+class NetlinkRoutes
+{
+public:
+    NetlinkRoutes();
+    ~NetlinkRoutes();
+    NetlinkRoutes(const NetlinkRoutes &) = delete;
+    NetlinkRoutes &operator=(const NetlinkRoutes &) = delete;
+
+    // ip may be an IPv4 or IPv6 address or a prefix in the "address/n" form, returns false if it can't be parsed or if the
+    // gateway is of the other family
+    bool addRoute(const std::string &ip, const std::string &gateway, uint32_t table);
+    bool deleteRoute(const std::string &ip, const std::string &gateway, uint32_t table);
+    // the rules are added and deleted for both families
+    void addRule(uint32_t table, uint32_t priority);
+    void deleteRule(uint32_t table, uint32_t priority);
+    // queue deletion of all IPv4 and IPv6 routes currently present in the table
+    void flushTable(uint32_t table);
+
+    // send all queued requests, returns the number of requests rejected by the kernel or not sent at all; the
+    // prefixes of the failed addRoute()/deleteRoute() requests are added to failedAdds/failedDeletes, as they were given
+    int commit(std::set<std::string> *failedAdds = nullptr, std::set<std::string> *failedDeletes = nullptr);
+
+private:
+    // every request is acked separately and each ack takes about a page of the receive buffer,
+    // so keep the batches small enough for all the acks of a batch to fit
+    static constexpr size_t kMaxBatchMessages = 128;
+    static constexpr int kReceiveBufferSize = 1024 * 1024;
+    static constexpr int kReceiveTimeoutMs = 5000;
+
+    struct Request
+    {
+        uint16_t type;
+        // the prefix as given by the caller, empty for rules
+        std::string ip;
+        std::string description;
+    };
+
+    int fd_;
+    uint32_t seq_;
+    uint32_t firstSeq_;
+    std::vector<char> batch_;
+    size_t lastMessageOffset_;
+    std::vector<Request> requests_;
+    int failed_;
+    std::set<std::string> failedAdds_;
+    std::set<std::string> failedDeletes_;
+
+    bool openSocket();
+    bool queueRoute(uint16_t type, uint16_t flags, const std::string &ip, const std::string &gateway, uint32_t table);
+    void queueRule(uint16_t type, uint16_t flags, uint8_t family, uint32_t table, uint32_t priority);
+    size_t appendMessage(uint16_t type, uint16_t flags, size_t payloadSize, const std::string &ip, const std::string &description);
+    void appendAttr(uint16_t type, const void *data, size_t size);
+    void sendBatch();
+    void setFailed(const Request &request);
+
+    // addr receives 4 bytes for AF_INET and 16 bytes for AF_INET6
+    static bool parsePrefix(const std::string &ip, uint8_t &family, unsigned char *addr, uint8_t &prefixLen);
+    static bool parseAddress(const std::string &ip, uint8_t &family, unsigned char *addr);
+    static size_t addressSize(uint8_t family) { return family == AF_INET6 ? 16 : 4; }
+};
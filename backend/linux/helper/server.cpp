@@ -24,15 +24,20 @@
 
 #define SOCK_PATH "/var/run/windscribe_helper_socket2"
 
-Server::Server()
+Server::Server() : commandsServed_(0), maxLatencyMs_(0), slowestCmdId_(-1)
 {
     acceptor_ = NULL;
+    latencyBuckets_.fill(0);
 }
 
 Server::~Server()
 {
     service_.stop();
 
+    workersWork_.reset();
+    workersService_.stop();
+    workers_.join_all();
+
     if (acceptor_) {
         delete acceptor_;
     }
@@ -40,7 +45,7 @@ Server::~Server()
     unlink(SOCK_PATH);
 }
 
-bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf, CMD_ANSWER &outCmdAnswer)
+bool Server::readCommand(socket_ptr sock, boost::asio::streambuf *buf, int &outCmdId, std::string &outPacket)
 {
     // not enough data for read command
     if (buf->size() < sizeof(int)*3) {
@@ -77,39 +82,107 @@ bool Server::readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf,
         return false;
     }
 
-    std::vector<char> vector(length);
-    memcpy(&vector[0], bufPtr + headerSize, length);
-    std::string str(vector.begin(), vector.end());
-    std::istringstream stream(str);
-    outCmdAnswer = processCommand(cmdId, str);
+    outCmdId = cmdId;
+    outPacket.assign(bufPtr + headerSize, length);
 
     buf->consume(headerSize + length);
 
     return true;
 }
 
+void Server::handleNextCommand(socket_ptr sock, boost::shared_ptr<boost::asio::streambuf> buf)
+{
+    int cmdId;
+    std::string packet;
+    if (!readCommand(sock, buf.get(), cmdId, packet)) {
+        // goto receive next commands
+        boost::asio::async_read(*sock, *buf, boost::asio::transfer_at_least(1),
+                                boost::bind(&Server::receiveCmdHandle, this, sock, buf, _1, _2));
+        return;
+    }
+
+    // the next command of this client is not read until the answer to this one is sent, so each client
+    // still sees its commands executed in order
+    const auto started = std::chrono::steady_clock::now();
+    workersService_.post([this, sock, buf, cmdId, packet, started]() {
+        const int state = commandState(cmdId);
+        std::unique_lock<std::mutex> wireGuardLock(wireGuardMutex_, std::defer_lock);
+        std::unique_lock<std::mutex> netfilterLock(netfilterMutex_, std::defer_lock);
+        std::unique_lock<std::mutex> openVpnConfigLock(openVpnConfigMutex_, std::defer_lock);
+        if (state & kStateWireGuard) {
+            wireGuardLock.lock();
+        }
+        if (state & kStateNetfilter) {
+            netfilterLock.lock();
+        }
+        if (state & kStateOpenVpnConfig) {
+            openVpnConfigLock.lock();
+        }
+        CMD_ANSWER cmdAnswer = processCommand(cmdId, packet);
+        cmdAnswer.serviceTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+        service_.post(boost::bind(&Server::commandFinished, this, sock, buf, cmdId, cmdAnswer, started));
+    });
+}
+
+void Server::commandFinished(socket_ptr sock, boost::shared_ptr<boost::asio::streambuf> buf, int cmdId, const CMD_ANSWER &cmdAnswer,
+                             std::chrono::steady_clock::time_point started)
+{
+    addLatency(cmdId, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count());
+
+    if (!sendAnswerCmd(sock, cmdAnswer)) {
+        Logger::instance().out("client app disconnected");
+        logLatencyHistogram();
+        return;
+    }
+    handleNextCommand(sock, buf);
+}
+
+void Server::addLatency(int cmdId, long long latencyMs)
+{
+    size_t bucket = 0;
+    while (bucket < kLatencyBucketsMs.size() && latencyMs >= kLatencyBucketsMs[bucket]) {
+        bucket++;
+    }
+    latencyBuckets_[bucket]++;
+    commandsServed_++;
+    if (latencyMs > maxLatencyMs_) {
+        maxLatencyMs_ = latencyMs;
+        slowestCmdId_ = cmdId;
+    }
+
+    if (commandsServed_ % kLatencyLogInterval == 0) {
+        logLatencyHistogram();
+    }
+}
+
+void Server::logLatencyHistogram()
+{
+    if (commandsServed_ == 0) {
+        return;
+    }
+
+    std::string histogram;
+    for (size_t i = 0; i < latencyBuckets_.size(); ++i) {
+        if (i < kLatencyBucketsMs.size()) {
+            histogram += " <" + std::to_string(kLatencyBucketsMs[i]) + "ms:";
+        } else {
+            histogram += " >=" + std::to_string(kLatencyBucketsMs.back()) + "ms:";
+        }
+        histogram += std::to_string(latencyBuckets_[i]);
+    }
+    Logger::instance().out("Command service times (%u commands):%s, max %lld ms (cmd %d)",
+                           commandsServed_, histogram.c_str(), maxLatencyMs_, slowestCmdId_);
+}
+
 void Server::receiveCmdHandle(socket_ptr sock, boost::shared_ptr<boost::asio::streambuf> buf, const boost::system::error_code& ec, std::size_t bytes_transferred)
 {
     UNUSED(bytes_transferred);
 
     if (!ec.value()) {
-        // read and handle commands
-        while (true) {
-            CMD_ANSWER cmdAnswer;
-            if (!readAndHandleCommand(sock, buf.get(), cmdAnswer)) {
-                // goto receive next commands
-                boost::asio::async_read(*sock, *buf, boost::asio::transfer_at_least(1),
-                                        boost::bind(&Server::receiveCmdHandle, this, sock, buf, _1, _2));
-                break;
-            } else {
-                if (!sendAnswerCmd(sock, cmdAnswer)) {
-                    Logger::instance().out("client app disconnected");
-                    return;
-                }
-            }
-        }
+        handleNextCommand(sock, buf);
     } else {
         Logger::instance().out("client app disconnected");
+        logLatencyHistogram();
     }
 }
 
@@ -170,6 +243,11 @@ void Server::run()
         ::unlink(SOCK_PATH);
         return;
     }
+    workersWork_.reset(new boost::asio::io_service::work(workersService_));
+    for (int i = 0; i < kWorkerThreads; ++i) {
+        workers_.create_thread([this]() { workersService_.run(); });
+    }
+
     startAccept();
 
     service_.run();
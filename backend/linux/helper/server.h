@@ -3,6 +3,10 @@
 #define BOOST_BIND_GLOBAL_PLACEHOLDERS 1
 
 #include <stdio.h>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <thread>
 #include <boost/asio.hpp>
@@ -25,10 +29,35 @@ public:
     void run();
 
 private:
+    // commands are handled on this many worker threads, so a slow command from one client doesn't stall the others
+    static constexpr int kWorkerThreads = 4;
+    // upper bounds (ms) of the command service time histogram buckets, the last bucket collects the rest
+    static constexpr std::array<int, 9> kLatencyBucketsMs = { 1, 5, 10, 50, 100, 500, 1000, 5000, 30000 };
+    static constexpr unsigned int kLatencyLogInterval = 500;
+
     boost::asio::io_service service_;
     boost::asio::local::stream_protocol::acceptor *acceptor_;
 
-    bool readAndHandleCommand(socket_ptr sock, boost::asio::streambuf *buf, CMD_ANSWER &outCmdAnswer);
+    boost::asio::io_service workersService_;
+    std::unique_ptr<boost::asio::io_service::work> workersWork_;
+    boost::thread_group workers_;
+    // one per CommandState, taken in this order by the commands that touch the state
+    std::mutex wireGuardMutex_;
+    std::mutex netfilterMutex_;
+    std::mutex openVpnConfigMutex_;
+
+    // accessed on the service_ thread only
+    std::array<unsigned int, kLatencyBucketsMs.size() + 1> latencyBuckets_;
+    unsigned int commandsServed_;
+    long long maxLatencyMs_;
+    int slowestCmdId_;
+
+    bool readCommand(socket_ptr sock, boost::asio::streambuf *buf, int &outCmdId, std::string &outPacket);
+    void handleNextCommand(socket_ptr sock, boost::shared_ptr<boost::asio::streambuf> buf);
+    void commandFinished(socket_ptr sock, boost::shared_ptr<boost::asio::streambuf> buf, int cmdId, const CMD_ANSWER &cmdAnswer,
+                         std::chrono::steady_clock::time_point started);
+    void addLatency(int cmdId, long long latencyMs);
+    void logLatencyHistogram();
 
     void receiveCmdHandle(socket_ptr sock, boost::shared_ptr<boost::asio::streambuf> buf, const boost::system::error_code& ec, std::size_t bytes_transferred);
     void acceptHandler(const boost::system::error_code & ec, socket_ptr sock);
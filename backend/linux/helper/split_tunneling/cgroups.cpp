@@ -1,23 +1,53 @@
 #include "cgroups.h"
 
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
 #include <fstream>
+#include <signal.h>
 #include <sstream>
+#include <unistd.h>
 
 #include "../logger.h"
 #include "../utils.h"
 
-CGroups::CGroups()
+namespace {
+
+// mountinfo escapes spaces and a few other characters in paths as \ooo
+std::string unescapeMountPath(const std::string &path)
+{
+    std::string ret;
+    for (size_t i = 0; i < path.size(); ++i) {
+        if (path[i] == '\\' && i + 3 < path.size()) {
+            ret += (char)std::stoi(path.substr(i + 1, 3), nullptr, 8);
+            i += 3;
+        } else {
+            ret += path[i];
+        }
+    }
+    return ret;
+}
+
+} // namespace
+
+CGroups::CGroups() : isMountsParsed_(false), isVersionDetected_(false), procsFd_(-1), rootProcsFd_(-1)
 {
 }
 
 CGroups::~CGroups()
 {
+    closeProcsFiles();
 }
 
 bool CGroups::enable(CMD_SEND_CONNECT_STATUS &connectStatus, bool isAllowLanTraffic, bool isExclude)
 {
     Logger::instance().out("cgroups enable");
 
+    auto startTime = std::chrono::steady_clock::now();
+    detectVersion();
+
     std::string out;
 
     int ret = Utils::executeCommand("/etc/windscribe/cgroups-up",
@@ -29,13 +59,16 @@ bool CGroups::enable(CMD_SEND_CONNECT_STATUS &connectStatus, bool isAllowLanTraf
                                       connectStatus.remoteIp,
                                       netClassId_.c_str(),
                                       isAllowLanTraffic ? "allow": "disallow",
-                                      isExclude ? "exclusive": "inclusive"},
+                                      isExclude ? "exclusive": "inclusive",
+                                      cgroup2_root_},
                                     &out);
     if (ret != 0) {
         Logger::instance().out("cgroups-up script failed: %s", out.c_str());
         return false;
     }
 
+    Logger::instance().out("cgroups enabled in %lld ms",
+                           (long long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count());
     return true;
 }
 
@@ -43,45 +76,336 @@ void CGroups::disable()
 {
     Logger::instance().out("cgroups disable");
 
-    Utils::executeCommand("/etc/windscribe/cgroups-down");
+    if (!cgroup2_root_.empty()) {
+        // put the processes back before the script moves whatever is left to the root cgroup
+        std::lock_guard<std::mutex> guard(mutex_);
+        std::vector<pid_t> pids = pidsInOurCgroup();
+        restoreOriginalCgroups(pids);
+        originalCgroups_.clear();
+        Logger::instance().out("cgroups: moved %zu processes back to their cgroups", pids.size());
+    }
+
+    // the script removes our cgroup. An open cgroup.procs doesn't hold it, but a descriptor of a removed cgroup only
+    // fails the writes, so the next enable() must open the files of the new one
+    closeProcsFiles();
+
+    if (cgroup2_root_.empty()) {
+        Utils::executeCommand("/etc/windscribe/cgroups-down");
+    } else {
+        Utils::executeCommand("/etc/windscribe/cgroups-down", {cgroup2_root_});
+    }
 }
 
 void CGroups::addApp(pid_t pid)
 {
-    std::ofstream out;
-    out.open((findNetclsRoot() + "/windscribe/cgroup.procs").c_str());
-    out << pid;
-    out.close();
+    writePids(true, {pid});
 }
 
 void CGroups::removeApp(pid_t pid)
 {
-    std::ofstream out;
-    out.open((findNetclsRoot() + "/cgroup.procs").c_str());
-    out << pid;
-    out.close();
+    writePids(false, {pid});
 }
 
-std::string CGroups::findNetclsRoot()
+long long CGroups::addApps(const std::vector<pid_t> &pids)
+{
+    return writePids(true, pids);
+}
+
+long long CGroups::removeApps(const std::vector<pid_t> &pids)
+{
+    return writePids(false, pids);
+}
+
+std::vector<std::string> CGroups::iptablesMatch(bool isInverted) const
+{
+    std::vector<std::string> args = {"-m", "cgroup"};
+    if (isInverted) {
+        args.push_back("!");
+    }
+    if (cgroup2_root_.empty()) {
+        args.push_back("--cgroup");
+        args.push_back(netClassId_);
+    } else {
+        // the path is relative to the cgroup v2 root
+        args.push_back("--path");
+        args.push_back(cgroupName_);
+    }
+    return args;
+}
+
+void CGroups::parseMounts()
 {
-    if (!net_cls_root_.empty()) {
-        return net_cls_root_;
+    std::ifstream mountinfo("/proc/self/mountinfo");
+    if (!mountinfo.is_open()) {
+        Logger::instance().out("cgroups: could not open /proc/self/mountinfo");
+        return;
     }
 
-    std::string response;
-    std::string line;
+    net_cls_root_.clear();
+    cgroup2_mount_.clear();
 
-    Utils::executeCommand("mount", { "-l", "-t", "cgroup" }, &response);
-    std::istringstream stream(response);
-    while (std::getline(stream, line)) {
-        int pos = line.find("net_cls on ");
-        if (pos == std::string::npos) {
+    // <id> <parent id> <major:minor> <root> <mount point> <options> [optional fields] - <fs type> <source> <super options>
+    std::string line;
+    while (std::getline(mountinfo, line)) {
+        size_t sep = line.find(" - ");
+        if (sep == std::string::npos) {
             continue;
         }
-        // path is from after "net_cls on " until we see " type cgroup"
-        net_cls_root_ = line.substr(pos + 11, line.find(" type cgroup") - 11);
-        return net_cls_root_;
+
+        std::istringstream head(line.substr(0, sep));
+        std::istringstream tail(line.substr(sep + 3));
+        std::string id, parentId, dev, root, mountPoint, fsType, source, superOptions;
+        head >> id >> parentId >> dev >> root >> mountPoint;
+        tail >> fsType >> source >> superOptions;
+
+        if (fsType == "cgroup" && net_cls_root_.empty()) {
+            std::istringstream options(superOptions);
+            std::string option;
+            while (std::getline(options, option, ',')) {
+                if (option == "net_cls") {
+                    net_cls_root_ = unescapeMountPath(mountPoint);
+                    break;
+                }
+            }
+        } else if (fsType == "cgroup2" && cgroup2_mount_.empty()) {
+            cgroup2_mount_ = unescapeMountPath(mountPoint);
+        }
+    }
+    isMountsParsed_ = true;
+}
+
+// the callers hold mutex_
+std::string CGroups::findNetclsRoot()
+{
+    // net_cls may be mounted later by cgroups-up, so parse again until it is found
+    if (!isMountsParsed_ || net_cls_root_.empty()) {
+        parseMounts();
+    }
+    return net_cls_root_;
+}
+
+void CGroups::detectVersion()
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (isVersionDetected_) {
+        return;
+    }
+    isVersionDetected_ = true;
+
+    // prefer net_cls as before; when it isn't mounted on a pure cgroup v2 system, use v2 instead of
+    // remounting the hierarchy in v1 mode
+    if (!findNetclsRoot().empty()) {
+        return;
+    }
+
+    if (cgroup2_mount_ == "/sys/fs/cgroup") {
+        cgroup2_root_ = cgroup2_mount_;
+        Logger::instance().out("cgroups: net_cls is not available, using cgroup v2 at %s", cgroup2_root_.c_str());
+    }
+}
+
+std::string CGroups::root()
+{
+    return cgroup2_root_.empty() ? findNetclsRoot() : cgroup2_root_;
+}
+
+void CGroups::closeProcsFiles()
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (procsFd_ >= 0) {
+        close(procsFd_);
+        procsFd_ = -1;
+    }
+    if (rootProcsFd_ >= 0) {
+        close(rootProcsFd_);
+        rootProcsFd_ = -1;
+    }
+}
+
+long long CGroups::writePids(bool isOurs, const std::vector<pid_t> &pids)
+{
+    auto startTime = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> guard(mutex_);
+
+    if (!cgroup2_root_.empty()) {
+        if (isOurs) {
+            recordOriginalCgroups(pids);
+        } else {
+            restoreOriginalCgroups(pids);
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+        }
+    }
+
+    int fd = procsFd(isOurs);
+    if (fd < 0) {
+        return 0;
+    }
+
+    // the kernel accepts a single pid per write, but the file stays open for the whole batch
+    for (auto pid : pids) {
+        if (!writePid(fd, pid)) {
+            Logger::instance().out("cgroups: could not move pid %d: %s", pid, strerror(errno));
+        }
+    }
+
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+// the callers hold mutex_
+int CGroups::procsFd(bool isOurs)
+{
+    int &fd = isOurs ? procsFd_ : rootProcsFd_;
+    if (fd < 0) {
+        std::string path = root() + (isOurs ? "/" + cgroupName_ : "") + "/cgroup.procs";
+        fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+        if (fd < 0) {
+            Logger::instance().out("cgroups: could not open %s: %s", path.c_str(), strerror(errno));
+        }
+    }
+    return fd;
+}
+
+bool CGroups::writePid(int fd, pid_t pid)
+{
+    char buf[16];
+    int len = snprintf(buf, sizeof(buf), "%d", pid);
+    // ESRCH is expected for processes which have exited in the meantime
+    return write(fd, buf, len) >= 0 || errno == ESRCH;
+}
+
+// the callers hold mutex_
+void CGroups::recordOriginalCgroups(const std::vector<pid_t> &pids)
+{
+    if (originalCgroups_.size() > kMaxOriginalCgroups) {
+        for (auto it = originalCgroups_.begin(); it != originalCgroups_.end();) {
+            if (kill(it->first, 0) != 0 && errno == ESRCH) {
+                it = originalCgroups_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    for (auto pid : pids) {
+        std::string cgroup = currentCgroup(pid);
+        if (!cgroup.empty() && !isOurCgroup(cgroup)) {
+            originalCgroups_[pid] = cgroup;
+        }
+    }
+}
+
+// the callers hold mutex_
+void CGroups::restoreOriginalCgroups(const std::vector<pid_t> &pids)
+{
+    // the processes of a batch usually come from a few cgroups, each cgroup.procs is opened once
+    std::map<std::string, std::vector<pid_t>> byCgroup;
+    for (auto pid : pids) {
+        // the processes of the app which are not in our cgroup stay where they are
+        if (isOurCgroup(currentCgroup(pid))) {
+            byCgroup[originalCgroup(pid)].push_back(pid);
+        }
+        originalCgroups_.erase(pid);
+    }
+
+    for (const auto &it : byCgroup) {
+        std::string path = cgroup2_root_ + (it.first == "/" ? "" : it.first) + "/cgroup.procs";
+        int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+        for (auto pid : it.second) {
+            // the cgroup may have been removed in the meantime, or may not take processes any more because controllers
+            // were enabled for its children; the root cgroup takes any process
+            if ((fd < 0 || !writePid(fd, pid)) && (procsFd(false) < 0 || !writePid(procsFd(false), pid))) {
+                Logger::instance().out("cgroups: could not move pid %d back: %s", pid, strerror(errno));
+            }
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+// the callers hold mutex_
+std::string CGroups::originalCgroup(pid_t pid)
+{
+    // a child forked in our cgroup has no record, it goes where its nearest ancestor with a record, or outside of our
+    // cgroup, is
+    pid_t ancestor = pid;
+    for (int depth = 0; depth < 64 && ancestor > 1; ++depth) {
+        auto it = originalCgroups_.find(ancestor);
+        if (it != originalCgroups_.end()) {
+            return it->second;
+        }
+        if (ancestor != pid) {
+            std::string cgroup = currentCgroup(ancestor);
+            if (!cgroup.empty() && !isOurCgroup(cgroup)) {
+                return cgroup;
+            }
+        }
+        ancestor = parentPid(ancestor);
+    }
+    return "/";
+}
+
+// the callers hold mutex_
+std::vector<pid_t> CGroups::pidsInOurCgroup()
+{
+    std::vector<pid_t> pids;
+    std::ifstream procs(root() + "/" + cgroupName_ + "/cgroup.procs");
+    pid_t pid;
+    while (procs >> pid) {
+        pids.push_back(pid);
+    }
+    return pids;
+}
+
+bool CGroups::isOurCgroup(const std::string &cgroup) const
+{
+    const std::string ours = "/" + cgroupName_;
+    return cgroup == ours || cgroup.rfind(ours + "/", 0) == 0;
+}
+
+// the cgroup v2 path of the process, empty if it has exited
+std::string CGroups::currentCgroup(pid_t pid)
+{
+    // read with a single syscall rather than an std::ifstream, this runs for every pid of a batch
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/cgroup", pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return std::string();
+    }
+    char buf[PATH_MAX + 64];
+    ssize_t len = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0) {
+        return std::string();
+    }
+    buf[len] = '\0';
+
+    // "0::<path>" is the line of the v2 hierarchy, the other lines are of v1 hierarchies
+    const char *line = buf;
+    while (line) {
+        const char *end = strchr(line, '\n');
+        if (strncmp(line, "0::", 3) == 0) {
+            return end ? std::string(line + 3, end) : std::string(line + 3);
+        }
+        line = end ? end + 1 : nullptr;
     }
     return std::string();
 }
 
+pid_t CGroups::parentPid(pid_t pid)
+{
+    // "<pid> (<comm>) <state> <ppid> ...", the command may contain spaces and parentheses
+    std::ifstream file("/proc/" + std::to_string(pid) + "/stat");
+    std::string stat;
+    std::getline(file, stat);
+    size_t pos = stat.rfind(')');
+    if (pos == std::string::npos) {
+        return 0;
+    }
+    std::istringstream fields(stat.substr(pos + 1));
+    std::string state;
+    pid_t ppid = 0;
+    fields >> state >> ppid;
+    return ppid;
+}
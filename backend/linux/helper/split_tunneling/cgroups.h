@@ -1,6 +1,10 @@
 #pragma once
 
+#include <map>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include "../../../posix_common/helper_commands.h"
 
 class CGroups
@@ -17,18 +21,62 @@ public:
 
     void addApp(pid_t pid);
     void removeApp(pid_t pid);
+    // move a batch of processes, returns the time it took in microseconds
+    long long addApps(const std::vector<pid_t> &pids);
+    long long removeApps(const std::vector<pid_t> &pids);
 
     std::string mark() const { return mark_; };
     std::string netClassId() const { return netClassId_; };
+    // iptables arguments matching the processes in our cgroup, or those outside of it if isInverted is set.
+    // With cgroup v2 the match is on the cgroup a socket was created in: the sockets a process opened before it was
+    // moved keep the route they had, only its new connections follow the split tunneling rules. net_cls updates the
+    // class id of the existing sockets of a moved process.
+    std::vector<std::string> iptablesMatch(bool isInverted) const;
 
 private:
     const std::string mark_ = "0xdecafbad";
     const std::string netClassId_ = "0xcafecafe";
+    const std::string cgroupName_ = "windscribe";
 
+    std::mutex mutex_;
+
+    // mount points found in /proc/self/mountinfo, parsed once and again only if net_cls was not mounted yet
+    bool isMountsParsed_;
     std::string net_cls_root_;
+    std::string cgroup2_mount_;
+    // set if the net_cls controller is unavailable and the cgroup v2 hierarchy is used instead,
+    // with the processes matched by cgroup path rather than by class id
+    std::string cgroup2_root_;
+    bool isVersionDetected_;
+
+    // cgroup.procs of our cgroup and of the root cgroup, kept open while split tunneling is enabled
+    int procsFd_;
+    int rootProcsFd_;
+
+    // cgroup v2 only: the cgroups, relative to the root, the processes were in before they were moved to ours. They are
+    // put back there when removed, rather than in the root cgroup, which would take them out of their systemd scopes.
+    std::unordered_map<pid_t, std::string> originalCgroups_;
+    // records of exited processes are dropped when there are more than this
+    static constexpr size_t kMaxOriginalCgroups = 4096;
 
     CGroups();
     ~CGroups();
 
+    void parseMounts();
     std::string findNetclsRoot();
+    void detectVersion();
+    std::string root();
+    void closeProcsFiles();
+    long long writePids(bool isOurs, const std::vector<pid_t> &pids);
+    int procsFd(bool isOurs);
+    static bool writePid(int fd, pid_t pid);
+
+    // cgroup v2
+    void recordOriginalCgroups(const std::vector<pid_t> &pids);
+    void restoreOriginalCgroups(const std::vector<pid_t> &pids);
+    std::string originalCgroup(pid_t pid);
+    std::vector<pid_t> pidsInOurCgroup();
+    bool isOurCgroup(const std::string &cgroup) const;
+    static std::string currentCgroup(pid_t pid);
+    static pid_t parentPid(pid_t pid);
 };
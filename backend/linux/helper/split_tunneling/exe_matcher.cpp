@@ -0,0 +1,103 @@
+#include "exe_matcher.h"
+
+#include <climits>
+#include <cstdio>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void ExeMatcher::setExes(const std::vector<std::string> &exes)
+{
+    ids_.clear();
+    paths_.clear();
+    patternExes_.clear();
+    pathResults_.clear();
+
+    for (const auto &exe : exes) {
+        if (exe.find("/snap/") != std::string::npos || exe.rfind("/app/", 0) == 0) {
+            patternExes_.push_back(exe);
+            continue;
+        }
+
+        // the path as well, since a package upgrade replaces the file and its inode
+        paths_.insert(exe);
+        struct stat st;
+        if (stat(exe.c_str(), &st) == 0) {
+            ids_.insert(ExeId{st.st_dev, st.st_ino});
+        }
+    }
+}
+
+bool ExeMatcher::matches(pid_t pid) const
+{
+    char procPath[32];
+    snprintf(procPath, sizeof(procPath), "/proc/%d/exe", pid);
+
+    struct stat st;
+    if (stat(procPath, &st) != 0) {
+        return false;
+    }
+    if (ids_.find(ExeId{st.st_dev, st.st_ino}) != ids_.end()) {
+        return true;
+    }
+    if (paths_.empty() && patternExes_.empty()) {
+        return false;
+    }
+
+    const ExeVersion version{st.st_dev, st.st_ino, st.st_mtim.tv_sec, st.st_mtim.tv_nsec};
+    auto it = pathResults_.find(version);
+    if (it != pathResults_.end()) {
+        return it->second;
+    }
+
+    char buf[PATH_MAX];
+    ssize_t len = readlink(procPath, buf, sizeof(buf) - 1);
+    if (len < 0) {
+        return false;
+    }
+    const bool isMatch = matchesPath(std::string(buf, len));
+
+    if (pathResults_.size() >= kMaxCachedResults) {
+        pathResults_.clear();
+    }
+    pathResults_.emplace(version, isMatch);
+    return isMatch;
+}
+
+bool ExeMatcher::matchesPath(const std::string &cmd) const
+{
+    if (paths_.find(cmd) != paths_.end()) {
+        return true;
+    }
+    for (const auto &exe : patternExes_) {
+        if (matchesPattern(cmd, exe)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ExeMatcher::matchesPattern(const std::string &cmd, const std::string &exe)
+{
+    if (cmd == exe) {
+        return true;
+    }
+
+    std::string suffix = exe.substr(exe.rfind("/"));
+    bool hasSuffix = cmd.size() >= suffix.size() && cmd.compare(cmd.size() - suffix.size(), suffix.size(), suffix) == 0;
+
+    // handle snap
+    size_t idx = exe.find("/snap/");
+    if (idx != std::string::npos) {
+        std::string prefix = exe.substr(0, idx + 6);
+        if (cmd.rfind(prefix, 0) == 0 && hasSuffix) {
+            return true;
+        }
+    }
+
+    // handle flatpak
+    if (cmd.rfind("/app/", 0) == 0 && exe.rfind("/app/", 0) == 0 && hasSuffix) {
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Matches processes against a list of executables with a stat() of /proc/<pid>/exe. The executables of the list are
+// identified by device and inode. Any other executable is matched by its path, which is read only the first time the
+// executable is seen: the result is cached by its device, inode and modification time. The paths match snap and flatpak
+// apps (their paths contain versions), executables which could not be found when the list was set, and executables
+// which were replaced by an upgrade since. Not thread-safe, because of the cache.
+class ExeMatcher
+{
+public:
+    void setExes(const std::vector<std::string> &exes);
+    bool isEmpty() const { return ids_.empty() && paths_.empty() && patternExes_.empty(); }
+    bool matches(pid_t pid) const;
+
+private:
+    struct ExeId
+    {
+        dev_t dev;
+        ino_t ino;
+        bool operator==(const ExeId &other) const { return dev == other.dev && ino == other.ino; }
+    };
+
+    struct ExeIdHash
+    {
+        size_t operator()(const ExeId &id) const { return std::hash<ino_t>()(id.ino) ^ (std::hash<dev_t>()(id.dev) << 1); }
+    };
+
+    // a new file may get the inode of a deleted one, the modification time tells them apart
+    struct ExeVersion
+    {
+        dev_t dev;
+        ino_t ino;
+        time_t mtimeSec;
+        long mtimeNsec;
+        bool operator==(const ExeVersion &other) const
+        {
+            return dev == other.dev && ino == other.ino && mtimeSec == other.mtimeSec && mtimeNsec == other.mtimeNsec;
+        }
+    };
+
+    struct ExeVersionHash
+    {
+        size_t operator()(const ExeVersion &version) const
+        {
+            return ExeIdHash()(ExeId{version.dev, version.ino}) ^ (std::hash<long>()(version.mtimeNsec) << 2);
+        }
+    };
+
+    // the cache is dropped when full, a busy system runs far fewer distinct executables
+    static constexpr size_t kMaxCachedResults = 4096;
+
+    std::unordered_set<ExeId, ExeIdHash> ids_;
+    std::unordered_set<std::string> paths_;
+    std::vector<std::string> patternExes_;
+    // whether the path of an executable outside of ids_ matches
+    mutable std::unordered_map<ExeVersion, bool, ExeVersionHash> pathResults_;
+
+    bool matchesPath(const std::string &cmd) const;
+    static bool matchesPattern(const std::string &cmd, const std::string &exe);
+};
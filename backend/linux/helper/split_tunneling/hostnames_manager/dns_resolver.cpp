@@ -1,4 +1,8 @@
 #include "dns_resolver.h"
+
+#include <algorithm>
+#include <set>
+
 #include "../../logger.h"
 
 using namespace wsnet;
@@ -35,8 +39,12 @@ void DnsResolver::onDnsResolved(uint64_t requestId, const std::string &hostname,
 
         HostInfo hi;
         hi.hostname = hostname;
-        hi.addresses = result->ips();
         hi.error = result->isError();
+        hi.ttl = result->ttl();
+        if (!hi.error) {
+            int newAddresses;
+            mergeAddresses(hi, result->ips(), newAddresses);
+        }
         results_[hostname] = hi;
         activeRequests_.erase(request);
         if (activeRequests_.empty()) {
@@ -53,7 +61,7 @@ void DnsResolver::onDnsResolved(uint64_t requestId, const std::string &hostname,
                 timer_.emplace(boost::asio::deadline_timer(io_service_, boost::posix_time::millisec(kRetryTimeoutMs)));
                 timer_->async_wait(std::bind(&DnsResolver::onTimer, this, std::placeholders::_1));
             } else {
-                resolveDomainsCallback_(results_);
+                onResolvingFinished();
             }
         }
     });
@@ -65,19 +73,151 @@ void DnsResolver::onTimer(const boost::system::error_code &error)
     if (error.value() == 0) {
         // repeat failed requests if the timeout allows
         if (sinceHelper(startTime_).count() >= kMaxTimeoutMs) {
-            resolveDomainsCallback_(results_);
+            onResolvingFinished();
         } else {
             for (const auto &it: results_) {
                 if (it.second.error) {
                     using namespace std::placeholders;
                     auto request = WSNet::instance()->dnsResolver()->lookup(it.first, curRequestId_, std::bind(&DnsResolver::onDnsResolved, this, _1, _2, _3));
                     activeRequests_.insert(std::make_pair(curRequestId_, request));
+                    curRequestId_++;
                 }
             }
         }
     }
 }
 
+void DnsResolver::onResolvingFinished()
+{
+    for (const auto &it : results_) {
+        scheduleRefresh(it.first, it.second.ttl, it.second.error);
+    }
+    startRefreshTimer();
+    resolveDomainsCallback_(results_);
+}
+
+void DnsResolver::onRefreshResolved(uint64_t requestId, const std::string &hostname, std::shared_ptr<wsnet::WSNetDnsRequestResult> result)
+{
+    boost::asio::post(io_service_,[this, requestId, hostname, result] {
+        auto request = refreshRequests_.find(requestId);
+        if (request == refreshRequests_.end())
+            return;
+        refreshRequests_.erase(request);
+
+        auto startTime = std::chrono::steady_clock::now();
+        HostInfo &hi = results_[hostname];
+        hi.hostname = hostname;
+
+        // keep the previous addresses if the refresh failed, they are better than nothing
+        if (result->isError()) {
+            Logger::instance().out("DnsResolver: refresh of %s failed: %s", hostname.c_str(), result->errorString().c_str());
+            scheduleRefresh(hostname, 0, true);
+            startRefreshTimer();
+            return;
+        }
+
+        int newAddresses = 0;
+        bool isChanged = mergeAddresses(hi, result->ips(), newAddresses) || hi.error;
+        hi.error = false;
+        hi.ttl = result->ttl();
+        scheduleRefresh(hostname, hi.ttl, false);
+        startRefreshTimer();
+
+        if (isChanged) {
+            Logger::instance().out("DnsResolver: addresses of %s changed, %d new, ttl %u", hostname.c_str(), newAddresses, hi.ttl);
+            resolveDomainsCallback_(results_);
+        }
+
+        // the latency includes applying the changes to the routes and the firewall in the callback
+        std::uint32_t latencyMs = result->elapsedMs() + (std::uint32_t)sinceHelper(startTime).count();
+        stats_.refreshes++;
+        stats_.staleIpMisses += newAddresses;
+        stats_.maxLatencyMs = std::max(stats_.maxLatencyMs, latencyMs);
+        stats_.totalLatencyMs += latencyMs;
+        if (isChanged) {
+            Logger::instance().out("DnsResolver: refreshes %llu, stale IP misses %llu, latency %u ms (avg %llu ms, max %u ms)",
+                                   (unsigned long long)stats_.refreshes, (unsigned long long)stats_.staleIpMisses, latencyMs,
+                                   (unsigned long long)(stats_.totalLatencyMs / stats_.refreshes), stats_.maxLatencyMs);
+        }
+    });
+}
+
+void DnsResolver::onRefreshTimer(const boost::system::error_code &error)
+{
+    // the timer was cancelled or restarted
+    if (error.value() != 0)
+        return;
+
+    auto now = std::chrono::steady_clock::now();
+    for (auto it = refreshDeadlines_.begin(); it != refreshDeadlines_.end();) {
+        if (it->second <= now) {
+            using namespace std::placeholders;
+            auto request = WSNet::instance()->dnsResolver()->lookup(it->first, curRequestId_, std::bind(&DnsResolver::onRefreshResolved, this, _1, _2, _3));
+            refreshRequests_.insert(std::make_pair(curRequestId_, request));
+            curRequestId_++;
+            it = refreshDeadlines_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    startRefreshTimer();
+}
+
+void DnsResolver::scheduleRefresh(const std::string &hostname, std::uint32_t ttl, bool isError)
+{
+    std::uint32_t intervalS = kDefaultRefreshIntervalS;
+    if (!isError && ttl != 0) {
+        intervalS = std::clamp<std::uint32_t>(ttl, kMinRefreshIntervalS, kMaxRefreshIntervalS);
+    }
+    refreshDeadlines_[hostname] = std::chrono::steady_clock::now() + std::chrono::seconds(intervalS);
+}
+
+void DnsResolver::startRefreshTimer()
+{
+    if (refreshDeadlines_.empty()) {
+        refreshTimer_.reset();
+        return;
+    }
+
+    auto earliest = std::min_element(refreshDeadlines_.begin(), refreshDeadlines_.end(),
+                                     [](const auto &a, const auto &b) { return a.second < b.second; })->second;
+    auto timeoutMs = std::chrono::duration_cast<std::chrono::milliseconds>(earliest - std::chrono::steady_clock::now()).count();
+    refreshTimer_.emplace(boost::asio::deadline_timer(io_service_, boost::posix_time::millisec(std::max<long long>(timeoutMs, 0))));
+    refreshTimer_->async_wait(std::bind(&DnsResolver::onRefreshTimer, this, std::placeholders::_1));
+}
+
+bool DnsResolver::mergeAddresses(HostInfo &hi, const std::vector<std::string> &addresses, int &newAddresses)
+{
+    auto now = std::chrono::steady_clock::now();
+    auto &seen = addressesSeen_[hi.hostname];
+    for (const auto &addr : addresses) {
+        seen[addr] = now;
+    }
+    for (auto it = seen.begin(); it != seen.end();) {
+        if (now - it->second > std::chrono::seconds(kKeepDroppedAddressesS)) {
+            it = seen.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    std::set<std::string> prev(hi.addresses.begin(), hi.addresses.end());
+    newAddresses = 0;
+    for (const auto &addr : addresses) {
+        if (prev.find(addr) == prev.end()) {
+            newAddresses++;
+        }
+    }
+
+    std::vector<std::string> merged;
+    for (const auto &it : seen) {
+        merged.push_back(it.first);
+    }
+    bool isChanged = merged.size() != prev.size() || !std::equal(merged.begin(), merged.end(), prev.begin());
+    hi.addresses = merged;
+    return isChanged;
+}
+
 void DnsResolver::resolveDomains(const std::vector<std::string> &hostnames)
 {
     timer_.reset();
@@ -100,6 +240,12 @@ void DnsResolver::cancelAll()
         for (auto &request : activeRequests_)
             request.second->cancel();
         activeRequests_.clear();
+        for (auto &request : refreshRequests_)
+            request.second->cancel();
+        refreshRequests_.clear();
+        refreshDeadlines_.clear();
+        refreshTimer_.reset();
+        addressesSeen_.clear();
         results_.clear();
     });
 }
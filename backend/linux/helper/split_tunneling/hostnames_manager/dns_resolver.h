@@ -26,6 +26,7 @@ public:
         std::string hostname;
         std::vector<std::string> addresses;
         bool error = false;
+        std::uint32_t ttl = 0;
     };
 
     explicit DnsResolver(std::function<void(std::map<std::string, HostInfo>)> resolveDomainsCallback);
@@ -33,6 +34,8 @@ public:
     DnsResolver(const DnsResolver &) = delete;
     DnsResolver &operator=(const DnsResolver &) = delete;
 
+    // the callback is called once all hostnames are resolved (or the retry timeout expired), and then again
+    // each time a refresh, scheduled according to the TTL of the records, changes the addresses
     void resolveDomains(const std::vector<std::string> &hostnames);
     void cancelAll();
 
@@ -41,6 +44,23 @@ private:
     static constexpr int kMaxTimeoutMs = 10 * 1000;
     // time after which to repeat failed requests
     static constexpr int kRetryTimeoutMs = 500;
+    // bounds of the refresh interval, the TTL of the records is used within them
+    static constexpr int kMinRefreshIntervalS = 30;
+    static constexpr int kMaxRefreshIntervalS = 3600;
+    // the interval for records without a TTL and for failed refreshes
+    static constexpr int kDefaultRefreshIntervalS = 300;
+    // addresses dropped from an answer are kept routed for a while, since applications may have cached them
+    static constexpr int kKeepDroppedAddressesS = 600;
+
+    // logged whenever a refresh changes the addresses
+    struct RefreshStats
+    {
+        std::uint64_t refreshes = 0;
+        // addresses which appeared in a refreshed answer before they were routed
+        std::uint64_t staleIpMisses = 0;
+        std::uint32_t maxLatencyMs = 0;
+        std::uint64_t totalLatencyMs = 0;
+    };
 
     std::function<void(std::map<std::string, HostInfo>)> resolveDomainsCallback_;
     boost::asio::io_service io_service_;
@@ -54,7 +74,22 @@ private:
 
     std::chrono::time_point<std::chrono::steady_clock> startTime_;
 
+    // refreshes after the initial resolution
+    std::optional<boost::asio::deadline_timer> refreshTimer_;
+    std::map<std::string, std::chrono::steady_clock::time_point> refreshDeadlines_;
+    std::map<uint64_t, std::shared_ptr<wsnet::WSNetCancelableCallback>> refreshRequests_;
+    // the time each address was last seen in an answer, per hostname
+    std::map<std::string, std::map<std::string, std::chrono::steady_clock::time_point>> addressesSeen_;
+
+    RefreshStats stats_;
+
     void onDnsResolved(std::uint64_t requestId, const std::string &hostname, std::shared_ptr<wsnet::WSNetDnsRequestResult> result);
     void onTimer(const boost::system::error_code& error);
+    void onRefreshResolved(std::uint64_t requestId, const std::string &hostname, std::shared_ptr<wsnet::WSNetDnsRequestResult> result);
+    void onRefreshTimer(const boost::system::error_code& error);
+    void onResolvingFinished();
+    void scheduleRefresh(const std::string &hostname, std::uint32_t ttl, bool isError);
+    void startRefreshTimer();
+    bool mergeAddresses(HostInfo &hi, const std::vector<std::string> &addresses, int &newAddresses);
 };
 
@@ -1,72 +1,89 @@
 #include "ip_routes.h"
 
-#include <set>
-
 #include "../../logger.h"
-#include "../../utils.h"
+
+IpRoutes::IpRoutes() : isRuleAdded_(false)
+{
+}
 
 void IpRoutes::setIps(const std::string &defaultRouteIp, const std::vector<std::string> &ips)
 {
     std::lock_guard<std::recursive_mutex> guard(mutex_);
 
     // exclude duplicates
-    std::set<std::string> ipsSet;
-    for (auto ip = ips.begin(); ip != ips.end(); ++ip) {
-        ipsSet.insert(*ip);
+    std::set<std::string> ipsSet(ips.begin(), ips.end());
+
+    if (!isRuleAdded_) {
+        // remove leftovers, e.g. if the helper was not stopped gracefully
+        netlink_.deleteRule(kRoutingTable, kRulePriority);
+        netlink_.flushTable(kRoutingTable);
+        netlink_.addRule(kRoutingTable, kRulePriority);
+        isRuleAdded_ = true;
     }
 
-    // find route which need to delete
-    std::set<std::string> ipsDelete;
-    for (auto it = activeRoutes_.begin(); it != activeRoutes_.end(); ++it) {
-        if (it->second.defaultRouteIp != defaultRouteIp || ipsSet.find(it->first) == ipsSet.end()) {
-            ipsDelete.insert(it->first);
+    // if the gateway has changed, all routes need to be replaced
+    if (defaultRouteIp != defaultRouteIp_) {
+        for (const auto &ip : activeRoutes_) {
+            netlink_.deleteRoute(ip, defaultRouteIp_, kRoutingTable);
         }
+        activeRoutes_.clear();
+        defaultRouteIp_ = defaultRouteIp;
     }
 
-    // delete routes
-    for (auto ip = ipsDelete.begin(); ip != ipsDelete.end(); ++ip) {
-        auto fr = activeRoutes_.find(*ip);
-        if (fr != activeRoutes_.end()) {
-            deleteRoute(fr->second);
-            activeRoutes_.erase(fr);
+    // only touch the prefixes that have changed
+    int deleted = 0;
+    for (auto it = activeRoutes_.begin(); it != activeRoutes_.end();) {
+        if (ipsSet.find(*it) == ipsSet.end()) {
+            netlink_.deleteRoute(*it, defaultRouteIp_, kRoutingTable);
+            it = activeRoutes_.erase(it);
+            deleted++;
+        } else {
+            ++it;
         }
     }
 
-    // add routes
-    for (auto ip = ipsSet.begin(); ip != ipsSet.end(); ++ip) {
-        auto ar = activeRoutes_.find(*ip);
-        if (ar != activeRoutes_.end()) {
-            continue;
-        } else {
-            RouteDescr rd;
-            rd.ip = *ip;
-            rd.defaultRouteIp = defaultRouteIp;
-            addRoute(rd);
-            activeRoutes_[*ip] = rd;
+    int added = 0;
+    for (const auto &ip : ipsSet) {
+        if (activeRoutes_.find(ip) == activeRoutes_.end() && netlink_.addRoute(ip, defaultRouteIp_, kRoutingTable)) {
+            activeRoutes_.insert(ip);
+            added++;
         }
     }
+
+    // a route the kernel didn't take is not active, so that the next call adds it again; one it didn't remove stays
+    // active unless it is wanted, so that the next call removes it again
+    std::set<std::string> failedAdds;
+    std::set<std::string> failedDeletes;
+    int failed = netlink_.commit(&failedAdds, &failedDeletes);
+    for (const auto &ip : failedAdds) {
+        if (activeRoutes_.erase(ip) > 0) {
+            added--;
+        }
+    }
+    for (const auto &ip : failedDeletes) {
+        if (ipsSet.find(ip) == ipsSet.end()) {
+            activeRoutes_.insert(ip);
+        }
+    }
+    Logger::instance().out("IpRoutes::setIps(), via %s: added %d, deleted %d, failed %d", defaultRouteIp_.c_str(), added, deleted, failed);
 }
 
 void IpRoutes::clear()
 {
     std::lock_guard<std::recursive_mutex> guard(mutex_);
-    for (auto it = activeRoutes_.begin(); it != activeRoutes_.end(); ++it) {
-        deleteRoute(it->second);
-    }
-    activeRoutes_.clear();
-}
 
-void IpRoutes::addRoute(const RouteDescr &rd)
-{
-    std::string cmd = "ip route add " + rd.ip + " via " + rd.defaultRouteIp;
-    Logger::instance().out("cmd: %s", cmd.c_str());
+    if (!isRuleAdded_) {
+        return;
+    }
 
-    Utils::executeCommand(cmd);
-}
+    for (const auto &ip : activeRoutes_) {
+        netlink_.deleteRoute(ip, defaultRouteIp_, kRoutingTable);
+    }
+    netlink_.deleteRule(kRoutingTable, kRulePriority);
+    int failed = netlink_.commit();
+    Logger::instance().out("IpRoutes::clear(), deleted %zu routes, failed %d", activeRoutes_.size(), failed);
 
-void IpRoutes::deleteRoute(const RouteDescr &rd)
-{
-    std::string cmd = "ip route del " + rd.ip + " via " + rd.defaultRouteIp;
-    Logger::instance().out("cmd: %s", cmd.c_str());
-    Utils::executeCommand(cmd);
+    activeRoutes_.clear();
+    defaultRouteIp_.clear();
+    isRuleAdded_ = false;
 }
@@ -3,26 +3,29 @@
 #include <string>
 #include <vector>
 #include <mutex>
-#include <map>
+#include <set>
 
-// manage Ip route via "route add" and "route delete" commands
+#include "../../routes_manager/netlink_routes.h"
+
+// manage Ip routes for split tunneling hostnames/IPs in a dedicated routing table via rtnetlink
 class IpRoutes
 {
 public:
+    IpRoutes();
+
     void setIps(const std::string &defaultRouteIp, const std::vector<std::string> &ips);
     void clear();
 
 private:
-    std::recursive_mutex mutex_;
+    // dedicated routing table and the rule that makes it take precedence over the main table
+    // and the split tunneling tables ("windscribe" 69, "windscribe_include" 70)
+    static constexpr uint32_t kRoutingTable = 71;
+    static constexpr uint32_t kRulePriority = 16380;
 
-    struct RouteDescr
-    {
-        std::string defaultRouteIp;
-        std::string ip;
-    };
-
-    std::map<std::string, RouteDescr> activeRoutes_;
+    std::recursive_mutex mutex_;
+    NetlinkRoutes netlink_;
 
-    void addRoute(const RouteDescr &rd);
-    void deleteRoute(const RouteDescr &rd);
+    bool isRuleAdded_;
+    std::string defaultRouteIp_;
+    std::set<std::string> activeRoutes_;
 };
@@ -1,63 +1,71 @@
 #include "process_monitor.h"
 
 #include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
 #include <cstring>
 #include <dirent.h>
-#include <fstream>
-#include <iterator>
+#include <linux/filter.h>
 #include <linux/netlink.h>
 #include <linux/connector.h>
 #include <linux/cn_proc.h>
-#include <sstream>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include "cgroups.h"
 #include "../logger.h"
 #include "../utils.h"
 
-void ProcessMonitor::monitorWorker(void *ctx)
+void ProcessMonitor::monitorWorker()
 {
-    int sock = *(int *)ctx;
     int ret;
-    struct __attribute__ ((aligned(NLMSG_ALIGNTO))) {
-        struct nlmsghdr nl_hdr;
-        struct __attribute__ ((__packed__)) {
-            struct cn_msg cn_msg;
-            struct proc_event proc_ev;
-        };
-    } nlcn_msg;
+    // a netlink header, the connector message and the event; cn_msg ends in a flexible array member, which newer
+    // kernel headers don't allow in the middle of a struct, so the message is taken apart from a buffer
+    __attribute__ ((aligned(NLMSG_ALIGNTO))) char buf[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(struct proc_event))];
+    const struct cn_msg *cnMsg = (const struct cn_msg *)NLMSG_DATA((struct nlmsghdr *)buf);
+    const struct proc_event *procEv = (const struct proc_event *)cnMsg->data;
+
+    // closing the socket doesn't wake up a blocked recv(), so stopMonitoring() signals stopFd_ instead
+    struct pollfd fds[] = {{sock_, POLLIN, 0}, {stopFd_, POLLIN, 0}};
 
     while (true) {
-        ret = recv(sock, &nlcn_msg, sizeof(nlcn_msg), 0);
+        ret = poll(fds, 2, -1);
+        if (ret == -1 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0 || fds[1].revents != 0 || (fds[0].revents & POLLIN) == 0) {
+            return;
+        }
+
+        ret = recv(sock_, buf, sizeof(buf), 0);
         if (ret <= 0) {
             return;
         }
 
-        std::string cmd;
-        switch (nlcn_msg.proc_ev.what) {
-            case 1: // PROC_EVENT_FORK:
-                if (compareCmd(nlcn_msg.proc_ev.event_data.fork.child_pid, apps_)) {
-                    CGroups::instance().addApp(nlcn_msg.proc_ev.event_data.fork.child_pid);
-                }
-                break;
-            case 2: // PROC_EVENT_EXEC:
-                if (compareCmd(nlcn_msg.proc_ev.event_data.exec.process_pid, apps_)) {
-                    CGroups::instance().addApp(nlcn_msg.proc_ev.event_data.exec.process_pid);
-                }
-                break;
-            case 0: // PROC_EVENT_EXIT:
-                if (compareCmd(nlcn_msg.proc_ev.event_data.exit.process_pid, apps_)) {
-                    CGroups::instance().addApp(nlcn_msg.proc_ev.event_data.exit.process_pid);
-                }
-                break;
-            default:
-                break;
+        // Only exec events matter: a forked child inherits the cgroup of its parent, and an exited process
+        // leaves the cgroup by itself. The socket filter drops the rest, this check is for the case it couldn't be attached.
+        if (procEv->what != proc_event::PROC_EVENT_EXEC) {
+            continue;
+        }
+
+        pid_t pid = procEv->event_data.exec.process_pid;
+        bool isMatch;
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            isMatch = matcher_.matches(pid);
+        }
+        if (isMatch) {
+            CGroups::instance().addApp(pid);
         }
     }
 }
 
-ProcessMonitor::ProcessMonitor() : isEnabled_(false), thread_(nullptr), sock_(-1)
+ProcessMonitor::ProcessMonitor() : isEnabled_(false), thread_(nullptr), sock_(-1), stopFd_(-1)
 {
 }
 
@@ -69,20 +77,28 @@ ProcessMonitor::~ProcessMonitor()
 void ProcessMonitor::setApps(const std::vector<std::string> &apps)
 {
     if (isEnabled_) {
+        std::vector<std::string> added;
         for (auto app : apps) {
             if (std::find(apps_.begin(), apps_.end(), app) == apps_.end()) {
-                addApp(app);
+                added.push_back(app);
             }
         }
 
+        std::vector<std::string> removed;
         for (auto app : apps_) {
             if (std::find(apps.begin(), apps.end(), app) == apps.end()) {
-                removeApp(app);
+                removed.push_back(app);
             }
         }
+
+        addApps(added);
+        removeApps(removed);
     }
 
     apps_ = apps;
+
+    std::lock_guard<std::mutex> guard(mutex_);
+    matcher_.setExes(apps_);
 }
 
 bool ProcessMonitor::enable()
@@ -93,13 +109,17 @@ bool ProcessMonitor::enable()
 
     Logger::instance().out("process monitor enable");
 
+    {
+        // refresh the inodes, executables may have been updated since the apps were set
+        std::lock_guard<std::mutex> guard(mutex_);
+        matcher_.setExes(apps_);
+    }
+
     if (!startMonitoring()) {
         return false;
     }
 
-    for (auto app : apps_) {
-        addApp(app);
-    }
+    addApps(apps_);
     isEnabled_ = true;
     return true;
 }
@@ -117,23 +137,41 @@ void ProcessMonitor::disable()
     isEnabled_ = false;
 }
 
-void ProcessMonitor::addApp(const std::string &exe) {
-    Logger::instance().out("process monitor add app: %s", exe.c_str());
-    std::vector<pid_t> pids = findPids(exe);
-    for (auto pid : pids) {
-        CGroups::instance().addApp(pid);
+void ProcessMonitor::addApps(const std::vector<std::string> &exes)
+{
+    if (exes.empty()) {
+        return;
     }
+    for (const auto &exe : exes) {
+        Logger::instance().out("process monitor add app: %s", exe.c_str());
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    ExeMatcher matcher;
+    matcher.setExes(exes);
+    std::vector<pid_t> pids = findPids(matcher);
+    long long scanUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+    long long writeUs = CGroups::instance().addApps(pids);
+    Logger::instance().out("process monitor added %zu processes, scan %lld us, cgroup writes %lld us", pids.size(), scanUs, writeUs);
 }
 
-void ProcessMonitor::removeApp(const std::string &exe) {
-    Logger::instance().out("process monitor remove app: %s", exe.c_str());
-    std::vector<pid_t> pids = findPids(exe);
-    for (auto pid : pids) {
-        CGroups::instance().removeApp(pid);
+void ProcessMonitor::removeApps(const std::vector<std::string> &exes)
+{
+    if (exes.empty()) {
+        return;
     }
+    for (const auto &exe : exes) {
+        Logger::instance().out("process monitor remove app: %s", exe.c_str());
+    }
+
+    ExeMatcher matcher;
+    matcher.setExes(exes);
+    std::vector<pid_t> pids = findPids(matcher);
+    CGroups::instance().removeApps(pids);
 }
 
-std::vector<pid_t> ProcessMonitor::findPids(const std::string &exe)
+// scans /proc once for all the executables of the matcher
+std::vector<pid_t> ProcessMonitor::findPids(const ExeMatcher &matcher)
 {
     std::vector<pid_t> pids;
 
@@ -146,11 +184,12 @@ std::vector<pid_t> ProcessMonitor::findPids(const std::string &exe)
         return pids;
     }
 
-    while (ep = readdir(dp)) {
+    while ((ep = readdir(dp))) {
         // numeric directories are pids in /proc
         if (ep->d_type == DT_DIR && ep->d_name[0] >= '0' && ep->d_name[0] <= '9') {
-            if (compareCmd(std::stoi(ep->d_name), {exe})) {
-                pids.push_back(std::stoi(ep->d_name));
+            pid_t pid = atoi(ep->d_name);
+            if (matcher.matches(pid)) {
+                pids.push_back(pid);
             }
         }
     }
@@ -159,49 +198,6 @@ std::vector<pid_t> ProcessMonitor::findPids(const std::string &exe)
     return pids;
 }
 
-bool ProcessMonitor::compareCmd(pid_t pid, const std::vector<std::string> &exes) {
-    std::string cmd = getCmdByPid(pid);
-
-    for (auto exe : exes) {
-        if (cmd == exe) {
-            return true;
-        }
-
-        // handle snap
-        int idx = exe.find("/snap/");
-        if (idx != std::string::npos) {
-            std::string prefix = exe.substr(0, idx + 6);
-            std::string suffix = exe.substr(exe.rfind("/"));
-            if (cmd.rfind(prefix, 0) == 0 && cmd.find(suffix, cmd.size() - suffix.length()) == cmd.size() - suffix.length()) {
-                return true;
-            }
-        }
-
-        // handle flatpak
-        if (cmd.rfind("/app/", 0) == 0 && exe.rfind("/app/", 0) == 0) {
-            std::string suffix = exe.substr(exe.rfind("/"));
-            if (cmd.find(suffix, cmd.size() - suffix.length()) == cmd.size() - suffix.length()) {
-                return true;
-            }
-        }
-    }
-
-    return false;
-}
-
-std::string ProcessMonitor::getCmdByPid(pid_t pid)
-{
-    char buf[PATH_MAX];
-
-    memset(buf, 0, PATH_MAX);
-
-    int ret = readlink((std::string("/proc/") + std::to_string(pid) + "/exe").c_str(), buf, PATH_MAX - 1);
-    if (ret < 0) {
-        return std::string();
-    }
-    return buf;
-}
-
 bool ProcessMonitor::startMonitoring()
 {
     if (thread_) {
@@ -214,7 +210,7 @@ bool ProcessMonitor::startMonitoring()
         return false;
     }
 
-    thread_ = new std::thread(&ProcessMonitor::monitorWorker, this, &sock_);
+    thread_ = new std::thread(&ProcessMonitor::monitorWorker, this);
     return true;
 }
 
@@ -223,7 +219,8 @@ bool ProcessMonitor::prepareMonitoring()
     int ret = 0;
     struct sockaddr_nl addr;
 
-    sock_ = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_CONNECTOR);
+    // close-on-exec: a process the helper runs would otherwise keep the socket, and its port, after disable()
+    sock_ = socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
     if (sock_ == -1) {
         Logger::instance().out("Could not open netlink socket");
         return false;
@@ -232,40 +229,56 @@ bool ProcessMonitor::prepareMonitoring()
     memset(&addr, 0, sizeof(addr));
     addr.nl_family = AF_NETLINK;
     addr.nl_groups = CN_IDX_PROC;
-    addr.nl_pid = getpid();
+    // the kernel picks a free port
+    addr.nl_pid = 0;
 
     ret = bind(sock_, (struct sockaddr *)&addr, sizeof(addr));
     if (ret == -1) {
         Logger::instance().out("Could not bind netlink socket");
-        close(sock_);
-        sock_ = -1;
+        closeSockets();
+        return false;
+    }
+
+    stopFd_ = eventfd(0, EFD_CLOEXEC);
+    if (stopFd_ == -1) {
+        Logger::instance().out("Could not create the stop event of the process monitor");
+        closeSockets();
         return false;
     }
 
+    // Drop everything but exec events in the kernel, so that the fork/exit storm of a busy system doesn't wake up
+    // the monitor thread. BPF_ABS loads are big-endian, hence htonl() for the compared value.
+    struct sock_filter filter[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, NLMSG_LENGTH(0) + offsetof(struct cn_msg, data) + offsetof(struct proc_event, what)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(proc_event::PROC_EVENT_EXEC), 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, 0xffffffff),
+        BPF_STMT(BPF_RET | BPF_K, 0),
+    };
+    struct sock_fprog fprog;
+    fprog.len = sizeof(filter) / sizeof(filter[0]);
+    fprog.filter = filter;
+    if (setsockopt(sock_, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) == -1) {
+        Logger::instance().out("Could not attach the process events filter");
+    }
+
     // Request for events
-    struct __attribute__ ((aligned(NLMSG_ALIGNTO))) {
-        struct nlmsghdr nl_hdr;
-        struct __attribute__ ((__packed__)) {
-            struct cn_msg cn_msg;
-            enum proc_cn_mcast_op cn_mcast;
-        };
-    } nlcn_msg;
-
-    memset(&nlcn_msg, 0, sizeof(nlcn_msg));
-    nlcn_msg.nl_hdr.nlmsg_len = sizeof(nlcn_msg);
-    nlcn_msg.nl_hdr.nlmsg_pid = getpid();
-    nlcn_msg.nl_hdr.nlmsg_type = NLMSG_DONE;
-
-    nlcn_msg.cn_msg.id.idx = CN_IDX_PROC;
-    nlcn_msg.cn_msg.id.val = CN_VAL_PROC;
-    nlcn_msg.cn_msg.len = sizeof(enum proc_cn_mcast_op);
-    nlcn_msg.cn_mcast = PROC_CN_MCAST_LISTEN;
-
-    ret = send(sock_, &nlcn_msg, sizeof(nlcn_msg), 0);
+    __attribute__ ((aligned(NLMSG_ALIGNTO))) char buf[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))];
+    memset(buf, 0, sizeof(buf));
+    struct nlmsghdr *nlHdr = (struct nlmsghdr *)buf;
+    nlHdr->nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op));
+    nlHdr->nlmsg_pid = 0;
+    nlHdr->nlmsg_type = NLMSG_DONE;
+
+    struct cn_msg *cnMsg = (struct cn_msg *)NLMSG_DATA(nlHdr);
+    cnMsg->id.idx = CN_IDX_PROC;
+    cnMsg->id.val = CN_VAL_PROC;
+    cnMsg->len = sizeof(enum proc_cn_mcast_op);
+    *(enum proc_cn_mcast_op *)cnMsg->data = PROC_CN_MCAST_LISTEN;
+
+    ret = send(sock_, buf, nlHdr->nlmsg_len, 0);
     if (ret == -1) {
         Logger::instance().out("Could not request events");
-        close(sock_);
-        sock_ = -1;
+        closeSockets();
         return false;
     }
     return true;
@@ -273,15 +286,29 @@ bool ProcessMonitor::prepareMonitoring()
 
 void ProcessMonitor::stopMonitoring()
 {
-    // closing the socket will cause the thread to exit
-    close(sock_);
-    sock_ = -1;
-
     if (thread_) {
+        uint64_t stop = 1;
+        if (write(stopFd_, &stop, sizeof(stop)) != sizeof(stop)) {
+            Logger::instance().out("Could not signal the process monitor to stop");
+        }
         thread_->join();
         delete thread_;
         thread_ = nullptr;
     }
+
+    closeSockets();
+}
+
+void ProcessMonitor::closeSockets()
+{
+    if (sock_ != -1) {
+        close(sock_);
+        sock_ = -1;
+    }
+    if (stopFd_ != -1) {
+        close(stopFd_);
+        stopFd_ = -1;
+    }
 }
 
 
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <mutex>
 #include <string>
 #include <thread>
 #include <vector>
 
+#include "exe_matcher.h"
+
 class ProcessMonitor
 {
 public:
@@ -22,19 +25,23 @@ private:
     std::vector<std::string> apps_;
     std::thread *thread_;
     int sock_;
+    // an eventfd that wakes up the monitor thread to stop it
+    int stopFd_;
+
+    // guards matcher_, which is used by the monitor thread
+    std::mutex mutex_;
+    ExeMatcher matcher_;
 
     ProcessMonitor();
     ~ProcessMonitor();
 
-    void addApp(const std::string &exe);
-    void removeApp(const std::string &exe);
-    std::vector<pid_t> findPids(const std::string &exe);
-    std::string getCmdByPid(pid_t pid);
+    void addApps(const std::vector<std::string> &exes);
+    void removeApps(const std::vector<std::string> &exes);
+    std::vector<pid_t> findPids(const ExeMatcher &matcher);
 
     bool prepareMonitoring();
     bool startMonitoring();
     void stopMonitoring();
-    void monitorWorker(void *ctx);
-    bool compareCmd(pid_t pid, const std::vector<std::string> &exes);
+    void closeSockets();
+    void monitorWorker();
 };
-
@@ -1,4 +1,7 @@
 #include "split_tunneling.h"
+
+#include <chrono>
+
 #include "../firewallcontroller.h"
 #include "../logger.h"
 #include "../utils.h"
@@ -48,6 +51,7 @@ bool SplitTunneling::updateState()
 {
     if (connectStatus_.isConnected && isSplitTunnelActive_) {
         if (!apps_.empty()) {
+            auto startTime = std::chrono::steady_clock::now();
             std::string gw = connectStatus_.vpnAdapter.adapterIp;
             if (connectStatus_.protocol == kCmdProtocolOpenvpn || connectStatus_.protocol == kCmdProtocolStunnelOrWstunnel) {
                 gw = connectStatus_.vpnAdapter.gatewayIp;
@@ -61,6 +65,8 @@ bool SplitTunneling::updateState()
             if (!ret) {
                 return ret;
             }
+            Logger::instance().out("split tunneling for %zu apps enabled in %lld ms", apps_.size(),
+                                   (long long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count());
         }
 
         if (isExclude_) {
@@ -73,8 +79,9 @@ bool SplitTunneling::updateState()
             }
         }
     } else {
-        CGroups::instance().disable();
+        // no more processes are moved to our cgroup while it is emptied
         ProcessMonitor::instance().disable();
+        CGroups::instance().disable();
         hostnamesManager_.disable();
     }
 
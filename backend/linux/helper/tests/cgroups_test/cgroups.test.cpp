@@ -0,0 +1,193 @@
+// Tests the cgroup v2 backend of CGroups in a private mount namespace, where the cgroup2 hierarchy is mounted at
+// /sys/fs/cgroup, as on a pure v2 system. The cgroups of the test are created in the real hierarchy and removed at exit.
+// Also measures how long moving the processes of a 500-process app set takes, against an std::ofstream per pid.
+
+#include <algorithm>
+#include <csignal>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <vector>
+
+#include "test_utils.h"
+#include "../../split_tunneling/cgroups.h"
+
+using namespace TestUtils;
+
+namespace {
+
+const std::string kRoot = "/sys/fs/cgroup";
+// the cgroups the processes of the test start in, e.g. their systemd scopes
+const std::string kAppCgroup = "/windscribe_test_app";
+const std::string kOtherCgroup = "/windscribe_test_other";
+
+std::vector<pid_t> children;
+
+void forkOnSignal(int)
+{
+    // the child of a process of the app, started after the app was moved
+    fork();
+}
+
+pid_t spawn(const std::string &cgroup)
+{
+    pid_t pid = fork();
+    if (pid == 0) {
+        signal(SIGUSR1, forkOnSignal);
+        while (true) {
+            pause();
+        }
+    }
+    CHECK(pid > 0);
+    CHECK(writeFile(kRoot + cgroup + "/cgroup.procs", std::to_string(pid)));
+    children.push_back(pid);
+    return pid;
+}
+
+std::vector<pid_t> pidsIn(const std::string &cgroup)
+{
+    std::vector<pid_t> pids;
+    std::ifstream procs(kRoot + cgroup + "/cgroup.procs");
+    pid_t pid;
+    while (procs >> pid) {
+        pids.push_back(pid);
+    }
+    return pids;
+}
+
+void cleanUp()
+{
+    for (const std::string cgroup : {std::string("/windscribe"), kAppCgroup, kOtherCgroup}) {
+        for (auto pid : pidsIn(cgroup)) {
+            kill(pid, SIGKILL);
+        }
+    }
+    for (auto pid : children) {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+    children.clear();
+    // the killed processes leave their cgroups asynchronously
+    for (int i = 0; i < 100 && !pidsIn(kAppCgroup).empty(); ++i) {
+        usleep(10000);
+    }
+    rmdir((kRoot + "/windscribe").c_str());
+    rmdir((kRoot + kAppCgroup).c_str());
+    rmdir((kRoot + kOtherCgroup).c_str());
+}
+
+void testRestoreOriginalCgroups()
+{
+    CMD_SEND_CONNECT_STATUS connectStatus = {};
+    CHECK(CGroups::instance().enable(connectStatus, false, true));
+    const std::vector<std::string> match = CGroups::instance().iptablesMatch(false);
+    CHECK(std::find(match.begin(), match.end(), "--path") != match.end());
+    // what cgroups-up does with cgroup v2
+    CHECK(mkdir((kRoot + "/windscribe").c_str(), 0755) == 0);
+
+    const pid_t app1 = spawn(kAppCgroup);
+    const pid_t app2 = spawn(kAppCgroup);
+    const pid_t other = spawn(kOtherCgroup);
+    CGroups::instance().addApps({app1, app2});
+    CHECK(cgroupOf(app1) == "/windscribe");
+    CHECK(cgroupOf(app2) == "/windscribe");
+
+    // a process forked in our cgroup goes where its parent came from
+    kill(app1, SIGUSR1);
+    pid_t forked = 0;
+    for (int i = 0; i < 100 && forked == 0; ++i) {
+        for (auto pid : pidsIn("/windscribe")) {
+            if (pid != app1 && pid != app2) {
+                forked = pid;
+            }
+        }
+        usleep(10000);
+    }
+    CHECK(forked != 0);
+    CGroups::instance().removeApps({forked});
+    CHECK(cgroupOf(forked) == kAppCgroup);
+    kill(forked, SIGKILL);
+
+    // a process that was never moved stays where it is
+    CGroups::instance().removeApps({app2, other});
+    CHECK(cgroupOf(app2) == kAppCgroup);
+    CHECK(cgroupOf(other) == kOtherCgroup);
+
+    // disabling puts back whatever is left
+    CGroups::instance().addApps({other});
+    CHECK(cgroupOf(other) == "/windscribe");
+    CGroups::instance().disable();
+    CHECK(cgroupOf(app1) == kAppCgroup);
+    CHECK(cgroupOf(other) == kOtherCgroup);
+    CHECK(pidsIn("/windscribe").empty());
+}
+
+void benchmarkAddApps(int count)
+{
+    std::vector<pid_t> pids;
+    for (int i = 0; i < count; ++i) {
+        pids.push_back(spawn(kAppCgroup));
+    }
+
+    // as CGroups::addApp() did before, the file opened for each pid
+    auto start = std::chrono::steady_clock::now();
+    for (auto pid : pids) {
+        std::ofstream procs(kRoot + "/windscribe/cgroup.procs");
+        procs << pid;
+    }
+    const long long ofstreamUs = elapsedUs(start);
+    CHECK(pidsIn("/windscribe").size() == pids.size());
+    for (auto pid : pids) {
+        CHECK(writeFile(kRoot + kAppCgroup + "/cgroup.procs", std::to_string(pid)));
+    }
+
+    // the mounts came from the output of "mount -l" before, on each enable
+    start = std::chrono::steady_clock::now();
+    CHECK(run("mount -l"));
+    const long long mountUs = elapsedUs(start);
+
+    CMD_SEND_CONNECT_STATUS connectStatus = {};
+    start = std::chrono::steady_clock::now();
+    CHECK(CGroups::instance().enable(connectStatus, false, true));
+    const long long enableUs = elapsedUs(start);
+    const long long addUs = CGroups::instance().addApps(pids);
+    CHECK(pidsIn("/windscribe").size() == pids.size());
+    const long long removeUs = CGroups::instance().removeApps(pids);
+    CHECK(pidsIn("/windscribe").empty());
+    for (auto pid : pids) {
+        CHECK(cgroupOf(pid) == kAppCgroup);
+    }
+    CGroups::instance().disable();
+
+    printf("%d processes: an ofstream per pid %lld us, addApps() %lld us, removeApps() %lld us\n", count, ofstreamUs, addUs,
+           removeUs);
+    printf("\"mount -l\" %lld us, CGroups::enable() without cgroups-up %lld us\n", mountUs, enableUs);
+}
+
+} // namespace
+
+int main()
+{
+    if (!mountCgroup2()) {
+        printf("SKIPPED: could not mount the cgroup2 hierarchy, the test needs root\n");
+        return kSkipped;
+    }
+    struct stat st;
+    if (stat((kRoot + "/windscribe").c_str(), &st) == 0) {
+        printf("SKIPPED: the windscribe cgroup exists, is the app running?\n");
+        return kSkipped;
+    }
+    // also when a check fails
+    atexit(cleanUp);
+    if (mkdir((kRoot + kAppCgroup).c_str(), 0755) != 0 || mkdir((kRoot + kOtherCgroup).c_str(), 0755) != 0) {
+        printf("SKIPPED: could not create cgroups\n");
+        return kSkipped;
+    }
+
+    testRestoreOriginalCgroups();
+
+    benchmarkAddApps(500);
+
+    printf("PASSED\n");
+    return 0;
+}
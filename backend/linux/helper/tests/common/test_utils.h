@@ -0,0 +1,106 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sched.h>
+#include <string>
+#include <sys/mount.h>
+#include <unistd.h>
+
+// The helper's tests are plain executables: they exit with 0 if everything passed, 1 on the first failed check, and
+// with kSkipped if the environment can't run them (no namespaces, no veth support, ...).
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            exit(1); \
+        } \
+    } while (0)
+
+namespace TestUtils {
+
+// ctest's SKIP_RETURN_CODE of the tests
+constexpr int kSkipped = 77;
+
+inline bool writeFile(const std::string &path, const std::string &data)
+{
+    std::ofstream file(path);
+    file << data;
+    file.close();
+    return !file.fail();
+}
+
+// Moves the process to new namespaces of the CLONE_NEW* flags. Unless running as root, a user namespace is created as
+// well, with the caller mapped to root in it. Must be called before any thread is started.
+inline bool enterNamespaces(int flags)
+{
+    if (geteuid() == 0) {
+        return unshare(flags) == 0;
+    }
+
+    const uid_t uid = geteuid();
+    const gid_t gid = getegid();
+    if (unshare(CLONE_NEWUSER | flags) != 0) {
+        return false;
+    }
+    return writeFile("/proc/self/setgroups", "deny") &&
+           writeFile("/proc/self/uid_map", "0 " + std::to_string(uid) + " 1") &&
+           writeFile("/proc/self/gid_map", "0 " + std::to_string(gid) + " 1");
+}
+
+// Mounts the cgroup2 hierarchy at /sys/fs/cgroup in a private mount namespace, as on a pure cgroup v2 system, where
+// CGroups uses it. Needs root, since the hierarchy can't be mounted from a user namespace.
+inline bool mountCgroup2()
+{
+    if (geteuid() != 0 || unshare(CLONE_NEWNS) != 0 || mount(nullptr, "/", nullptr, MS_REC | MS_PRIVATE, nullptr) != 0) {
+        return false;
+    }
+    // CGroups prefers net_cls, so nothing but the cgroup2 hierarchy must be mounted there
+    umount2("/sys/fs/cgroup", MNT_DETACH);
+    return mount("cgroup2", "/sys/fs/cgroup", "cgroup2", 0, nullptr) == 0;
+}
+
+// the cgroup v2 path of a process, empty if it has exited
+inline std::string cgroupOf(pid_t pid)
+{
+    std::ifstream file("/proc/" + std::to_string(pid) + "/cgroup");
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.rfind("0::", 0) == 0) {
+            return line.substr(3);
+        }
+    }
+    return std::string();
+}
+
+// runs a shell command with its output discarded, returns true if it exited with 0
+inline bool run(const std::string &cmd)
+{
+    return system((cmd + " >/dev/null 2>&1").c_str()) == 0;
+}
+
+inline std::string output(const std::string &cmd)
+{
+    std::string ret;
+    FILE *pipe = popen(cmd.c_str(), "r");
+    if (!pipe) {
+        return ret;
+    }
+    char buf[4096];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), pipe)) > 0) {
+        ret.append(buf, len);
+    }
+    pclose(pipe);
+    return ret;
+}
+
+inline long long elapsedUs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace TestUtils
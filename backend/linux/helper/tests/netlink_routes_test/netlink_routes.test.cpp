@@ -0,0 +1,220 @@
+// Tests NetlinkRoutes and IpRoutes in a private network namespace and measures how long route updates take at scale,
+// against the "ip route" processes that IpRoutes used to run for each address.
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "test_utils.h"
+#include "../../routes_manager/netlink_routes.h"
+#include "../../split_tunneling/hostnames_manager/ip_routes.h"
+
+using namespace TestUtils;
+
+namespace {
+
+// a table of the tests, IpRoutes uses 71
+constexpr uint32_t kTable = 72;
+
+// a veth pair, since IPv6 routes can't go via lo
+bool setUpLinks()
+{
+    return run("ip link add ws0 type veth peer name ws1") &&
+           run("ip link set ws0 up") &&
+           run("ip link set ws1 up") &&
+           run("ip addr add 10.255.0.1/24 dev ws0") &&
+           run("ip -6 addr add fd00:255::1/64 dev ws0 nodad");
+}
+
+int routeCount(uint32_t table)
+{
+    const std::string routes = output("ip -4 route show table " + std::to_string(table) + "; ip -6 route show table " +
+                                      std::to_string(table));
+    int count = 0;
+    for (char c : routes) {
+        count += c == '\n' ? 1 : 0;
+    }
+    return count;
+}
+
+bool hasRoute(const std::string &ip, uint32_t table)
+{
+    return !output("ip route show table " + std::to_string(table) + " " + ip).empty();
+}
+
+// consecutive addresses of 100.64.0.0/10, starting from the offset
+std::vector<std::string> addresses(int count, int offset = 0)
+{
+    std::vector<std::string> ret;
+    for (int i = offset; i < offset + count; ++i) {
+        ret.push_back("100." + std::to_string(64 + (i >> 16)) + "." + std::to_string((i >> 8) & 0xFF) + "." +
+                      std::to_string(i & 0xFF));
+    }
+    return ret;
+}
+
+void testAddDelete()
+{
+    NetlinkRoutes netlink;
+    CHECK(netlink.addRoute("10.1.0.0/16", "10.255.0.2", kTable));
+    CHECK(netlink.addRoute("192.0.2.1", "10.255.0.2", kTable));
+    CHECK(netlink.addRoute("2001:db8:1::/48", "fd00:255::2", kTable));
+    // a prefix with host bits set is masked, as "ip route" does
+    CHECK(netlink.addRoute("198.51.100.7/24", "10.255.0.2", kTable));
+    CHECK(!netlink.addRoute("not an address", "10.255.0.2", kTable));
+    CHECK(!netlink.addRoute("2001:db8:2::/48", "10.255.0.2", kTable));
+    CHECK(netlink.commit() == 0);
+    CHECK(routeCount(kTable) == 4);
+    CHECK(hasRoute("198.51.100.0/24", kTable));
+
+    // adding an existing route and deleting a missing one leave the table as requested, so they don't fail
+    CHECK(netlink.addRoute("192.0.2.1", "10.255.0.2", kTable));
+    CHECK(netlink.deleteRoute("192.0.2.99", "10.255.0.2", kTable));
+    CHECK(netlink.commit() == 0);
+
+    CHECK(netlink.deleteRoute("10.1.0.0/16", "10.255.0.2", kTable));
+    CHECK(netlink.deleteRoute("192.0.2.1", "10.255.0.2", kTable));
+    CHECK(netlink.deleteRoute("2001:db8:1::/48", "fd00:255::2", kTable));
+    CHECK(netlink.deleteRoute("198.51.100.0/24", "10.255.0.2", kTable));
+    CHECK(netlink.commit() == 0);
+    CHECK(routeCount(kTable) == 0);
+}
+
+void testFailedRoutesReported()
+{
+    NetlinkRoutes netlink;
+    CHECK(netlink.addRoute("192.0.2.1", "10.255.0.2", kTable));
+    // no link has this gateway's network
+    CHECK(netlink.addRoute("192.0.2.2", "10.254.0.2", kTable));
+    CHECK(netlink.addRoute("192.0.2.3", "10.255.0.2", kTable));
+
+    std::set<std::string> failedAdds;
+    std::set<std::string> failedDeletes;
+    CHECK(netlink.commit(&failedAdds, &failedDeletes) == 1);
+    CHECK(failedAdds == std::set<std::string>({"192.0.2.2"}));
+    CHECK(failedDeletes.empty());
+    CHECK(routeCount(kTable) == 2);
+
+    netlink.flushTable(kTable);
+    CHECK(netlink.commit() == 0);
+    CHECK(routeCount(kTable) == 0);
+}
+
+void testFlushTable()
+{
+    {
+        NetlinkRoutes netlink;
+        for (const auto &ip : addresses(300)) {
+            CHECK(netlink.addRoute(ip, "10.255.0.2", kTable));
+        }
+        CHECK(netlink.addRoute("2001:db8:1::/48", "fd00:255::2", kTable));
+        CHECK(netlink.commit() == 0);
+        CHECK(routeCount(kTable) == 301);
+    }
+
+    // as on the first use after a crash of the helper, with a new socket
+    NetlinkRoutes netlink;
+    netlink.flushTable(kTable);
+    CHECK(netlink.commit() == 0);
+    CHECK(routeCount(kTable) == 0);
+}
+
+void testIpRoutesRetriesFailedRoutes()
+{
+    IpRoutes ipRoutes;
+
+    // the gateway isn't reachable yet, so nothing is added
+    ipRoutes.setIps("10.254.0.2", {"192.0.2.1", "192.0.2.2"});
+    CHECK(routeCount(71) == 0);
+    CHECK(output("ip rule show").find("lookup 71") != std::string::npos);
+
+    // the same list once the gateway is reachable: the routes are added this time
+    CHECK(run("ip addr add 10.254.0.1/24 dev ws0"));
+    ipRoutes.setIps("10.254.0.2", {"192.0.2.1", "192.0.2.2"});
+    CHECK(routeCount(71) == 2);
+
+    // only the difference is applied
+    ipRoutes.setIps("10.254.0.2", {"192.0.2.2", "192.0.2.3"});
+    CHECK(routeCount(71) == 2);
+    CHECK(!hasRoute("192.0.2.1", 71));
+    CHECK(hasRoute("192.0.2.3", 71));
+
+    // a new gateway replaces all the routes
+    ipRoutes.setIps("10.255.0.2", {"192.0.2.2", "192.0.2.3"});
+    CHECK(output("ip route show table 71").find("via 10.254.0.2") == std::string::npos);
+    CHECK(routeCount(71) == 2);
+
+    ipRoutes.clear();
+    CHECK(routeCount(71) == 0);
+    CHECK(output("ip rule show").find("lookup 71") == std::string::npos);
+    CHECK(run("ip addr del 10.254.0.1/24 dev ws0"));
+}
+
+void benchmarkIpRoutes(int count)
+{
+    IpRoutes ipRoutes;
+    const std::vector<std::string> ips = addresses(count);
+
+    auto start = std::chrono::steady_clock::now();
+    ipRoutes.setIps("10.255.0.2", ips);
+    const long long addUs = elapsedUs(start);
+    CHECK(routeCount(71) == count);
+
+    // a refresh in which a tenth of the addresses have changed
+    std::vector<std::string> refreshed(ips.begin() + count / 10, ips.end());
+    const std::vector<std::string> added = addresses(count / 10, count);
+    refreshed.insert(refreshed.end(), added.begin(), added.end());
+    start = std::chrono::steady_clock::now();
+    ipRoutes.setIps("10.255.0.2", refreshed);
+    const long long refreshUs = elapsedUs(start);
+    CHECK(routeCount(71) == count);
+
+    start = std::chrono::steady_clock::now();
+    ipRoutes.clear();
+    const long long clearUs = elapsedUs(start);
+    CHECK(routeCount(71) == 0);
+
+    printf("IpRoutes, %d routes: add %lld ms, refresh of 10%% %lld ms, clear %lld ms\n", count, addUs / 1000,
+           refreshUs / 1000, clearUs / 1000);
+}
+
+// one shell and one "ip" process per route, as Utils::executeCommand() ran them before
+void benchmarkIpRouteProcesses(int count)
+{
+    const std::vector<std::string> ips = addresses(count);
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &ip : ips) {
+        CHECK(run("ip route add " + ip + " via 10.255.0.2 table " + std::to_string(kTable)));
+    }
+    const long long addUs = elapsedUs(start);
+    CHECK(run("ip route flush table " + std::to_string(kTable)));
+
+    printf("\"ip route add\" processes, %d routes: %lld ms, %lld us per route\n", count, addUs / 1000, addUs / count);
+}
+
+} // namespace
+
+int main()
+{
+    if (!enterNamespaces(CLONE_NEWNET)) {
+        printf("SKIPPED: could not create a network namespace\n");
+        return kSkipped;
+    }
+    if (!setUpLinks()) {
+        printf("SKIPPED: could not set up a veth pair, is iproute2 installed?\n");
+        return kSkipped;
+    }
+
+    testAddDelete();
+    testFailedRoutesReported();
+    testFlushTable();
+    testIpRoutesRetriesFailedRoutes();
+
+    benchmarkIpRouteProcesses(500);
+    benchmarkIpRoutes(1000);
+    benchmarkIpRoutes(10000);
+    benchmarkIpRoutes(50000);
+
+    printf("PASSED\n");
+    return 0;
+}
@@ -0,0 +1,180 @@
+// Tests ExeMatcher and measures the CPU time the process monitor takes during a fork storm: processes executed one
+// after another, as on a busy build machine. The monitor listens to the proc connector, so the test needs root. The
+// processes of matched executables are moved to a cgroup of the cgroup2 hierarchy, mounted in a private mount namespace.
+
+#include <csignal>
+#include <spawn.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <vector>
+
+#include "test_utils.h"
+#include "../../split_tunneling/cgroups.h"
+#include "../../split_tunneling/exe_matcher.h"
+#include "../../split_tunneling/process_monitor.h"
+
+using namespace TestUtils;
+
+extern char **environ;
+
+namespace {
+
+constexpr int kExecs = 10000;
+const std::string kRoot = "/sys/fs/cgroup";
+// copies, so that no other process on the system runs them
+const std::string kStormExe = "/tmp/windscribe_test_true";
+const std::string kAppExe = "/tmp/windscribe_test_sleep";
+// a snap app makes the matcher read the paths of the executables outside of its inode set
+const std::string kSnapExe = "/snap/firefox/1234/usr/lib/firefox/firefox";
+
+std::vector<pid_t> children;
+
+pid_t spawn(const std::string &exe, const std::vector<std::string> &args = {})
+{
+    std::vector<char *> argv;
+    argv.push_back(const_cast<char *>(exe.c_str()));
+    for (const auto &arg : args) {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid_t pid;
+    CHECK(posix_spawn(&pid, exe.c_str(), nullptr, nullptr, argv.data(), environ) == 0);
+    return pid;
+}
+
+pid_t spawnSleeper(const std::string &exe)
+{
+    pid_t pid = spawn(exe, {"1000"});
+    children.push_back(pid);
+    // until it has executed
+    for (int i = 0; i < 100 && output("readlink /proc/" + std::to_string(pid) + "/exe").find(exe) == std::string::npos; ++i) {
+        usleep(10000);
+    }
+    return pid;
+}
+
+void cleanUp()
+{
+    for (auto pid : children) {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+    children.clear();
+    rmdir((kRoot + "/windscribe").c_str());
+    unlink(kStormExe.c_str());
+    unlink(kAppExe.c_str());
+}
+
+double cpuMs()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+}
+
+void testExeMatcher()
+{
+    ExeMatcher matcher;
+    matcher.setExes({kAppExe, kSnapExe});
+
+    const pid_t app = spawnSleeper(kAppExe);
+    CHECK(matcher.matches(app));
+    CHECK(!matcher.matches(getpid()));
+    // from the cache this time
+    CHECK(!matcher.matches(getpid()));
+
+    // an upgrade replaces the file, a new process of the app has a new inode but the same path
+    CHECK(run("rm " + kAppExe + " && cp /bin/sleep " + kAppExe));
+    const pid_t upgraded = spawnSleeper(kAppExe);
+    CHECK(matcher.matches(upgraded));
+    CHECK(matcher.matches(app));
+}
+
+// kExecs processes of the exe, one after another, from a child, so that their CPU time isn't ours; returns the time
+// the storm took in ms
+long long forkStorm(const std::string &exe)
+{
+    auto start = std::chrono::steady_clock::now();
+    pid_t storm = fork();
+    if (storm == 0) {
+        for (int i = 0; i < kExecs; ++i) {
+            waitpid(spawn(exe), nullptr, 0);
+        }
+        _exit(0);
+    }
+    CHECK(storm > 0);
+    waitpid(storm, nullptr, 0);
+    return elapsedUs(start) / 1000;
+}
+
+// the CPU time of the process during the storm: the monitor thread's, while the main thread waits
+void benchmarkForkStorm(const char *name, const std::vector<std::string> &apps)
+{
+    const bool isMonitoring = !apps.empty();
+    if (isMonitoring) {
+        ProcessMonitor::instance().setApps(apps);
+        CHECK(ProcessMonitor::instance().enable());
+    }
+
+    const double cpuStart = cpuMs();
+    const long long stormMs = forkStorm(kStormExe);
+    // for the monitor thread to catch up with the events
+    usleep(200000);
+    const double cpu = cpuMs() - cpuStart;
+
+    if (isMonitoring) {
+        ProcessMonitor::instance().disable();
+    }
+    printf("Fork storm of %d execs, %s: helper CPU %.1f ms, %.2f us per exec (the storm took %lld ms)\n", kExecs, name, cpu,
+           cpu * 1000 / kExecs, stormMs);
+}
+
+void testMatchedProcessMoved()
+{
+    ProcessMonitor::instance().setApps({kAppExe});
+    CHECK(ProcessMonitor::instance().enable());
+    const pid_t app = spawnSleeper(kAppExe);
+    for (int i = 0; i < 100 && cgroupOf(app) != "/windscribe"; ++i) {
+        usleep(10000);
+    }
+    CHECK(cgroupOf(app) == "/windscribe");
+    ProcessMonitor::instance().disable();
+}
+
+} // namespace
+
+int main()
+{
+    if (!mountCgroup2()) {
+        printf("SKIPPED: the test needs root\n");
+        return kSkipped;
+    }
+    struct stat st;
+    if (stat((kRoot + "/windscribe").c_str(), &st) == 0) {
+        printf("SKIPPED: the windscribe cgroup exists, is the app running?\n");
+        return kSkipped;
+    }
+    // also when a check fails
+    atexit(cleanUp);
+    CHECK(run("cp /bin/true " + kStormExe + " && cp /bin/sleep " + kAppExe));
+
+    testExeMatcher();
+
+    CMD_SEND_CONNECT_STATUS connectStatus = {};
+    CHECK(CGroups::instance().enable(connectStatus, false, true));
+    // what cgroups-up does with cgroup v2
+    CHECK(mkdir((kRoot + "/windscribe").c_str(), 0755) == 0);
+
+    testMatchedProcessMoved();
+
+    benchmarkForkStorm("without the monitor", {});
+    benchmarkForkStorm("no process matched", {kAppExe, kSnapExe});
+    benchmarkForkStorm("every process matched", {kStormExe, kAppExe});
+
+    CGroups::instance().disable();
+    printf("PASSED\n");
+    return 0;
+}
@@ -1,5 +1,4 @@
 #include "utils.h"
-#include "3rdparty/pstream.h"
 
 #include <arpa/inet.h>
 #include <skyr/core/parse.hpp>
@@ -9,53 +8,36 @@
 #include <sys/stat.h>
 
 #include "logger.h"
+#include "process_runner.h"
 
 namespace Utils
 {
 
-// based on 3rd party lib (http://pstreams.sourceforge.net/)
 int executeCommand(const std::string &cmd, const std::vector<std::string> &args,
-                   std::string *pOutputStr, bool appendFromStdErr)
+                   std::string *pOutputStr, bool appendFromStdErr, int timeoutMs)
 {
-    std::string cmdLine = cmd;
-
-    for (auto it = args.begin(); it != args.end(); ++it) {
-        cmdLine += " \"";
-        cmdLine += *it;
-        cmdLine += "\"";
-    }
-
-    if (pOutputStr) {
-        pOutputStr->clear();
-    }
-
-    redi::ipstream proc(cmdLine, redi::pstreams::pstdout | redi::pstreams::pstderr);
-    std::string line;
-    // read child's stdout
-    while (std::getline(proc.out(), line)) {
-        if (pOutputStr) {
-            *pOutputStr += line + "\n";
+    std::vector<std::string> argv;
+
+    bool isShellNeeded = cmd.find_first_of(" \t\n;|&<>()$`'\"\\*?[]{}~#!") != std::string::npos;
+    for (auto it = args.begin(); it != args.end() && !isShellNeeded; ++it) {
+        isShellNeeded = it->find_first_of("$`\"\\") != std::string::npos;
+    }
+
+    if (!isShellNeeded) {
+        argv.push_back(cmd);
+        argv.insert(argv.end(), args.begin(), args.end());
+    } else {
+        // command lines such as "ip route | grep default" still need a shell
+        std::string cmdLine = cmd;
+        for (auto it = args.begin(); it != args.end(); ++it) {
+            cmdLine += " \"";
+            cmdLine += *it;
+            cmdLine += "\"";
         }
-    }
-    // if reading stdout stopped at EOF then reset the state:
-    if (proc.eof() && proc.fail()) {
-        proc.clear();
+        argv = { "/bin/sh", "-c", cmdLine };
     }
 
-    if (appendFromStdErr) {
-        // read child's stderr
-        while (std::getline(proc.err(), line)) {
-            if (pOutputStr) {
-                *pOutputStr += line + "\n";
-            }
-        }
-    }
-
-    proc.close();
-    if (proc.rdbuf()->exited()) {
-        return proc.rdbuf()->status();
-    }
-    return 0;
+    return ProcessRunner::instance().run(argv, pOutputStr, appendFromStdErr, timeoutMs);
 }
 
 
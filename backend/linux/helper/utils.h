@@ -11,9 +11,13 @@
 namespace Utils
 {
     // execute cmd with args and return output from stdout and stderror to pOutputStr (if pOutputStr != NULL)
+    // cmd is run directly unless /bin/sh would change the command line, i.e. cmd has shell syntax (spaces, pipes,
+    // redirections) or an argument has characters which are expanded in double quotes
+    // if timeoutMs > 0, the child is killed if it does not finish in time; returns the wait status of the child, as
+    // waitpid() reports it, so 0 means it exited with 0
     int executeCommand(const std::string &cmd,
                        const std::vector<std::string> &args = std::vector<std::string>(),
-                       std::string *pOutputStr = nullptr, bool appendFromStdErr = true);
+                       std::string *pOutputStr = nullptr, bool appendFromStdErr = true, int timeoutMs = 0);
 
     // find case insensitive sub string in a given substring
     size_t findCaseInsensitive(std::string data, std::string toSearch, size_t pos = 0);
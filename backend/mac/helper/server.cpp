@@ -1,6 +1,7 @@
 #include "server.h"
 
 #include <assert.h>
+#include <chrono>
 #include <sstream>
 
 #include <boost/archive/text_oarchive.hpp>
@@ -75,7 +76,9 @@ void Server::peer_event_handler(xpc_connection_t peer, xpc_object_t event)
             data = std::string((const char *)buf, length);
         }
 
+        const auto started = std::chrono::steady_clock::now();
         CMD_ANSWER cmdAnswer = processCommand(cmdId, data);
+        cmdAnswer.serviceTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
 
         // send answer
         std::stringstream stream;
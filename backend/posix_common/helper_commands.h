@@ -87,8 +87,9 @@ struct CMD_ANSWER {
     unsigned long long customInfoValue[2];
     std::string body;
     int exitCode;
+    long long serviceTimeUs;    // from reading the command to the answer, for the connect traces of the client
 
-    CMD_ANSWER() : cmdId(0), executed(0), customInfoValue(), body(), exitCode(-1) {}
+    CMD_ANSWER() : cmdId(0), executed(0), customInfoValue(), body(), exitCode(-1), serviceTimeUs(0) {}
 };
 
 // command structs
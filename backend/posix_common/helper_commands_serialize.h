@@ -1,5 +1,7 @@
 #pragma once
 
+#include <boost/serialization/version.hpp>
+
 #ifndef UNUSED
 #define UNUSED(x) (void)(x)
 #endif
@@ -10,13 +12,16 @@ namespace serialization {
 template<class Archive>
 void serialize(Archive &ar, CMD_ANSWER &a, const unsigned int version)
 {
-    UNUSED(version);
     ar & a.cmdId;
     ar & a.executed;
     ar & a.customInfoValue[0];
     ar & a.customInfoValue[1];
     ar & a.body;
     ar & a.exitCode;
+    // a helper installed before the version 1 doesn't send it
+    if (version >= 1) {
+        ar & a.serviceTimeUs;
+    }
 }
 
 template<class Archive>
@@ -273,3 +278,5 @@ void serialize(Archive &ar, CMD_INSTALLER_CREATE_CLI_SYMLINK_DIR &a, const unsig
 
 }
 }
+
+BOOST_CLASS_VERSION(CMD_ANSWER, 1)
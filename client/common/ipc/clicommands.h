@@ -3,6 +3,7 @@
 #include "command.h"
 #include "types/enginesettings.h"
 #include "types/connectstate.h"
+#include "types/proxysharingclientstats.h"
 
 namespace IPC
 {
@@ -197,6 +198,84 @@ public:
     bool isKeepFirewallOn_;
 };
 
+class GetSharingClients : public Command
+{
+public:
+    GetSharingClients() {}
+    explicit GetSharingClients(char *buf, int size)
+    {
+        Q_UNUSED(buf)
+        Q_UNUSED(size)
+    }
+
+    std::vector<char> getData() const override
+    {
+        return std::vector<char>();
+    }
+
+    std::string getStringId() const override { return getCommandStringId(); }
+    std::string getDebugString() const override
+    {
+        return "CliCommands::GetSharingClients debug string";
+    }
+    static std::string getCommandStringId() { return "CliCommands::GetSharingClients";  }
+};
+
+class SetSharingRateLimit : public Command
+{
+public:
+    SetSharingRateLimit() {}
+    explicit SetSharingRateLimit(char *buf, int size)
+    {
+        QByteArray arr(buf, size);
+        QDataStream ds(&arr, QIODevice::ReadOnly);
+        ds >> address_ >> rateLimitKBps_;
+    }
+
+    std::vector<char> getData() const override
+    {
+        QByteArray arr;
+        QDataStream ds(&arr, QIODevice::WriteOnly);
+        ds << address_ << rateLimitKBps_;
+        return std::vector<char>(arr.begin(), arr.end());
+    }
+
+    std::string getStringId() const override { return getCommandStringId(); }
+    std::string getDebugString() const override
+    {
+        return "CliCommands::SetSharingRateLimit debug string";
+    }
+    static std::string getCommandStringId() { return "CliCommands::SetSharingRateLimit";  }
+
+    // empty for all the clients without a limit of their own
+    QString address_;
+    // 0 is unlimited
+    quint32 rateLimitKBps_ = 0;
+};
+
+class Subscribe : public Command
+{
+public:
+    Subscribe() {}
+    explicit Subscribe(char *buf, int size)
+    {
+        Q_UNUSED(buf)
+        Q_UNUSED(size)
+    }
+
+    std::vector<char> getData() const override
+    {
+        return std::vector<char>();
+    }
+
+    std::string getStringId() const override { return getCommandStringId(); }
+    std::string getDebugString() const override
+    {
+        return "CliCommands::Subscribe debug string";
+    }
+    static std::string getCommandStringId() { return "CliCommands::Subscribe";  }
+};
+
 class ConnectToLocationAnswer : public Command
 {
 public:
@@ -417,5 +496,114 @@ public:
     static std::string getCommandStringId() { return "CliCommands::SignedOut";  }
 };
 
+class SharingClients : public Command
+{
+public:
+    SharingClients() {}
+    explicit SharingClients(char *buf, int size)
+    {
+        QByteArray arr(buf, size);
+        QDataStream ds(&arr, QIODevice::ReadOnly);
+        ds >> clients_;
+    }
+
+    std::vector<char> getData() const override
+    {
+        QByteArray arr;
+        QDataStream ds(&arr, QIODevice::WriteOnly);
+        ds << clients_;
+        return std::vector<char>(arr.begin(), arr.end());
+    }
+
+    std::string getStringId() const override { return getCommandStringId(); }
+    std::string getDebugString() const override
+    {
+        return "CliCommands::SharingClients debug string";
+    }
+    static std::string getCommandStringId() { return "CliCommands::SharingClients";  }
+
+    QVector<types::ProxySharingClientStats> clients_;
+};
+
+// An update for the subscribers (windscribe-cli watch): only the parts in changes_ are sent. The first event after
+// Subscribe has all of them.
+class Event : public Command
+{
+public:
+    enum Change {
+        CHANGE_CONNECT_STATE = 0x01,
+        CHANGE_TRAFFIC = 0x02,
+        CHANGE_PING = 0x04,
+        CHANGE_ERROR = 0x08,
+        CHANGE_FIREWALL = 0x10
+    };
+
+    Event() {}
+    explicit Event(char *buf, int size)
+    {
+        QByteArray arr(buf, size);
+        QDataStream ds(&arr, QIODevice::ReadOnly);
+        ds >> changes_;
+        if (changes_ & CHANGE_CONNECT_STATE) {
+            ds >> connectState_;
+        }
+        if (changes_ & CHANGE_TRAFFIC) {
+            ds >> bytesIn_ >> bytesOut_ >> bytesInPerSec_ >> bytesOutPerSec_;
+        }
+        if (changes_ & CHANGE_PING) {
+            ds >> pingMs_;
+        }
+        if (changes_ & CHANGE_ERROR) {
+            ds >> error_;
+        }
+        if (changes_ & CHANGE_FIREWALL) {
+            ds >> isFirewallEnabled_ >> isFirewallAlwaysOn_;
+        }
+    }
+
+    std::vector<char> getData() const override
+    {
+        QByteArray arr;
+        QDataStream ds(&arr, QIODevice::WriteOnly);
+        ds << changes_;
+        if (changes_ & CHANGE_CONNECT_STATE) {
+            ds << connectState_;
+        }
+        if (changes_ & CHANGE_TRAFFIC) {
+            ds << bytesIn_ << bytesOut_ << bytesInPerSec_ << bytesOutPerSec_;
+        }
+        if (changes_ & CHANGE_PING) {
+            ds << pingMs_;
+        }
+        if (changes_ & CHANGE_ERROR) {
+            ds << error_;
+        }
+        if (changes_ & CHANGE_FIREWALL) {
+            ds << isFirewallEnabled_ << isFirewallAlwaysOn_;
+        }
+        return std::vector<char>(arr.begin(), arr.end());
+    }
+
+    std::string getStringId() const override { return getCommandStringId(); }
+    std::string getDebugString() const override
+    {
+        return "CliCommands::Event debug string";
+    }
+    static std::string getCommandStringId() { return "CliCommands::Event";  }
+
+    quint32 changes_ = 0;
+    types::ConnectState connectState_;
+    // since the connection was made
+    quint64 bytesIn_ = 0;
+    quint64 bytesOut_ = 0;
+    quint64 bytesInPerSec_ = 0;
+    quint64 bytesOutPerSec_ = 0;
+    // PingTime::NO_PING_INFO or PingTime::PING_FAILED if there is no ping
+    qint32 pingMs_ = 0;
+    QString error_;
+    bool isFirewallEnabled_ = false;
+    bool isFirewallAlwaysOn_ = false;
+};
+
 } // namespace CliCommands
 } // namespace IPC
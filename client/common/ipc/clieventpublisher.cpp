@@ -0,0 +1,148 @@
+#include "clieventpublisher.h"
+
+namespace IPC
+{
+
+CliEventPublisher::CliEventPublisher(int intervalMs, QObject *parent) : QObject(parent)
+{
+    timer_.setInterval(intervalMs);
+    connect(&timer_, &QTimer::timeout, this, &CliEventPublisher::onTimer);
+}
+
+void CliEventPublisher::addSubscriber(Connection *connection)
+{
+    if (subscribers_.contains(connection)) {
+        return;
+    }
+
+    // everything, for a start
+    CliCommands::Event event;
+    event.changes_ = CliCommands::Event::CHANGE_CONNECT_STATE | CliCommands::Event::CHANGE_TRAFFIC | CliCommands::Event::CHANGE_PING |
+                     CliCommands::Event::CHANGE_FIREWALL;
+    event.connectState_ = connectState_;
+    event.bytesIn_ = bytesIn_;
+    event.bytesOut_ = bytesOut_;
+    event.bytesInPerSec_ = sentBytesInPerSec_;
+    event.bytesOutPerSec_ = sentBytesOutPerSec_;
+    event.pingMs_ = pingMs_;
+    event.isFirewallEnabled_ = isFirewallEnabled_;
+    event.isFirewallAlwaysOn_ = isFirewallAlwaysOn_;
+    connection->sendCommand(event);
+
+    if (subscribers_.isEmpty()) {
+        // the counters of the first interval start now
+        sentBytesIn_ = bytesIn_;
+        sentBytesOut_ = bytesOut_;
+        sentPingMs_ = pingMs_;
+        intervalTimer_.start();
+        timer_.start();
+    }
+    subscribers_.append(connection);
+}
+
+void CliEventPublisher::removeSubscriber(Connection *connection)
+{
+    subscribers_.removeOne(connection);
+    if (subscribers_.isEmpty()) {
+        timer_.stop();
+    }
+}
+
+void CliEventPublisher::setConnectState(const types::ConnectState &connectState)
+{
+    if (connectState == connectState_) {
+        return;
+    }
+    if (connectState.connectState == CONNECT_STATE_CONNECTED && connectState_.connectState != CONNECT_STATE_CONNECTED) {
+        // the counters are per connection, as in the main window
+        bytesIn_ = 0;
+        bytesOut_ = 0;
+        sentBytesIn_ = 0;
+        sentBytesOut_ = 0;
+    }
+    connectState_ = connectState;
+
+    CliCommands::Event event;
+    event.changes_ = CliCommands::Event::CHANGE_CONNECT_STATE;
+    event.connectState_ = connectState_;
+    publish(event);
+}
+
+void CliEventPublisher::setFirewallState(bool isEnabled, bool isAlwaysOn)
+{
+    if (isEnabled == isFirewallEnabled_ && isAlwaysOn == isFirewallAlwaysOn_) {
+        return;
+    }
+    isFirewallEnabled_ = isEnabled;
+    isFirewallAlwaysOn_ = isAlwaysOn;
+
+    CliCommands::Event event;
+    event.changes_ = CliCommands::Event::CHANGE_FIREWALL;
+    event.isFirewallEnabled_ = isFirewallEnabled_;
+    event.isFirewallAlwaysOn_ = isFirewallAlwaysOn_;
+    publish(event);
+}
+
+void CliEventPublisher::addTraffic(quint64 bytesIn, quint64 bytesOut, bool isTotalBytes)
+{
+    if (isTotalBytes) {
+        bytesIn_ = bytesIn;
+        bytesOut_ = bytesOut;
+    } else {
+        bytesIn_ += bytesIn;
+        bytesOut_ += bytesOut;
+    }
+}
+
+void CliEventPublisher::setPing(int pingMs)
+{
+    pingMs_ = pingMs;
+}
+
+void CliEventPublisher::reportError(const QString &error)
+{
+    CliCommands::Event event;
+    event.changes_ = CliCommands::Event::CHANGE_ERROR;
+    event.error_ = error;
+    publish(event);
+}
+
+void CliEventPublisher::onTimer()
+{
+    const qint64 elapsedMs = qMax<qint64>(1, intervalTimer_.restart());
+
+    CliCommands::Event event;
+    // the counters were reset by a new connection if they went down
+    const quint64 bytesInPerSec = bytesIn_ >= sentBytesIn_ ? (bytesIn_ - sentBytesIn_) * 1000 / elapsedMs : 0;
+    const quint64 bytesOutPerSec = bytesOut_ >= sentBytesOut_ ? (bytesOut_ - sentBytesOut_) * 1000 / elapsedMs : 0;
+    if (bytesIn_ != sentBytesIn_ || bytesOut_ != sentBytesOut_ ||
+        bytesInPerSec != sentBytesInPerSec_ || bytesOutPerSec != sentBytesOutPerSec_) {
+        event.changes_ |= CliCommands::Event::CHANGE_TRAFFIC;
+        event.bytesIn_ = bytesIn_;
+        event.bytesOut_ = bytesOut_;
+        event.bytesInPerSec_ = bytesInPerSec;
+        event.bytesOutPerSec_ = bytesOutPerSec;
+        sentBytesIn_ = bytesIn_;
+        sentBytesOut_ = bytesOut_;
+        sentBytesInPerSec_ = bytesInPerSec;
+        sentBytesOutPerSec_ = bytesOutPerSec;
+    }
+    if (pingMs_ != sentPingMs_) {
+        event.changes_ |= CliCommands::Event::CHANGE_PING;
+        event.pingMs_ = pingMs_;
+        sentPingMs_ = pingMs_;
+    }
+
+    if (event.changes_ != 0) {
+        publish(event);
+    }
+}
+
+void CliEventPublisher::publish(const CliCommands::Event &event)
+{
+    for (Connection *connection : subscribers_) {
+        connection->sendCommand(event);
+    }
+}
+
+} // namespace IPC
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QVector>
+#include "clicommands.h"
+#include "connection.h"
+#include "types/pingtime.h"
+
+namespace IPC
+{
+
+// Streams the state of the app to the connections that subscribed for it (windscribe-cli watch), so that they don't
+// have to poll it. Connect state and firewall changes and errors go out at once; the traffic counters and the ping change much more
+// often and are coalesced into at most one event per interval, with only what changed since the last one.
+class CliEventPublisher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CliEventPublisher(int intervalMs = DEFAULT_INTERVAL_MS, QObject *parent = nullptr);
+
+    // the connections stay owned by the caller, which removes them before deleting them
+    void addSubscriber(Connection *connection);
+    void removeSubscriber(Connection *connection);
+    bool hasSubscribers() const { return !subscribers_.isEmpty(); }
+
+    void setConnectState(const types::ConnectState &connectState);
+    void setFirewallState(bool isEnabled, bool isAlwaysOn);
+    // as Backend::statisticsUpdated gives them
+    void addTraffic(quint64 bytesIn, quint64 bytesOut, bool isTotalBytes);
+    void setPing(int pingMs);
+    void reportError(const QString &error);
+
+private slots:
+    void onTimer();
+
+private:
+    static constexpr int DEFAULT_INTERVAL_MS = 1000;
+
+    QVector<Connection *> subscribers_;
+    QTimer timer_;
+    QElapsedTimer intervalTimer_;
+
+    types::ConnectState connectState_;
+    bool isFirewallEnabled_ = false;
+    bool isFirewallAlwaysOn_ = false;
+    quint64 bytesIn_ = 0;
+    quint64 bytesOut_ = 0;
+    int pingMs_ = PingTime::NO_PING_INFO;
+
+    // what the subscribers were sent last
+    quint64 sentBytesIn_ = 0;
+    quint64 sentBytesOut_ = 0;
+    quint64 sentBytesInPerSec_ = 0;
+    quint64 sentBytesOutPerSec_ = 0;
+    int sentPingMs_ = PingTime::NO_PING_INFO;
+
+    void publish(const CliCommands::Event &event);
+};
+
+} // namespace IPC
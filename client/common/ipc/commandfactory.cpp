@@ -1,5 +1,4 @@
 #include <QObject>
-#include <QDebug>
 
 #include "commandfactory.h"
 #include "clicommands.h"
@@ -10,8 +9,6 @@ namespace IPC
 
 Command *CommandFactory::makeCommand(const std::string strId, char *buf, int size)
 {
-    qDebug() << QString::fromStdString(strId);
-
     // CLI commands
     if (strId == IPC::CliCommands::Connect::getCommandStringId())
     {
@@ -73,6 +70,26 @@ Command *CommandFactory::makeCommand(const std::string strId, char *buf, int siz
     {
         return new IPC::CliCommands::SignedOut(buf, size);
     }
+    else if (strId == IPC::CliCommands::GetSharingClients::getCommandStringId())
+    {
+        return new IPC::CliCommands::GetSharingClients(buf, size);
+    }
+    else if (strId == IPC::CliCommands::SetSharingRateLimit::getCommandStringId())
+    {
+        return new IPC::CliCommands::SetSharingRateLimit(buf, size);
+    }
+    else if (strId == IPC::CliCommands::SharingClients::getCommandStringId())
+    {
+        return new IPC::CliCommands::SharingClients(buf, size);
+    }
+    else if (strId == IPC::CliCommands::Subscribe::getCommandStringId())
+    {
+        return new IPC::CliCommands::Subscribe(buf, size);
+    }
+    else if (strId == IPC::CliCommands::Event::getCommandStringId())
+    {
+        return new IPC::CliCommands::Event(buf, size);
+    }
 
     WS_ASSERT(false);
     return NULL;
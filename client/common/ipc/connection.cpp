@@ -1,12 +1,15 @@
 #include "connection.h"
 #include "commandfactory.h"
+#include <QPointer>
 #include <QTimer>
 #include "utils/ws_assert.h"
 
 namespace IPC
 {
 
-Connection::Connection(QLocalSocket *localSocket) : localSocket_(localSocket), bytesWrittingInProgress_(0)
+static const int MAX_PREALLOCATED_FRAME_SIZE = 64 * 1024 * 1024;
+
+Connection::Connection(QLocalSocket *localSocket) : localSocket_(localSocket), readPos_(0), bytesWrittingInProgress_(0)
 {
     QObject::connect(localSocket_, &QLocalSocket::disconnected, this, &Connection::onSocketDisconnected);
     QObject::connect(localSocket_, &QLocalSocket::bytesWritten, this, &Connection::onSocketBytesWritten);
@@ -14,7 +17,7 @@ Connection::Connection(QLocalSocket *localSocket) : localSocket_(localSocket), b
     QObject::connect(localSocket_, &QLocalSocket::errorOccurred, this, &Connection::onSocketError);
 }
 
-Connection::Connection() : localSocket_(NULL), bytesWrittingInProgress_(0)
+Connection::Connection() : localSocket_(NULL), readPos_(0), bytesWrittingInProgress_(0)
 {
 }
 
@@ -26,6 +29,10 @@ Connection::~Connection()
 void Connection::connect()
 {
     safeDeleteSocket();
+    writeBuf_.clear();
+    readBuf_.clear();
+    readPos_ = 0;
+    bytesWrittingInProgress_ = 0;
     localSocket_ = new QLocalSocket;
     QObject::connect(localSocket_, &QLocalSocket::connected, this, &Connection::onSocketConnected);
     QObject::connect(localSocket_, &QLocalSocket::disconnected, this, &Connection::onSocketDisconnected);
@@ -58,27 +65,31 @@ void Connection::sendCommand(const Command &commandl)
 
     WS_ASSERT(sizeOfStringId > 0);
 
-    bool isWriteBufIsEmpty = writeBuf_.isEmpty();
-
-    writeBuf_.append((const char *)&sizeOfBuf, sizeof(sizeOfBuf));
-    writeBuf_.append((const char *)&sizeOfStringId, sizeof(sizeOfStringId));
-    writeBuf_.append(strId.c_str(), sizeOfStringId);
+    // the frame is put together in place, with the space for it allocated once
+    const int sizeOfFrame = sizeof(int) * 2 + sizeOfStringId + sizeOfBuf;
+    const int offset = writeBuf_.size();
+    if (writeBuf_.capacity() < offset + sizeOfFrame)
+    {
+        // grows geometrically, for bursts of commands
+        writeBuf_.reserve(qMax(offset + sizeOfFrame, writeBuf_.capacity() * 2));
+    }
+    writeBuf_.resize(offset + sizeOfFrame);
+    char *frame = writeBuf_.data() + offset;
+    memcpy(frame, &sizeOfBuf, sizeof(int));
+    memcpy(frame + sizeof(int), &sizeOfStringId, sizeof(int));
+    memcpy(frame + sizeof(int) * 2, strId.c_str(), sizeOfStringId);
     if (sizeOfBuf > 0)
     {
-        writeBuf_.append(&buf[0], sizeOfBuf);
+        memcpy(frame + sizeof(int) * 2 + sizeOfStringId, &buf[0], sizeOfBuf);
     }
-    if (isWriteBufIsEmpty)
+
+    // while the socket is busy the commands are coalesced, to be written in one go from onSocketBytesWritten
+    if (bytesWrittingInProgress_ == 0)
     {
-        qint64 bytesWritten = localSocket_->write(writeBuf_);
-        if (bytesWritten == -1)
-        {
-            emit stateChanged(CONNECTION_DISCONNECTED, this);
-        }
-        else
-        {
-            bytesWrittingInProgress_ += bytesWritten;
-            writeBuf_.remove(0, bytesWritten);
-        }
+        // handed over whole, the socket can keep a big buffer without copying it
+        QByteArray data;
+        data.swap(writeBuf_);
+        writeToSocket(data);
     }
 }
 
@@ -115,16 +126,9 @@ void Connection::onSocketBytesWritten(qint64 bytes)
 
     if (!writeBuf_.isEmpty())
     {
-        qint64 bytesWritten = localSocket_->write(writeBuf_);
-        if (bytesWritten == -1)
-        {
-            emit stateChanged(CONNECTION_DISCONNECTED, this);
-        }
-        else
-        {
-            bytesWrittingInProgress_ += bytesWritten;
-            writeBuf_.remove(0, bytesWritten);
-        }
+        QByteArray data;
+        data.swap(writeBuf_);
+        writeToSocket(data);
     }
     else if (bytesWrittingInProgress_ == 0)
     {
@@ -134,11 +138,45 @@ void Connection::onSocketBytesWritten(qint64 bytes)
 
 void Connection::onReadyRead()
 {
-    readBuf_.append(localSocket_->readAll());
+    // read right behind the data left from the last time, without a temporary buffer
+    const qint64 available = localSocket_->bytesAvailable();
+    if (available > 0)
+    {
+        const int oldSize = readBuf_.size();
+        readBuf_.resize(oldSize + available);
+        const qint64 bytesRead = localSocket_->read(readBuf_.data() + oldSize, available);
+        readBuf_.resize(oldSize + qMax<qint64>(bytesRead, 0));
+    }
+
     while (canReadCommand())
     {
         Command *cmd = readCommand();
+        QPointer<Connection> guard(this);
         emit newCommand(cmd, this);
+        // a slot may have closed the connection or deleted it
+        if (!guard || !localSocket_)
+        {
+            return;
+        }
+    }
+
+    // the commands that were read are dropped at once, instead of moving the rest of the buffer after each of them
+    if (readPos_ > 0)
+    {
+        readBuf_.remove(0, readPos_);
+        readPos_ = 0;
+    }
+    // the rest of an incomplete frame is read into space allocated for the whole frame
+    if (readBuf_.size() >= (int)(sizeof(int) * 2))
+    {
+        int sizeOfCmd;
+        int sizeOfId;
+        memcpy(&sizeOfCmd, readBuf_.data(), sizeof(int));
+        memcpy(&sizeOfId, readBuf_.data() + sizeof(int), sizeof(int));
+        if (sizeOfCmd >= 0 && sizeOfId >= 0 && sizeOfCmd < MAX_PREALLOCATED_FRAME_SIZE && sizeOfId < MAX_PREALLOCATED_FRAME_SIZE)
+        {
+            readBuf_.reserve(sizeof(int) * 2 + sizeOfId + sizeOfCmd);
+        }
     }
 }
 
@@ -151,14 +189,15 @@ void Connection::onSocketError(QLocalSocket::LocalSocketError socketError)
 
 bool Connection::canReadCommand()
 {
-    if (readBuf_.size() > (int)(sizeof(int) * 2))
+    const int available = readBuf_.size() - readPos_;
+    if (available > (int)(sizeof(int) * 2))
     {
         int sizeOfCmd;
         int sizeOfId;
-        memcpy(&sizeOfCmd, readBuf_.data(), sizeof(int));
-        memcpy(&sizeOfId, readBuf_.data() + sizeof(int), sizeof(int));
+        memcpy(&sizeOfCmd, readBuf_.data() + readPos_, sizeof(int));
+        memcpy(&sizeOfId, readBuf_.data() + readPos_ + sizeof(int), sizeof(int));
 
-        if (readBuf_.size() >= (int)(sizeof(int) * 2 + sizeOfCmd + sizeOfId))
+        if (available >= (int)(sizeof(int) * 2 + sizeOfCmd + sizeOfId))
         {
             return true;
         }
@@ -168,18 +207,36 @@ bool Connection::canReadCommand()
 
 Command *Connection::readCommand()
 {
+    char *frame = readBuf_.data() + readPos_;
     int sizeOfCmd;
     int sizeOfId;
-    memcpy(&sizeOfCmd, readBuf_.data(), sizeof(int));
-    memcpy(&sizeOfId, readBuf_.data() + sizeof(int), sizeof(int));
+    memcpy(&sizeOfCmd, frame, sizeof(int));
+    memcpy(&sizeOfId, frame + sizeof(int), sizeof(int));
 
-    std::string strId(readBuf_.data() + sizeof(int) * 2, sizeOfId);
+    std::string strId(frame + sizeof(int) * 2, sizeOfId);
 
-    Command *cmd = CommandFactory::makeCommand(strId, readBuf_.data() + sizeof(int) * 2 + sizeOfId, sizeOfCmd);
-    readBuf_.remove(0, sizeof(int) * 2 + sizeOfId + sizeOfCmd);
+    Command *cmd = CommandFactory::makeCommand(strId, frame + sizeof(int) * 2 + sizeOfId, sizeOfCmd);
+    readPos_ += sizeof(int) * 2 + sizeOfId + sizeOfCmd;
     return cmd;
 }
 
+void Connection::writeToSocket(const QByteArray &data)
+{
+    qint64 bytesWritten = localSocket_->write(data);
+    if (bytesWritten == -1)
+    {
+        emit stateChanged(CONNECTION_DISCONNECTED, this);
+    }
+    else
+    {
+        bytesWrittingInProgress_ += bytesWritten;
+        if (bytesWritten < data.size())
+        {
+            writeBuf_.prepend(data.constData() + bytesWritten, data.size() - bytesWritten);
+        }
+    }
+}
+
 void Connection::safeDeleteSocket()
 {
     if (localSocket_)
@@ -38,12 +38,16 @@ private slots:
 private:
     QLocalSocket *localSocket_;
 
+    // the frames of the commands sent while the socket is still writing, handed to it at once when it's done
     QByteArray writeBuf_;
+    // the commands before readPos_ are read already, they are dropped together after each read
     QByteArray readBuf_;
+    int readPos_;
     qint64 bytesWrittingInProgress_;
 
     bool canReadCommand();
     Command *readCommand();
+    void writeToSocket(const QByteArray &data);
 
     void safeDeleteSocket();
 };
@@ -0,0 +1,276 @@
+#include "clieventpublisher.test.h"
+#include <QtTest>
+#include <QElapsedTimer>
+#include <ctime>
+
+#include "ipc/clicommands.h"
+#include "ipc/clieventpublisher.h"
+
+namespace {
+
+const int kTimeoutMs = 10000;
+const int kClientCount = 10;
+const int kBenchmarkMs = 3000;
+
+// keeps the events a connection receives
+class Receiver : public QObject
+{
+public:
+    explicit Receiver(IPC::Connection *connection)
+    {
+        QObject::connect(connection, &IPC::Connection::newCommand, this, [this](IPC::Command *command, IPC::Connection *) {
+            if (auto *event = dynamic_cast<IPC::CliCommands::Event *>(command))
+                events << *event;
+            delete command;
+        });
+    }
+
+    QVector<IPC::CliCommands::Event> events;
+};
+
+bool waitFor(const std::function<bool()> &condition)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (!condition()) {
+        if (timer.elapsed() > kTimeoutMs)
+            return false;
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    }
+    return true;
+}
+
+types::ConnectState makeConnectState(CONNECT_STATE state, const QString &city)
+{
+    types::ConnectState connectState;
+    connectState.connectState = state;
+    connectState.location = LocationID::createApiLocationId(1, city, "nick");
+    return connectState;
+}
+
+// the CPU time of the process, both ends of the connections included
+qint64 cpuTimeMs()
+{
+    return (qint64)std::clock() * 1000 / CLOCKS_PER_SEC;
+}
+
+} // namespace
+
+void CliEventPublisher_test::init()
+{
+    const QString name = QString("windscribe_clieventpublisher_test_%1").arg(QCoreApplication::applicationPid());
+    QLocalServer::removeServer(name);
+    QVERIFY(server_.listen(name));
+}
+
+void CliEventPublisher_test::cleanup()
+{
+    qDeleteAll(clientConnections_);
+    clientConnections_.clear();
+    qDeleteAll(serverConnections_);
+    serverConnections_.clear();
+    server_.close();
+}
+
+void CliEventPublisher_test::makeConnections(int count)
+{
+    for (int i = 0; i < count; ++i) {
+        QLocalSocket *clientSocket = new QLocalSocket();
+        clientSocket->connectToServer(server_.serverName());
+        QVERIFY(clientSocket->waitForConnected(kTimeoutMs));
+        QVERIFY(server_.waitForNewConnection(kTimeoutMs));
+        QLocalSocket *serverSocket = server_.nextPendingConnection();
+        QVERIFY(serverSocket);
+        serverSocket->setParent(nullptr);
+        clientConnections_ << new IPC::Connection(clientSocket);
+        serverConnections_ << new IPC::Connection(serverSocket);
+    }
+}
+
+void CliEventPublisher_test::testSnapshotOnSubscribe()
+{
+    makeConnections(1);
+    Receiver receiver(clientConnections_[0]);
+
+    IPC::CliEventPublisher publisher(60000);
+    publisher.setConnectState(makeConnectState(CONNECT_STATE_CONNECTED, "Toronto"));
+    publisher.addTraffic(1000, 2000, true);
+    publisher.addTraffic(10, 20, false);
+    publisher.setPing(42);
+    publisher.setFirewallState(true, false);
+    publisher.addSubscriber(serverConnections_[0]);
+
+    QVERIFY(waitFor([&]() { return receiver.events.size() == 1; }));
+    const IPC::CliCommands::Event &event = receiver.events[0];
+    QCOMPARE(event.changes_, (quint32)(IPC::CliCommands::Event::CHANGE_CONNECT_STATE | IPC::CliCommands::Event::CHANGE_TRAFFIC |
+                                       IPC::CliCommands::Event::CHANGE_PING | IPC::CliCommands::Event::CHANGE_FIREWALL));
+    QCOMPARE(event.connectState_.connectState, CONNECT_STATE_CONNECTED);
+    QCOMPARE(event.connectState_.location.city(), QString("Toronto"));
+    QCOMPARE(event.bytesIn_, (quint64)1010);
+    QCOMPARE(event.bytesOut_, (quint64)2020);
+    QCOMPARE(event.pingMs_, 42);
+    QVERIFY(event.isFirewallEnabled_);
+    QVERIFY(!event.isFirewallAlwaysOn_);
+}
+
+void CliEventPublisher_test::testTrafficAndPingCoalesced()
+{
+    makeConnections(1);
+    Receiver receiver(clientConnections_[0]);
+
+    IPC::CliEventPublisher publisher(100);
+    publisher.addSubscriber(serverConnections_[0]);
+    QVERIFY(waitFor([&]() { return receiver.events.size() == 1; }));
+
+    // many updates in one interval make one event with the last values
+    for (int i = 0; i < 50; ++i)
+        publisher.addTraffic(1000, 500, false);
+    publisher.setPing(30);
+    publisher.setPing(40);
+    QVERIFY(waitFor([&]() { return receiver.events.size() == 2; }));
+    const IPC::CliCommands::Event event = receiver.events[1];
+    QCOMPARE(event.changes_, (quint32)(IPC::CliCommands::Event::CHANGE_TRAFFIC | IPC::CliCommands::Event::CHANGE_PING));
+    QCOMPARE(event.bytesIn_, (quint64)50000);
+    QCOMPARE(event.bytesOut_, (quint64)25000);
+    QVERIFY(event.bytesInPerSec_ > 0);
+    QCOMPARE(event.pingMs_, 40);
+
+    // then the rates drop to zero once, and nothing changes anymore
+    QVERIFY(waitFor([&]() { return receiver.events.size() == 3; }));
+    QCOMPARE(receiver.events[2].changes_, (quint32)IPC::CliCommands::Event::CHANGE_TRAFFIC);
+    QCOMPARE(receiver.events[2].bytesIn_, (quint64)50000);
+    QCOMPARE(receiver.events[2].bytesInPerSec_, (quint64)0);
+    QCOMPARE(receiver.events[2].bytesOutPerSec_, (quint64)0);
+    QTest::qWait(500);
+    QCOMPARE(receiver.events.size(), 3);
+}
+
+void CliEventPublisher_test::testConnectStateAndErrorAtOnce()
+{
+    makeConnections(1);
+    Receiver receiver(clientConnections_[0]);
+
+    // no event on the timer during the test
+    IPC::CliEventPublisher publisher(3600 * 1000);
+    publisher.addSubscriber(serverConnections_[0]);
+    QVERIFY(waitFor([&]() { return receiver.events.size() == 1; }));
+
+    publisher.setConnectState(makeConnectState(CONNECT_STATE_CONNECTING, "Paris"));
+    QVERIFY(waitFor([&]() { return receiver.events.size() == 2; }));
+    QCOMPARE(receiver.events[1].changes_, (quint32)IPC::CliCommands::Event::CHANGE_CONNECT_STATE);
+    QCOMPARE(receiver.events[1].connectState_.connectState, CONNECT_STATE_CONNECTING);
+    QCOMPARE(receiver.events[1].connectState_.location.city(), QString("Paris"));
+
+    publisher.reportError("Connect error 24");
+    QVERIFY(waitFor([&]() { return receiver.events.size() == 3; }));
+    QCOMPARE(receiver.events[2].changes_, (quint32)IPC::CliCommands::Event::CHANGE_ERROR);
+    QCOMPARE(receiver.events[2].error_, QString("Connect error 24"));
+
+    publisher.setFirewallState(true, true);
+    QVERIFY(waitFor([&]() { return receiver.events.size() == 4; }));
+    QCOMPARE(receiver.events[3].changes_, (quint32)IPC::CliCommands::Event::CHANGE_FIREWALL);
+    QVERIFY(receiver.events[3].isFirewallEnabled_);
+    QVERIFY(receiver.events[3].isFirewallAlwaysOn_);
+
+    // the same state again is not an event
+    publisher.setConnectState(makeConnectState(CONNECT_STATE_CONNECTING, "Paris"));
+    publisher.setFirewallState(true, true);
+    QTest::qWait(200);
+    QCOMPARE(receiver.events.size(), 4);
+}
+
+void CliEventPublisher_test::testUnsubscribe()
+{
+    makeConnections(2);
+    Receiver first(clientConnections_[0]);
+    Receiver second(clientConnections_[1]);
+
+    IPC::CliEventPublisher publisher(3600 * 1000);
+    publisher.addSubscriber(serverConnections_[0]);
+    publisher.addSubscriber(serverConnections_[1]);
+    // twice is once
+    publisher.addSubscriber(serverConnections_[1]);
+    QVERIFY(waitFor([&]() { return first.events.size() == 1 && second.events.size() == 1; }));
+
+    publisher.removeSubscriber(serverConnections_[0]);
+    QVERIFY(publisher.hasSubscribers());
+    publisher.setConnectState(makeConnectState(CONNECT_STATE_CONNECTED, "Oslo"));
+    QVERIFY(waitFor([&]() { return second.events.size() == 2; }));
+    QTest::qWait(200);
+    QCOMPARE(first.events.size(), 1);
+
+    publisher.removeSubscriber(serverConnections_[1]);
+    QVERIFY(!publisher.hasSubscribers());
+}
+
+void CliEventPublisher_test::benchmarkWatchersVsPolling()
+{
+    makeConnections(kClientCount * 2);
+
+    // the engine: traffic every 100 ms, a connect state change every second
+    IPC::CliEventPublisher publisher;
+    QTimer trafficTimer;
+    QObject::connect(&trafficTimer, &QTimer::timeout, [&publisher]() { publisher.addTraffic(12345, 678, false); });
+    QTimer stateTimer;
+    int stateChanges = 0;
+    QObject::connect(&stateTimer, &QTimer::timeout, [&]() {
+        stateChanges++;
+        publisher.setConnectState(makeConnectState(stateChanges % 2 ? CONNECT_STATE_CONNECTED : CONNECT_STATE_CONNECTING, "Kyiv"));
+    });
+
+    // watchers
+    int eventCount = 0;
+    for (int i = 0; i < kClientCount; ++i) {
+        QObject::connect(clientConnections_[i], &IPC::Connection::newCommand, [&eventCount](IPC::Command *command, IPC::Connection *) {
+            delete command;
+            eventCount++;
+        });
+    }
+    trafficTimer.start(100);
+    stateTimer.start(1000);
+    qint64 cpuStart = cpuTimeMs();
+    for (int i = 0; i < kClientCount; ++i)
+        publisher.addSubscriber(serverConnections_[i]);
+    QTest::qWait(kBenchmarkMs);
+    const qint64 watchCpuMs = cpuTimeMs() - cpuStart;
+    for (int i = 0; i < kClientCount; ++i)
+        publisher.removeSubscriber(serverConnections_[i]);
+    QVERIFY(eventCount >= kClientCount * kBenchmarkMs / 1000);
+
+    // pollers, every 100 ms to see a connect state change within 100 ms, answered as LocalIPCServer does
+    int answerCount = 0;
+    QVector<QTimer *> pollTimers;
+    for (int i = kClientCount; i < kClientCount * 2; ++i) {
+        QObject::connect(serverConnections_[i], &IPC::Connection::newCommand, [](IPC::Command *command, IPC::Connection *connection) {
+            if (command->getStringId() == IPC::CliCommands::GetState::getCommandStringId()) {
+                IPC::CliCommands::State state;
+                state.isLoggedIn_ = true;
+                state.waitingForLoginInfo_ = false;
+                state.connectState_ = CONNECT_STATE_CONNECTED;
+                state.location_ = LocationID::createApiLocationId(1, "Kyiv", "nick");
+                connection->sendCommand(state);
+            }
+            delete command;
+        });
+        QObject::connect(clientConnections_[i], &IPC::Connection::newCommand, [&answerCount](IPC::Command *command, IPC::Connection *) {
+            delete command;
+            answerCount++;
+        });
+        QTimer *pollTimer = new QTimer(this);
+        IPC::Connection *client = clientConnections_[i];
+        QObject::connect(pollTimer, &QTimer::timeout, [client]() { client->sendCommand(IPC::CliCommands::GetState()); });
+        pollTimers << pollTimer;
+    }
+    cpuStart = cpuTimeMs();
+    for (QTimer *pollTimer : pollTimers)
+        pollTimer->start(100);
+    QTest::qWait(kBenchmarkMs);
+    const qint64 pollCpuMs = cpuTimeMs() - cpuStart;
+    qDeleteAll(pollTimers);
+    QVERIFY(answerCount > 0);
+
+    qDebug() << kClientCount << "watchers:" << watchCpuMs << "ms CPU," << eventCount << "events in" << kBenchmarkMs << "ms";
+    qDebug() << kClientCount << "pollers:" << pollCpuMs << "ms CPU," << answerCount << "answers in" << kBenchmarkMs << "ms";
+}
+
+QTEST_MAIN(CliEventPublisher_test)
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QObject>
+#include <QVector>
+
+#include "ipc/connection.h"
+
+class CliEventPublisher_test : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void testSnapshotOnSubscribe();
+    void testTrafficAndPingCoalesced();
+    void testConnectStateAndErrorAtOnce();
+    void testUnsubscribe();
+    // the CPU time of 10 watchers, compared with 10 clients that poll GetState often enough to notice a connect state
+    // change as soon
+    void benchmarkWatchersVsPolling();
+
+private:
+    QLocalServer server_;
+    // pairs of connections with the same index
+    QVector<IPC::Connection *> serverConnections_;
+    QVector<IPC::Connection *> clientConnections_;
+
+    void makeConnections(int count);
+};
@@ -0,0 +1,190 @@
+#include "connection.test.h"
+#include <QtTest>
+#include <QElapsedTimer>
+
+#include "ipc/clicommands.h"
+#include "ipc/commandfactory.h"
+#include "ipc/connection.h"
+
+namespace {
+
+const int kCommandCount = 100000;
+const int kTimeoutMs = 60000;
+
+// receives the locations of Connect commands
+class Receiver : public QObject
+{
+public:
+    explicit Receiver(IPC::Connection *connection)
+    {
+        QObject::connect(connection, &IPC::Connection::newCommand, this, [this](IPC::Command *command, IPC::Connection *) {
+            auto *connect = dynamic_cast<IPC::CliCommands::Connect *>(command);
+            locations << (connect ? connect->location_ : QString());
+            delete command;
+        });
+    }
+
+    QStringList locations;
+};
+
+bool waitFor(const std::function<bool()> &condition)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (!condition()) {
+        if (timer.elapsed() > kTimeoutMs)
+            return false;
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+    }
+    return true;
+}
+
+QByteArray frame(const IPC::Command &command)
+{
+    const std::vector<char> body = command.getData();
+    const std::string id = command.getStringId();
+    const int sizeOfBuf = body.size();
+    const int sizeOfId = id.size();
+    QByteArray result;
+    result.append((const char *)&sizeOfBuf, sizeof(int));
+    result.append((const char *)&sizeOfId, sizeof(int));
+    result.append(id.c_str(), sizeOfId);
+    result.append(body.data(), sizeOfBuf);
+    return result;
+}
+
+} // namespace
+
+void Connection_test::init()
+{
+    const QString name = QString("windscribe_connection_test_%1").arg(QCoreApplication::applicationPid());
+    QLocalServer::removeServer(name);
+    QVERIFY(server_.listen(name));
+    clientSocket_ = new QLocalSocket();
+    clientSocket_->connectToServer(name);
+    QVERIFY(clientSocket_->waitForConnected(kTimeoutMs));
+    QVERIFY(server_.waitForNewConnection(kTimeoutMs));
+    serverSocket_ = server_.nextPendingConnection();
+    QVERIFY(serverSocket_);
+    serverSocket_->setParent(nullptr);
+}
+
+void Connection_test::cleanup()
+{
+    // owned by the connections, if the test made them
+    clientSocket_ = nullptr;
+    serverSocket_ = nullptr;
+    server_.close();
+}
+
+void Connection_test::testCommandsInOrder()
+{
+    IPC::Connection sender(clientSocket_);
+    IPC::Connection receiver(serverSocket_);
+    Receiver received(&receiver);
+    QSignalSpy allWritten(&sender, &IPC::Connection::allWritten);
+
+    // one burst, most of it coalesced while the socket writes the first command
+    for (int i = 0; i < 1000; ++i) {
+        IPC::CliCommands::Connect command;
+        command.location_ = QString::number(i);
+        sender.sendCommand(command);
+    }
+    QVERIFY(waitFor([&]() { return received.locations.size() >= 1000; }));
+    QCOMPARE(received.locations.size(), 1000);
+    for (int i = 0; i < 1000; ++i)
+        QCOMPARE(received.locations[i], QString::number(i));
+    QVERIFY(waitFor([&]() { return allWritten.count() > 0; }));
+
+    // and one more after the socket is idle
+    IPC::CliCommands::Connect command;
+    command.location_ = "last";
+    sender.sendCommand(command);
+    QVERIFY(waitFor([&]() { return received.locations.size() == 1001; }));
+    QCOMPARE(received.locations.last(), QString("last"));
+}
+
+void Connection_test::testCommandSplitAcrossReads()
+{
+    IPC::Connection receiver(serverSocket_);
+    Receiver received(&receiver);
+
+    IPC::CliCommands::Connect command;
+    command.location_ = QString(5000, 'x');
+    const QByteArray data = frame(command) + frame(command);
+    // byte by byte for the header, then in uneven pieces
+    int pos = 0;
+    for (int step : { 1, 1, 1, 1, 1, 1, 1, 1, 100, 3000, 7000 }) {
+        clientSocket_->write(data.mid(pos, step));
+        clientSocket_->flush();
+        pos += step;
+        QTest::qWait(10);
+    }
+    clientSocket_->write(data.mid(pos));
+    clientSocket_->flush();
+    QVERIFY(waitFor([&]() { return received.locations.size() == 2; }));
+    QCOMPARE(received.locations[0], command.location_);
+    QCOMPARE(received.locations[1], command.location_);
+    delete clientSocket_;
+}
+
+void Connection_test::benchmarkThroughput()
+{
+    QElapsedTimer timer;
+    qint64 legacyMs;
+    {
+        // the former framing: each command appended to a QByteArray, written, and removed from the front when read
+        QByteArray writeBuf;
+        QByteArray readBuf;
+        int count = 0;
+        const QMetaObject::Connection readConnection = QObject::connect(serverSocket_, &QLocalSocket::readyRead, [&]() {
+            readBuf.append(serverSocket_->readAll());
+            for (;;) {
+                if (readBuf.size() <= (int)(sizeof(int) * 2))
+                    break;
+                int sizeOfCmd, sizeOfId;
+                memcpy(&sizeOfCmd, readBuf.data(), sizeof(int));
+                memcpy(&sizeOfId, readBuf.data() + sizeof(int), sizeof(int));
+                const int size = sizeof(int) * 2 + sizeOfCmd + sizeOfId;
+                if (readBuf.size() < size)
+                    break;
+                delete IPC::CommandFactory::makeCommand(std::string(readBuf.data() + sizeof(int) * 2, sizeOfId),
+                                                        readBuf.data() + sizeof(int) * 2 + sizeOfId, sizeOfCmd);
+                readBuf.remove(0, size);
+                count++;
+            }
+        });
+        timer.start();
+        for (int i = 0; i < kCommandCount; ++i) {
+            IPC::CliCommands::Firewall command;
+            command.isEnable_ = i % 2;
+            writeBuf.append(frame(command));
+            clientSocket_->write(writeBuf);
+            writeBuf.clear();
+        }
+        QVERIFY(waitFor([&]() { return count == kCommandCount; }));
+        legacyMs = qMax<qint64>(1, timer.elapsed());
+        QObject::disconnect(readConnection);
+    }
+
+    IPC::Connection sender(clientSocket_);
+    IPC::Connection receiver(serverSocket_);
+    int count = 0;
+    QObject::connect(&receiver, &IPC::Connection::newCommand, [&count](IPC::Command *command, IPC::Connection *) {
+        delete command;
+        count++;
+    });
+    timer.start();
+    for (int i = 0; i < kCommandCount; ++i) {
+        IPC::CliCommands::Firewall command;
+        command.isEnable_ = i % 2;
+        sender.sendCommand(command);
+    }
+    QVERIFY(waitFor([&]() { return count == kCommandCount; }));
+    const qint64 elapsedMs = qMax<qint64>(1, timer.elapsed());
+
+    qDebug() << "former framing:" << kCommandCount * 1000 / legacyMs << "commands/s";
+    qDebug() << "Connection:" << kCommandCount * 1000 / elapsedMs << "commands/s";
+}
+
+QTEST_MAIN(Connection_test)
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QObject>
+
+class Connection_test : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void testCommandsInOrder();
+    void testCommandSplitAcrossReads();
+    // 100k small commands through a socket pair, compared with the framing of a QByteArray appended to and removed
+    // from the front per command
+    void benchmarkThroughput();
+
+private:
+    QLocalServer server_;
+    QLocalSocket *clientSocket_ = nullptr;
+    QLocalSocket *serverSocket_ = nullptr;
+};
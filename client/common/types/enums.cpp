@@ -68,6 +68,83 @@ QString LOGIN_RET_toString(LOGIN_RET ret)
     }
 }
 
+QString CONNECT_ERROR_toString(CONNECT_ERROR err)
+{
+    // stable names for the CLI, unlike the numbers
+    switch (err) {
+    case NO_CONNECT_ERROR:
+        return "NO_CONNECT_ERROR";
+    case AUTH_ERROR:
+        return "AUTH_ERROR";
+    case LOCATION_NOT_EXIST:
+        return "LOCATION_NOT_EXIST";
+    case LOCATION_NO_ACTIVE_NODES:
+        return "LOCATION_NO_ACTIVE_NODES";
+    case CONNECTION_BLOCKED:
+        return "CONNECTION_BLOCKED";
+    case NO_OPENVPN_SOCKET:
+        return "NO_OPENVPN_SOCKET";
+    case EXE_SUBPROCESS_FAILED:
+        return "EXE_SUBPROCESS_FAILED";
+    case NO_INSTALLED_TUN_TAP:
+        return "NO_INSTALLED_TUN_TAP";
+    case UDP_CANT_ASSIGN:
+        return "UDP_CANT_ASSIGN";
+    case CONNECTED_ERROR:
+        return "CONNECTED_ERROR";
+    case INITIALIZATION_SEQUENCE_COMPLETED_WITH_ERRORS:
+        return "INITIALIZATION_SEQUENCE_COMPLETED_WITH_ERRORS";
+    case UDP_NO_BUFFER_SPACE:
+        return "UDP_NO_BUFFER_SPACE";
+    case UDP_NETWORK_DOWN:
+        return "UDP_NETWORK_DOWN";
+    case TCP_ERROR:
+        return "TCP_ERROR";
+    case CANNOT_OPEN_CUSTOM_CONFIG:
+        return "CANNOT_OPEN_CUSTOM_CONFIG";
+    case IKEV_FAILED_TO_CONNECT:
+        return "IKEV_FAILED_TO_CONNECT";
+    case IKEV_NOT_FOUND_WIN:
+        return "IKEV_NOT_FOUND_WIN";
+    case IKEV_FAILED_SET_ENTRY_WIN:
+        return "IKEV_FAILED_SET_ENTRY_WIN";
+    case IKEV_FAILED_MODIFY_HOSTS_WIN:
+        return "IKEV_FAILED_MODIFY_HOSTS_WIN";
+    case IKEV_NETWORK_EXTENSION_NOT_FOUND_MAC:
+        return "IKEV_NETWORK_EXTENSION_NOT_FOUND_MAC";
+    case IKEV_FAILED_SET_KEYCHAIN_MAC:
+        return "IKEV_FAILED_SET_KEYCHAIN_MAC";
+    case IKEV_FAILED_START_MAC:
+        return "IKEV_FAILED_START_MAC";
+    case IKEV_FAILED_LOAD_PREFERENCES_MAC:
+        return "IKEV_FAILED_LOAD_PREFERENCES_MAC";
+    case IKEV_FAILED_SAVE_PREFERENCES_MAC:
+        return "IKEV_FAILED_SAVE_PREFERENCES_MAC";
+    case WIREGUARD_CONNECTION_ERROR:
+        return "WIREGUARD_CONNECTION_ERROR";
+    case EMERGENCY_FAILED_CONNECT:
+        return "EMERGENCY_FAILED_CONNECT";
+    case WINTUN_OVER_CAPACITY:
+        return "WINTUN_OVER_CAPACITY";
+    case WINTUN_FATAL_ERROR:
+        return "WINTUN_FATAL_ERROR";
+    case STATE_TIMEOUT_FOR_AUTOMATIC:
+        return "STATE_TIMEOUT_FOR_AUTOMATIC";
+    case WIREGUARD_ADAPTER_SETUP_FAILED:
+        return "WIREGUARD_ADAPTER_SETUP_FAILED";
+    case WIREGUARD_COULD_NOT_RETRIEVE_CONFIG:
+        return "WIREGUARD_COULD_NOT_RETRIEVE_CONFIG";
+    case CTRLD_START_FAILED:
+        return "CTRLD_START_FAILED";
+    case PRIV_KEY_PASSWORD_ERROR:
+        return "PRIV_KEY_PASSWORD_ERROR";
+    case LOCKDOWN_MODE_IKEV2:
+        return "LOCKDOWN_MODE_IKEV2";
+    default:
+        return "UNKNOWN";
+    }
+}
+
 QString DNS_POLICY_TYPE_ToString(DNS_POLICY_TYPE d)
 {
     if (d == DNS_TYPE_OS_DEFAULT)
@@ -270,6 +270,7 @@ enum LOCATION_TAB {
 
 // utils for enums
 QString LOGIN_RET_toString(LOGIN_RET ret);
+QString CONNECT_ERROR_toString(CONNECT_ERROR err);
 QString DNS_POLICY_TYPE_ToString(DNS_POLICY_TYPE d);
 QList<QPair<QString, QVariant>> DNS_POLICY_TYPE_toList();
 
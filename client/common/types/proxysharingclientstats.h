@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QDataStream>
+#include <QString>
+
+namespace types {
+
+// Traffic of one LAN device through the shared proxy since the proxy sharing was started.
+struct ProxySharingClientStats
+{
+    QString address;
+    qint32 activeConnections = 0;
+    quint64 totalConnections = 0;
+    quint64 bytesUploaded = 0;      // from the device to the internet
+    quint64 bytesDownloaded = 0;    // from the internet to the device
+    quint32 rateLimitKBps = 0;      // 0 if not limited
+
+    bool operator==(const ProxySharingClientStats &other) const
+    {
+        return other.address == address &&
+               other.activeConnections == activeConnections &&
+               other.totalConnections == totalConnections &&
+               other.bytesUploaded == bytesUploaded &&
+               other.bytesDownloaded == bytesDownloaded &&
+               other.rateLimitKBps == rateLimitKBps;
+    }
+
+    bool operator!=(const ProxySharingClientStats &other) const
+    {
+        return !(*this == other);
+    }
+
+    friend QDataStream& operator <<(QDataStream &stream, const ProxySharingClientStats &o)
+    {
+        stream << versionForSerialization_;
+        stream << o.address << o.activeConnections << o.totalConnections << o.bytesUploaded << o.bytesDownloaded << o.rateLimitKBps;
+        return stream;
+    }
+
+    friend QDataStream& operator >>(QDataStream &stream, ProxySharingClientStats &o)
+    {
+        quint32 version;
+        stream >> version;
+        if (version > o.versionForSerialization_)
+        {
+            stream.setStatus(QDataStream::ReadCorruptData);
+            return stream;
+        }
+        stream >> o.address >> o.activeConnections >> o.totalConnections >> o.bytesUploaded >> o.bytesDownloaded >> o.rateLimitKBps;
+        return stream;
+    }
+
+private:
+    static constexpr quint32 versionForSerialization_ = 1;  // should increment the version if the data format is changed
+};
+
+} // types namespace
@@ -0,0 +1,227 @@
+#include "asynclogwriter.h"
+
+#include <chrono>
+
+namespace {
+
+size_t roundUpToPowerOfTwo(size_t value)
+{
+    size_t result = 2;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+} // namespace
+
+AsyncLogWriter::AsyncLogWriter(const WriteFunction &writeFunction, const SyncFunction &syncFunction, SyncPolicy syncPolicy,
+                               size_t capacity)
+    : writeFunction_(writeFunction), syncFunction_(syncFunction), syncPolicy_(syncPolicy),
+      slots_(new Slot[roundUpToPowerOfTwo(capacity)]), mask_(roundUpToPowerOfTwo(capacity) - 1), enqueuePos_(0), dequeuePos_(0),
+      isWriterIdle_(false), isStopped_(false), isStopRequested_(false), flushTarget_(0), writtenPos_(0), stalls_(0)
+{
+    for (size_t i = 0; i <= mask_; ++i) {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    thread_ = std::thread([this]() { run(); });
+}
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+    stop();
+}
+
+void AsyncLogWriter::write(const char *data, size_t size)
+{
+    if (isStopped_.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    std::string line(data, size);
+    while (!tryPush(line)) {
+        // a line logged by the write or sync function would wait for the writer, i.e. for itself
+        if (std::this_thread::get_id() == thread_.get_id()) {
+            return;
+        }
+        // the writer is a whole ring behind, e.g. the disk is stalled
+        stalls_.fetch_add(1, std::memory_order_relaxed);
+        wakeWriter();
+        std::this_thread::yield();
+        if (isStopped_.load(std::memory_order_relaxed)) {
+            return;
+        }
+    }
+
+    // pairs with the fence of the writer before it looks at the queue for the last time before sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (isWriterIdle_.load(std::memory_order_relaxed)) {
+        wakeWriter();
+    }
+}
+
+void AsyncLogWriter::flush()
+{
+    if (std::this_thread::get_id() == thread_.get_id()) {
+        return;
+    }
+    std::unique_lock<std::mutex> locker(mutex_);
+    if (isStopped_) {
+        return;
+    }
+    const size_t target = enqueuePos_.load(std::memory_order_acquire);
+    if (target > flushTarget_) {
+        flushTarget_ = target;
+    }
+    wakeCondition_.notify_one();
+    flushedCondition_.wait(locker, [this, target]() { return writtenPos_ >= target || isStopped_; });
+}
+
+void AsyncLogWriter::stop()
+{
+    {
+        std::lock_guard<std::mutex> locker(mutex_);
+        if (isStopRequested_) {
+            return;
+        }
+        isStopRequested_ = true;
+        wakeCondition_.notify_one();
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+std::string AsyncLogWriter::tail() const
+{
+    std::lock_guard<std::mutex> locker(tailMutex_);
+    return tail_;
+}
+
+bool AsyncLogWriter::tryPush(std::string &line)
+{
+    size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+        slot = &slots_[pos & mask_];
+        const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        const intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // full
+            return false;
+        } else {
+            pos = enqueuePos_.load(std::memory_order_relaxed);
+        }
+    }
+    slot->line = std::move(line);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool AsyncLogWriter::tryPop(std::string &line)
+{
+    Slot &slot = slots_[dequeuePos_ & mask_];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeuePos_ + 1) {
+        return false;
+    }
+    line.swap(slot.line);
+    slot.line.clear();
+    slot.sequence.store(dequeuePos_ + mask_ + 1, std::memory_order_release);
+    dequeuePos_++;
+    return true;
+}
+
+bool AsyncLogWriter::hasQueued() const
+{
+    return slots_[dequeuePos_ & mask_].sequence.load(std::memory_order_acquire) == dequeuePos_ + 1;
+}
+
+void AsyncLogWriter::wakeWriter()
+{
+    std::lock_guard<std::mutex> locker(mutex_);
+    wakeCondition_.notify_one();
+}
+
+void AsyncLogWriter::run()
+{
+    std::string batch;
+    std::string line;
+    bool isUnsynced = false;
+    auto lastSync = std::chrono::steady_clock::now();
+
+    for (;;) {
+        batch.clear();
+        while (tryPop(line)) {
+            batch += line;
+            batch += "\r\n";
+        }
+
+        if (!batch.empty()) {
+            writeFunction_(batch.data(), batch.size());
+            isUnsynced = true;
+            appendToTail(batch);
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        bool isFlushRequested;
+        bool isStopRequested;
+        {
+            std::lock_guard<std::mutex> locker(mutex_);
+            isFlushRequested = flushTarget_ > writtenPos_;
+            isStopRequested = isStopRequested_;
+        }
+        if (isUnsynced && (syncPolicy_ == kSyncEveryBatch || isFlushRequested || isStopRequested ||
+                           (syncPolicy_ == kSyncPeriodically && now - lastSync >= std::chrono::milliseconds(kSyncIntervalMs)))) {
+            syncFunction_();
+            isUnsynced = false;
+            lastSync = now;
+        }
+
+        std::unique_lock<std::mutex> locker(mutex_);
+        writtenPos_ = dequeuePos_;
+        flushedCondition_.notify_all();
+        if (isStopRequested_ && !hasQueued()) {
+            isStopped_ = true;
+            flushedCondition_.notify_all();
+            break;
+        }
+        if (!batch.empty() || hasQueued() || flushTarget_ > writtenPos_) {
+            // a flush waits for lines that were claimed but are not in the ring yet
+            if (flushTarget_ > writtenPos_ && !hasQueued()) {
+                locker.unlock();
+                std::this_thread::yield();
+            }
+            continue;
+        }
+
+        isWriterIdle_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wakeCondition_.wait_for(locker, std::chrono::milliseconds(kIdleWaitMs), [this]() {
+            return hasQueued() || isStopRequested_ || flushTarget_ > writtenPos_;
+        });
+        isWriterIdle_.store(false, std::memory_order_relaxed);
+    }
+}
+
+void AsyncLogWriter::appendToTail(const std::string &lines)
+{
+    std::lock_guard<std::mutex> locker(tailMutex_);
+    for (size_t pos = 0; pos < lines.size();) {
+        // the tail has the line ends of the old in-memory log
+        const size_t end = lines.find("\r\n", pos);
+        tail_.append(lines, pos, end - pos);
+        tail_ += '\n';
+        pos = end + 2;
+    }
+    // trimmed in big steps, at a line start
+    if (tail_.size() > kTailBytes * 2) {
+        size_t cut = tail_.size() - kTailBytes;
+        const size_t lineEnd = tail_.find('\n', cut);
+        cut = (lineEnd == std::string::npos) ? cut : lineEnd + 1;
+        tail_.erase(0, cut);
+    }
+}
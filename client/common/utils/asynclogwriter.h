@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Takes log lines from any number of threads and writes them on a thread of its own, so that logging costs the caller
+// a copy into a lock-free ring instead of a write and a flush of the file under a global lock. The writer takes
+// everything that is queued in one batch, writes it with one call and syncs it to the disk according to the policy.
+// The last kTailBytes of the log are kept in memory.
+class AsyncLogWriter
+{
+public:
+    enum SyncPolicy { kSyncNever, kSyncPeriodically, kSyncEveryBatch };
+
+    // called on the writer thread only
+    typedef std::function<void(const char *data, size_t size)> WriteFunction;
+    typedef std::function<void()> SyncFunction;
+
+    AsyncLogWriter(const WriteFunction &writeFunction, const SyncFunction &syncFunction, SyncPolicy syncPolicy = kSyncPeriodically,
+                   size_t capacity = kDefaultCapacity);
+    ~AsyncLogWriter();
+
+    // one line without the line end. Waits for a free slot if the writer is behind by the whole capacity; on the writer
+    // thread, i.e. from the write or sync function, the line is dropped instead.
+    void write(const char *data, size_t size);
+    // waits until the lines written before the call reached the file, does nothing on the writer thread
+    void flush();
+    // writes what is queued and ends the writer thread, later lines are dropped
+    void stop();
+
+    std::string tail() const;
+    // how often a caller had to wait for a free slot
+    uint64_t stalls() const { return stalls_; }
+
+private:
+    static constexpr size_t kDefaultCapacity = 8192;
+    static constexpr size_t kTailBytes = 512 * 1024;
+    static constexpr int kSyncIntervalMs = 5000;
+    // the writer wakes up by itself after that long, in case a wakeup was missed
+    static constexpr int kIdleWaitMs = 200;
+
+    // Bounded MPMC queue of D. Vyukov, with a single consumer: a slot is free for the position p when its sequence
+    // is p, and holds the line for p when its sequence is p + 1.
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        std::string line;
+    };
+
+    const WriteFunction writeFunction_;
+    const SyncFunction syncFunction_;
+    const SyncPolicy syncPolicy_;
+
+    std::unique_ptr<Slot[]> slots_;
+    const size_t mask_;
+    std::atomic<size_t> enqueuePos_;
+    size_t dequeuePos_;     // writer thread only
+
+    std::mutex mutex_;
+    std::condition_variable wakeCondition_;
+    std::condition_variable flushedCondition_;
+    std::atomic<bool> isWriterIdle_;
+    std::atomic<bool> isStopped_;
+    bool isStopRequested_;
+    size_t flushTarget_;
+    size_t writtenPos_;
+    std::atomic<uint64_t> stalls_;
+
+    mutable std::mutex tailMutex_;
+    std::string tail_;
+
+    std::thread thread_;
+
+    bool tryPush(std::string &line);
+    bool tryPop(std::string &line);
+    bool hasQueued() const;
+    void wakeWriter();
+    void run();
+    void appendToTail(const std::string &lines);
+};
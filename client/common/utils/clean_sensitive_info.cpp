@@ -1,6 +1,10 @@
 #include "clean_sensitive_info.h"
 #include <QStandardPaths>
 #include <QString>
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <queue>
 #include <string>
 #include <vector>
 
@@ -65,6 +69,153 @@ T CleanSensitiveInfoHelper<T>::process()
     return result;
 }
 
+const SensitiveInfoScrubber &SensitiveInfoScrubber::instance()
+{
+    static const SensitiveInfoScrubber scrubber(GetSensitiveReplacements<std::string>());
+    return scrubber;
+}
+
+SensitiveInfoScrubber::SensitiveInfoScrubber(const Replacements &replacements)
+    : firstByte_(-1)
+{
+    for (const auto &replacement : replacements)
+        if (!replacement.first.empty())
+            replacements_.push_back(replacement);
+
+    // the trie, -1 for a missing edge
+    transitions_.assign(256, -1);
+    outputs_.resize(1);
+    for (int i = 0; i < static_cast<int>(replacements_.size()); ++i) {
+        int state = 0;
+        for (unsigned char c : replacements_[i].first) {
+            if (transitions_[state * 256 + c] < 0) {
+                transitions_[state * 256 + c] = static_cast<int32_t>(outputs_.size());
+                outputs_.emplace_back();
+                transitions_.resize(transitions_.size() + 256, -1);
+            }
+            state = transitions_[state * 256 + c];
+        }
+        outputs_[state].push_back(i);
+    }
+
+    // breadth-first, turning the missing edges into the edges of the longest proper suffix in the trie
+    std::vector<int32_t> fail(outputs_.size(), 0);
+    std::queue<int32_t> queue;
+    for (int c = 0; c < 256; ++c) {
+        int32_t &next = transitions_[c];
+        if (next < 0) {
+            next = 0;
+        } else {
+            queue.push(next);
+        }
+    }
+    while (!queue.empty()) {
+        const int32_t state = queue.front();
+        queue.pop();
+        const std::vector<int> &suffixOutputs = outputs_[fail[state]];
+        outputs_[state].insert(outputs_[state].end(), suffixOutputs.begin(), suffixOutputs.end());
+        for (int c = 0; c < 256; ++c) {
+            int32_t &next = transitions_[state * 256 + c];
+            if (next < 0) {
+                next = transitions_[fail[state] * 256 + c];
+            } else {
+                fail[next] = transitions_[fail[state] * 256 + c];
+                queue.push(next);
+            }
+        }
+    }
+
+    hasOutputs_.resize(outputs_.size());
+    for (size_t state = 0; state < outputs_.size(); ++state)
+        hasOutputs_[state] = !outputs_[state].empty();
+    for (const auto &replacement : replacements_) {
+        const int c = static_cast<unsigned char>(replacement.first[0]);
+        if (&replacement == &replacements_.front()) {
+            firstByte_ = c;
+        } else if (c != firstByte_) {
+            firstByte_ = -1;
+            break;
+        }
+    }
+}
+
+void SensitiveInfoScrubber::scrub(const char *data, size_t size, std::string &out) const
+{
+    std::vector<Match> matches;
+    int32_t state = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (state == 0 && firstByte_ >= 0) {
+            const void *found = memchr(data + i, firstByte_, size - i);
+            if (!found)
+                break;
+            i = static_cast<const char *>(found) - data;
+        }
+        state = transitions_[state * 256 + static_cast<unsigned char>(data[i])];
+        if (hasOutputs_[state]) {
+            for (int replacement : outputs_[state])
+                matches.push_back({ i + 1 - replacements_[replacement].first.size(), i + 1, replacement });
+        }
+    }
+    if (matches.empty()) {
+        out.append(data, size);
+        return;
+    }
+
+    selectMatches(matches);
+    size_t pos = 0;
+    for (const Match &match : matches) {
+        out.append(data + pos, match.start - pos);
+        out += replacements_[match.replacement].second;
+        pos = match.end;
+    }
+    out.append(data + pos, size - pos);
+}
+
+std::string SensitiveInfoScrubber::scrub(const std::string &text) const
+{
+    std::string result;
+    result.reserve(text.size());
+    scrub(text.data(), text.size(), result);
+    return result;
+}
+
+// Replacing one string after another keeps the leftmost occurrences of each string that overlap neither each other
+// nor the replaced occurrences of the strings before it. Leaves those in matches, sorted by position.
+void SensitiveInfoScrubber::selectMatches(std::vector<Match> &matches) const
+{
+    std::stable_sort(matches.begin(), matches.end(), [](const Match &a, const Match &b) {
+        return a.replacement < b.replacement || (a.replacement == b.replacement && a.start < b.start);
+    });
+
+    std::vector<Match> selected;
+    int replacement = -1;
+    size_t firstOfReplacement = 0;
+    size_t lastEnd = 0;
+    for (const Match &match : matches) {
+        if (match.replacement != replacement) {
+            // keeps the matches of the strings before sorted by position
+            std::inplace_merge(selected.begin(), selected.begin() + firstOfReplacement, selected.end(),
+                               [](const Match &a, const Match &b) { return a.start < b.start; });
+            replacement = match.replacement;
+            firstOfReplacement = selected.size();
+            lastEnd = 0;
+        }
+        if (match.start < lastEnd)
+            continue;
+        const auto begin = selected.begin();
+        const auto end = selected.begin() + firstOfReplacement;
+        const auto next = std::lower_bound(begin, end, match.end,
+                                           [](const Match &m, size_t position) { return m.start < position; });
+        if (next != begin && std::prev(next)->end > match.start)
+            continue;
+        selected.push_back(match);
+        lastEnd = match.end;
+    }
+    std::inplace_merge(selected.begin(), selected.begin() + firstOfReplacement, selected.end(),
+                       [](const Match &a, const Match &b) { return a.start < b.start; });
+    matches.swap(selected);
+}
+
 // Explicit template instantiations.
 template class CleanSensitiveInfoHelper<QString>;
 template class CleanSensitiveInfoHelper<std::string>;
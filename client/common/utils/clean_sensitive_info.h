@@ -1,5 +1,11 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
 namespace Utils {
 
 template<typename T>
@@ -21,4 +27,42 @@ T cleanSensitiveInfo(const T &value)
     return CleanSensitiveInfoHelper<T>(value).process();
 }
 
+// Replaces strings in UTF-8 text with the result of replacing them one after another, like cleanSensitiveInfo does for
+// its paths, but in a single pass over the text: an Aho-Corasick automaton finds the occurrences of all the strings at
+// once, and an earlier string wins where occurrences overlap. For long texts, e.g. the merged log.
+class SensitiveInfoScrubber
+{
+public:
+    typedef std::vector<std::pair<std::string, std::string>> Replacements;
+
+    // the replacements of cleanSensitiveInfo
+    static const SensitiveInfoScrubber &instance();
+
+    // empty strings are ignored
+    explicit SensitiveInfoScrubber(const Replacements &replacements);
+
+    // appends the scrubbed text to out
+    void scrub(const char *data, size_t size, std::string &out) const;
+    std::string scrub(const std::string &text) const;
+
+private:
+    struct Match
+    {
+        size_t start;
+        size_t end;
+        int replacement;
+    };
+
+    Replacements replacements_;
+    // the automaton as a full transition table, 256 entries per state
+    std::vector<int32_t> transitions_;
+    // the replacements that end in a state, the ones of the suffixes included
+    std::vector<std::vector<int>> outputs_;
+    std::vector<uint8_t> hasOutputs_;
+    // the byte all the strings start with, or -1; the search skips to it with memchr from the initial state
+    int firstByte_;
+
+    void selectMatches(std::vector<Match> &matches) const;
+};
+
 }  // namespace Utils
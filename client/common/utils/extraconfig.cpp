@@ -33,9 +33,12 @@ const QString WS_WG_UDP_STUFFING = WS_PREFIX + "wireguard-udp-stuffing";
 const QString WS_SERVERLIST_COUNTRY_OVERRIDE = WS_PREFIX + "serverlist-country-override";
 
 const QString WS_USE_OPENVPN_DCO = WS_PREFIX + "use-openvpn-dco";
+const QString WS_OPENVPN_BYTECOUNT_INTERVAL_STR = WS_PREFIX + "openvpn-bytecount-interval";
 
 const QString WS_LOG_CTRLD = WS_PREFIX + "log-ctrld";
 
+const QString WS_VPN_SHARE_NATIVE_PROXY = WS_PREFIX + "vpn-share-native-proxy";
+
 void ExtraConfig::writeConfig(const QString &cfg)
 {
     QMutexLocker locker(&mutex_);
@@ -348,6 +351,16 @@ bool ExtraConfig::useOpenVpnDCO()
     return getFlagFromExtraConfigLines(WS_USE_OPENVPN_DCO);
 }
 
+int ExtraConfig::getOpenVpnBytecountInterval(bool &success)
+{
+    return getIntFromExtraConfigLines(WS_OPENVPN_BYTECOUNT_INTERVAL_STR, success);
+}
+
+bool ExtraConfig::getVpnShareNativeProxy()
+{
+    return getFlagFromExtraConfigLines(WS_VPN_SHARE_NATIVE_PROXY);
+}
+
 ExtraConfig::ExtraConfig() : path_(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation)
                                    + "/windscribe_extra.conf"),
                              regExp_("(?m)^(?i)(verb)(\\s+)(\\d+$)")
@@ -62,6 +62,11 @@ public:
     bool haveServerListCountryOverride();
 
     bool useOpenVpnDCO();
+    // seconds between the traffic statistics from openvpn
+    int getOpenVpnBytecountInterval(bool &success);
+
+    // share the connection through the native proxy engine rather than the Qt proxy servers
+    bool getVpnShareNativeProxy();
 
 private:
     ExtraConfig();
@@ -8,9 +8,16 @@
 #include <QStandardPaths>
 #include <QString>
 
+#ifdef Q_OS_WIN
+    #include <io.h>
+    #include <windows.h>
+#else
+    #include <unistd.h>
+#endif
+
 QFile *Logger::file_ = NULL;
+std::atomic<AsyncLogWriter *> Logger::writer_(nullptr);
 QMutex Logger::mutex_;
-QString Logger::strLog_;
 QString Logger::logPath_;
 QString Logger::prevLogPath_;
 bool Logger::consoleOutput_;
@@ -90,6 +97,18 @@ void Logger::install(const QString &name, bool consoleOutput, bool recoveryMode)
     QMutexLocker lock(&mutex_);
     file_ = new QFile(logFilePath);
     file_->open(openModeFlag);
+    writer_ = new AsyncLogWriter(
+        [](const char *data, size_t size) {
+            file_->write(data, size);
+            file_->flush();
+        },
+        []() {
+#ifdef Q_OS_WIN
+            FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(file_->handle())));
+#else
+            fsync(file_->handle());
+#endif
+        });
     consoleOutput_ = consoleOutput;
     prevMessageHandler_ = qInstallMessageHandler(myMessageHandler);
 }
@@ -101,6 +120,12 @@ Logger::Logger()
 Logger::~Logger()
 {
     QMutexLocker lock(&mutex_);
+    // other threads may still be logging while the statics are destroyed, the stopped writer drops their lines and
+    // stays allocated for them
+    if (writer_)
+    {
+        writer_.load()->stop();
+    }
     if (file_)
     {
         file_->close();
@@ -122,19 +147,18 @@ void Logger::copyToPrevLog()
 
 void Logger::myMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &s)
 {
+    // formatted on the calling thread, written on the thread of the writer
+    AsyncLogWriter *writer = writer_;
+    if (writer)
     {
-        QMutexLocker lock(&mutex_);
-
-        if (file_)
+        QString str = qFormatLogMessage(type, context, s);
+        str.replace(QLatin1String("{gmt_time}"), gmtTime());
+        const QByteArray line = str.toLocal8Bit();
+        writer->write(line.constData(), line.size());
+        // the process is about to abort
+        if (type == QtFatalMsg)
         {
-            QString str = qFormatLogMessage(type, context, s);
-            QString strDateTime = QDateTime::currentDateTimeUtc().toString("ddMMyy hh:mm:ss:zzz");
-            str.replace("{gmt_time}", strDateTime);
-
-            file_->write(str.toLocal8Bit());
-            file_->write("\r\n");
-            file_->flush();
-            strLog_ += str + "\n";
+            writer->flush();
         }
     }
     if (consoleOutput_)
@@ -145,7 +169,6 @@ void Logger::myMessageHandler(QtMsgType type, const QMessageLogContext &context,
 
 QString Logger::getLogStr()
 {
-    QMutexLocker lock(&mutex_);
     QString ret;
     QFile prevFileLog(prevLogPath_);
     if (prevFileLog.open(QIODevice::ReadOnly))
@@ -154,14 +177,50 @@ QString Logger::getLogStr()
         ret += "----------------------------------------------------------------\n";
         prevFileLog.close();
     }
-    ret += strLog_;
+    ret += getCurrentLogStr();
     return ret;
 }
 
 QString Logger::getCurrentLogStr()
 {
-    QMutexLocker lock(&mutex_);
-    return strLog_;
+    AsyncLogWriter *writer = writer_;
+    if (!writer)
+    {
+        return QString();
+    }
+    writer->flush();
+    return QString::fromLocal8Bit(writer->tail());
+}
+
+void Logger::flush()
+{
+    AsyncLogWriter *writer = writer_;
+    if (writer)
+    {
+        writer->flush();
+    }
+}
+
+QString Logger::gmtTime()
+{
+    thread_local qint64 cachedSecond = -1;
+    thread_local QString cachedPrefix;
+
+    const qint64 msecs = QDateTime::currentMSecsSinceEpoch();
+    const qint64 second = msecs / 1000;
+    if (second != cachedSecond)
+    {
+        cachedSecond = second;
+        cachedPrefix = QDateTime::fromMSecsSinceEpoch(second * 1000, Qt::UTC).toString("ddMMyy hh:mm:ss:");
+    }
+    const int millisecond = static_cast<int>(msecs % 1000);
+    QString result;
+    result.reserve(cachedPrefix.size() + 3);
+    result += cachedPrefix;
+    result += QChar('0' + millisecond / 100);
+    result += QChar('0' + millisecond / 10 % 10);
+    result += QChar('0' + millisecond % 10);
+    return result;
 }
 
 void Logger::startConnectionMode()
@@ -3,7 +3,9 @@
 #include <QFile>
 #include <QMutex>
 #include <QLoggingCategory>
+#include <atomic>
 
+#include "asynclogwriter.h"
 #include "clean_sensitive_info.h"
 #include "multiline_message_logger.h"
 
@@ -56,8 +58,11 @@ public:
 
     void install(const QString &name, bool consoleOutput, bool recoveryMode);
     void setConsoleOutput(bool on);
+    // the previous log and the tail of the current one
     QString getLogStr();
     QString getCurrentLogStr();
+    // waits until the lines logged so far are in the log file
+    void flush();
 
     void startConnectionMode();
     void endConnectionMode();
@@ -74,9 +79,10 @@ private:
 private:
     static QtMessageHandler prevMessageHandler_;
 
+    // the file is written on the thread of the writer only
     static QFile *file_;
+    static std::atomic<AsyncLogWriter *> writer_;
     static QMutex mutex_;
-    static QString strLog_;
     static QString logPath_;
     static QString prevLogPath_;
     static bool consoleOutput_;
@@ -88,4 +94,6 @@ private:
     static QLoggingCategory *connectionModeLoggingCategory_;
 
     static void copyToPrevLog();
+    // "ddMMyy hh:mm:ss:zzz" in UTC, formatted once per second and thread
+    static QString gmtTime();
 };
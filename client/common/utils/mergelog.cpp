@@ -1,138 +1,306 @@
 #include "mergelog.h"
 
+#include <QBuffer>
 #include <QCoreApplication>
+#include <QDate>
 #include <QFile>
 #include <QFileInfo>
 #include <QStandardPaths>
-#include <QTextStream>
 
-#include <future>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "clean_sensitive_info.h"
+#include "logger.h"
 
 namespace
 {
-bool isYearInDatePresent(const std::string &dateline)
+enum class LineSource { GUI, SERVICE, WIREGUARD_SERVICE, NUM_LINE_SOURCES, INSTALLER };
+
+// bigger logs are merged from their last 10 MB
+const qint64 kMaxBytesPerFile = 10000000;
+const size_t kOutputChunkSize = 64 * 1024;
+const qint64 kMsPerDay = 24 * 60 * 60 * 1000;
+
+bool isDigits(const char *p, int count)
+{
+    for (int i = 0; i < count; ++i)
+        if (p[i] < '0' || p[i] > '9')
+            return false;
+    return true;
+}
+
+int twoDigits(const char *p)
 {
-    const int scan = qMin(6, (int)dateline.size());
-    for (int i = 0; i < scan; ++i)
-        if (dateline[i] == ' ')
+    return (p[0] - '0') * 10 + (p[1] - '0');
+}
+
+// days since 1970-01-01 in the proleptic Gregorian calendar (H. Hinnant's days_from_civil)
+qint64 daysFromCivil(int y, int m, int d)
+{
+    y -= m <= 2;
+    const qint64 era = (y >= 0 ? y : y - 399) / 400;
+    const qint64 yoe = y - era * 400;
+    const qint64 doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const qint64 doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// Parses the time of a line that starts with "[ddMMyy hh:mm:ss:zzz" or, in logs of old versions, "[ddMM hh:mm:ss:zzz"
+// (the current year), as ms without a time zone. The fixed format is checked in place, without sscanf and QDateTime.
+bool parseLineTime(const char *line, int size, int currentYear, qint64 &outMs)
+{
+    if (size < 20 || line[0] != '[')
+        return false;
+
+    const char *p = line + 1;
+    int year;
+    if (p[4] == ' ') {
+        if (!isDigits(p, 4))
             return false;
+        year = currentYear;
+        p += 5;
+    } else if (p[6] == ' ') {
+        if (!isDigits(p, 6))
+            return false;
+        year = 2000 + twoDigits(p + 4);
+        p += 7;
+    } else {
+        return false;
+    }
+    const int day = twoDigits(line + 1);
+    const int month = twoDigits(line + 3);
+
+    // "hh:mm:ss:zzz", within the 20 bytes checked above
+    if (!isDigits(p, 2) || p[2] != ':' || !isDigits(p + 3, 2) || p[5] != ':' || !isDigits(p + 6, 2) || p[8] != ':' ||
+        !isDigits(p + 9, 3))
+        return false;
+    const int hour = twoDigits(p);
+    const int minute = twoDigits(p + 3);
+    const int second = twoDigits(p + 6);
+    const int ms = twoDigits(p + 9) * 10 + (p[11] - '0');
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 59)
+        return false;
+
+    outMs = daysFromCivil(year, month, day) * kMsPerDay + ((hour * 60 + minute) * 60 + second) * 1000 + ms;
     return true;
 }
 
-// parse date from string "ddMMyy hh:mm:ss:zzz"
-QDateTime parseDateTimeFormat1(const std::string &datestr)
+// The tail of a log file and the line of it where the merge is. Lines without a time are skipped, as well as the ones
+// outside of the time limits if they are set.
+class Input
 {
-    int dd,MM,yy;
-    int hh, mm, ss, zzz;
-    if (sscanf(datestr.c_str(),"%02d%02d%02d %02d:%02d:%02d:%03d", &dd, &MM, &yy, &hh, &mm, &ss, &zzz) == 7)
+public:
+    Input(const QString &filename, LineSource source, int currentYear)
+        : source_(source), currentYear_(currentYear)
     {
-        return QDateTime(QDate(yy + 1900, MM, dd), QTime(hh, mm, ss, zzz));
+        if (filename.isEmpty())
+            return;
+        file_.setFileName(filename);
+        if (!file_.open(QIODevice::ReadOnly))
+            return;
+
+        const qint64 size = file_.size();
+        const qint64 offset = qMax<qint64>(0, size - kMaxBytesPerFile);
+        qint64 length = size - offset;
+        if (length <= 0)
+            return;
+        if (uchar *map = file_.map(offset, length)) {
+            begin_ = reinterpret_cast<const char *>(map);
+        } else {
+            // no mapping on this file system, read the same tail
+            file_.seek(offset);
+            data_ = file_.read(length);
+            begin_ = data_.constData();
+            length = data_.size();
+        }
+        end_ = begin_ + length;
+
+        // the line cut by the offset
+        if (offset > 0) {
+            const char *lineEnd = static_cast<const char *>(memchr(begin_, '\n', end_ - begin_));
+            begin_ = lineEnd ? lineEnd + 1 : end_;
+        }
+        pos_ = begin_;
     }
 
-    return QDateTime();
-}
+    void setTimeLimits(qint64 minMs, qint64 maxMs)
+    {
+        isLimited_ = true;
+        minMs_ = minMs;
+        maxMs_ = maxMs;
+    }
+
+    void rewind()
+    {
+        pos_ = begin_;
+        hasLine_ = false;
+        hasTime_ = false;
+    }
+
+    // moves to the next line, false at the end
+    bool next()
+    {
+        while (pos_ < end_) {
+            const char *line = pos_;
+            const char *lineEnd = static_cast<const char *>(memchr(pos_, '\n', end_ - pos_));
+            pos_ = lineEnd ? lineEnd + 1 : end_;
+            int size = static_cast<int>((lineEnd ? lineEnd : end_) - line);
+            if (size > 0 && line[size - 1] == '\r')
+                size--;
+
+            if (size < 20 || line[0] != '[')
+                continue;
+            // a line with a broken date stays where it is
+            qint64 timeMs;
+            if (parseLineTime(line, size, currentYear_, timeMs)) {
+                timeMs_ = timeMs;
+                hasTime_ = true;
+            } else if (!hasTime_) {
+                continue;
+            }
+            if (isLimited_ && (timeMs_ < minMs_ || timeMs_ > maxMs_))
+                continue;
 
-// parse date from string "ddMM hh:mm:ss:zzz"
-QDateTime parseDateTimeFormat2(const std::string &datestr)
+            line_ = line;
+            lineSize_ = size;
+            hasLine_ = true;
+            return true;
+        }
+        hasLine_ = false;
+        return false;
+    }
+
+    bool hasLine() const { return hasLine_; }
+    const char *line() const { return line_; }
+    int lineSize() const { return lineSize_; }
+    qint64 timeMs() const { return timeMs_; }
+    LineSource source() const { return source_; }
+
+    // lines of the same ms go in the order of the sources
+    bool isBefore(const Input &other) const
+    {
+        return timeMs_ < other.timeMs_ || (timeMs_ == other.timeMs_ && source_ < other.source_);
+    }
+
+private:
+    const LineSource source_;
+    const int currentYear_;
+    QFile file_;
+    QByteArray data_;
+    const char *begin_ = nullptr;
+    const char *end_ = nullptr;
+    const char *pos_ = nullptr;
+
+    bool isLimited_ = false;
+    qint64 minMs_ = 0;
+    qint64 maxMs_ = 0;
+
+    bool hasLine_ = false;
+    bool hasTime_ = false;
+    const char *line_ = nullptr;
+    int lineSize_ = 0;
+    qint64 timeMs_ = 0;
+};
+
+// collects the output in chunks, to write the device in big pieces
+class Output
 {
-    int dd,MM;
-    int hh, mm, ss, zzz;
-    if (sscanf(datestr.c_str(),"%02d%02d %02d:%02d:%02d:%03d", &dd, &MM, &hh, &mm, &ss, &zzz) == 6)
+public:
+    explicit Output(QIODevice *device) : device_(device), scrubber_(Utils::SensitiveInfoScrubber::instance())
     {
-        return QDateTime(QDate(1900, MM, dd), QTime(hh, mm, ss, zzz));
+        chunk_.reserve(kOutputChunkSize * 2);
     }
+    ~Output() { flush(); }
 
-    return QDateTime();
-}
+    void append(const QByteArray &data)
+    {
+        chunk_.append(data.constData(), data.size());
+        if (chunk_.size() >= kOutputChunkSize)
+            flush();
+    }
+
+    void appendLine(LineSource source, const char *line, int size)
+    {
+        switch (source) {
+        case LineSource::GUI:
+            chunk_ += "G ";
+            break;
+        case LineSource::SERVICE:
+            chunk_ += "S ";
+            break;
+        case LineSource::WIREGUARD_SERVICE:
+            chunk_ += "W ";
+            break;
+        case LineSource::INSTALLER:
+            chunk_ += "I ";
+            break;
+        default:
+            break;
+        }
+        // the lines are scrubbed as UTF-8, without converting them to QString and back
+        scrubber_.scrub(line, size, chunk_);
+        chunk_ += '\n';
+        if (chunk_.size() >= kOutputChunkSize)
+            flush();
+    }
+
+    void flush()
+    {
+        if (!chunk_.empty()) {
+            device_->write(chunk_.data(), chunk_.size());
+            chunk_.clear();
+        }
+    }
+
+private:
+    QIODevice *device_;
+    const Utils::SensitiveInfoScrubber &scrubber_;
+    std::string chunk_;
+};
 
 }  // namespace
 
 QString MergeLog::mergeLogs(bool doMergePerLine)
 {
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    mergeLogs(&buffer, doMergePerLine);
+    return QString::fromUtf8(buffer.data());
+}
+
+QString MergeLog::mergePrevLogs(bool doMergePerLine)
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    mergePrevLogs(&buffer, doMergePerLine);
+    return QString::fromUtf8(buffer.data());
+}
+
+void MergeLog::mergeLogs(QIODevice *output, bool doMergePerLine)
+{
+    // the log of this process is written in the background
+    Logger::instance().flush();
     const QString guiLogFilename = guiLogLocation();
     const QString serviceLogFilename1 = serviceLogLocation();
     const QString serviceLogFilename2 = prevServiceLogLocation();
     const QString wgServiceLogFilename = wireguardServiceLogLocation();
     const QString installerLogFilename = installerLogLocation();
-    return merge(guiLogFilename, serviceLogFilename1, serviceLogFilename2,
-                 wgServiceLogFilename, installerLogFilename, doMergePerLine);
+    merge(output, guiLogFilename, serviceLogFilename1, serviceLogFilename2,
+          wgServiceLogFilename, installerLogFilename, doMergePerLine);
 }
 
-QString MergeLog::mergePrevLogs(bool doMergePerLine)
+void MergeLog::mergePrevLogs(QIODevice *output, bool doMergePerLine)
 {
     const QString guiLogFilename = prevGuiLogLocation();
     const QString serviceLogFilename1 = serviceLogLocation();
     const QString serviceLogFilename2 = prevServiceLogLocation();
     const QString wgPrevServiceLogFilename = prevWireguardServiceLogLocation();
     const QString installerPrevLogFilename = prevInstallerLogLocation();
-    return merge(guiLogFilename, serviceLogFilename1, serviceLogFilename2,
-                 wgPrevServiceLogFilename, installerPrevLogFilename, doMergePerLine);
-}
-
-int MergeLog::mergeTask(QMutex *mutex, QMultiMap<quint64, QPair<LineSource, QString>> *lines, const QString *filename, LineSource source, bool useMinMax, QDateTime min, QDateTime max)
-{
-    int datasize = 0;
-    const int kCurrentYearOffset = QDateTime::currentDateTime().date().year() - 1900;
-    QDateTime prevDateTime;
-
-    QFile file(*filename);
-    if (!file.open(QIODevice::ReadOnly)) {
-        return 0;
-    }
-
-    int timestamp = 0;
-    QTextStream textStream(&file);
-    // If file is larger than 10MiB, just take the last 10MiB
-    int64_t filelen = file.size();
-    if (filelen > 10000000) {
-        file.seek(filelen - 10000000);
-    }
-
-    while (!textStream.atEnd())
-    {
-        QString line = textStream.readLine();
-
-        if (line[0] != '[' || line.length() < 20)
-            continue;
-
-        const auto datestr = line.sliced(1, 19).toStdString();
-        const auto datetime = isYearInDatePresent(datestr)
-                                  ? parseDateTimeFormat1(datestr)
-                                        .addYears(100)
-                                  : parseDateTimeFormat2(datestr)
-                                        .addYears(kCurrentYearOffset);
-
-        if (useMinMax && (datetime < min || datetime > max))
-            continue;
-
-        // Installer on Mac can have inconsistency in times because of native mac api.
-        // In the example below we have the same timestamp but different time since start.
-        // [110124 20:16:15:449      0.002] CPU architecture: arm64)
-        // [110124 20:16:15:449      0.003] MacOS version: Version 14.1 (Build 23B74)
-        // It is necessary to calculate time there to increase timestamp var by 1 for each line.
-        // It is acceptable as times of installer do not intersect other times.
-        if (prevDateTime != datetime && source != LineSource::INSTALLER) {
-            prevDateTime = datetime;
-            timestamp = 0;
-        }
-
-        // In QMultiMap, elements with the same key will be placed in a reverse order.
-        // https://doc.qt.io/qt-5/qmap-iterator.html#details
-        // To deal with the issue, we create a compound key: 44 bits for a timestamp, 2 bits
-        // for the source, and 18 additional lower bits for a "timestamp" (line serial
-        // number). We assume the maximum number of lines with unique timestamp never
-        // exceeds 262143, which is quite reasonable (it looks infeasible to output 250k+
-        // lines to a log file within 1 ms).
-        const auto key = (static_cast<quint64>(datetime.toMSecsSinceEpoch()) << 20)
-                       | (static_cast<quint64>(source) << 18) | qMin(timestamp++, 0x3ffff);
-
-        {
-            QMutexLocker locker(mutex);
-            lines->insert(key, qMakePair(source, line));
-        }
-        datasize += line.length() + 3;
-    }
-    return datasize;
+    merge(output, guiLogFilename, serviceLogFilename1, serviceLogFilename2,
+          wgPrevServiceLogFilename, installerPrevLogFilename, doMergePerLine);
 }
 
 const QString MergeLog::guiLogLocation()
@@ -216,118 +384,96 @@ const QString MergeLog::prevInstallerLogLocation()
 #endif
 }
 
-QString MergeLog::merge(const QString &guiLogFilename, const QString &serviceLogFilename,
-                        const QString &servicePrevLogFilename, const QString &wireguardServiceLogFilename,
-                        const QString &installerLogFilename, bool doMergePerLine)
+void MergeLog::merge(QIODevice *output, const QString &guiLogFilename, const QString &serviceLogFilename,
+                     const QString &servicePrevLogFilename, const QString &wireguardServiceLogFilename,
+                     const QString &installerLogFilename, bool doMergePerLine)
 {
-    QMutex mutex;
-    QMultiMap<quint64, QPair<LineSource, QString>> lines;
-    int estimatedLogSize = 0;
-
-    auto futureGuiLog = std::async(MergeLog::mergeTask, &mutex, &lines, &guiLogFilename, LineSource::GUI, false, QDateTime(), QDateTime());
-    estimatedLogSize += futureGuiLog.get();
-
-    QDateTime minDate, maxDate;
-    bool isUseMinMaxDate = false;
-    if (lines.count() > 1)
-    {
-        minDate = QDateTime::fromMSecsSinceEpoch(lines.firstKey() >> 20); // Strip source and timestamp.
-        maxDate = QDateTime::fromMSecsSinceEpoch(lines.lastKey() >> 20);
-        isUseMinMaxDate = true;
+    const int currentYear = QDate::currentDate().year();
+    std::vector<std::unique_ptr<Input>> inputs;
+
+    // the time span of the GUI log limits the other logs
+    inputs.emplace_back(new Input(guiLogFilename, LineSource::GUI, currentYear));
+    qint64 minTime = 0, maxTime = 0;
+    int count = 0;
+    while (inputs[0]->next()) {
+        const qint64 time = inputs[0]->timeMs();
+        if (count == 0 || time < minTime)
+            minTime = time;
+        if (count == 0 || time > maxTime)
+            maxTime = time;
+        count++;
     }
+    const bool isUseMinMaxDate = count > 1;
 
-    auto futureService = std::async(MergeLog::mergeTask, &mutex, &lines, &serviceLogFilename, LineSource::SERVICE, isUseMinMaxDate, minDate, maxDate);
-    auto futureServicePrev = std::async(MergeLog::mergeTask, &mutex, &lines, &servicePrevLogFilename, LineSource::SERVICE, isUseMinMaxDate, minDate, maxDate);
-    estimatedLogSize += futureService.get() + futureServicePrev.get();
-
-    auto futureWGService = std::async(MergeLog::mergeTask, &mutex, &lines, &wireguardServiceLogFilename, LineSource::WIREGUARD_SERVICE, isUseMinMaxDate, minDate, maxDate);
-    estimatedLogSize += futureWGService.get();
-
+    inputs.emplace_back(new Input(serviceLogFilename, LineSource::SERVICE, currentYear));
+    inputs.emplace_back(new Input(servicePrevLogFilename, LineSource::SERVICE, currentYear));
+    inputs.emplace_back(new Input(wireguardServiceLogFilename, LineSource::WIREGUARD_SERVICE, currentYear));
     if (!installerLogFilename.isEmpty()) {
-        const auto installerMinDate = minDate.addDays(-7);
-        auto futureInstaller = std::async(MergeLog::mergeTask, &mutex, &lines, &installerLogFilename, LineSource::INSTALLER, isUseMinMaxDate, installerMinDate, maxDate);
-        estimatedLogSize += futureInstaller.get();
+        // Installer on Mac can have the same timestamp for many lines because of native mac api, the order of the
+        // file is kept for them.
+        inputs.emplace_back(new Input(installerLogFilename, LineSource::INSTALLER, currentYear));
+        if (isUseMinMaxDate)
+            inputs.back()->setTimeLimits(minTime - 7 * kMsPerDay, maxTime);
+    }
+    for (size_t i = 1; i < inputs.size(); ++i) {
+        if (isUseMinMaxDate && inputs[i]->source() != LineSource::INSTALLER)
+            inputs[i]->setTimeLimits(minTime, maxTime);
+        while (inputs[i]->next())
+            count++;
     }
-
-    if (!doMergePerLine)
-        estimatedLogSize += 400;  // Account for log separation lines.
-
-    QString result;
-    result.reserve(estimatedLogSize);
-    auto logAppendFun = [&result](const QPair<LineSource, QString> &data) {
-        switch (data.first) {
-        case LineSource::GUI:
-            result.append("G ");
-            break;
-        case LineSource::SERVICE:
-            result.append("S ");
-            break;
-        case LineSource::WIREGUARD_SERVICE:
-            result.append("W ");
-            break;
-        case LineSource::INSTALLER:
-            result.append("I ");
-            break;
-        default:
-            break;
-        }
-
-        result.append(data.second);
-        result.append("\n");
-    };
 
     // cut out the part of the log if the count of lines  exceeds MAX_COUNT_OF_LINES (keep 10% begin and 90% end of log)
     int cutCount = 0;
     int cutBeginInd = 0;
-    int cutEndInd = lines.count();
-    if (lines.count() > MAX_COUNT_OF_LINES)
+    int cutEndInd = count;
+    if (count > MAX_COUNT_OF_LINES)
     {
-        cutCount = lines.count() - MAX_COUNT_OF_LINES;
+        cutCount = count - MAX_COUNT_OF_LINES;
         cutBeginInd = MAX_COUNT_OF_LINES / 10;
-        cutEndInd = lines.count() - MAX_COUNT_OF_LINES * 0.9;
+        cutEndInd = count - MAX_COUNT_OF_LINES * 0.9;
     }
 
-    if (doMergePerLine) {
+    Output out(output);
+
+    // One merge of all the inputs, writing the lines of the source, or of all sources for NUM_LINE_SOURCES. The
+    // indexes count the lines of all sources either way, so that the same middle is cut out.
+    auto writeMerged = [&](LineSource onlySource, const char *separator) {
+        for (auto &input : inputs) {
+            input->rewind();
+            input->next();
+        }
+        bool isFirstLine = true;
         int ind = 0;
-        for (auto it = lines.constBegin(); it != lines.constEnd(); ++it)
-        {
-            // cut out middle
-            if (cutCount == 0 || ind < cutBeginInd || ind > cutEndInd)
-            {
-                logAppendFun(it.value());
+        for (;;) {
+            // there are few inputs, a linear search is faster than a heap
+            Input *first = nullptr;
+            for (auto &input : inputs) {
+                if (input->hasLine() && (!first || input->isBefore(*first)))
+                    first = input.get();
             }
-            ind++;
-        }
-    } else {
-        const char *separators[] = { nullptr, "Engine", "Service" };
-        for (int i = 0; i < static_cast<int>(LineSource::NUM_LINE_SOURCES); ++i) {
-            const auto current_source = static_cast<LineSource>(i);
-            bool is_first_line = true;
-            int ind = 0;
-            for (auto it = lines.constBegin(); it != lines.constEnd(); ++it) {
-                if (it.value().first != current_source)
-                {
-                    ind++;
-                    continue;
-                }
-                if (is_first_line) {
-                    is_first_line = false;
-                    if (separators[i]) {
-                        result.append("---");
-                        result.append(separators[i]);
-                        result.append(QString().fill('-',189));
-                        result.append("\n");
-                    }
+            if (!first)
+                break;
+
+            if (onlySource == LineSource::NUM_LINE_SOURCES || first->source() == onlySource) {
+                if (isFirstLine) {
+                    isFirstLine = false;
+                    if (separator)
+                        out.append(QByteArray("---") + separator + QByteArray(189, '-') + "\n");
                 }
                 // cut out middle
                 if (cutCount == 0 || ind < cutBeginInd || ind > cutEndInd)
-                {
-                    logAppendFun(it.value());
-                }
-                ind++;
+                    out.appendLine(first->source(), first->line(), first->lineSize());
             }
+            ind++;
+            first->next();
         }
+    };
+
+    if (doMergePerLine) {
+        writeMerged(LineSource::NUM_LINE_SOURCES, nullptr);
+    } else {
+        const char *separators[] = { nullptr, "Engine", "Service" };
+        for (int i = 0; i < static_cast<int>(LineSource::NUM_LINE_SOURCES); ++i)
+            writeMerged(static_cast<LineSource>(i), separators[i]);
     }
-    return result;
 }
-
@@ -1,7 +1,6 @@
 #pragma once
 
-#include <QDateTime>
-#include <QMutex>
+#include <QIODevice>
 #include <QString>
 
 // merge logs files log_gui.txt, windscribeservice.log, and WireguardServiceLog.txt (Windows only) to one,
@@ -11,14 +10,18 @@ class MergeLog
 public:
     static QString mergeLogs(bool doMergePerLine);
     static QString mergePrevLogs(bool doMergePerLine);
+    // write the merged log to output as it is merged, UTF-8 encoded
+    static void mergeLogs(QIODevice *output, bool doMergePerLine);
+    static void mergePrevLogs(QIODevice *output, bool doMergePerLine);
+
+    // The files are memory-mapped, at most their last 10 MB, and merged by time line by line, so that memory use does
+    // not depend on the size of the logs. Each file keeps its own order of lines. Missing files are skipped.
+    static void merge(QIODevice *output, const QString &guiLogFilename, const QString &serviceLogFilename,
+                      const QString &servicePrevLogFilename, const QString &wireguardServiceLogFilename,
+                      const QString &installerLogFilename, bool doMergePerLine);
 
 private:
     static constexpr int MAX_COUNT_OF_LINES = 100000;
-    static QString merge(const QString &guiLogFilename, const QString &serviceLogFilename, const QString &servicePrevLogFilename,
-                         const QString &wireguardServiceLogFilename, const QString &installerLogFilename, bool doMergePerLine);
-
-    enum class LineSource { GUI, SERVICE, WIREGUARD_SERVICE, NUM_LINE_SOURCES, INSTALLER };
-    static int mergeTask(QMutex *mutex, QMultiMap<quint64, QPair<LineSource, QString>> *lines, const QString *filename, LineSource source, bool useMinMax, QDateTime min, QDateTime max);
 
     static const QString guiLogLocation();
     static const QString serviceLogLocation();
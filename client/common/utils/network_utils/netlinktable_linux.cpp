@@ -0,0 +1,273 @@
+#include "netlinktable_linux.h"
+
+#include <QtEndian>
+
+#include <algorithm>
+
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <string.h>
+
+namespace {
+
+QHostAddress addressFromAttribute(const rtattr *attr, bool isIPv6)
+{
+    if (isIPv6) {
+        if (RTA_PAYLOAD(attr) < 16) {
+            return QHostAddress();
+        }
+        return QHostAddress(static_cast<const quint8 *>(RTA_DATA(attr)));
+    }
+    if (RTA_PAYLOAD(attr) < sizeof(quint32)) {
+        return QHostAddress();
+    }
+    quint32 address;
+    memcpy(&address, RTA_DATA(attr), sizeof(address));
+    return QHostAddress(qFromBigEndian(address));
+}
+
+} // namespace
+
+void NetlinkTable_linux::clear()
+{
+    links_.clear();
+    addresses_.clear();
+    defaultRoutes_.clear();
+}
+
+void NetlinkTable_linux::apply(const char *data, size_t size, QSet<int> &outChangedIfIndexes)
+{
+    int len = static_cast<int>(size);
+    for (nlmsghdr *header = reinterpret_cast<nlmsghdr *>(const_cast<char *>(data)); NLMSG_OK(header, len); header = NLMSG_NEXT(header, len)) {
+        switch (header->nlmsg_type) {
+        case RTM_NEWLINK:
+        case RTM_DELLINK:
+            applyLink(header, outChangedIfIndexes);
+            break;
+        case RTM_NEWADDR:
+        case RTM_DELADDR:
+            applyAddress(header, outChangedIfIndexes);
+            break;
+        case RTM_NEWROUTE:
+        case RTM_DELROUTE:
+            applyRoute(header, outChangedIfIndexes);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+NetlinkTable_linux::DefaultInterface NetlinkTable_linux::defaultInterface(bool isIPv6, bool ignoreTun) const
+{
+    DefaultInterface result;
+    const DefaultRoute *best = nullptr;
+    for (const DefaultRoute &route : defaultRoutes_) {
+        // network manager adds 20000 to the metric until the interface passes a connectivity check, so the lowest wins
+        if (route.isIPv6 != isIPv6 || route.metric == 0 || (best && route.metric >= best->metric)) {
+            continue;
+        }
+        auto it = links_.constFind(route.ifIndex);
+        if (it == links_.constEnd() || it->name.isEmpty()) {
+            continue;
+        }
+        if (ignoreTun && (it->name.startsWith("tun") || it->name.startsWith("utun"))) {
+            continue;
+        }
+        best = &route;
+    }
+
+    if (best) {
+        const Link &link = links_[best->ifIndex];
+        result.isOnline = true;
+        result.ifIndex = best->ifIndex;
+        result.name = link.name;
+        result.macAddress = link.macAddress;
+        result.isActive = (link.flags & (IFF_UP | IFF_RUNNING)) == (IFF_UP | IFF_RUNNING);
+        result.gateway = best->gateway;
+    }
+    return result;
+}
+
+bool NetlinkTable_linux::link(int ifIndex, Link &outLink) const
+{
+    auto it = links_.constFind(ifIndex);
+    if (it == links_.constEnd()) {
+        return false;
+    }
+    outLink = *it;
+    return true;
+}
+
+int NetlinkTable_linux::ifIndexByName(const QString &ifname) const
+{
+    for (auto it = links_.constBegin(); it != links_.constEnd(); ++it) {
+        if (it->name == ifname) {
+            return it.key();
+        }
+    }
+    return 0;
+}
+
+QList<int> NetlinkTable_linux::ifIndexes() const
+{
+    QList<int> result = links_.keys();
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+QList<QHostAddress> NetlinkTable_linux::addresses(int ifIndex) const
+{
+    return addresses_.value(ifIndex);
+}
+
+void NetlinkTable_linux::applyLink(nlmsghdr *header, QSet<int> &outChangedIfIndexes)
+{
+    if (header->nlmsg_len < NLMSG_LENGTH(sizeof(ifinfomsg))) {
+        return;
+    }
+    ifinfomsg *info = static_cast<ifinfomsg *>(NLMSG_DATA(header));
+    // AF_BRIDGE messages describe the bridge ports, not the links themselves
+    if (info->ifi_family != AF_UNSPEC) {
+        return;
+    }
+    const int ifIndex = info->ifi_index;
+
+    if (header->nlmsg_type == RTM_DELLINK) {
+        links_.remove(ifIndex);
+        addresses_.remove(ifIndex);
+        removeDefaultRoutes(ifIndex);
+        outChangedIfIndexes.insert(ifIndex);
+        return;
+    }
+
+    Link link;
+    link.flags = info->ifi_flags;
+    // the same as SIOCGIFHWADDR gives for the interfaces without one, such as tun
+    unsigned char mac[6] = {};
+    int attrLen = IFLA_PAYLOAD(header);
+    for (rtattr *attr = IFLA_RTA(info); RTA_OK(attr, attrLen); attr = RTA_NEXT(attr, attrLen)) {
+        if (attr->rta_type == IFLA_IFNAME) {
+            link.name = QString::fromLocal8Bit(static_cast<const char *>(RTA_DATA(attr)), strnlen(static_cast<const char *>(RTA_DATA(attr)), RTA_PAYLOAD(attr)));
+        } else if (attr->rta_type == IFLA_ADDRESS && RTA_PAYLOAD(attr) >= sizeof(mac)) {
+            memcpy(mac, RTA_DATA(attr), sizeof(mac));
+        }
+    }
+    link.macAddress = QString::asprintf("%.2X:%.2X:%.2X:%.2X:%.2X:%.2X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+
+    auto it = links_.find(ifIndex);
+    if (it == links_.end() || it->name != link.name || it->flags != link.flags || it->macAddress != link.macAddress) {
+        links_[ifIndex] = link;
+        outChangedIfIndexes.insert(ifIndex);
+    }
+    // the kernel flushes the IPv4 routes of a link that goes down without notifying about each of them,
+    // the IPv6 ones are removed with a notification and can go the same way
+    if (!(link.flags & IFF_UP)) {
+        removeDefaultRoutes(ifIndex);
+    }
+}
+
+void NetlinkTable_linux::applyAddress(nlmsghdr *header, QSet<int> &outChangedIfIndexes)
+{
+    if (header->nlmsg_len < NLMSG_LENGTH(sizeof(ifaddrmsg))) {
+        return;
+    }
+    ifaddrmsg *info = static_cast<ifaddrmsg *>(NLMSG_DATA(header));
+    if (info->ifa_family != AF_INET && info->ifa_family != AF_INET6) {
+        return;
+    }
+    const bool isIPv6 = info->ifa_family == AF_INET6;
+    const int ifIndex = info->ifa_index;
+
+    // IFA_ADDRESS is the peer address on IPv4 point-to-point links, IFA_LOCAL is always ours
+    QHostAddress address;
+    int attrLen = IFA_PAYLOAD(header);
+    for (rtattr *attr = IFA_RTA(info); RTA_OK(attr, attrLen); attr = RTA_NEXT(attr, attrLen)) {
+        if (attr->rta_type == IFA_LOCAL) {
+            address = addressFromAttribute(attr, isIPv6);
+        } else if (attr->rta_type == IFA_ADDRESS && address.isNull()) {
+            address = addressFromAttribute(attr, isIPv6);
+        }
+    }
+    if (address.isNull()) {
+        return;
+    }
+
+    QList<QHostAddress> &addresses = addresses_[ifIndex];
+    if (header->nlmsg_type == RTM_NEWADDR) {
+        if (!addresses.contains(address)) {
+            addresses.append(address);
+            outChangedIfIndexes.insert(ifIndex);
+        }
+    } else if (addresses.removeAll(address) > 0) {
+        outChangedIfIndexes.insert(ifIndex);
+    }
+}
+
+void NetlinkTable_linux::applyRoute(nlmsghdr *header, QSet<int> &outChangedIfIndexes)
+{
+    if (header->nlmsg_len < NLMSG_LENGTH(sizeof(rtmsg))) {
+        return;
+    }
+    rtmsg *info = static_cast<rtmsg *>(NLMSG_DATA(header));
+    if ((info->rtm_family != AF_INET && info->rtm_family != AF_INET6) || info->rtm_dst_len != 0 || info->rtm_type != RTN_UNICAST) {
+        return;
+    }
+    const bool isIPv6 = info->rtm_family == AF_INET6;
+
+    DefaultRoute route = { isIPv6, 0, 0, QHostAddress() };
+    quint32 table = info->rtm_table;
+    int attrLen = RTM_PAYLOAD(header);
+    for (rtattr *attr = RTM_RTA(info); RTA_OK(attr, attrLen); attr = RTA_NEXT(attr, attrLen)) {
+        if (attr->rta_type == RTA_OIF && RTA_PAYLOAD(attr) >= sizeof(int)) {
+            memcpy(&route.ifIndex, RTA_DATA(attr), sizeof(int));
+        } else if (attr->rta_type == RTA_GATEWAY) {
+            route.gateway = addressFromAttribute(attr, isIPv6);
+        } else if (attr->rta_type == RTA_PRIORITY && RTA_PAYLOAD(attr) >= sizeof(quint32)) {
+            memcpy(&route.metric, RTA_DATA(attr), sizeof(quint32));
+        } else if (attr->rta_type == RTA_TABLE && RTA_PAYLOAD(attr) >= sizeof(quint32)) {
+            memcpy(&table, RTA_DATA(attr), sizeof(quint32));
+        } else if (attr->rta_type == RTA_MULTIPATH && RTA_PAYLOAD(attr) >= sizeof(rtnexthop)) {
+            // a multipath default route counts as a route through its first hop
+            rtnexthop *nexthop = static_cast<rtnexthop *>(RTA_DATA(attr));
+            route.ifIndex = nexthop->rtnh_ifindex;
+            int nexthopLen = nexthop->rtnh_len - sizeof(rtnexthop);
+            for (rtattr *nested = RTNH_DATA(nexthop); RTA_OK(nested, nexthopLen); nested = RTA_NEXT(nested, nexthopLen)) {
+                if (nested->rta_type == RTA_GATEWAY) {
+                    route.gateway = addressFromAttribute(nested, isIPv6);
+                }
+            }
+        }
+    }
+    if (table != RT_TABLE_MAIN || route.ifIndex == 0) {
+        return;
+    }
+
+    if (header->nlmsg_type == RTM_NEWROUTE) {
+        if (header->nlmsg_flags & NLM_F_REPLACE) {
+            // the kernel keys the default routes of a table by the family and the metric
+            for (int i = defaultRoutes_.size() - 1; i >= 0; --i) {
+                if (defaultRoutes_[i].isIPv6 == isIPv6 && defaultRoutes_[i].metric == route.metric && !(defaultRoutes_[i] == route)) {
+                    outChangedIfIndexes.insert(defaultRoutes_[i].ifIndex);
+                    defaultRoutes_.removeAt(i);
+                }
+            }
+        }
+        if (!defaultRoutes_.contains(route)) {
+            defaultRoutes_.append(route);
+            outChangedIfIndexes.insert(route.ifIndex);
+        }
+    } else if (defaultRoutes_.removeAll(route) > 0) {
+        outChangedIfIndexes.insert(route.ifIndex);
+    }
+}
+
+void NetlinkTable_linux::removeDefaultRoutes(int ifIndex)
+{
+    for (int i = defaultRoutes_.size() - 1; i >= 0; --i) {
+        if (defaultRoutes_[i].ifIndex == ifIndex) {
+            defaultRoutes_.removeAt(i);
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QHash>
+#include <QHostAddress>
+#include <QList>
+#include <QMetaType>
+#include <QSet>
+#include <QString>
+
+struct nlmsghdr;
+
+// In-memory copy of the kernel's links, addresses and default routes of both families, kept up to date from the
+// rtnetlink dumps and notifications. Not thread safe, see NetlinkWatcher_linux.
+class NetlinkTable_linux
+{
+public:
+    struct Link
+    {
+        QString name;
+        unsigned int flags = 0;
+        QString macAddress;
+    };
+
+    struct DefaultInterface
+    {
+        bool isOnline = false;
+        int ifIndex = -1;
+        QString name;
+        QString macAddress;
+        bool isActive = false;
+        QHostAddress gateway;
+
+        bool operator==(const DefaultInterface &other) const
+        {
+            return isOnline == other.isOnline && ifIndex == other.ifIndex && name == other.name &&
+                   macAddress == other.macAddress && isActive == other.isActive && gateway == other.gateway;
+        }
+        bool operator!=(const DefaultInterface &other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    void clear();
+
+    // applies the link, address and route messages of the buffer, other messages are skipped; the indexes of the
+    // interfaces whose link, addresses or default routes changed are added to outChangedIfIndexes
+    void apply(const char *data, size_t size, QSet<int> &outChangedIfIndexes);
+
+    // the interface of the lowest metric default route of the main table, the zero metric routes are not considered
+    DefaultInterface defaultInterface(bool isIPv6 = false, bool ignoreTun = true) const;
+
+    bool link(int ifIndex, Link &outLink) const;
+    int ifIndexByName(const QString &ifname) const;
+    QList<int> ifIndexes() const;
+    // both families, in the order they were added
+    QList<QHostAddress> addresses(int ifIndex) const;
+
+private:
+    struct DefaultRoute
+    {
+        bool isIPv6;
+        int ifIndex;
+        quint32 metric;
+        QHostAddress gateway;
+
+        bool operator==(const DefaultRoute &other) const
+        {
+            return isIPv6 == other.isIPv6 && ifIndex == other.ifIndex && metric == other.metric && gateway == other.gateway;
+        }
+    };
+
+    QHash<int, Link> links_;
+    QHash<int, QList<QHostAddress>> addresses_;
+    QList<DefaultRoute> defaultRoutes_;
+
+    void applyLink(nlmsghdr *header, QSet<int> &outChangedIfIndexes);
+    void applyAddress(nlmsghdr *header, QSet<int> &outChangedIfIndexes);
+    void applyRoute(nlmsghdr *header, QSet<int> &outChangedIfIndexes);
+    void removeDefaultRoutes(int ifIndex);
+};
+
+Q_DECLARE_METATYPE(NetlinkTable_linux::DefaultInterface)
@@ -0,0 +1,288 @@
+#include "netlinkwatcher_linux.h"
+
+#include <QMutexLocker>
+
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <algorithm>
+#include <errno.h>
+#include <net/if.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../logger.h"
+
+NetlinkWatcher_linux &NetlinkWatcher_linux::instance()
+{
+    static NetlinkWatcher_linux watcher;
+    static const bool isStarted = watcher.start();
+    Q_UNUSED(isStarted);
+    return watcher;
+}
+
+NetlinkWatcher_linux::NetlinkWatcher_linux() : nextListenerId_(0), fd_(-1), wakeFd_(-1), buffer_(kBufferSize), isResyncPending_(false)
+{
+}
+
+NetlinkWatcher_linux::~NetlinkWatcher_linux()
+{
+    stop();
+}
+
+bool NetlinkWatcher_linux::start()
+{
+    if ((fd_ = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE)) < 0) {
+        qCDebug(LOG_BASIC) << "NetlinkWatcher_linux could not open netlink socket:" << errno;
+        return false;
+    }
+
+    // a bigger buffer makes ENOBUFS, and with it a full resync, less likely during bursts
+    int bufferSize = 1024 * 1024;
+    setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_IFADDR | RTMGRP_IPV6_ROUTE;
+    if (bind(fd_, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        qCDebug(LOG_BASIC) << "NetlinkWatcher_linux could not bind address:" << errno;
+        close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    if (!resync()) {
+        qCDebug(LOG_BASIC) << "NetlinkWatcher_linux could not load the routing table, retrying";
+        isResyncPending_ = true;
+        resyncRetryTime_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(kResyncRetryMs);
+    }
+
+    wakeFd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    thread_ = std::thread([this]() { run(); });
+    return true;
+}
+
+void NetlinkWatcher_linux::stop()
+{
+    if (thread_.joinable()) {
+        const quint64 value = 1;
+        if (write(wakeFd_, &value, sizeof(value)) < 0) {
+            qCDebug(LOG_BASIC) << "NetlinkWatcher_linux could not wake the thread:" << errno;
+        }
+        thread_.join();
+    }
+    if (wakeFd_ >= 0) {
+        close(wakeFd_);
+        wakeFd_ = -1;
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+}
+
+void NetlinkWatcher_linux::processMessages(const char *data, size_t size)
+{
+    QSet<int> changedIfIndexes;
+    {
+        QMutexLocker locker(&mutex_);
+        table_.apply(data, size, changedIfIndexes);
+    }
+    if (!changedIfIndexes.isEmpty()) {
+        notify(changedIfIndexes);
+    }
+}
+
+NetlinkTable_linux::DefaultInterface NetlinkWatcher_linux::defaultInterface(bool isIPv6, bool ignoreTun) const
+{
+    QMutexLocker locker(&mutex_);
+    return table_.defaultInterface(isIPv6, ignoreTun);
+}
+
+QList<QHostAddress> NetlinkWatcher_linux::addresses(const QString &ifname, bool isIPv6) const
+{
+    QMutexLocker locker(&mutex_);
+    QList<QHostAddress> result;
+    const int ifIndex = table_.ifIndexByName(ifname);
+    NetlinkTable_linux::Link link;
+    if (ifIndex == 0 || !table_.link(ifIndex, link) || !isUp(link)) {
+        return result;
+    }
+    const QAbstractSocket::NetworkLayerProtocol protocol = isIPv6 ? QAbstractSocket::IPv6Protocol : QAbstractSocket::IPv4Protocol;
+    for (const QHostAddress &address : table_.addresses(ifIndex)) {
+        if (address.protocol() == protocol) {
+            result << address;
+        }
+    }
+    return result;
+}
+
+QList<QHostAddress> NetlinkWatcher_linux::globalAddresses(bool isIPv6) const
+{
+    QMutexLocker locker(&mutex_);
+    QList<QHostAddress> result;
+    const QAbstractSocket::NetworkLayerProtocol protocol = isIPv6 ? QAbstractSocket::IPv6Protocol : QAbstractSocket::IPv4Protocol;
+    for (int ifIndex : table_.ifIndexes()) {
+        NetlinkTable_linux::Link link;
+        if (!table_.link(ifIndex, link) || !isUp(link) || (link.flags & IFF_LOOPBACK)) {
+            continue;
+        }
+        for (const QHostAddress &address : table_.addresses(ifIndex)) {
+            if (address.protocol() == protocol && !address.isLoopback() && !address.isLinkLocal()) {
+                result << address;
+            }
+        }
+    }
+    return result;
+}
+
+int NetlinkWatcher_linux::addListener(const Listener &listener)
+{
+    QMutexLocker locker(&listenersMutex_);
+    listeners_[++nextListenerId_] = listener;
+    return nextListenerId_;
+}
+
+void NetlinkWatcher_linux::removeListener(int id)
+{
+    QMutexLocker locker(&listenersMutex_);
+    listeners_.remove(id);
+}
+
+void NetlinkWatcher_linux::run()
+{
+    struct pollfd pfds[2] = { { fd_, POLLIN, 0 }, { wakeFd_, POLLIN, 0 } };
+    for (;;) {
+        int timeoutMs = -1;
+        if (isResyncPending_) {
+            const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(resyncRetryTime_ - std::chrono::steady_clock::now());
+            timeoutMs = std::max(0, (int)remaining.count());
+        }
+        const int ret = poll(pfds, 2, timeoutMs);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            qCDebug(LOG_BASIC) << "NetlinkWatcher_linux poll failed:" << errno;
+            return;
+        }
+        if (pfds[1].revents) {
+            return;
+        }
+        // also when the notifications keep coming
+        if (isResyncPending_ && std::chrono::steady_clock::now() >= resyncRetryTime_) {
+            resyncAndNotify();
+        }
+
+        for (;;) {
+            ssize_t len = recv(fd_, buffer_.data(), buffer_.size(), MSG_DONTWAIT);
+            if (len > 0) {
+                processMessages(buffer_.data(), len);
+            } else if (len < 0 && errno == ENOBUFS) {
+                // some notifications were dropped, the table can't be trusted anymore
+                qCDebug(LOG_BASIC) << "NetlinkWatcher_linux netlink socket overrun, reloading the routing table";
+                resyncAndNotify();
+            } else {
+                break;
+            }
+        }
+    }
+}
+
+bool NetlinkWatcher_linux::resync()
+{
+    // the queries keep getting the old table until the new one is complete
+    NetlinkTable_linux table;
+    // the kernel serves one dump at a time per socket
+    if (!dump(table, RTM_GETLINK) || !dump(table, RTM_GETADDR) || !dump(table, RTM_GETROUTE)) {
+        return false;
+    }
+    QMutexLocker locker(&mutex_);
+    table_ = table;
+    return true;
+}
+
+void NetlinkWatcher_linux::resyncAndNotify()
+{
+    QSet<int> changedIfIndexes;
+    {
+        QMutexLocker locker(&mutex_);
+        for (int ifIndex : table_.ifIndexes()) {
+            changedIfIndexes.insert(ifIndex);
+        }
+    }
+    if (!resync()) {
+        // a partial table would be worse than the old one, which the deltas still keep up to date meanwhile
+        if (!isResyncPending_) {
+            qCDebug(LOG_BASIC) << "NetlinkWatcher_linux could not reload the routing table, retrying";
+        }
+        isResyncPending_ = true;
+        resyncRetryTime_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(kResyncRetryMs);
+        return;
+    }
+    isResyncPending_ = false;
+    {
+        QMutexLocker locker(&mutex_);
+        for (int ifIndex : table_.ifIndexes()) {
+            changedIfIndexes.insert(ifIndex);
+        }
+    }
+    notify(changedIfIndexes);
+}
+
+bool NetlinkWatcher_linux::dump(NetlinkTable_linux &table, int type)
+{
+    struct {
+        nlmsghdr header;
+        rtgenmsg message;
+    } request;
+    memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = sizeof(request);
+    request.header.nlmsg_type = type;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.header.nlmsg_seq = type;
+    request.message.rtgen_family = AF_UNSPEC;
+    if (send(fd_, &request, sizeof(request), 0) < 0) {
+        return false;
+    }
+
+    // notifications may come in between the parts of the dump, they are applied the same way
+    QSet<int> changedIfIndexes;
+    for (;;) {
+        struct pollfd pfd = { fd_, POLLIN, 0 };
+        if (poll(&pfd, 1, kDumpTimeoutMs) <= 0) {
+            return false;
+        }
+        ssize_t len = recv(fd_, buffer_.data(), buffer_.size(), MSG_DONTWAIT);
+        if (len < 0 && (errno == EAGAIN || errno == EINTR)) {
+            continue;
+        }
+        if (len <= 0) {
+            return false;
+        }
+        table.apply(buffer_.data(), len, changedIfIndexes);
+
+        int remaining = static_cast<int>(len);
+        for (nlmsghdr *header = reinterpret_cast<nlmsghdr *>(buffer_.data()); NLMSG_OK(header, remaining); header = NLMSG_NEXT(header, remaining)) {
+            if (header->nlmsg_seq == static_cast<quint32>(type) && (header->nlmsg_type == NLMSG_DONE || header->nlmsg_type == NLMSG_ERROR)) {
+                return header->nlmsg_type == NLMSG_DONE;
+            }
+        }
+    }
+}
+
+void NetlinkWatcher_linux::notify(const QSet<int> &changedIfIndexes)
+{
+    QMutexLocker locker(&listenersMutex_);
+    for (const Listener &listener : qAsConst(listeners_)) {
+        listener(changedIfIndexes);
+    }
+}
+
+bool NetlinkWatcher_linux::isUp(const NetlinkTable_linux::Link &link)
+{
+    return (link.flags & IFF_UP) != 0;
+}
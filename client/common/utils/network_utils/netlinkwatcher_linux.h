@@ -0,0 +1,75 @@
+#pragma once
+
+#include <QHostAddress>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "netlinktable_linux.h"
+
+// One rtnetlink socket and one thread per process keep a NetlinkTable_linux of both families up to date. The interface
+// and address queries of NetworkUtils_linux are answered from it, and RouteMonitor_linux listens to its changes.
+class NetlinkWatcher_linux
+{
+public:
+    // called on the watcher thread after the messages that changed something, with the indexes of the interfaces whose
+    // link, addresses or default routes changed
+    typedef std::function<void(const QSet<int> &changedIfIndexes)> Listener;
+
+    // started on first use
+    static NetlinkWatcher_linux &instance();
+
+    // a watcher that is not started gets its messages from processMessages(), for the replay tests
+    NetlinkWatcher_linux();
+    ~NetlinkWatcher_linux();
+
+    bool start();
+    void stop();
+    void processMessages(const char *data, size_t size);
+
+    NetlinkTable_linux::DefaultInterface defaultInterface(bool isIPv6 = false, bool ignoreTun = true) const;
+    // the addresses of an interface that is up, empty otherwise
+    QList<QHostAddress> addresses(const QString &ifname, bool isIPv6) const;
+    // the addresses of the interfaces that are up, by interface index, loopback and link-local ones excluded
+    QList<QHostAddress> globalAddresses(bool isIPv6) const;
+
+    int addListener(const Listener &listener);
+    // no call of the listener is in progress or will happen once this returns
+    void removeListener(int id);
+
+private:
+    static constexpr int kDumpTimeoutMs = 1000;
+    // a failed resync is repeated after this long
+    static constexpr int kResyncRetryMs = 1000;
+    // the kernel builds the dump parts up to 32 KB
+    static constexpr int kBufferSize = 64 * 1024;
+
+    mutable QMutex mutex_;
+    NetlinkTable_linux table_;
+
+    QMutex listenersMutex_;
+    QMap<int, Listener> listeners_;
+    int nextListenerId_;
+
+    int fd_;
+    int wakeFd_;
+    std::thread thread_;
+    std::vector<char> buffer_;
+    // watcher thread only, once started
+    bool isResyncPending_;
+    std::chrono::steady_clock::time_point resyncRetryTime_;
+
+    void run();
+    // replaces the table with a fresh dump; the old one is kept if the dump fails
+    bool resync();
+    void resyncAndNotify();
+    bool dump(NetlinkTable_linux &table, int type);
+    void notify(const QSet<int> &changedIfIndexes);
+    static bool isUp(const NetlinkTable_linux::Link &link);
+};
@@ -1,24 +1,18 @@
 #pragma once
 
-#include <QList>
 #include <QString>
+#include <functional>
 
 namespace NetworkUtils_linux
 {
 
-class RoutingTableEntry
-{
-public:
-    int metric = 0;
-    int mtu = 0;
-    int flags = 0;
-    int netmask = 0;
-    QString interface;
-    QString gateway;
-    QString destination;
-};
-
-void getDefaultRoute(QString &outGatewayIp, QString &outInterfaceName, QString &outAdapterIp, bool ignoreTun = false);
+// answered from the in-memory table of NetlinkWatcher_linux
+void getDefaultRoute(QString &outGatewayIp, QString &outInterfaceName, QString &outAdapterIp, bool ignoreTun = false, bool isIPv6 = false);
 QString getLocalIP();
 
+// DF-flagged ICMP echo probes of the given payload size, see PathMtuProber_linux
+bool pingWithMtu(const QString &url, int mtu);
+// the largest payload in [minMtu, maxMtu] that reaches the host unfragmented, -1 if none does or it was cancelled
+int discoverMtu(const QString &url, int minMtu, int maxMtu, const std::function<bool()> &isCancelled = nullptr);
+
 } // namespace NetworkUtils_linux
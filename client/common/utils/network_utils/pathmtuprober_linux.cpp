@@ -0,0 +1,284 @@
+#include "pathmtuprober_linux.h"
+
+#include <QElapsedTimer>
+
+#include <errno.h>
+#include <linux/errqueue.h>
+#include <netdb.h>
+#include <netinet/ip_icmp.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../logger.h"
+
+PathMtuProber_linux::PathMtuProber_linux(const QString &host) : host_(host), fd_(-1), sequence_(0)
+{
+    memset(&address_, 0, sizeof(address_));
+}
+
+PathMtuProber_linux::~PathMtuProber_linux()
+{
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+int PathMtuProber_linux::discover(int minSize, int maxSize, const std::function<bool()> &isCancelled)
+{
+    if (!resolve()) {
+        return -1;
+    }
+    if (!open()) {
+        return kernelPathMtuSize(minSize, maxSize);
+    }
+
+    // good is the largest size known to pass, bad the smallest one known not to
+    int good = minSize - 1;
+    int bad = maxSize + 1;
+    int retries = kRetryRounds;
+    // the full size passes on most networks, and the smallest one failing means the host can't be reached at all
+    QList<int> sizes = { maxSize };
+    if ((minSize + maxSize) / 2 < maxSize) {
+        sizes << (minSize + maxSize) / 2;
+    }
+    if (minSize < (minSize + maxSize) / 2) {
+        sizes << minSize;
+    }
+
+    int rounds = 0;
+    while (bad - good > 1) {
+        if (isCancelled && isCancelled()) {
+            return -1;
+        }
+
+        const QList<ProbeResult> results = probeRound(sizes);
+        ++rounds;
+        for (int i = 0; i < sizes.size(); ++i) {
+            if (results[i] == kPassed && sizes[i] > good) {
+                good = sizes[i];
+            }
+        }
+        int lost = bad;
+        bool isAnswered = false;
+        for (int i = 0; i < sizes.size(); ++i) {
+            isAnswered = isAnswered || results[i] != kLost;
+            if (sizes[i] <= good) {
+                continue;
+            }
+            if (results[i] == kTooBig && sizes[i] < bad) {
+                bad = sizes[i];
+            } else if (results[i] == kLost && sizes[i] < lost) {
+                lost = sizes[i];
+            }
+        }
+        // only consecutive rounds without any answer use up the retries
+        if (isAnswered) {
+            retries = kRetryRounds;
+        } else if (lost < bad) {
+            if (retries > 0) {
+                --retries;
+            } else {
+                bad = lost;
+            }
+        }
+
+        // split what is left evenly; after a round without any answer that is the range it probed, split again
+        sizes.clear();
+        const int count = qMin(kProbesPerRound, bad - good - 1);
+        for (int i = 1; i <= count; ++i) {
+            const int size = good + (bad - good) * i / (count + 1);
+            if (size > good && size < bad && (sizes.isEmpty() || sizes.last() != size)) {
+                sizes << size;
+            }
+        }
+    }
+
+    qCDebug(LOG_PACKET_SIZE) << "Path MTU probing of" << host_ << "took" << rounds << "rounds";
+    return good >= minSize ? good : -1;
+}
+
+bool PathMtuProber_linux::probe(int size)
+{
+    if (!resolve()) {
+        return false;
+    }
+    if (!open()) {
+        return kernelPathMtuSize(size, size) == size;
+    }
+    return probeRound(QList<int>() << size).first() == kPassed;
+}
+
+bool PathMtuProber_linux::resolve()
+{
+    if (address_.sin_family == AF_INET) {
+        return true;
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo *result = nullptr;
+    const int error = getaddrinfo(host_.toStdString().c_str(), nullptr, &hints, &result);
+    if (error != 0 || result == nullptr) {
+        qCDebug(LOG_PACKET_SIZE) << "PathMtuProber_linux could not resolve" << host_ << ":" << gai_strerror(error);
+        return false;
+    }
+    memcpy(&address_, result->ai_addr, sizeof(address_));
+    freeaddrinfo(result);
+    return true;
+}
+
+bool PathMtuProber_linux::open()
+{
+    if (fd_ >= 0) {
+        return true;
+    }
+
+    fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_ICMP);
+    if (fd_ < 0) {
+        qCDebug(LOG_PACKET_SIZE) << "PathMtuProber_linux could not open ICMP socket:" << errno
+                                 << "(net.ipv4.ping_group_range), falling back to the route MTU";
+        return false;
+    }
+
+    // DF on every probe, without the kernel refusing sizes above the path MTU it has cached from an earlier ICMP
+    int value = IP_PMTUDISC_PROBE;
+    setsockopt(fd_, IPPROTO_IP, IP_MTU_DISCOVER, &value, sizeof(value));
+    // fragmentation-needed replies of the routers on the way
+    value = 1;
+    setsockopt(fd_, IPPROTO_IP, IP_RECVERR, &value, sizeof(value));
+    return true;
+}
+
+QList<PathMtuProber_linux::ProbeResult> PathMtuProber_linux::probeRound(const QList<int> &sizes)
+{
+    QList<ProbeResult> results(sizes.size(), kLost);
+    QList<quint16> sequences;
+    QList<bool> isPending;
+    int pendingCount = 0;
+
+    std::vector<char> buffer(64 * 1024);
+    for (int size : sizes) {
+        struct icmphdr header;
+        memset(&header, 0, sizeof(header));
+        header.type = ICMP_ECHO;
+        header.un.echo.sequence = htons(++sequence_);
+        std::vector<char> packet(sizeof(header) + size, 0);
+        memcpy(packet.data(), &header, sizeof(header));
+
+        sequences << sequence_;
+        // an ICMP error of an earlier probe leaves the socket error set, and sendto() would return it instead of sending
+        int pendingError = 0;
+        socklen_t len = sizeof(pendingError);
+        getsockopt(fd_, SOL_SOCKET, SO_ERROR, &pendingError, &len);
+        if (sendto(fd_, packet.data(), packet.size(), 0, reinterpret_cast<const sockaddr *>(&address_), sizeof(address_)) < 0) {
+            // larger than the MTU of the outgoing interface
+            if (errno == EMSGSIZE) {
+                results[sequences.size() - 1] = kTooBig;
+            }
+            isPending << false;
+        } else {
+            isPending << true;
+            ++pendingCount;
+        }
+    }
+
+    auto resolveProbe = [&](quint16 sequence, ProbeResult result) {
+        const int i = sequences.indexOf(sequence);
+        if (i >= 0 && isPending[i]) {
+            results[i] = result;
+            isPending[i] = false;
+            --pendingCount;
+        }
+    };
+
+    QElapsedTimer timer;
+    timer.start();
+    while (pendingCount > 0) {
+        const int remaining = kProbeTimeoutMs - static_cast<int>(timer.elapsed());
+        if (remaining <= 0) {
+            break;
+        }
+        struct pollfd pfd = { fd_, POLLIN, 0 };
+        if (poll(&pfd, 1, remaining) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if (pfd.revents & POLLERR) {
+            char control[512];
+            struct iovec iov = { buffer.data(), buffer.size() };
+            struct msghdr message;
+            memset(&message, 0, sizeof(message));
+            message.msg_iov = &iov;
+            message.msg_iovlen = 1;
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+            const ssize_t len = recvmsg(fd_, &message, MSG_ERRQUEUE | MSG_DONTWAIT);
+            for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message); len >= 0 && cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+                if (cmsg->cmsg_level != IPPROTO_IP || cmsg->cmsg_type != IP_RECVERR) {
+                    continue;
+                }
+                const struct sock_extended_err *error = reinterpret_cast<const struct sock_extended_err *>(CMSG_DATA(cmsg));
+                if (error->ee_errno != EMSGSIZE) {
+                    continue;
+                }
+                // the payload is the header of the probe that didn't fit, and the MTU of the next hop applies to the
+                // larger ones still on the way too
+                if (len >= static_cast<ssize_t>(sizeof(struct icmphdr))) {
+                    resolveProbe(ntohs(reinterpret_cast<const struct icmphdr *>(buffer.data())->un.echo.sequence), kTooBig);
+                }
+                for (int i = 0; error->ee_info > 0 && i < sizes.size(); ++i) {
+                    if (sizes[i] + kHeadersSize > static_cast<int>(error->ee_info)) {
+                        resolveProbe(sequences[i], kTooBig);
+                    }
+                }
+            }
+        }
+
+        if (pfd.revents & POLLIN) {
+            for (;;) {
+                const ssize_t len = recv(fd_, buffer.data(), buffer.size(), MSG_DONTWAIT);
+                if (len < 0) {
+                    break;
+                }
+                const struct icmphdr *header = reinterpret_cast<const struct icmphdr *>(buffer.data());
+                if (len >= static_cast<ssize_t>(sizeof(struct icmphdr)) && header->type == ICMP_ECHOREPLY) {
+                    resolveProbe(ntohs(header->un.echo.sequence), kPassed);
+                }
+            }
+        }
+    }
+    return results;
+}
+
+int PathMtuProber_linux::kernelPathMtuSize(int minSize, int maxSize)
+{
+    // connecting a UDP socket sends nothing, it only looks the route up, along with what the kernel knows of its MTU
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_in address = address_;
+    address.sin_port = htons(9);
+    int mtu = 0;
+    socklen_t len = sizeof(mtu);
+    if (::connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0 ||
+        getsockopt(fd, IPPROTO_IP, IP_MTU, &mtu, &len) < 0) {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    const int size = mtu - kHeadersSize;
+    if (size < minSize) {
+        return -1;
+    }
+    return qMin(size, maxSize);
+}
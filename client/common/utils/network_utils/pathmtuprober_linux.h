@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <functional>
+#include <netinet/in.h>
+
+// Finds the largest ICMP echo payload that reaches a host without fragmentation. The probes are sent with DF set over an
+// unprivileged ICMP datagram socket, several sizes per round trip, so a range of 170 sizes takes a handful of RTTs
+// instead of a timeout per step. Where net.ipv4.ping_group_range doesn't allow such a socket, the path MTU the kernel
+// knows for the route is used instead.
+class PathMtuProber_linux
+{
+public:
+    explicit PathMtuProber_linux(const QString &host);
+    ~PathMtuProber_linux();
+
+    // the largest payload in [minSize, maxSize] that gets an echo reply, -1 if none does, the host can't be resolved or
+    // isCancelled returned true between two rounds
+    int discover(int minSize, int maxSize, const std::function<bool()> &isCancelled = nullptr);
+    // a single probe of the given payload size
+    bool probe(int size);
+
+private:
+    enum ProbeResult { kPassed, kTooBig, kLost };
+
+    // this many consecutive rounds that only lost probes split the same range again before the losses count as too big,
+    // so that a lost reply doesn't shrink the result and a black hole router doesn't stall the search
+    static constexpr int kRetryRounds = 2;
+    static constexpr int kProbesPerRound = 3;
+    static constexpr int kProbeTimeoutMs = 1000;
+    // IPv4 and ICMP headers
+    static constexpr int kHeadersSize = 28;
+
+    QString host_;
+    struct sockaddr_in address_;
+    int fd_;
+    quint16 sequence_;
+
+    bool resolve();
+    bool open();
+    QList<ProbeResult> probeRound(const QList<int> &sizes);
+    int kernelPathMtuSize(int minSize, int maxSize);
+};
@@ -0,0 +1,343 @@
+#include "spantracer.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QThread>
+#include <algorithm>
+
+#include "logger.h"
+
+namespace {
+
+const int kProcessId = 1;
+const int kRemoteProcessId = 2;
+
+QJsonObject makeEvent(const QString &phase, const QString &category, const QString &name, int pid, int tid, qint64 tsNs)
+{
+    QJsonObject event;
+    event["ph"] = phase;
+    event["cat"] = category;
+    event["name"] = name;
+    event["pid"] = pid;
+    event["tid"] = tid;
+    event["ts"] = tsNs / 1000.0;
+    return event;
+}
+
+QJsonObject makeMetadata(const QString &name, int pid, int tid, const QString &value)
+{
+    QJsonObject event;
+    event["ph"] = "M";
+    event["name"] = name;
+    event["pid"] = pid;
+    event["tid"] = tid;
+    event["args"] = QJsonObject{ { "name", value } };
+    return event;
+}
+
+QString formatMs(qint64 ns)
+{
+    return QString::number(ns / 1000000.0, 'f', 1);
+}
+
+} // namespace
+
+SpanTracer::Span::Span(const QString &category, const QString &name, const QString &detail)
+    : startNs_(-1)
+{
+    if (SpanTracer::instance().isTracing()) {
+        category_ = category;
+        name_ = name;
+        detail_ = detail;
+        startNs_ = nowNs();
+    }
+}
+
+SpanTracer::Span::~Span()
+{
+    if (startNs_ >= 0) {
+        SpanTracer::instance().addSpan(category_, name_, detail_, startNs_, nowNs());
+    }
+}
+
+SpanTracer &SpanTracer::instance()
+{
+    static SpanTracer tracer;
+    return tracer;
+}
+
+qint64 SpanTracer::nowNs()
+{
+    static const QElapsedTimer timer = []() {
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+    return timer.nsecsElapsed();
+}
+
+SpanTracer::SpanTracer() : isTracing_(false), traces_(kMaxTraces), nextTrace_(0)
+{
+}
+
+void SpanTracer::beginTrace(const QString &name)
+{
+    Trace abandoned;
+    {
+        QMutexLocker locker(&mutex_);
+        if (isTracing_) {
+            abandoned = finishCurrent("abandoned");
+        }
+        current_ = Trace();
+        current_.name = name;
+        current_.startNs = nowNs();
+        isTracing_ = true;
+    }
+    if (!abandoned.name.isEmpty()) {
+        qCDebugMultiline(LOG_BASIC) << summary(abandoned);
+    }
+}
+
+void SpanTracer::endTrace(const QString &result)
+{
+    Trace trace;
+    {
+        QMutexLocker locker(&mutex_);
+        if (!isTracing_) {
+            return;
+        }
+        trace = finishCurrent(result);
+    }
+    qCDebugMultiline(LOG_BASIC) << summary(trace);
+    saveToFile(toChromeTraceJson());
+}
+
+void SpanTracer::beginSpan(const QString &category, const QString &name, const QString &detail)
+{
+    if (!isTracing_) {
+        return;
+    }
+    SpanRecord record;
+    record.category = category;
+    record.name = name;
+    record.detail = detail;
+    record.startNs = nowNs();
+    record.isAsync = true;
+
+    QMutexLocker locker(&mutex_);
+    record.threadId = currentThreadId();
+    // the previous phase of the name, e.g. a connection attempt, ends where the next one starts
+    auto it = openSpans_.find(name);
+    if (it != openSpans_.end()) {
+        it->endNs = record.startNs;
+        addSpanRecord(it.value());
+    }
+    openSpans_[name] = record;
+}
+
+void SpanTracer::endSpan(const QString &name)
+{
+    if (!isTracing_) {
+        return;
+    }
+    const qint64 endNs = nowNs();
+
+    QMutexLocker locker(&mutex_);
+    auto it = openSpans_.find(name);
+    if (it == openSpans_.end()) {
+        return;
+    }
+    SpanRecord record = it.value();
+    openSpans_.erase(it);
+    record.endNs = endNs;
+    addSpanRecord(record);
+}
+
+void SpanTracer::addRemoteSpan(const QString &process, const QString &name, qint64 durationNs)
+{
+    if (!isTracing_ || durationNs <= 0) {
+        return;
+    }
+    SpanRecord record;
+    record.category = process;
+    record.name = name;
+    record.process = process;
+    record.endNs = nowNs();
+    record.startNs = record.endNs - durationNs;
+
+    QMutexLocker locker(&mutex_);
+    addSpanRecord(record);
+}
+
+void SpanTracer::addSpan(const QString &category, const QString &name, const QString &detail, qint64 startNs, qint64 endNs)
+{
+    if (!isTracing_) {
+        return;
+    }
+    SpanRecord record;
+    record.category = category;
+    record.name = name;
+    record.detail = detail;
+    record.startNs = startNs;
+    record.endNs = endNs;
+
+    QMutexLocker locker(&mutex_);
+    record.threadId = currentThreadId();
+    addSpanRecord(record);
+}
+
+QByteArray SpanTracer::toChromeTraceJson() const
+{
+    QMutexLocker locker(&mutex_);
+
+    QJsonArray events;
+    events << makeMetadata("process_name", kProcessId, 0, QCoreApplication::applicationName());
+    events << makeMetadata("process_name", kRemoteProcessId, 0, "helper");
+    events << makeMetadata("thread_name", kProcessId, 0, "traces");
+    for (auto it = threadNames_.constBegin(); it != threadNames_.constEnd(); ++it) {
+        events << makeMetadata("thread_name", kProcessId, it.key(), it.value());
+    }
+
+    int asyncId = 0;
+    for (int i = 0; i < kMaxTraces; ++i) {
+        // oldest first
+        const Trace &trace = traces_[(nextTrace_ + i) % kMaxTraces];
+        if (trace.name.isEmpty()) {
+            continue;
+        }
+
+        // the whole trace on a track of its own
+        QJsonObject traceEvent = makeEvent("X", "trace", trace.name, kProcessId, 0, trace.startNs);
+        traceEvent["dur"] = (trace.endNs - trace.startNs) / 1000.0;
+        traceEvent["args"] = QJsonObject{ { "result", trace.result } };
+        events << traceEvent;
+
+        for (const SpanRecord &span : trace.spans) {
+            const int pid = span.process.isEmpty() ? kProcessId : kRemoteProcessId;
+            const QJsonObject args{ { "detail", span.detail } };
+            if (span.isAsync) {
+                // may overlap the spans of the thread it started on without nesting in them
+                QJsonObject begin = makeEvent("b", span.category, span.name, pid, span.threadId, span.startNs);
+                QJsonObject end = makeEvent("e", span.category, span.name, pid, span.threadId, span.endNs);
+                ++asyncId;
+                begin["id"] = asyncId;
+                end["id"] = asyncId;
+                begin["args"] = args;
+                events << begin << end;
+            } else {
+                QJsonObject event = makeEvent("X", span.category, span.name, pid, span.threadId, span.startNs);
+                event["dur"] = (span.endNs - span.startNs) / 1000.0;
+                if (!span.detail.isEmpty()) {
+                    event["args"] = args;
+                }
+                events << event;
+            }
+        }
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = events;
+    root["displayTimeUnit"] = "ms";
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+void SpanTracer::addSpanRecord(const SpanRecord &record)
+{
+    // the trace may have ended since the caller checked
+    if (isTracing_ && current_.spans.size() < kMaxSpansPerTrace) {
+        current_.spans << record;
+    }
+}
+
+int SpanTracer::currentThreadId()
+{
+    const Qt::HANDLE handle = QThread::currentThreadId();
+    auto it = threadIds_.constFind(handle);
+    if (it != threadIds_.constEnd()) {
+        return it.value();
+    }
+
+    const int id = threadIds_.size() + 1;
+    threadIds_[handle] = id;
+    QString name = QThread::currentThread()->objectName();
+    if (name.isEmpty()) {
+        name = (QCoreApplication::instance() && QThread::currentThread() == QCoreApplication::instance()->thread())
+               ? QString("main") : QString("thread %1").arg(id);
+    }
+    threadNames_[id] = name;
+    return id;
+}
+
+SpanTracer::Trace SpanTracer::finishCurrent(const QString &result)
+{
+    current_.result = result;
+    current_.endNs = nowNs();
+    // the phases that did not end by now end with the trace
+    for (SpanRecord &record : openSpans_) {
+        record.endNs = current_.endNs;
+        record.detail += record.detail.isEmpty() ? "unfinished" : ", unfinished";
+        addSpanRecord(record);
+    }
+    openSpans_.clear();
+    isTracing_ = false;
+
+    traces_[nextTrace_] = current_;
+    nextTrace_ = (nextTrace_ + 1) % kMaxTraces;
+    Trace trace = current_;
+    current_ = Trace();
+    return trace;
+}
+
+QString SpanTracer::summary(const Trace &trace)
+{
+    struct Phase
+    {
+        QString name;
+        qint64 firstStartNs = 0;
+        qint64 totalNs = 0;
+        int count = 0;
+    };
+
+    QVector<Phase> phases;
+    QHash<QString, int> indexes;
+    for (const SpanRecord &span : trace.spans) {
+        const QString name = (span.process.isEmpty() ? span.category : span.process + " side") + ": " + span.name;
+        auto it = indexes.constFind(name);
+        if (it == indexes.constEnd()) {
+            it = indexes.insert(name, phases.size());
+            Phase phase;
+            phase.name = name;
+            phase.firstStartNs = span.startNs;
+            phases << phase;
+        }
+        Phase &phase = phases[it.value()];
+        phase.totalNs += span.endNs - span.startNs;
+        phase.count++;
+    }
+    std::stable_sort(phases.begin(), phases.end(), [](const Phase &a, const Phase &b) { return a.firstStartNs < b.firstStartNs; });
+
+    QStringList lines;
+    lines << QString("Trace %1 ended (%2) after %3 ms, per phase:").arg(trace.name, trace.result, formatMs(trace.endNs - trace.startNs));
+    for (const Phase &phase : qAsConst(phases)) {
+        lines << QString("%1 ms %2x %3").arg(formatMs(phase.totalNs), 10).arg(phase.count, 3).arg(phase.name);
+    }
+    return lines.join("\n");
+}
+
+void SpanTracer::saveToFile(const QByteArray &json) const
+{
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+    QDir().mkpath(dir);
+    QFile file(dir + "/connect_traces.json");
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        file.write(json);
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <atomic>
+
+// Records the phases of a connect or a disconnect as spans with monotonic timestamps, from any thread. The last
+// kMaxTraces traces are kept, exported in the Chrome trace-event format (chrome://tracing, ui.perfetto.dev) to
+// connect_traces.json next to the logs, and summarized per phase in the log when they end.
+// Nothing is recorded while no trace is open.
+class SpanTracer
+{
+public:
+    // a phase that lasts as long as the object
+    class Span
+    {
+    public:
+        Span(const QString &category, const QString &name, const QString &detail = QString());
+        ~Span();
+
+    private:
+        QString category_;
+        QString name_;
+        QString detail_;
+        qint64 startNs_;
+    };
+
+    static SpanTracer &instance();
+    // monotonic, the same clock for all threads
+    static qint64 nowNs();
+
+    // an unfinished trace is ended as "abandoned"
+    void beginTrace(const QString &name);
+    // does nothing if no trace is open
+    void endTrace(const QString &result);
+    bool isTracing() const { return isTracing_; }
+
+    // a phase that starts and ends in different places, matched by name; an open phase of the same name ends here
+    void beginSpan(const QString &category, const QString &name, const QString &detail = QString());
+    void endSpan(const QString &name);
+    // a phase that took durationNs in another process and ended now, e.g. a command executed by the helper
+    void addRemoteSpan(const QString &process, const QString &name, qint64 durationNs);
+    void addSpan(const QString &category, const QString &name, const QString &detail, qint64 startNs, qint64 endNs);
+
+    QByteArray toChromeTraceJson() const;
+
+private:
+    static constexpr int kMaxTraces = 10;
+    // keeps a connect that retries for minutes bounded
+    static constexpr int kMaxSpansPerTrace = 2000;
+
+    struct SpanRecord
+    {
+        QString category;
+        QString name;
+        QString detail;
+        QString process;    // empty for this process
+        qint64 startNs = 0;
+        qint64 endNs = 0;
+        int threadId = 0;
+        bool isAsync = false;
+    };
+
+    struct Trace
+    {
+        QString name;
+        QString result;
+        qint64 startNs = 0;
+        qint64 endNs = 0;
+        QVector<SpanRecord> spans;
+    };
+
+    mutable QMutex mutex_;
+    std::atomic<bool> isTracing_;
+    Trace current_;
+    QHash<QString, SpanRecord> openSpans_;
+    QVector<Trace> traces_;     // ring buffer
+    int nextTrace_;
+
+    QHash<Qt::HANDLE, int> threadIds_;
+    QHash<int, QString> threadNames_;
+
+    SpanTracer();
+    void addSpanRecord(const SpanRecord &record);
+    int currentThreadId();
+    Trace finishCurrent(const QString &result);
+    static QString summary(const Trace &trace);
+    void saveToFile(const QByteArray &json) const;
+};
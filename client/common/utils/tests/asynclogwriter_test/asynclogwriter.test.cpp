@@ -0,0 +1,249 @@
+#include "asynclogwriter.test.h"
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "utils/asynclogwriter.h"
+
+namespace {
+
+const int kThreads = 8;
+
+QByteArray threadLine(int thread, int line)
+{
+    return QString("[191026 10:00:00:000  12.345] [basic]\t thread %1 line %2 with a payload of a usual length")
+        .arg(thread).arg(line).toLatin1();
+}
+
+// the lines of each thread must come in the order they were written
+bool checkLines(const QByteArray &log, int linesPerThread)
+{
+    std::vector<int> next(kThreads, 0);
+    const QList<QByteArray> lines = log.split('\n');
+    int count = 0;
+    for (const QByteArray &line : lines) {
+        if (line.isEmpty()) {
+            continue;
+        }
+        const int threadPos = line.indexOf("thread ");
+        const QList<QByteArray> parts = line.mid(threadPos).split(' ');
+        const int thread = parts[1].toInt();
+        const int index = parts[3].toInt();
+        if (thread < 0 || thread >= kThreads || index != next[thread]) {
+            return false;
+        }
+        next[thread]++;
+        count++;
+    }
+    return count == kThreads * linesPerThread;
+}
+
+struct BenchmarkResult
+{
+    double linesPerSecond = 0;
+    qint64 p50Ns = 0;
+    qint64 p99Ns = 0;
+};
+
+// every thread writes linesPerThread lines through log, timing each call
+template<typename LogFunction>
+BenchmarkResult runThreads(int linesPerThread, LogFunction log, const std::function<void()> &finish)
+{
+    std::vector<std::vector<qint64>> latencies(kThreads);
+    QElapsedTimer total;
+    total.start();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            latencies[t].reserve(linesPerThread);
+            QElapsedTimer timer;
+            for (int i = 0; i < linesPerThread; ++i) {
+                const QByteArray line = threadLine(t, i);
+                timer.start();
+                log(line);
+                latencies[t].push_back(timer.nsecsElapsed());
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    finish();
+    const qint64 totalNs = total.nsecsElapsed();
+
+    std::vector<qint64> all;
+    for (const std::vector<qint64> &v : latencies) {
+        all.insert(all.end(), v.begin(), v.end());
+    }
+    std::sort(all.begin(), all.end());
+    BenchmarkResult result;
+    result.linesPerSecond = all.size() * 1e9 / totalNs;
+    result.p50Ns = all[all.size() / 2];
+    result.p99Ns = all[all.size() * 99 / 100];
+    return result;
+}
+
+} // namespace
+
+void AsyncLogWriter_test::testAllLinesInOrder()
+{
+    const int kLines = 20000;
+    QByteArray log;
+    AsyncLogWriter writer([&log](const char *data, size_t size) { log.append(data, static_cast<int>(size)); }, []() {},
+                          AsyncLogWriter::kSyncNever, 64);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&writer, t]() {
+            for (int i = 0; i < kLines; ++i) {
+                const QByteArray line = threadLine(t, i);
+                writer.write(line.constData(), line.size());
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    writer.stop();
+
+    QVERIFY(log.endsWith("\r\n"));
+    QVERIFY(checkLines(log, kLines));
+    // the small ring was full now and then, nothing was lost
+    qDebug() << "stalls:" << writer.stalls();
+}
+
+void AsyncLogWriter_test::testFlush()
+{
+    std::mutex mutex;
+    QByteArray log;
+    int syncs = 0;
+    AsyncLogWriter writer(
+        [&](const char *data, size_t size) {
+            std::lock_guard<std::mutex> locker(mutex);
+            log.append(data, static_cast<int>(size));
+        },
+        [&]() {
+            std::lock_guard<std::mutex> locker(mutex);
+            syncs++;
+        },
+        AsyncLogWriter::kSyncNever);
+
+    for (int i = 0; i < 100; ++i) {
+        const QByteArray line = threadLine(0, i);
+        writer.write(line.constData(), line.size());
+        if (i % 10 == 9) {
+            writer.flush();
+            std::lock_guard<std::mutex> locker(mutex);
+            QVERIFY(log.endsWith(line + "\r\n"));
+        }
+    }
+    // a flush syncs even if the policy does not
+    std::lock_guard<std::mutex> locker(mutex);
+    QVERIFY(syncs >= 1);
+    QCOMPARE(writer.tail(), QByteArray(log).replace("\r\n", "\n").toStdString());
+}
+
+void AsyncLogWriter_test::testTailIsBounded()
+{
+    qint64 written = 0;
+    AsyncLogWriter writer([&written](const char *, size_t size) { written += size; }, []() {}, AsyncLogWriter::kSyncNever);
+    const QByteArray line(1000, 'x');
+    for (int i = 0; i < 5000; ++i) {
+        writer.write(line.constData(), line.size());
+    }
+    writer.flush();
+
+    const std::string tail = writer.tail();
+    QCOMPARE(written, qint64(5000 * (line.size() + 2)));
+    QVERIFY(tail.size() <= 2 * 512 * 1024);
+    QVERIFY(tail.size() >= 512 * 1024 - line.size());
+    // whole lines only
+    QCOMPARE(tail.size() % (line.size() + 1), size_t(0));
+}
+
+void AsyncLogWriter_test::testLinesAfterStopAreDropped()
+{
+    QByteArray log;
+    AsyncLogWriter writer([&log](const char *data, size_t size) { log.append(data, static_cast<int>(size)); }, []() {});
+    writer.write("before", 6);
+    writer.stop();
+    writer.write("after", 5);
+    writer.flush();
+    QCOMPARE(log, QByteArray("before\r\n"));
+}
+
+void AsyncLogWriter_test::testLoggingFromWriterThread()
+{
+    QByteArray log;
+    AsyncLogWriter *writerPtr = nullptr;
+    bool isFirstBatch = true;
+    AsyncLogWriter writer(
+        [&](const char *data, size_t size) {
+            log.append(data, static_cast<int>(size));
+            if (isFirstBatch) {
+                isFirstBatch = false;
+                // more than the ring holds, and nobody else is there to take them out
+                for (int i = 0; i < 8; ++i) {
+                    writerPtr->write("inner", 5);
+                }
+                writerPtr->flush();
+            }
+        },
+        []() {}, AsyncLogWriter::kSyncNever, 2);
+    writerPtr = &writer;
+
+    writer.write("outer", 5);
+    writer.flush();
+    writer.stop();
+    QVERIFY(log.startsWith("outer\r\n"));
+    QCOMPARE(log.count("inner\r\n"), 2);
+}
+
+void AsyncLogWriter_test::benchmarkThroughputAndLatency()
+{
+    const int kLines = 100000;
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    // as Logger wrote before: a write and a flush per line, under a global mutex
+    QFile syncFile(dir.filePath("sync.log"));
+    QVERIFY(syncFile.open(QIODevice::WriteOnly));
+    std::mutex mutex;
+    const BenchmarkResult syncResult = runThreads(kLines, [&](const QByteArray &line) {
+        std::lock_guard<std::mutex> locker(mutex);
+        syncFile.write(line);
+        syncFile.write("\r\n");
+        syncFile.flush();
+    }, []() {});
+    syncFile.close();
+
+    QFile asyncFile(dir.filePath("async.log"));
+    QVERIFY(asyncFile.open(QIODevice::WriteOnly));
+    AsyncLogWriter writer(
+        [&asyncFile](const char *data, size_t size) {
+            asyncFile.write(data, size);
+            asyncFile.flush();
+        },
+        []() {});
+    // includes waiting for the writer to catch up
+    const BenchmarkResult asyncResult = runThreads(kLines, [&writer](const QByteArray &line) {
+        writer.write(line.constData(), line.size());
+    }, [&writer]() { writer.flush(); });
+    writer.stop();
+    asyncFile.close();
+
+    qDebug().nospace() << "mutex+flush: " << qRound64(syncResult.linesPerSecond) << " lines/s, p50 " << syncResult.p50Ns
+                       << " ns, p99 " << syncResult.p99Ns << " ns";
+    qDebug().nospace() << "async:       " << qRound64(asyncResult.linesPerSecond) << " lines/s, p50 " << asyncResult.p50Ns
+                       << " ns, p99 " << asyncResult.p99Ns << " ns, stalls " << writer.stalls();
+
+    QVERIFY(asyncFile.open(QIODevice::ReadOnly));
+    QVERIFY(checkLines(asyncFile.readAll(), kLines));
+    QVERIFY(asyncResult.p50Ns < syncResult.p50Ns);
+}
+
+QTEST_MAIN(AsyncLogWriter_test)
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <QObject>
+
+class AsyncLogWriter_test : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testAllLinesInOrder();
+    void testFlush();
+    void testTailIsBounded();
+    void testLinesAfterStopAreDropped();
+    void testLoggingFromWriterThread();
+    // 8 threads logging at once, compared with the former write and flush of the file under a mutex
+    void benchmarkThroughputAndLatency();
+};
@@ -0,0 +1,196 @@
+#include "mergelog.test.h"
+#include <QtTest>
+#include <QBuffer>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+
+#include "utils/mergelog.h"
+
+namespace {
+
+// in the current year, for the dates without a year
+const qint64 kStartMs = QDateTime(QDate(QDate::currentDate().year(), 10, 19), QTime(10, 0), Qt::UTC).toMSecsSinceEpoch();
+
+// a log line at kStartMs + ms, the time since start of the line is ms as well
+QByteArray line(qint64 ms, const QByteArray &text, bool hasYear = true)
+{
+    const QDateTime time = QDateTime::fromMSecsSinceEpoch(kStartMs + ms, Qt::UTC);
+    const QString date = time.toString(hasYear ? "ddMMyy hh:mm:ss:zzz" : "ddMM hh:mm:ss:zzz");
+    return "[" + date.toLatin1() + QByteArray::number(ms).rightJustified(11) + "] " + text + "\r\n";
+}
+
+void writeFile(const QString &path, const QByteArray &data)
+{
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(data);
+}
+
+// the time since start of a merged line
+qint64 lineMs(const QString &line)
+{
+    const int end = line.indexOf(']');
+    return line.mid(end - 11, 11).trimmed().toLongLong();
+}
+
+} // namespace
+
+void MergeLog_test::init()
+{
+    dir_ = new QTemporaryDir();
+    QVERIFY(dir_->isValid());
+}
+
+void MergeLog_test::cleanup()
+{
+    delete dir_;
+    dir_ = nullptr;
+}
+
+QString MergeLog_test::path(const QString &name) const
+{
+    return dir_->filePath(name);
+}
+
+QStringList MergeLog_test::merge(const QString &gui, const QString &service, const QString &wireguard, bool doMergePerLine)
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    MergeLog::merge(&buffer, path(gui), path(service), path("missing.txt"), path(wireguard), QString(), doMergePerLine);
+    QStringList lines = QString::fromUtf8(buffer.data()).split('\n');
+    if (!lines.isEmpty() && lines.last().isEmpty())
+        lines.removeLast();
+    return lines;
+}
+
+void MergeLog_test::testMergeByTime()
+{
+    writeFile(path("gui.txt"), line(0, "gui 0") + line(10, "gui 10") + "a line without a time\r\n" + line(30, "gui 30") +
+                               line(30, "gui 30 again"));
+    writeFile(path("service.txt"), line(5, "service 5") + line(30, "service 30") + line(30, "service 30 again"));
+    writeFile(path("wg.txt"), line(10, "wg 10") + line(20, "wg 20"));
+
+    const QStringList lines = merge("gui.txt", "service.txt", "wg.txt");
+    QStringList texts;
+    for (const QString &l : lines)
+        texts << l.left(2) + l.mid(l.indexOf("] ") + 2);
+    // the same ms goes GUI, service, WireGuard, and the order of each file is kept
+    QCOMPARE(texts, QStringList({ "G gui 0", "S service 5", "G gui 10", "W wg 10", "W wg 20", "G gui 30", "G gui 30 again",
+                                  "S service 30", "S service 30 again" }));
+}
+
+void MergeLog_test::testOtherLogsLimitedToGuiTimeSpan()
+{
+    writeFile(path("gui.txt"), line(1000, "gui") + line(2000, "gui"));
+    writeFile(path("service.txt"), line(999, "before") + line(1500, "within") + line(2001, "after"));
+
+    const QStringList lines = merge("gui.txt", "service.txt", "wg.txt");
+    QCOMPARE(lines.size(), 3);
+    QVERIFY(lines[1].startsWith("S ") && lines[1].endsWith("within"));
+}
+
+void MergeLog_test::testDateWithoutYear()
+{
+    writeFile(path("gui.txt"), line(0, "gui 0") + line(100, "gui 100"));
+    writeFile(path("service.txt"), line(50, "old format", false));
+
+    const QStringList lines = merge("gui.txt", "service.txt", "wg.txt");
+    QCOMPARE(lines.size(), 3);
+    QVERIFY(lines[1].endsWith("old format"));
+}
+
+void MergeLog_test::testSeparateSources()
+{
+    writeFile(path("gui.txt"), line(0, "gui 0") + line(20, "gui 20"));
+    writeFile(path("service.txt"), line(10, "service 10"));
+    writeFile(path("wg.txt"), line(15, "wg 15"));
+
+    const QStringList lines = merge("gui.txt", "service.txt", "wg.txt", false);
+    QCOMPARE(lines.size(), 6);
+    QVERIFY(lines[0].endsWith("gui 0"));
+    QVERIFY(lines[1].endsWith("gui 20"));
+    QVERIFY(lines[2].startsWith("---Engine---"));
+    QVERIFY(lines[3].endsWith("service 10"));
+    QVERIFY(lines[4].startsWith("---Service---"));
+    QVERIFY(lines[5].endsWith("wg 15"));
+}
+
+void MergeLog_test::testCutOutMiddle()
+{
+    QByteArray gui;
+    QByteArray service;
+    for (int i = 0; i < 80000; ++i) {
+        gui += line(i * 2, "gui");
+        service += line(i * 2 + 1, "service");
+    }
+    gui += line(160000, "gui");
+    writeFile(path("gui.txt"), gui);
+    writeFile(path("service.txt"), service);
+
+    const QStringList lines = merge("gui.txt", "service.txt", "wg.txt");
+    // 10% of the limit from the beginning and 90% from the end
+    QCOMPARE(lines.size(), 99999);
+    QCOMPARE(lineMs(lines[9999]), qint64(9999));
+    QCOMPARE(lineMs(lines[10000]), qint64(160001 - 90000 + 1));
+    QCOMPARE(lineMs(lines.last()), qint64(160000));
+}
+
+void MergeLog_test::testOnlyEndOfBigFile()
+{
+    QByteArray gui;
+    qint64 ms = 0;
+    while (gui.size() < 11000000)
+        gui += line(ms++, QByteArray(200, 'x'));
+    writeFile(path("gui.txt"), gui);
+
+    const QStringList lines = merge("gui.txt", "service.txt", "wg.txt");
+    QVERIFY(lines.size() < ms);
+    QVERIFY(lines.first().startsWith("G ["));
+    QCOMPARE(lineMs(lines.last()), ms - 1);
+    for (int i = 1; i < lines.size(); ++i)
+        QCOMPARE(lineMs(lines[i]), lineMs(lines[i - 1]) + 1);
+}
+
+void MergeLog_test::benchmarkBigLogs()
+{
+    const QStringList names = { "gui.txt", "service.txt", "wg.txt" };
+    for (int f = 0; f < names.size(); ++f) {
+        QFile file(path(names[f]));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QByteArray chunk;
+        qint64 ms = 0;
+        for (int i = 0; file.size() < 50000000; ++i) {
+            ms += 1 + (i * 7 + f) % 5;
+            chunk += line(ms, "[basic]\t a line of a usual length, number " + QByteArray::number(i));
+            if (chunk.size() > 1000000) {
+                file.write(chunk);
+                file.flush();
+                chunk.clear();
+            }
+        }
+    }
+
+    QFile output(path("merged.txt"));
+    QVERIFY(output.open(QIODevice::WriteOnly));
+    QElapsedTimer timer;
+    timer.start();
+    MergeLog::merge(&output, path(names[0]), path(names[1]), QString(), path(names[2]), QString(), true);
+    output.close();
+    const qint64 elapsedMs = timer.elapsed();
+    qDebug() << "merged 3 x 50 MB in" << elapsedMs << "ms, output" << output.size() << "bytes";
+
+    QVERIFY(output.open(QIODevice::ReadOnly));
+    qint64 prevMs = -1;
+    int count = 0;
+    while (!output.atEnd()) {
+        const QString l = QString::fromUtf8(output.readLine());
+        const qint64 ms = lineMs(l);
+        QVERIFY(ms >= prevMs);
+        prevMs = ms;
+        count++;
+    }
+    QCOMPARE(count, 99999);
+}
+
+QTEST_MAIN(MergeLog_test)
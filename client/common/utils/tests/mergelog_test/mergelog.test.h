@@ -0,0 +1,28 @@
+#pragma once
+
+#include <QObject>
+#include <QTemporaryDir>
+
+class MergeLog_test : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+
+    void testMergeByTime();
+    void testOtherLogsLimitedToGuiTimeSpan();
+    void testDateWithoutYear();
+    void testSeparateSources();
+    void testCutOutMiddle();
+    void testOnlyEndOfBigFile();
+    // three logs of 50 MB each, written to a file
+    void benchmarkBigLogs();
+
+private:
+    QTemporaryDir *dir_ = nullptr;
+
+    QString path(const QString &name) const;
+    QStringList merge(const QString &gui, const QString &service, const QString &wireguard, bool doMergePerLine = true);
+};
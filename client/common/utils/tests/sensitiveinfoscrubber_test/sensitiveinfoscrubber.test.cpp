@@ -0,0 +1,146 @@
+#include "sensitiveinfoscrubber.test.h"
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QStandardPaths>
+
+#include "utils/clean_sensitive_info.h"
+
+namespace {
+
+QString replaceOneAfterAnother(QString text, const Utils::SensitiveInfoScrubber::Replacements &replacements)
+{
+    for (const auto &replacement : replacements) {
+        if (!replacement.first.empty())
+            text.replace(QString::fromStdString(replacement.first), QString::fromStdString(replacement.second));
+    }
+    return text;
+}
+
+QByteArray scrub(const Utils::SensitiveInfoScrubber &scrubber, const QByteArray &text)
+{
+    std::string result;
+    scrubber.scrub(text.constData(), text.size(), result);
+    return QByteArray::fromStdString(result);
+}
+
+} // namespace
+
+QByteArray SensitiveInfoScrubber_test::corpus()
+{
+    QFile file(":data/tests/sensitiveinfoscrubber/corpus.txt");
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    QString text = QString::fromUtf8(file.readAll());
+
+    const QString home = QStandardPaths::writableLocation(QStandardPaths::HomeLocation);
+    const QString runtime = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    const QString genericData = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation);
+    text.replace("{HOME_PREFIX}", home.left(home.size() - 1));
+    text.replace("{RUNTIME_PREFIX}", runtime.left(runtime.size() - 1));
+    text.replace("{HOME_LAST}", home.section('/', -1));
+    text.replace("{HOME}", home);
+    text.replace("{RUNTIME}", runtime);
+    text.replace("{GENERIC_DATA}", genericData);
+    return text.toUtf8();
+}
+
+void SensitiveInfoScrubber_test::testSameAsCleanSensitiveInfo()
+{
+    const QByteArray text = corpus();
+    QVERIFY(!text.isEmpty());
+    const Utils::SensitiveInfoScrubber &scrubber = Utils::SensitiveInfoScrubber::instance();
+
+    for (const QByteArray &line : text.split('\n'))
+        QCOMPARE(scrub(scrubber, line), Utils::cleanSensitiveInfo(QString::fromUtf8(line)).toUtf8());
+    QCOMPARE(scrub(scrubber, text), Utils::cleanSensitiveInfo(QString::fromUtf8(text)).toUtf8());
+    // the corpus does have paths to clean
+    QVERIFY(scrub(scrubber, text) != text);
+}
+
+void SensitiveInfoScrubber_test::testOverlaps_data()
+{
+    QTest::addColumn<QStringList>("strings");
+    QTest::addColumn<QString>("text");
+
+    QTest::newRow("prefix first") << QStringList{ "/home/u", "/home/u/.local" } << QString("/home/u/.local/share /home/u");
+    QTest::newRow("prefix last") << QStringList{ "/home/u/.local", "/home/u" } << QString("/home/u/.local/share /home/u");
+    QTest::newRow("suffix") << QStringList{ "u/x", "/home/u" } << QString("/home/u/x /home/u");
+    QTest::newRow("same string twice") << QStringList{ "/run/u", "/run/u" } << QString("/run/u/1 /run/u");
+    QTest::newRow("overlapping itself") << QStringList{ "aa" } << QString("aaaaa");
+    QTest::newRow("empty string") << QStringList{ "", "b" } << QString("abc");
+    QTest::newRow("nothing to replace") << QStringList{ "/home/u" } << QString("/home/v /run/u");
+}
+
+void SensitiveInfoScrubber_test::testOverlaps()
+{
+    QFETCH(QStringList, strings);
+    QFETCH(QString, text);
+
+    Utils::SensitiveInfoScrubber::Replacements replacements;
+    for (int i = 0; i < strings.size(); ++i)
+        replacements.emplace_back(strings[i].toStdString(), QString("%%1%").arg(i).toStdString());
+    const Utils::SensitiveInfoScrubber scrubber(replacements);
+    QCOMPARE(scrub(scrubber, text.toUtf8()), replaceOneAfterAnother(text, replacements).toUtf8());
+}
+
+void SensitiveInfoScrubber_test::testRandomOverlaps()
+{
+    QRandomGenerator random(1);
+    const char alphabet[] = "ab/";
+    for (int iteration = 0; iteration < 100000; ++iteration) {
+        Utils::SensitiveInfoScrubber::Replacements replacements;
+        const int count = 1 + random.bounded(4);
+        for (int i = 0; i < count; ++i) {
+            // every other time all strings start alike
+            std::string string = (iteration % 2) ? "/" : "";
+            const int length = 1 + random.bounded(4);
+            for (int j = 0; j < length; ++j)
+                string += alphabet[random.bounded(3)];
+            replacements.emplace_back(string, "%" + std::to_string(i) + "%");
+        }
+        QString text;
+        const int length = random.bounded(30);
+        for (int j = 0; j < length; ++j)
+            text += QChar("ab/x"[random.bounded(4)]);
+
+        const Utils::SensitiveInfoScrubber scrubber(replacements);
+        QCOMPARE(scrub(scrubber, text.toUtf8()), replaceOneAfterAnother(text, replacements).toUtf8());
+    }
+}
+
+void SensitiveInfoScrubber_test::benchmarkThroughput()
+{
+    const QByteArray text = corpus();
+    QVERIFY(!text.isEmpty());
+    QByteArray log;
+    while (log.size() < 50 * 1000 * 1000)
+        log += text;
+    const QList<QByteArray> lines = log.split('\n');
+
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray before;
+    before.reserve(log.size());
+    for (const QByteArray &line : lines) {
+        before += Utils::cleanSensitiveInfo(QString::fromUtf8(line)).toUtf8();
+        before += '\n';
+    }
+    const qint64 beforeMs = qMax<qint64>(1, timer.restart());
+
+    const Utils::SensitiveInfoScrubber &scrubber = Utils::SensitiveInfoScrubber::instance();
+    std::string after;
+    after.reserve(log.size());
+    for (const QByteArray &line : lines) {
+        scrubber.scrub(line.constData(), line.size(), after);
+        after += '\n';
+    }
+    const qint64 afterMs = qMax<qint64>(1, timer.elapsed());
+
+    qDebug() << "cleanSensitiveInfo per line:" << log.size() / 1000 / beforeMs << "MB/s";
+    qDebug() << "SensitiveInfoScrubber:" << log.size() / 1000 / afterMs << "MB/s";
+    QCOMPARE(QByteArray::fromStdString(after), before);
+}
+
+QTEST_MAIN(SensitiveInfoScrubber_test)
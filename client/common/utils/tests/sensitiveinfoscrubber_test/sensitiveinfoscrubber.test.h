@@ -0,0 +1,21 @@
+#pragma once
+
+#include <QObject>
+
+class SensitiveInfoScrubber_test : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    // the same output as cleanSensitiveInfo for the lines of a corpus with the paths of this machine
+    void testSameAsCleanSensitiveInfo();
+    // overlapping strings, against replacing them one after another with QString::replace
+    void testOverlaps_data();
+    void testOverlaps();
+    void testRandomOverlaps();
+    // a 50 MB log, line by line, compared with cleanSensitiveInfo on a QString per line
+    void benchmarkThroughput();
+
+private:
+    static QByteArray corpus();
+};
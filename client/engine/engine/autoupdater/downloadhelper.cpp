@@ -2,15 +2,22 @@
 
 #include <QDir>
 #include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
 #include <QStandardPaths>
+#include <QTimer>
 
 #include "names.h"
 #include "utils/logger.h"
 #include "utils/ws_assert.h"
 
 #if defined(Q_OS_LINUX)
+#include <fcntl.h>
 #include "utils/linuxutils.h"
 #elif defined(Q_OS_MAC)
+#include <fcntl.h>
 #include "utils/utils.h"
 #endif
 
@@ -78,8 +85,20 @@ void DownloadHelper::get(QMap<QString, QString> downloads)
 
     busy_ = true;
     progressPercent_ = 0;
-    for (const auto & download : downloads.keys())
-        getInner(download, downloads[download]);
+    hashes_.clear();
+    for (const auto & download : downloads.keys()) {
+        if (!getInner(download, downloads[download])) {
+            fail();
+            return;
+        }
+    }
+
+    // a file could be complete already, from before
+    for (size_t i = 0; busy_ && i < downloads_.size(); ++i) {
+        if (!downloads_[i]->done) {
+            onSegmentDone(downloads_[i].get());
+        }
+    }
 }
 
 void DownloadHelper::stop()
@@ -94,85 +113,158 @@ void DownloadHelper::stop()
     busy_ = false;
 }
 
-void DownloadHelper::onReplyFinished(std::uint64_t requestId, NetworkError errCode, const std::string &data)
+QString DownloadHelper::sha256(const QString &targetFilenamePath) const
 {
-    auto it = replies_.find(requestId);
-    if (it == replies_.end()) {
-        return;
-    }
-
-    it->second->done = true;
+    return hashes_.value(targetFilenamePath);
+}
 
-    // if any reply fails, we fail
-    if (errCode != NetworkError::kSuccess) {
-        qCDebug(LOG_DOWNLOADER) << "Download failed";
-        deleteAllCurrentReplies();
-        busy_ = false;
-        emit finished(DOWNLOAD_STATE_FAIL);
+void DownloadHelper::onReplyFinished(std::uint64_t requestId, NetworkError errCode, const std::string &data)
+{
+    Q_UNUSED(data);
+    auto it = requests_.find(requestId);
+    if (it == requests_.end()) {
         return;
     }
-
-    if (allRepliesDone()) {
-        qCDebug(LOG_DOWNLOADER) << "Download finished successfully";
-        deleteAllCurrentReplies();
-        busy_ = false;
-        emit finished(DOWNLOAD_STATE_SUCCESS);
-        return;
+    FileDownload *download = it->second.first;
+    const size_t index = it->second.second;
+    requests_.erase(it);
+    Segment &segment = download->segments[index];
+    segment.request.reset();
+
+    if (errCode == NetworkError::kSuccess) {
+        if (!segment.isValidated) {
+            // too short for a progress callback
+            if ((qint64)segment.pending.size() != segment.end - segment.requestStart) {
+                onRangeNotSupported(download);
+                return;
+            }
+            segment.isValidated = true;
+            const std::string pending = std::move(segment.pending);
+            segment.pending.clear();
+            writeSegment(download, index, pending.data(), pending.size());
+            return;
+        }
+        if (segment.end < 0) {
+            // the server didn't tell the size, the file is what came
+            download->size = segment.pos;
+            segment.end = segment.pos;
+        }
+        if (segment.isDone()) {
+            onSegmentDone(download);
+            return;
+        }
+        qCDebug(LOG_DOWNLOADER) << "Download of a segment ended early at" << segment.pos;
+    } else {
+        qCDebug(LOG_DOWNLOADER) << "Download of a segment failed at" << segment.pos;
     }
 
-    // still waiting on replies
-    qCDebug(LOG_DOWNLOADER) << "Download single file successful";
+    retrySegment(download, index);
 }
 
 void DownloadHelper::onReplyDownloadProgress(std::uint64_t requestId, std::uint64_t bytesReceived, std::uint64_t bytesTotal)
 {
-    auto it = replies_.find(requestId);
-    if (it == replies_.end()) {
+    Q_UNUSED(bytesReceived);
+    auto it = requests_.find(requestId);
+    if (it == requests_.end()) {
         return;
     }
-
-    it->second->bytesReceived = bytesReceived;
-    it->second->bytesTotal = bytesTotal;
-
-    // recalculate total progress
-    qint64 sum = 0;
-    qint64 total = 0;
-    for (const auto &reply : replies_) {
-        sum += reply.second->bytesReceived;
-        total += reply.second->bytesTotal;
+    FileDownload *download = it->second.first;
+    const size_t index = it->second.second;
+    Segment &segment = download->segments[index];
+
+    if (!segment.isValidated) {
+        // the length of a range response is the length of the range
+        if ((qint64)bytesTotal != segment.end - segment.requestStart) {
+            onRangeNotSupported(download);
+            return;
+        }
+        segment.isValidated = true;
+        const std::string pending = std::move(segment.pending);
+        segment.pending.clear();
+        if (!pending.empty()) {
+            writeSegment(download, index, pending.data(), pending.size());
+        }
+        return;
     }
 
-    progressPercent_ = (double) sum / (double) total * 100;
-    emit progressChanged(progressPercent_);
+    if (download->size < 0 && segment.end < 0 && bytesTotal > 0) {
+        // the whole file from the start
+        download->size = bytesTotal;
+        onSizeKnown(download);
+    }
 }
 
 void DownloadHelper::onReplyReadyRead(std::uint64_t requestId, const std::string &data)
 {
-    auto it = replies_.find(requestId);
-    if (it == replies_.end()) {
+    auto it = requests_.find(requestId);
+    if (it == requests_.end() || data.empty()) {
         return;
     }
-    if (!data.empty()) {
-        if (it->second->file.isOpen()) {
-            it->second->file.write(data.c_str(), data.size());
-        } else {
-            qCDebug(LOG_DOWNLOADER) << "Download error occurred (file not opened)";
+    FileDownload *download = it->second.first;
+    const size_t index = it->second.second;
+    Segment &segment = download->segments[index];
+
+    if (!segment.isValidated) {
+        segment.pending += data;
+        // more than the range, it was ignored
+        if ((qint64)segment.pending.size() > segment.end - segment.requestStart) {
+            onRangeNotSupported(download);
         }
+        return;
     }
+    writeSegment(download, index, data.data(), data.size());
 }
 
-void DownloadHelper::getInner(const QString url, const QString targetFilenamePath)
+bool DownloadHelper::getInner(const QString url, const QString targetFilenamePath)
 {
     // remove a previously used file if it exists
     QFile::remove(targetFilenamePath);
     qCDebug(LOG_DOWNLOADER) << "Starting download from url: " << url;
 
-    auto fileAndProgess = std::make_unique<FileAndProgress>();
-    fileAndProgess->file.setFileName(targetFilenamePath);
-    if (!fileAndProgess->file.open(QIODevice::WriteOnly))
+    auto download = std::make_unique<FileDownload>();
+    download->url = url;
+    download->targetPath = targetFilenamePath;
+    download->file.setFileName(partPath(targetFilenamePath));
+    // keeps what was downloaded before
+    if (!download->file.open(QIODevice::ReadWrite))
     {
         qCDebug(LOG_DOWNLOADER) << "Failed to open file for download" << url;
-        return;
+        return false;
+    }
+    FileDownload *d = download.get();
+    downloads_.push_back(std::move(download));
+
+    if (loadState(d)) {
+        qCDebug(LOG_DOWNLOADER) << "Resuming download of" << d->size << "bytes, the first" << d->hashedPos << "are there";
+    } else {
+        d->file.resize(0);
+        d->segments.assign(1, Segment());
+    }
+    d->stateSavedTimer.start();
+
+    for (size_t i = 0; i < d->segments.size(); ++i) {
+        if (!d->segments[i].isDone()) {
+            startSegment(d, i);
+        }
+    }
+    if (d->size > 0) {
+        updateProgress();
+    }
+    return true;
+}
+
+void DownloadHelper::startSegment(FileDownload *download, size_t index)
+{
+    Segment &segment = download->segments[index];
+    segment.requestStart = segment.pos;
+    segment.pending.clear();
+    // the open range from the start is the file whether the server takes the range or not
+    segment.isValidated = segment.end < 0;
+    WS_ASSERT(segment.end >= 0 || segment.pos == 0);
+
+    std::string range = std::to_string(segment.pos) + "-";
+    if (segment.end >= 0) {
+        range += std::to_string(segment.end - 1);
     }
 
     auto callbackFinished = [this] (std::uint64_t requestId, std::uint32_t elapsedMs,
@@ -196,12 +288,345 @@ void DownloadHelper::getInner(const QString url, const QString targetFilenamePat
         }) ;
     };
 
-    auto httpRequest = WSNet::instance()->httpNetworkManager()->createGetRequest(url.toStdString(), (std::uint16_t)(60000 * 5));  // timeout 5 mins
+    auto httpRequest = WSNet::instance()->httpNetworkManager()->createGetRequest(download->url.toStdString(), (std::uint16_t)(60000 * 5));  // timeout 5 mins
     httpRequest->setRemoveFromWhitelistIpsAfterFinish(true);
+    httpRequest->setRange(range);
+
+    segment.requestId = uniqueRequestId_++;
+    requests_[segment.requestId] = std::make_pair(download, index);
+    segment.request = WSNet::instance()->httpNetworkManager()->executeRequestEx(httpRequest, segment.requestId, callbackFinished, callbackProgress, callbackReadyData);
+}
+
+void DownloadHelper::cancelSegment(FileDownload *download, size_t index)
+{
+    Segment &segment = download->segments[index];
+    if (segment.request) {
+        segment.request->cancel();
+        segment.request.reset();
+        requests_.erase(segment.requestId);
+    }
+}
+
+void DownloadHelper::retrySegment(FileDownload *download, size_t index)
+{
+    Segment &segment = download->segments[index];
+    segment.retries++;
+    if (segment.retries > MAX_SEGMENT_RETRIES) {
+        fail();
+        return;
+    }
+    saveState(download);
+
+    const int delayMs = RETRY_DELAY_MS * segment.retries;
+    qCDebug(LOG_DOWNLOADER) << "Retrying the segment in" << delayMs << "ms";
+    const std::uint64_t generation = generation_;
+    QTimer::singleShot(delayMs, this, [this, download, index, generation]() {
+        // the download is gone, or the segments were changed meanwhile
+        if (generation != generation_ || index >= download->segments.size() ||
+            download->segments[index].request || download->segments[index].isDone()) {
+            return;
+        }
+        if (download->segments[index].end < 0) {
+            restartFromZero(download);
+        } else {
+            startSegment(download, index);
+        }
+    });
+}
+
+void DownloadHelper::restartFromZero(FileDownload *download)
+{
+    qCDebug(LOG_DOWNLOADER) << "Restarting the download from the start";
+    for (size_t i = 0; i < download->segments.size(); ++i) {
+        cancelSegment(download, i);
+    }
+    download->segments.assign(1, Segment());
+    download->size = -1;
+    download->hash.reset();
+    download->hashedPos = 0;
+    download->file.resize(0);
+    QFile::remove(statePath(download->targetPath));
+    startSegment(download, 0);
+}
+
+void DownloadHelper::writeSegment(FileDownload *download, size_t index, const char *data, qint64 size)
+{
+    Segment &segment = download->segments[index];
+    if (segment.end >= 0) {
+        // the first request of a new download goes on into the next segment
+        size = qMin(size, segment.end - segment.pos);
+    }
+    if (size <= 0) {
+        return;
+    }
+
+    if (!download->file.seek(segment.pos) || download->file.write(data, size) != size) {
+        qCDebug(LOG_DOWNLOADER) << "Download error occurred (can't write the file)" << download->file.errorString();
+        fail();
+        return;
+    }
+    updateHash(download, segment.pos, data, size);
+    segment.pos += size;
+    segment.retries = 0;
+    updateProgress();
+
+    if (segment.isDone()) {
+        cancelSegment(download, index);
+        onSegmentDone(download);
+    } else if (download->stateSavedTimer.elapsed() >= SAVE_STATE_PERIOD_MS) {
+        saveState(download);
+    }
+}
+
+void DownloadHelper::onSizeKnown(FileDownload *download)
+{
+    qCDebug(LOG_DOWNLOADER) << "Download size:" << download->size;
+    if (!preallocate(download->file, download->size)) {
+        qCDebug(LOG_DOWNLOADER) << "Failed to preallocate the file" << download->file.errorString();
+    }
+
+    // the first request goes on up to the second segment, the rest of the file is split among the others
+    Segment &first = download->segments[0];
+    const qint64 count = download->isRangeSupported ? qBound<qint64>(1, download->size / MIN_SEGMENT_SIZE, SEGMENT_COUNT) : 1;
+    first.end = qMax(download->size / count, first.pos);
+    const qint64 rest = download->size - first.end;
+    const qint64 restCount = qMin(count - 1, rest / MIN_SEGMENT_SIZE);
+    if (restCount <= 0) {
+        first.end = download->size;
+    } else {
+        qint64 start = first.end;
+        for (qint64 i = 0; i < restCount; ++i) {
+            Segment segment;
+            segment.start = start;
+            segment.pos = start;
+            segment.end = (i == restCount - 1) ? download->size : start + rest / restCount;
+            start = segment.end;
+            download->segments.push_back(segment);
+        }
+        qCDebug(LOG_DOWNLOADER) << "Downloading in" << download->segments.size() << "segments";
+        for (size_t i = 1; i < download->segments.size(); ++i) {
+            startSegment(download, i);
+        }
+    }
+    saveState(download);
+
+    if (download->segments[0].isDone()) {
+        cancelSegment(download, 0);
+        onSegmentDone(download);
+    }
+}
+
+void DownloadHelper::onRangeNotSupported(FileDownload *download)
+{
+    qCDebug(LOG_DOWNLOADER) << "The server does not support ranges, downloading the file in one piece";
+    download->isRangeSupported = false;
+    QFile::remove(statePath(download->targetPath));
+
+    for (size_t i = 1; i < download->segments.size(); ++i) {
+        cancelSegment(download, i);
+    }
+    Segment &first = download->segments[0];
+    if (first.request && first.requestStart == 0 && first.isValidated) {
+        // the first request is for the whole file anyway
+        download->segments.resize(1);
+        download->segments[0].end = download->size;
+    } else {
+        restartFromZero(download);
+    }
+}
 
-    fileAndProgess->request = WSNet::instance()->httpNetworkManager()->executeRequestEx(httpRequest, uniqueRequestId_, callbackFinished, callbackProgress, callbackReadyData);
-    replies_[uniqueRequestId_] = std::move(fileAndProgess);
-    uniqueRequestId_++;
+void DownloadHelper::onSegmentDone(FileDownload *download)
+{
+    if (download->segments.empty()) {
+        return;
+    }
+    for (const Segment &segment : download->segments) {
+        if (!segment.isDone()) {
+            saveState(download);
+            return;
+        }
+    }
+
+    WS_ASSERT(download->hashedPos == download->size);
+    download->file.close();
+    QFile::remove(download->targetPath);
+    if (!download->file.rename(download->targetPath)) {
+        qCDebug(LOG_DOWNLOADER) << "Failed to rename the downloaded file" << download->file.errorString();
+        fail();
+        return;
+    }
+    QFile::remove(statePath(download->targetPath));
+    hashes_[download->targetPath] = QString::fromLatin1(download->hash.result().toHex());
+    download->done = true;
+    qCDebug(LOG_DOWNLOADER) << "Download single file successful";
+
+    finishIfAllDone();
+}
+
+void DownloadHelper::finishIfAllDone()
+{
+    if (!busy_ || !allRepliesDone()) {
+        return;
+    }
+    qCDebug(LOG_DOWNLOADER) << "Download finished successfully";
+    deleteAllCurrentReplies();
+    busy_ = false;
+    emit finished(DOWNLOAD_STATE_SUCCESS);
+}
+
+void DownloadHelper::fail()
+{
+    qCDebug(LOG_DOWNLOADER) << "Download failed";
+    deleteAllCurrentReplies();
+    busy_ = false;
+    emit finished(DOWNLOAD_STATE_FAIL);
+}
+
+void DownloadHelper::updateHash(FileDownload *download, qint64 pos, const char *data, qint64 size)
+{
+    if (pos <= download->hashedPos && pos + size > download->hashedPos) {
+        const qint64 offset = download->hashedPos - pos;
+        download->hash.addData(QByteArrayView(data + offset, size - offset));
+        download->hashedPos = pos + size;
+    }
+
+    // the segments that follow and were written before are read back
+    for (const Segment &segment : download->segments) {
+        while (segment.start <= download->hashedPos && download->hashedPos < segment.pos) {
+            if (!download->file.seek(download->hashedPos)) {
+                return;
+            }
+            const QByteArray bytes = download->file.read(qMin(segment.pos - download->hashedPos, HASH_READ_SIZE));
+            if (bytes.isEmpty()) {
+                return;
+            }
+            download->hash.addData(bytes);
+            download->hashedPos += bytes.size();
+        }
+    }
+}
+
+void DownloadHelper::updateProgress()
+{
+    qint64 sum = 0;
+    qint64 total = 0;
+    for (const auto &download : downloads_) {
+        if (download->size <= 0) {
+            continue;
+        }
+        total += download->size;
+        for (const Segment &segment : download->segments) {
+            sum += segment.pos - segment.start;
+        }
+    }
+    if (total == 0) {
+        return;
+    }
+
+    const uint progressPercent = (double) sum / (double) total * 100;
+    if (progressPercent != progressPercent_) {
+        progressPercent_ = progressPercent;
+        emit progressChanged(progressPercent_);
+    }
+}
+
+QString DownloadHelper::partPath(const QString &targetFilenamePath)
+{
+    return targetFilenamePath + ".part";
+}
+
+QString DownloadHelper::statePath(const QString &targetFilenamePath)
+{
+    return targetFilenamePath + ".part.state";
+}
+
+bool DownloadHelper::loadState(FileDownload *download)
+{
+    QFile stateFile(statePath(download->targetPath));
+    if (!stateFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QJsonObject state = QJsonDocument::fromJson(stateFile.readAll()).object();
+    const qint64 size = state["size"].toInteger(-1);
+    if (state["url"].toString() != download->url || size <= 0 || download->file.size() != size) {
+        qCDebug(LOG_DOWNLOADER) << "The previous download is of another file, starting over";
+        return false;
+    }
+
+    std::vector<Segment> segments;
+    qint64 start = 0;
+    for (const QJsonValue &value : state["segments"].toArray()) {
+        const QJsonObject object = value.toObject();
+        Segment segment;
+        segment.start = object["start"].toInteger(-1);
+        segment.end = object["end"].toInteger(-1);
+        segment.pos = object["pos"].toInteger(-1);
+        if (segment.start != start || segment.end <= segment.start || segment.pos < segment.start || segment.pos > segment.end) {
+            return false;
+        }
+        start = segment.end;
+        segments.push_back(segment);
+    }
+    if (start != size) {
+        return false;
+    }
+
+    download->size = size;
+    download->segments = std::move(segments);
+    // the hash of what's there
+    updateHash(download, 0, nullptr, 0);
+    return true;
+}
+
+void DownloadHelper::saveState(FileDownload *download)
+{
+    download->stateSavedTimer.restart();
+    if (download->size < 0 || !download->isRangeSupported || download->done) {
+        return;
+    }
+
+    // what the state says is in the file is there
+    download->file.flush();
+
+    QJsonArray segments;
+    for (const Segment &segment : download->segments) {
+        QJsonObject object;
+        object["start"] = segment.start;
+        object["end"] = segment.end;
+        object["pos"] = segment.pos;
+        segments.append(object);
+    }
+    QJsonObject state;
+    state["url"] = download->url;
+    state["size"] = download->size;
+    state["segments"] = segments;
+
+    QSaveFile stateFile(statePath(download->targetPath));
+    if (!stateFile.open(QIODevice::WriteOnly) || stateFile.write(QJsonDocument(state).toJson(QJsonDocument::Compact)) < 0 ||
+        !stateFile.commit()) {
+        qCDebug(LOG_DOWNLOADER) << "Failed to save the state of the download" << stateFile.errorString();
+    }
+}
+
+bool DownloadHelper::preallocate(QFile &file, qint64 size)
+{
+    if (!file.flush()) {
+        return false;
+    }
+#if defined(Q_OS_LINUX)
+    // the blocks are reserved at once, so the segments don't fragment the file and a full disk fails now
+    if (posix_fallocate(file.handle(), 0, size) == 0) {
+        return true;
+    }
+#elif defined(Q_OS_MAC)
+    fstore_t store = { F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, size, 0 };
+    if (fcntl(file.handle(), F_PREALLOCATE, &store) == -1) {
+        store.fst_flags = F_ALLOCATEALL;
+        fcntl(file.handle(), F_PREALLOCATE, &store);
+    }
+#endif
+    // on Windows setting the size allocates the file
+    return file.resize(size);
 }
 
 void DownloadHelper::removeAutoUpdateInstallerFiles()
@@ -226,9 +651,8 @@ void DownloadHelper::removeAutoUpdateInstallerFiles()
 
 bool DownloadHelper::allRepliesDone()
 {
-    for (const auto &reply : replies_) {
-        // breaks
-        if (!reply.second->done) {
+    for (const auto &download : downloads_) {
+        if (!download->done) {
             return false;
         }
     }
@@ -237,8 +661,15 @@ bool DownloadHelper::allRepliesDone()
 
 void DownloadHelper::deleteAllCurrentReplies()
 {
-    for (const auto &reply : replies_)
-        reply.second->request->cancel();
+    for (const auto &download : downloads_) {
+        for (size_t i = 0; i < download->segments.size(); ++i) {
+            cancelSegment(download.get(), i);
+        }
+        // for the next get()
+        saveState(download.get());
+    }
 
-    replies_.clear();
+    requests_.clear();
+    downloads_.clear();
+    generation_++;
 }
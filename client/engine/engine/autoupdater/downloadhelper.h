@@ -2,11 +2,16 @@
 
 #include <QString>
 #include <QObject>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QSharedPointer>
 #include <QMap>
 #include <wsnet/WSNet.h>
 
+// Downloads files with a few range requests in parallel. The state of a download is kept next to it, so that a
+// download that was interrupted or stopped continues where it was on the next get(), and a segment that fails is
+// requested again from where it broke off. The SHA-256 of a file is computed while it's downloaded.
 class DownloadHelper : public QObject
 {
     Q_OBJECT
@@ -27,22 +32,60 @@ public:
     void get(QMap<QString, QString> downloads);
     void stop();
 
+    // hex SHA-256 of a file of the last successful get()
+    QString sha256(const QString &targetFilenamePath) const;
+
 signals:
     void finished(DownloadHelper::DownloadState state);
     void progressChanged(uint progressPercent);
 
 private:
-    std::uint64_t uniqueRequestId_ = 0;
+    static constexpr int SEGMENT_COUNT = 4;
+    static constexpr qint64 MIN_SEGMENT_SIZE = 1024 * 1024;
+    // in a row, for a segment
+    static constexpr int MAX_SEGMENT_RETRIES = 5;
+    static constexpr int RETRY_DELAY_MS = 1000;
+    static constexpr int SAVE_STATE_PERIOD_MS = 1000;
+    static constexpr qint64 HASH_READ_SIZE = 1024 * 1024;
 
-    struct FileAndProgress {
+    // bytes [start, end) of the file, downloaded by a request of its own
+    struct Segment {
+        qint64 start = 0;
+        qint64 end = -1;    // -1 until the size of the file is known
+        qint64 pos = 0;     // written up to
+        std::uint64_t requestId = 0;
         std::shared_ptr<wsnet::WSNetCancelableCallback> request;
+        qint64 requestStart = 0;
+        // whether the server sends the requested range; the data is held back until it's known
+        bool isValidated = false;
+        std::string pending;
+        int retries = 0;
+
+        bool isDone() const { return end >= 0 && pos >= end; }
+    };
+
+    struct FileDownload {
+        QString url;
+        QString targetPath;
         QFile file;
-        qint64 bytesReceived = 0;
-        qint64 bytesTotal = 0;
+        qint64 size = -1;
+        std::vector<Segment> segments;
+        // of the bytes before hashedPos
+        QCryptographicHash hash { QCryptographicHash::Sha256 };
+        qint64 hashedPos = 0;
+        bool isRangeSupported = true;
         bool done = false;
+        QElapsedTimer stateSavedTimer;
     };
 
-    std::map<std::uint64_t, std::unique_ptr<FileAndProgress> > replies_;
+    std::uint64_t uniqueRequestId_ = 0;
+    // for the retries that are due after a stop()
+    std::uint64_t generation_ = 0;
+
+    std::vector<std::unique_ptr<FileDownload> > downloads_;
+    // the file and the segment of a running request
+    std::map<std::uint64_t, std::pair<FileDownload *, size_t> > requests_;
+    QMap<QString, QString> hashes_;
     bool busy_;
     const QString platform_;
 
@@ -50,7 +93,7 @@ private:
     uint progressPercent_;
     DownloadState state_;
 
-    void getInner(const QString url, const QString targetFilenamePath);
+    bool getInner(const QString url, const QString targetFilenamePath);
     void removeAutoUpdateInstallerFiles();
     bool allRepliesDone();
     void deleteAllCurrentReplies();
@@ -60,4 +103,23 @@ private:
     void onReplyDownloadProgress(std::uint64_t requestId, std::uint64_t bytesReceived,
                                  std::uint64_t bytesTotal);
     void onReplyReadyRead(std::uint64_t requestId, const std::string &data);
+
+    void startSegment(FileDownload *download, size_t index);
+    void cancelSegment(FileDownload *download, size_t index);
+    void retrySegment(FileDownload *download, size_t index);
+    void restartFromZero(FileDownload *download);
+    void writeSegment(FileDownload *download, size_t index, const char *data, qint64 size);
+    void onSizeKnown(FileDownload *download);
+    void onRangeNotSupported(FileDownload *download);
+    void onSegmentDone(FileDownload *download);
+    void finishIfAllDone();
+    void fail();
+    void updateHash(FileDownload *download, qint64 pos, const char *data, qint64 size);
+    void updateProgress();
+
+    static QString partPath(const QString &targetFilenamePath);
+    static QString statePath(const QString &targetFilenamePath);
+    bool loadState(FileDownload *download);
+    void saveState(FileDownload *download);
+    static bool preallocate(QFile &file, qint64 size);
 };
@@ -0,0 +1,250 @@
+#include "downloadhelper.test.h"
+#include <QtTest>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QPointer>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include "engine/autoupdater/downloadhelper.h"
+#include "utils/utils.h"
+
+namespace {
+
+const qint64 kFileSize = 8 * 1024 * 1024 + 12345;
+
+} // namespace
+
+RangeServer::RangeServer(const QByteArray &content) : content_(content)
+{
+    listen(QHostAddress::LocalHost);
+}
+
+QString RangeServer::url() const
+{
+    return QString("http://127.0.0.1:%1/update.deb").arg(serverPort());
+}
+
+void RangeServer::incomingConnection(qintptr socketDescriptor)
+{
+    QTcpSocket *socket = new QTcpSocket(this);
+    socket->setSocketDescriptor(socketDescriptor);
+    connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+    QByteArray *request = new QByteArray;
+    connect(socket, &QTcpSocket::destroyed, [request]() { delete request; });
+    connect(socket, &QTcpSocket::readyRead, socket, [this, socket, request]() {
+        request->append(socket->readAll());
+        if (request->contains("\r\n\r\n")) {
+            respond(socket, *request);
+            request->clear();
+        }
+    });
+}
+
+void RangeServer::respond(QTcpSocket *socket, const QByteArray &request)
+{
+    static const QRegularExpression rangeRegExp("\r\nRange: bytes=(\\d+)-(\\d*)\r\n", QRegularExpression::CaseInsensitiveOption);
+    const QRegularExpressionMatch match = rangeRegExp.match(QString::fromLatin1(request));
+    ranges << (match.hasMatch() ? match.captured(1) + "-" + match.captured(2) : QString());
+
+    QByteArray header;
+    QByteArray body;
+    if (match.hasMatch() && isRangeSupported) {
+        const qint64 start = match.captured(1).toLongLong();
+        const qint64 end = match.captured(2).isEmpty() ? content_.size() - 1 : qMin<qint64>(match.captured(2).toLongLong(), content_.size() - 1);
+        body = content_.mid(start, end - start + 1);
+        header = "HTTP/1.1 206 Partial Content\r\n";
+        header += "Content-Range: bytes " + QByteArray::number(start) + "-" + QByteArray::number(end) + "/" + QByteArray::number(content_.size()) + "\r\n";
+    } else {
+        body = content_;
+        header = "HTTP/1.1 200 OK\r\n";
+    }
+    header += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    header += "Content-Type: application/octet-stream\r\n\r\n";
+    socket->write(header);
+
+    qint64 dropAfterBytes = -1;
+    if (dropCount > 0) {
+        dropCount--;
+        dropAfterBytes = dropAfter;
+    }
+    send(socket, body, dropAfterBytes);
+}
+
+void RangeServer::send(QTcpSocket *socket, QByteArray body, qint64 dropAfterBytes)
+{
+    qint64 size = chunkIntervalMs > 0 ? qMin<qint64>(chunkSize, body.size()) : body.size();
+    if (dropAfterBytes >= 0 && dropAfterBytes < size) {
+        size = dropAfterBytes;
+    }
+    socket->write(body.constData(), size);
+    bytesSent += size;
+    body.remove(0, size);
+
+    if (dropAfterBytes >= 0) {
+        dropAfterBytes -= size;
+        if (dropAfterBytes == 0) {
+            socket->flush();
+            socket->abort();
+            socket->deleteLater();
+            return;
+        }
+    }
+    if (!body.isEmpty()) {
+        QPointer<QTcpSocket> guard(socket);
+        QTimer::singleShot(chunkIntervalMs, this, [this, guard, body, dropAfterBytes]() {
+            if (guard && guard->state() == QAbstractSocket::ConnectedState) {
+                send(guard, body, dropAfterBytes);
+            }
+        });
+    }
+}
+
+void DownloadHelper_test::initTestCase()
+{
+    QVERIFY(dir_.isValid());
+    QVERIFY(wsnet::WSNet::initialize(Utils::getPlatformNameSafe().toStdString(), "2.0.0", false, ""));
+}
+
+void DownloadHelper_test::cleanupTestCase()
+{
+    wsnet::WSNet::cleanup();
+}
+
+void DownloadHelper_test::testSegments()
+{
+    const QByteArray content = randomContent(kFileSize);
+    RangeServer server(content);
+    DownloadHelper helper(nullptr, Utils::getPlatformNameSafe());
+    const QString path = dir_.filePath("segments.deb");
+
+    QCOMPARE(download(&helper, server.url(), path), (int)DownloadHelper::DOWNLOAD_STATE_SUCCESS);
+    QCOMPARE(readFile(path), content);
+    QCOMPARE(helper.sha256(path).toLatin1(), sha256(content));
+    QVERIFY(!QFile::exists(path + ".part"));
+    QVERIFY(!QFile::exists(path + ".part.state"));
+
+    // the request for the whole file and the three others
+    QCOMPARE(server.ranges.size(), 4);
+    QCOMPARE(server.ranges.first(), QString("0-"));
+}
+
+void DownloadHelper_test::testSmallFile()
+{
+    const QByteArray content = randomContent(1000);
+    RangeServer server(content);
+    DownloadHelper helper(nullptr, Utils::getPlatformNameSafe());
+    const QString path = dir_.filePath("small.deb");
+
+    QCOMPARE(download(&helper, server.url(), path), (int)DownloadHelper::DOWNLOAD_STATE_SUCCESS);
+    QCOMPARE(readFile(path), content);
+    QCOMPARE(helper.sha256(path).toLatin1(), sha256(content));
+    QCOMPARE(server.ranges.size(), 1);
+}
+
+void DownloadHelper_test::testRetryAfterDrop()
+{
+    const QByteArray content = randomContent(kFileSize);
+    RangeServer server(content);
+    server.dropCount = 3;
+    server.dropAfter = 300 * 1024;
+    DownloadHelper helper(nullptr, Utils::getPlatformNameSafe());
+    const QString path = dir_.filePath("drop.deb");
+
+    QCOMPARE(download(&helper, server.url(), path), (int)DownloadHelper::DOWNLOAD_STATE_SUCCESS);
+    QCOMPARE(readFile(path), content);
+    QCOMPARE(helper.sha256(path).toLatin1(), sha256(content));
+
+    // a broken segment continues where it was, not from its start
+    QVERIFY(server.ranges.size() > 4);
+    for (const QString &range : server.ranges.mid(1)) {
+        QVERIFY2(!range.startsWith("0-"), qPrintable(range));
+    }
+}
+
+void DownloadHelper_test::testRangeIgnored()
+{
+    const QByteArray content = randomContent(kFileSize);
+    RangeServer server(content);
+    server.isRangeSupported = false;
+    DownloadHelper helper(nullptr, Utils::getPlatformNameSafe());
+    const QString path = dir_.filePath("norange.deb");
+
+    QCOMPARE(download(&helper, server.url(), path), (int)DownloadHelper::DOWNLOAD_STATE_SUCCESS);
+    QCOMPARE(readFile(path), content);
+    QCOMPARE(helper.sha256(path).toLatin1(), sha256(content));
+    QVERIFY(!QFile::exists(path + ".part.state"));
+}
+
+void DownloadHelper_test::testResume()
+{
+    const QByteArray content = randomContent(kFileSize);
+    RangeServer server(content);
+    server.chunkIntervalMs = 20;
+    const QString path = dir_.filePath("resume.deb");
+
+    {
+        DownloadHelper helper(nullptr, Utils::getPlatformNameSafe());
+        uint progress = 0;
+        connect(&helper, &DownloadHelper::progressChanged, [&progress](uint progressPercent) { progress = progressPercent; });
+        QMap<QString, QString> downloads;
+        downloads.insert(server.url(), path);
+        helper.get(downloads);
+        QTRY_VERIFY_WITH_TIMEOUT(progress >= 30, 30000);
+        helper.stop();
+    }
+    // the canceled requests are closed
+    QTest::qWait(500);
+    QVERIFY(QFile::exists(path + ".part"));
+    QVERIFY(QFile::exists(path + ".part.state"));
+
+    const qint64 bytesSentBefore = server.bytesSent;
+    const int requestsBefore = server.ranges.size();
+    server.chunkIntervalMs = 0;
+    DownloadHelper helper(nullptr, Utils::getPlatformNameSafe());
+    QCOMPARE(download(&helper, server.url(), path), (int)DownloadHelper::DOWNLOAD_STATE_SUCCESS);
+    QCOMPARE(readFile(path), content);
+    QCOMPARE(helper.sha256(path).toLatin1(), sha256(content));
+
+    // only what was missing was sent again
+    QVERIFY(server.bytesSent - bytesSentBefore < kFileSize * 8 / 10);
+    for (const QString &range : server.ranges.mid(requestsBefore)) {
+        QVERIFY2(!range.startsWith("0-"), qPrintable(range));
+    }
+}
+
+QByteArray DownloadHelper_test::randomContent(qint64 size)
+{
+    QByteArray content(size, 0);
+    QRandomGenerator::global()->fillRange(reinterpret_cast<quint32 *>(content.data()), size / sizeof(quint32));
+    return content;
+}
+
+QByteArray DownloadHelper_test::sha256(const QByteArray &content)
+{
+    return QCryptographicHash::hash(content, QCryptographicHash::Sha256).toHex();
+}
+
+int DownloadHelper_test::download(DownloadHelper *helper, const QString &url, const QString &path, int timeoutMs)
+{
+    int result = -1;
+    QObject::connect(helper, &DownloadHelper::finished, [&result](DownloadHelper::DownloadState state) { result = state; });
+    QMap<QString, QString> downloads;
+    downloads.insert(url, path);
+    helper->get(downloads);
+    QTest::qWaitFor([&result]() { return result != -1; }, timeoutMs);
+    return result;
+}
+
+QByteArray DownloadHelper_test::readFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+QTEST_MAIN(DownloadHelper_test)
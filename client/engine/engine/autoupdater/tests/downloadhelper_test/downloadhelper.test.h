@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QStringList>
+#include <QTcpServer>
+#include <QTemporaryDir>
+
+class DownloadHelper;
+
+// An HTTP server on 127.0.0.1 with one file. It can ignore the Range header like some servers and proxies do, drop
+// the first responses half way through, and send slowly.
+class RangeServer : public QTcpServer
+{
+public:
+    explicit RangeServer(const QByteArray &content);
+
+    QString url() const;
+
+    bool isRangeSupported = true;
+    // the number of responses to break off, and after how many bytes
+    int dropCount = 0;
+    qint64 dropAfter = 0;
+    // 0 sends at once
+    int chunkIntervalMs = 0;
+    qint64 chunkSize = 64 * 1024;
+
+    // the Range headers of the requests, empty for none
+    QStringList ranges;
+    qint64 bytesSent = 0;
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    QByteArray content_;
+
+    void respond(QTcpSocket *socket, const QByteArray &request);
+    void send(QTcpSocket *socket, QByteArray body, qint64 dropAfter);
+};
+
+class DownloadHelper_test : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testSegments();
+    void testSmallFile();
+    void testRetryAfterDrop();
+    void testRangeIgnored();
+    void testResume();
+
+private:
+    QTemporaryDir dir_;
+
+    static QByteArray randomContent(qint64 size);
+    static QByteArray sha256(const QByteArray &content);
+    // the state the helper finished with
+    static int download(DownloadHelper *helper, const QString &url, const QString &path, int timeoutMs = 30000);
+    static QByteArray readFile(const QString &path);
+};
@@ -1,4 +1,5 @@
 #include "utils/logger.h"
+#include "utils/spantracer.h"
 #include <QStandardPaths>
 #include <QThread>
 #include <QCoreApplication>
@@ -58,6 +59,7 @@ ConnectionManager::ConnectionManager(QObject *parent, IHelper *helper, INetworkD
     stunnelManager_(nullptr),
     wstunnelManager_(nullptr),
     ctrldManager_(nullptr),
+    protocolProbeStore_("protocolProbeResults"),
     bEmitAuthError_(false),
     makeOVPNFile_(nullptr),
     makeOVPNFileFromCustom_(nullptr),
@@ -178,9 +180,11 @@ void ConnectionManager::clickConnect(const QString &ovpnConfig, const apiinfo::S
         connector_ = NULL;
     }
 
-    updateConnectionSettingsPolicy(connectionSettings, portMap, proxySettings);
-
-    connSettingsPolicy_->debugLocationInfoToLog();
+    {
+        SpanTracer::Span span("connection", "settings policy");
+        updateConnectionSettingsPolicy(connectionSettings, portMap, proxySettings);
+        connSettingsPolicy_->debugLocationInfoToLog();
+    }
     doConnect();
 }
 
@@ -200,6 +204,7 @@ void ConnectionManager::clickDisconnect()
         qCDebug(LOG_CONNECTION) << "ConnectionManager::clickDisconnect()";
         if (connector_)
         {
+            SpanTracer::instance().beginSpan("connection", "disconnect tunnel");
             connector_->startDisconnect();
         }
         else
@@ -369,6 +374,8 @@ void ConnectionManager::onConnectionConnected(const AdapterGatewayInfo &connecti
     timerReconnection_.stop();
     connectingTimer_.stop();
     state_ = STATE_CONNECTED;
+    SpanTracer::instance().endSpan("tunnel");
+    connSettingsPolicy_->putSuccessfulConnection();
     emit connected();
 }
 
@@ -382,6 +389,8 @@ void ConnectionManager::onConnectionDisconnected()
     }
 
     qCDebug(LOG_CONNECTION) << "ConnectionManager::onConnectionDisconnected(), state_ =" << state_;
+    SpanTracer::instance().endSpan("tunnel");
+    SpanTracer::instance().endSpan("disconnect tunnel");
 
     testVPNTunnel_->stopTests();
     doMacRestoreProcedures();
@@ -552,6 +561,7 @@ void ConnectionManager::onConnectionError(CONNECT_ERROR err)
     }
 
     qCDebug(LOG_CONNECTION) << "ConnectionManager::onConnectionError(), state_ =" << state_ << ", error =" << (int)err;
+    SpanTracer::instance().endSpan("tunnel");
     testVPNTunnel_->stopTests();
 
     if ((err == CONNECT_ERROR::AUTH_ERROR && bEmitAuthError_)
@@ -851,6 +861,7 @@ void ConnectionManager::onTimerReconnection()
 
 void ConnectionManager::onWstunnelStarted()
 {
+    SpanTracer::instance().endSpan("start tunnel process");
     doConnectPart3();
 }
 
@@ -883,6 +894,13 @@ void ConnectionManager::doConnect()
     qCDebug(LOG_CONNECTION) << "Default adapter and gateway:" << defaultAdapterInfo_.makeLogString();
     connectTimer_.stop();
 
+    startConnectingTimer();
+    SpanTracer::instance().beginSpan("connection", "resolve hostnames");
+    connSettingsPolicy_->resolveHostnames();
+}
+
+void ConnectionManager::startConnectingTimer()
+{
     connectingTimer_.setSingleShot(true);
     if (connSettingsPolicy_->isAutomaticMode()) {
         CurrentConnectionDescr settings = connSettingsPolicy_->getCurrentConnectionSettings();
@@ -893,8 +911,6 @@ void ConnectionManager::doConnect()
         }
         connectingTimer_.start();
     }
-
-    connSettingsPolicy_->resolveHostnames();
 }
 
 void ConnectionManager::doConnectPart2()
@@ -902,6 +918,7 @@ void ConnectionManager::doConnectPart2()
     bIgnoreConnectionErrorsForOpenVpn_ = false;
 
     currentConnectionDescr_ = connSettingsPolicy_->getCurrentConnectionSettings();
+    SpanTracer::Span span("connection", "prepare", currentConnectionDescr_.protocol.toLongString());
 
     if (currentConnectionDescr_.connectionNodeType == CONNECTION_NODE_ERROR)
     {
@@ -1005,6 +1022,9 @@ void ConnectionManager::doConnectPart2()
                 return;
             }
 
+            if (currentConnectionDescr_.protocol.isStunnelOrWStunnelProtocol()) {
+                SpanTracer::instance().beginSpan("connection", "start tunnel process", currentConnectionDescr_.protocol.toLongString());
+            }
             if (currentConnectionDescr_.protocol == types::Protocol::STUNNEL) {
                 if (!stunnelManager_->runProcess(currentConnectionDescr_.ip, currentConnectionDescr_.port,
                                                  ExtraConfig::instance().getStealthExtraTLSPadding() || isAntiCensorship_)) {
@@ -1080,6 +1100,8 @@ void ConnectionManager::doConnectPart2()
 
 void ConnectionManager::doConnectPart3()
 {
+    // until the connector reports connected, disconnected or an error
+    SpanTracer::instance().beginSpan("connection", "tunnel", currentConnectionDescr_.protocol.toLongString());
     if (currentConnectionDescr_.protocol.isWireGuardProtocol())
     {
         WireGuardConfig* pConfig = (currentConnectionDescr_.connectionNodeType == CONNECTION_NODE_CUSTOM_CONFIG ? currentConnectionDescr_.wgCustomConfig.get() : &wireGuardConfig_);
@@ -1296,6 +1318,7 @@ void ConnectionManager::restoreConnectionAfterWakeUp()
 
 void ConnectionManager::onTunnelTestsFinished(bool bSuccess, const QString &ipAddress)
 {
+    SpanTracer::instance().endSpan("tunnel tests");
     bool hasAttempts = false;
     int attempts = ExtraConfig::instance().getTunnelTestAttempts(hasAttempts);
     bool noError = ExtraConfig::instance().getIsTunnelTestNoError();
@@ -1363,11 +1386,21 @@ void ConnectionManager::onTimerWaitNetworkConnectivity()
 
 void ConnectionManager::onHostnamesResolved()
 {
+    SpanTracer::instance().endSpan("resolve hostnames");
+    // the automatic policy probes the protocols first, the user may have clicked disconnect in the meantime
+    if (state_ == STATE_DISCONNECTED || state_ == STATE_DISCONNECTING_FROM_USER_CLICK) {
+        return;
+    }
+    // and it may have put another protocol first, the probing time doesn't count either
+    if (connectingTimer_.isActive()) {
+        startConnectingTimer();
+    }
     doConnectPart2();
 }
 
 void ConnectionManager::onGetWireGuardConfigAnswer(WireGuardConfigRetCode retCode, const WireGuardConfig &config)
 {
+    SpanTracer::instance().endSpan("wireguard config");
     // if we got an answer after we've timed out or disconnected, ignore this event
     CurrentConnectionDescr settings = connSettingsPolicy_->getCurrentConnectionSettings();
     if ((state_ != STATE_CONNECTING_FROM_USER_CLICK && state_ != STATE_WAKEUP_RECONNECTING && state_ != STATE_RECONNECTING)
@@ -1456,6 +1489,7 @@ void ConnectionManager::setPacketSize(types::PacketSize ps)
 
 void ConnectionManager::startTunnelTests()
 {
+    SpanTracer::instance().beginSpan("connection", "tunnel tests", currentConnectionDescr_.protocol.toLongString());
     testVPNTunnel_->startTests(currentConnectionDescr_.protocol);
 }
 
@@ -1524,10 +1558,14 @@ void ConnectionManager::updateConnectionSettingsPolicy(const types::ConnectionSe
     if (bli_->locationId().isCustomConfigsLocation()) {
         connSettingsPolicy_.reset(new CustomConfigConnSettingsPolicy(bli_));
     } else if (connectionSettings.isAutomatic()) {
+        types::NetworkInterface networkInterface;
+        networkDetectionManager_->getCurrentNetworkInterface(networkInterface);
 #ifdef Q_OS_MAC
-        connSettingsPolicy_.reset(new AutoConnSettingsPolicy(bli_, portMap, proxySettings.isProxyEnabled(), lastKnownGoodProtocol_, MacUtils::isLockdownMode()));
+        connSettingsPolicy_.reset(new AutoConnSettingsPolicy(bli_, portMap, proxySettings.isProxyEnabled(), lastKnownGoodProtocol_, MacUtils::isLockdownMode(),
+                                                             &protocolProbeStore_, networkInterface.networkOrSsid));
 #else
-        connSettingsPolicy_.reset(new AutoConnSettingsPolicy(bli_, portMap, proxySettings.isProxyEnabled(), lastKnownGoodProtocol_, false));
+        connSettingsPolicy_.reset(new AutoConnSettingsPolicy(bli_, portMap, proxySettings.isProxyEnabled(), lastKnownGoodProtocol_, false,
+                                                             &protocolProbeStore_, networkInterface.networkOrSsid));
 #endif
     } else {
         connSettingsPolicy_.reset(new ManualConnSettingsPolicy(bli_, connectionSettings, portMap));
@@ -1551,6 +1589,7 @@ void ConnectionManager::connectOrStartConnectTimer()
 void ConnectionManager::getWireGuardConfig(const QString &serverName, bool deleteOldestKey, const QString &deviceId)
 {
     SAFE_DELETE(getWireGuardConfig_);
+    SpanTracer::instance().beginSpan("wsnet", "wireguard config");
     getWireGuardConfig_ = new GetWireGuardConfig(this);
     connect(getWireGuardConfig_, &GetWireGuardConfig::getWireGuardConfigAnswer, this, &ConnectionManager::onGetWireGuardConfigAnswer);
     getWireGuardConfig_->getWireGuardConfig(serverName, deleteOldestKey, deviceId);
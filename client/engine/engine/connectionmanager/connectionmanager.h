@@ -12,6 +12,7 @@
 #include "iconnection.h"
 #include "engine/wireguardconfig/wireguardconfig.h"
 #include "connsettingspolicy/baseconnsettingspolicy.h"
+#include "connsettingspolicy/protocolprobestore.h"
 #include "engine/customconfigs/customovpnauthcredentialsstorage.h"
 #include "engine/apiinfo/servercredentials.h"
 #include "engine/locationsmodel/baselocationinfo.h"
@@ -159,6 +160,7 @@ private:
 #endif
 
     QScopedPointer<BaseConnSettingsPolicy> connSettingsPolicy_;
+    ProtocolProbeStore protocolProbeStore_;
 
     QString lastIp_;
 
@@ -218,6 +220,7 @@ private:
     types::Protocol lastKnownGoodProtocol_;
 
     void doConnect();
+    void startConnectingTimer();
     void doConnectPart2();
     void doConnectPart3();
     bool checkFails();
@@ -2,6 +2,7 @@
 
 #include <QDataStream>
 #include <QSettings>
+#include <QStringList>
 #include "utils/extraconfig.h"
 #include "utils/ipvalidation.h"
 #include "utils/logger.h"
@@ -11,7 +12,9 @@ types::Protocol AutoConnSettingsPolicy::lastKnownGoodProtocol_;
 
 AutoConnSettingsPolicy::AutoConnSettingsPolicy(QSharedPointer<locationsmodel::BaseLocationInfo> bli,
                                                const api_responses::PortMap &portMap, bool isProxyEnabled,
-                                               const types::Protocol protocol, bool isLockdownMode)
+                                               const types::Protocol protocol, bool isLockdownMode,
+                                               ProtocolProbeStore *probeStore, const QString &network)
+    : isProxyEnabled_(isProxyEnabled), probeStore_(probeStore), network_(network), prober_(nullptr), isProbed_(false)
 {
     attempts_.clear();
     curAttempt_ = 0;
@@ -80,6 +83,11 @@ void AutoConnSettingsPolicy::putFailedConnection()
         return;
     }
 
+    // both attempts of the protocol failed
+    if (probeStore_ && curAttempt_ % 2 == 1) {
+        probeStore_->putConnectionResult(network_, attempts_[curAttempt_].protocol, false);
+    }
+
     if (curAttempt_ < (attempts_.count() - 1)) {
         if (attempts_[curAttempt_].changeNode) {
             QString remoteOverride = ExtraConfig::instance().getRemoteIpFromExtraConfig();
@@ -100,6 +108,13 @@ void AutoConnSettingsPolicy::putFailedConnection()
     }
 }
 
+void AutoConnSettingsPolicy::putSuccessfulConnection()
+{
+    if (bStarted_ && probeStore_) {
+        probeStore_->putConnectionResult(network_, attempts_[curAttempt_].protocol, true);
+    }
+}
+
 bool AutoConnSettingsPolicy::isFailed() const
 {
     if (!bStarted_) {
@@ -157,10 +172,76 @@ bool AutoConnSettingsPolicy::isCustomConfig()
 
 void AutoConnSettingsPolicy::resolveHostnames()
 {
-    // nothing todo
+    // the probes run once, before the first attempt. Through a proxy they would tell nothing about the VPN traffic.
+    if (isProbed_ || !probeStore_ || isProxyEnabled_ || attempts_.isEmpty()) {
+        emit hostnamesResolved();
+        return;
+    }
+    isProbed_ = true;
+
+    QHash<int, ProtocolProber::Outcome> outcomes;
+    if (probeStore_->recentProbe(network_, outcomes)) {
+        qCDebug(LOG_CONNECTION) << "Using the protocol probes of this network from the last minutes";
+        applyProbeOutcomes(outcomes);
+        emit hostnamesResolved();
+        return;
+    }
+
+    QVector<ProtocolProber::Target> targets;
+    for (int i = 0; i < attempts_.size(); i += 2) {
+        ProtocolProber::Target target;
+        target.protocol = attempts_[i].protocol;
+        target.ip = locationInfo_->getIpForSelectedNode(portMap_.getUseIpInd(target.protocol));
+        target.port = portMap_.const_items()[attempts_[i].portMapInd].ports[0];
+        targets << target;
+    }
+    prober_ = new ProtocolProber(this);
+    connect(prober_, &ProtocolProber::finished, this, &AutoConnSettingsPolicy::onProbeFinished);
+    prober_->start(targets);
+}
+
+void AutoConnSettingsPolicy::onProbeFinished()
+{
+    const QHash<int, ProtocolProber::Outcome> outcomes = prober_->outcomes();
+    prober_->deleteLater();
+    prober_ = nullptr;
+
+    probeStore_->setProbe(network_, outcomes);
+    applyProbeOutcomes(outcomes);
     emit hostnamesResolved();
 }
 
+void AutoConnSettingsPolicy::applyProbeOutcomes(const QHash<int, ProtocolProber::Outcome> &outcomes)
+{
+    QVector<types::Protocol> protocols;
+    for (int i = 0; i < attempts_.size(); i += 2) {
+        protocols << attempts_[i].protocol;
+    }
+    const QVector<types::Protocol> ordered = probeStore_->order(network_, protocols, outcomes);
+    if (ordered == protocols) {
+        return;
+    }
+
+    QVector<AttemptInfo> attempts;
+    QStringList names;
+    for (const types::Protocol &protocol : ordered) {
+        for (const AttemptInfo &attempt : qAsConst(attempts_)) {
+            if (attempt.protocol == protocol) {
+                attempts << attempt;
+            }
+        }
+        names << protocol.toLongString();
+    }
+    attempts_ = attempts;
+    qCDebug(LOG_CONNECTION) << "Protocols reordered by the probes:" << names.join(", ");
+
+    QString remoteOverride = ExtraConfig::instance().getRemoteIpFromExtraConfig();
+    if (IpValidation::isIp(remoteOverride) && attempts_[0].protocol == types::Protocol::WIREGUARD) {
+        locationInfo_->selectNodeByIp(remoteOverride);
+    }
+    emit protocolStatusChanged(protocolStatus());
+}
+
 QVector<types::ProtocolStatus> AutoConnSettingsPolicy::protocolStatus() {
     QVector<types::ProtocolStatus> status;
     QVector<types::ProtocolStatus> failedProtocols;
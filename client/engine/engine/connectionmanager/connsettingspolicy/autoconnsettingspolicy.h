@@ -3,18 +3,21 @@
 #include "baseconnsettingspolicy.h"
 #include "engine/locationsmodel/mutablelocationinfo.h"
 #include "api_responses/portmap.h"
+#include "protocolprobestore.h"
 
 // // manage automatic connection mode (only for API and static ips locations)
 class AutoConnSettingsPolicy : public BaseConnSettingsPolicy
 {
     Q_OBJECT
 public:
+    // probeStore may be null, the protocols are tried in the order of the port map then
     AutoConnSettingsPolicy(QSharedPointer<locationsmodel::BaseLocationInfo> bli, const api_responses::PortMap &portMap, bool isProxyEnabled,
-                           const types::Protocol protocol, bool isLockdownMode);
+                           const types::Protocol protocol, bool isLockdownMode, ProtocolProbeStore *probeStore, const QString &network);
 
     void reset() override;
     void debugLocationInfoToLog() const override;
     void putFailedConnection() override;
+    void putSuccessfulConnection() override;
     bool isFailed() const override;
     CurrentConnectionDescr getCurrentConnectionSettings() const override;
     bool isAutomaticMode() override;
@@ -22,6 +25,9 @@ public:
     void resolveHostnames() override;
     bool hasProtocolChanged() override;
 
+private slots:
+    void onProbeFinished();
+
 private:
     struct AttemptInfo
     {
@@ -36,9 +42,17 @@ private:
     QSharedPointer<locationsmodel::MutableLocationInfo> locationInfo_;
     api_responses::PortMap portMap_;
     bool bIsAllFailed_;
+    bool isProxyEnabled_;
+
+    ProtocolProbeStore *probeStore_;
+    QString network_;
+    ProtocolProber *prober_;
+    bool isProbed_;
 
     static types::Protocol lastKnownGoodProtocol_;
     static uint lastKnownGoodPort_;
 
     QVector<types::ProtocolStatus> protocolStatus();
+    // reorders the attempts before the first one, keeping both attempts of a protocol together
+    void applyProbeOutcomes(const QHash<int, ProtocolProber::Outcome> &outcomes);
 };
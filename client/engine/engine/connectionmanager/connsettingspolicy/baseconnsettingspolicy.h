@@ -62,6 +62,8 @@ public:
     virtual void reset() = 0;
     virtual void debugLocationInfoToLog() const = 0;
     virtual void putFailedConnection() = 0;
+    // the current settings got connected
+    virtual void putSuccessfulConnection() {}
     virtual bool isFailed() const = 0;
     virtual CurrentConnectionDescr getCurrentConnectionSettings() const = 0;
     virtual bool isAutomaticMode() = 0;
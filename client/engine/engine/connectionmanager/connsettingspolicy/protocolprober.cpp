@@ -0,0 +1,320 @@
+#include "protocolprober.h"
+
+#include <QRandomGenerator>
+#include <QSslSocket>
+#include <QTcpSocket>
+#include <QUdpSocket>
+
+#include "utils/logger.h"
+
+namespace {
+
+QByteArray randomBytes(int count)
+{
+    QByteArray bytes(count, Qt::Uninitialized);
+    for (int i = 0; i < count; ++i) {
+        bytes[i] = static_cast<char>(QRandomGenerator::global()->bounded(256));
+    }
+    return bytes;
+}
+
+void appendUint16(QByteArray &data, quint16 value)
+{
+    data.append(static_cast<char>(value >> 8));
+    data.append(static_cast<char>(value & 0xFF));
+}
+
+void appendUint32(QByteArray &data, quint32 value)
+{
+    appendUint16(data, value >> 16);
+    appendUint16(data, value & 0xFFFF);
+}
+
+// the path wstunnelmanager uses, the server forwards it to OpenVPN
+const char *kWebSocketPath = "/tcp/127.0.0.1/1194";
+
+} // namespace
+
+ProtocolProber::ProtocolProber(QObject *parent) : QObject(parent), isRunning_(false)
+{
+    timer_.setSingleShot(true);
+    connect(&timer_, &QTimer::timeout, this, &ProtocolProber::onTimeout);
+}
+
+ProtocolProber::~ProtocolProber()
+{
+    stop();
+}
+
+void ProtocolProber::start(const QVector<Target> &targets, int timeoutMs)
+{
+    stop();
+    probes_.clear();
+    for (const Target &target : targets) {
+        Probe probe;
+        probe.target = target;
+        probes_ << probe;
+    }
+
+    isRunning_ = true;
+    elapsed_.start();
+    timer_.start(timeoutMs);
+    for (int i = 0; i < probes_.size(); ++i) {
+        startProbe(i);
+    }
+    // nothing may have been sent at all, finished() is still emitted after start() returns
+    QMetaObject::invokeMethod(this, [this]() { checkFinished(); }, Qt::QueuedConnection);
+}
+
+void ProtocolProber::stop()
+{
+    isRunning_ = false;
+    timer_.stop();
+    for (Probe &probe : probes_) {
+        if (probe.socket) {
+            probe.socket->disconnect(this);
+            probe.socket->abort();
+            probe.socket->deleteLater();
+            probe.socket = nullptr;
+        }
+    }
+}
+
+bool ProtocolProber::isRunning() const
+{
+    return isRunning_;
+}
+
+QHash<int, ProtocolProber::Outcome> ProtocolProber::outcomes() const
+{
+    QHash<int, Outcome> outcomes;
+    for (const Probe &probe : probes_) {
+        outcomes[probe.target.protocol.toInt()] = probe.outcome;
+    }
+    return outcomes;
+}
+
+void ProtocolProber::onTimeout()
+{
+    for (int i = 0; i < probes_.size(); ++i) {
+        // OpenVPN servers with tls-auth don't answer a hard reset without the HMAC, silence doesn't mean blocked
+        finishProbe(i, probes_[i].target.protocol == types::Protocol::OPENVPN_UDP ? kUnknown : kUnreachable);
+    }
+    checkFinished();
+}
+
+void ProtocolProber::startProbe(int index)
+{
+    Probe &probe = probes_[index];
+    switch (probe.target.protocol.toInt()) {
+    case types::Protocol::OPENVPN_TCP:
+        startTcp(index, false, false);
+        break;
+    case types::Protocol::STUNNEL:
+        startTcp(index, true, false);
+        break;
+    case types::Protocol::WSTUNNEL:
+        startTcp(index, true, true);
+        break;
+    case types::Protocol::IKEV2:
+        probe.expectedReply = randomBytes(8);
+        startUdp(index, ikeSaInitRequest(probe.expectedReply));
+        break;
+    case types::Protocol::OPENVPN_UDP:
+        startUdp(index, openVpnHardResetRequest());
+        break;
+    default:
+        probe.isDone = true;
+        break;
+    }
+}
+
+void ProtocolProber::startTcp(int index, bool isTls, bool isWebSocket)
+{
+    Probe &probe = probes_[index];
+    if (isTls && !QSslSocket::supportsSsl()) {
+        probe.isDone = true;
+        return;
+    }
+
+    if (!isTls) {
+        QTcpSocket *socket = new QTcpSocket(this);
+        probe.socket = socket;
+        connect(socket, &QAbstractSocket::errorOccurred, this, [this, index]() { finishProbe(index, kUnreachable); checkFinished(); });
+        connect(socket, &QAbstractSocket::connected, this, [this, index]() { finishProbe(index, kReachable); checkFinished(); });
+        socket->connectToHost(probe.target.ip, probe.target.port);
+        return;
+    }
+
+    QSslSocket *socket = new QSslSocket(this);
+    probe.socket = socket;
+    // also a TLS alert or a reset of a middlebox that doesn't like the handshake
+    connect(socket, &QAbstractSocket::errorOccurred, this, [this, index]() { finishProbe(index, kUnreachable); checkFinished(); });
+    // the certificates are issued for the hostnames of the nodes, what matters here is that the handshake gets through
+    socket->setPeerVerifyMode(QSslSocket::VerifyNone);
+    if (!isWebSocket) {
+        connect(socket, &QSslSocket::encrypted, this, [this, index]() { finishProbe(index, kReachable); checkFinished(); });
+    } else {
+        const QString host = QString("%1:%2").arg(probe.target.ip).arg(probe.target.port);
+        connect(socket, &QSslSocket::encrypted, this, [socket, host]() {
+            const QByteArray request = QByteArray("GET ") + kWebSocketPath + " HTTP/1.1\r\n"
+                                       "Host: " + host.toUtf8() + "\r\n"
+                                       "Upgrade: websocket\r\n"
+                                       "Connection: Upgrade\r\n"
+                                       "Sec-WebSocket-Key: " + randomBytes(16).toBase64() + "\r\n"
+                                       "Sec-WebSocket-Version: 13\r\n\r\n";
+            socket->write(request);
+        });
+        connect(socket, &QSslSocket::readyRead, this, [this, index, socket]() {
+            if (!socket->canReadLine()) {
+                return;
+            }
+            // a filtering proxy that lets TLS through answers the upgrade with its block page, if at all
+            const QByteArray statusLine = socket->readLine();
+            finishProbe(index, statusLine.startsWith("HTTP/1.1 101") ? kReachable : kUnreachable);
+            checkFinished();
+        });
+    }
+    socket->connectToHostEncrypted(probe.target.ip, probe.target.port);
+}
+
+void ProtocolProber::startUdp(int index, const QByteArray &request)
+{
+    Probe &probe = probes_[index];
+    QUdpSocket *socket = new QUdpSocket(this);
+    probe.socket = socket;
+    // a connected UDP socket gets the ICMP port unreachable of a closed port as ConnectionRefusedError
+    connect(socket, &QAbstractSocket::errorOccurred, this, [this, index]() { finishProbe(index, kUnreachable); checkFinished(); });
+    connect(socket, &QAbstractSocket::connected, this, [socket, request]() { socket->write(request); });
+    connect(socket, &QUdpSocket::readyRead, this, [this, index, socket]() {
+        while (socket->hasPendingDatagrams()) {
+            const QByteArray reply = socket->receiveDatagram().data();
+            const QByteArray &expectedReply = probes_[index].expectedReply;
+            bool isValid;
+            if (expectedReply.isEmpty()) {
+                // P_CONTROL_HARD_RESET_SERVER_V2
+                isValid = !reply.isEmpty() && (static_cast<quint8>(reply[0]) >> 3) == 8;
+            } else {
+                // the IKE header of the response starts with our SPI
+                isValid = reply.size() >= 28 && reply.startsWith(expectedReply);
+            }
+            if (isValid) {
+                finishProbe(index, kReachable);
+                checkFinished();
+                return;
+            }
+        }
+    });
+    socket->connectToHost(probe.target.ip, probe.target.port);
+}
+
+void ProtocolProber::finishProbe(int index, Result result)
+{
+    Probe &probe = probes_[index];
+    if (probe.isDone) {
+        return;
+    }
+    probe.isDone = true;
+    probe.outcome.result = result;
+    if (result == kReachable) {
+        probe.outcome.latencyMs = static_cast<int>(elapsed_.elapsed());
+    }
+    if (probe.socket) {
+        probe.socket->disconnect(this);
+        probe.socket->abort();
+        probe.socket->deleteLater();
+        probe.socket = nullptr;
+    }
+    qCDebug(LOG_CONNECTION) << "Protocol probe" << probe.target.protocol.toLongString() << probe.target.port
+                            << (result == kReachable ? "reachable" : (result == kUnreachable ? "unreachable" : "unknown"))
+                            << "in" << elapsed_.elapsed() << "ms";
+}
+
+void ProtocolProber::checkFinished()
+{
+    if (!isRunning_) {
+        return;
+    }
+    for (const Probe &probe : qAsConst(probes_)) {
+        if (!probe.isDone) {
+            return;
+        }
+    }
+    isRunning_ = false;
+    timer_.stop();
+    emit finished();
+}
+
+QByteArray ProtocolProber::ikeSaInitRequest(const QByteArray &initiatorSpi)
+{
+    // RFC 7296, one proposal of AES-CBC-256, HMAC-SHA2-256 and MODP-2048. A server that doesn't like it still answers
+    // with NO_PROPOSAL_CHOSEN or INVALID_KE_PAYLOAD, which is enough here.
+    auto transform = [](bool isLast, quint8 type, quint16 id, quint16 keyLength) {
+        QByteArray data;
+        data.append(static_cast<char>(isLast ? 0 : 3));
+        data.append('\0');
+        appendUint16(data, keyLength > 0 ? 12 : 8);
+        data.append(static_cast<char>(type));
+        data.append('\0');
+        appendUint16(data, id);
+        if (keyLength > 0) {
+            appendUint16(data, 0x800E);
+            appendUint16(data, keyLength);
+        }
+        return data;
+    };
+    const QByteArray transforms = transform(false, 1, 12, 256) + transform(false, 2, 5, 0) +
+                                  transform(false, 3, 12, 0) + transform(true, 4, 14, 0);
+
+    QByteArray proposal;
+    proposal.append('\0');
+    proposal.append('\0');
+    appendUint16(proposal, 8 + transforms.size());
+    proposal.append('\x01');  // proposal number
+    proposal.append('\x01');  // IKE
+    proposal.append('\0');    // SPI size
+    proposal.append('\x04');  // transforms
+    proposal += transforms;
+
+    QByteArray sa;
+    sa.append('\x22');  // next payload: KE
+    sa.append('\0');
+    appendUint16(sa, 4 + proposal.size());
+    sa += proposal;
+
+    QByteArray ke;
+    ke.append('\x28');  // next payload: Nonce
+    ke.append('\0');
+    appendUint16(ke, 8 + 256);
+    appendUint16(ke, 14);
+    appendUint16(ke, 0);
+    QByteArray publicValue = randomBytes(256);
+    // below the prime
+    publicValue[0] = static_cast<char>(publicValue[0] & 0x7F);
+    ke += publicValue;
+
+    QByteArray nonce;
+    nonce.append('\0');
+    nonce.append('\0');
+    appendUint16(nonce, 4 + 32);
+    nonce += randomBytes(32);
+
+    QByteArray header = initiatorSpi + QByteArray(8, '\0');
+    header.append('\x21');  // next payload: SA
+    header.append('\x20');  // version 2.0
+    header.append('\x22');  // IKE_SA_INIT
+    header.append('\x08');  // initiator
+    appendUint32(header, 0);
+    appendUint32(header, 28 + sa.size() + ke.size() + nonce.size());
+    return header + sa + ke + nonce;
+}
+
+QByteArray ProtocolProber::openVpnHardResetRequest()
+{
+    QByteArray data;
+    data.append(static_cast<char>(7 << 3));  // P_CONTROL_HARD_RESET_CLIENT_V2, key id 0
+    data += randomBytes(8);                  // session id
+    data.append('\0');                       // no acks
+    appendUint32(data, 0);                   // packet id
+    return data;
+}
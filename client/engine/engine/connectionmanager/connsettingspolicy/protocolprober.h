@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+
+#include "types/protocol.h"
+
+class QAbstractSocket;
+
+// Checks concurrently whether the transport of each protocol gets through to a node before the connection attempts
+// start: a TCP connect for OpenVPN TCP, a TLS handshake for stunnel, a TLS handshake and a WebSocket upgrade for
+// wstunnel, an IKE_SA_INIT exchange for IKEv2 and a hard reset for OpenVPN UDP. WireGuard drops anything that isn't
+// a handshake from a peer it knows, so it can't be probed without connecting and is always kUnknown.
+class ProtocolProber : public QObject
+{
+    Q_OBJECT
+public:
+    struct Target
+    {
+        types::Protocol protocol;
+        QString ip;
+        uint port = 0;
+    };
+
+    enum Result { kUnknown, kReachable, kUnreachable };
+
+    struct Outcome
+    {
+        Result result = kUnknown;
+        int latencyMs = -1;
+    };
+
+    explicit ProtocolProber(QObject *parent = nullptr);
+    ~ProtocolProber();
+
+    void start(const QVector<Target> &targets, int timeoutMs = kDefaultTimeoutMs);
+    void stop();
+    bool isRunning() const;
+
+    // by types::Protocol::toInt()
+    QHash<int, Outcome> outcomes() const;
+
+signals:
+    void finished();
+
+private slots:
+    void onTimeout();
+
+private:
+    static constexpr int kDefaultTimeoutMs = 3000;
+
+    struct Probe
+    {
+        Target target;
+        QAbstractSocket *socket = nullptr;
+        QByteArray expectedReply;
+        Outcome outcome;
+        bool isDone = false;
+    };
+
+    QVector<Probe> probes_;
+    QTimer timer_;
+    QElapsedTimer elapsed_;
+    bool isRunning_;
+
+    void startProbe(int index);
+    void startTcp(int index, bool isTls, bool isWebSocket);
+    void startUdp(int index, const QByteArray &request);
+    void finishProbe(int index, Result result);
+    void checkFinished();
+
+    static QByteArray ikeSaInitRequest(const QByteArray &initiatorSpi);
+    static QByteArray openVpnHardResetRequest();
+};
@@ -0,0 +1,154 @@
+#include "protocolprobestore.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QIODevice>
+#include <QSettings>
+#include <algorithm>
+
+#include "utils/simplecrypt.h"
+#include "types/global_consts.h"
+
+ProtocolProbeStore::ProtocolProbeStore(const QString &settingsKey) : settingsKey_(settingsKey)
+{
+    loadFromSettings();
+}
+
+bool ProtocolProbeStore::recentProbe(const QString &network, QHash<int, ProtocolProber::Outcome> &outOutcomes) const
+{
+    auto it = networks_.constFind(network);
+    if (it == networks_.constEnd() || QDateTime::currentMSecsSinceEpoch() - it->probeTime > kProbeValidityMs) {
+        return false;
+    }
+
+    outOutcomes.clear();
+    for (auto protocol = it->protocols.constBegin(); protocol != it->protocols.constEnd(); ++protocol) {
+        outOutcomes[protocol.key()] = protocol.value().probe;
+    }
+    return true;
+}
+
+void ProtocolProbeStore::setProbe(const QString &network, const QHash<int, ProtocolProber::Outcome> &outcomes)
+{
+    NetworkStats &stats = networkStats(network);
+    stats.probeTime = stats.updateTime;
+    for (auto it = outcomes.constBegin(); it != outcomes.constEnd(); ++it) {
+        stats.protocols[it.key()].probe = it.value();
+    }
+    saveToSettings();
+}
+
+void ProtocolProbeStore::putConnectionResult(const QString &network, const types::Protocol &protocol, bool isSuccess)
+{
+    ProtocolStats &stats = networkStats(network).protocols[protocol.toInt()];
+    if (isSuccess) {
+        stats.successes++;
+    } else {
+        stats.failures++;
+    }
+    saveToSettings();
+}
+
+QVector<types::Protocol> ProtocolProbeStore::order(const QString &network, const QVector<types::Protocol> &protocols,
+                                                   const QHash<int, ProtocolProber::Outcome> &outcomes) const
+{
+    const QHash<int, ProtocolStats> history = networks_.value(network).protocols;
+    auto rank = [&](const types::Protocol &protocol) {
+        const ProtocolProber::Outcome outcome = outcomes.value(protocol.toInt());
+        const ProtocolStats stats = history.value(protocol.toInt());
+        int group = 0;
+        if (outcome.result == ProtocolProber::kUnreachable) {
+            group = 2;
+        } else if (stats.failures > stats.successes) {
+            group = 1;
+        }
+        const int latencyStep = outcome.result == ProtocolProber::kReachable ? outcome.latencyMs / kLatencyStepMs : 0;
+        return qMakePair(group, latencyStep);
+    };
+
+    QVector<types::Protocol> result = protocols;
+    std::stable_sort(result.begin(), result.end(), [&](const types::Protocol &a, const types::Protocol &b) {
+        return rank(a) < rank(b);
+    });
+    return result;
+}
+
+ProtocolProbeStore::NetworkStats &ProtocolProbeStore::networkStats(const QString &network)
+{
+    if (!networks_.contains(network) && networks_.size() >= kMaxNetworks) {
+        auto oldest = std::min_element(networks_.begin(), networks_.end(), [](const NetworkStats &a, const NetworkStats &b) {
+            return a.updateTime < b.updateTime;
+        });
+        networks_.erase(oldest);
+    }
+    NetworkStats &stats = networks_[network];
+    stats.updateTime = QDateTime::currentMSecsSinceEpoch();
+    return stats;
+}
+
+void ProtocolProbeStore::saveToSettings()
+{
+    QByteArray arr;
+    {
+        QDataStream ds(&arr, QIODevice::WriteOnly);
+        ds << magic_;
+        ds << versionForSerialization_;
+        ds << networks_.size();
+        for (auto it = networks_.constBegin(); it != networks_.constEnd(); ++it) {
+            ds << it.key() << it->probeTime << it->updateTime << it->protocols.size();
+            for (auto protocol = it->protocols.constBegin(); protocol != it->protocols.constEnd(); ++protocol) {
+                ds << protocol.key() << static_cast<int>(protocol->probe.result) << protocol->probe.latencyMs
+                   << protocol->successes << protocol->failures;
+            }
+        }
+    }
+
+    QSettings settings;
+    SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
+    settings.setValue(settingsKey_, simpleCrypt.encryptToString(arr));
+}
+
+void ProtocolProbeStore::loadFromSettings()
+{
+    networks_.clear();
+
+    QSettings settings;
+    if (!settings.contains(settingsKey_)) {
+        return;
+    }
+
+    SimpleCrypt simpleCrypt(SIMPLE_CRYPT_KEY);
+    QString str = settings.value(settingsKey_).toString();
+    QByteArray arr = simpleCrypt.decryptToByteArray(str);
+
+    QDataStream ds(&arr, QIODevice::ReadOnly);
+    quint32 magic;
+    ds >> magic;
+    if (magic != magic_) {
+        return;
+    }
+    int version;
+    ds >> version;
+    if (version != versionForSerialization_) {
+        return;
+    }
+
+    qsizetype networkCount;
+    ds >> networkCount;
+    for (qsizetype i = 0; i < networkCount && ds.status() == QDataStream::Ok; ++i) {
+        QString network;
+        NetworkStats stats;
+        qsizetype protocolCount;
+        ds >> network >> stats.probeTime >> stats.updateTime >> protocolCount;
+        for (qsizetype j = 0; j < protocolCount && ds.status() == QDataStream::Ok; ++j) {
+            int protocol, result;
+            ProtocolStats protocolStats;
+            ds >> protocol >> result >> protocolStats.probe.latencyMs >> protocolStats.successes >> protocolStats.failures;
+            protocolStats.probe.result = static_cast<ProtocolProber::Result>(result);
+            stats.protocols[protocol] = protocolStats;
+        }
+        if (ds.status() == QDataStream::Ok) {
+            networks_[network] = stats;
+        }
+    }
+}
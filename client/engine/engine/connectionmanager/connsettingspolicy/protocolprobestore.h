@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QHash>
+#include <QVector>
+
+#include "protocolprober.h"
+
+// What was learned about each protocol on a network, saved between program launches: the last probe and how the
+// connection attempts went. Networks are identified by NetworkInterface::networkOrSsid.
+class ProtocolProbeStore
+{
+public:
+    struct ProtocolStats
+    {
+        ProtocolProber::Outcome probe;
+        int successes = 0;
+        int failures = 0;
+    };
+
+    explicit ProtocolProbeStore(const QString &settingsKey);
+
+    // the probe outcomes if the network was probed recently enough to skip probing again
+    bool recentProbe(const QString &network, QHash<int, ProtocolProber::Outcome> &outOutcomes) const;
+    void setProbe(const QString &network, const QHash<int, ProtocolProber::Outcome> &outcomes);
+    void putConnectionResult(const QString &network, const types::Protocol &protocol, bool isSuccess);
+
+    // Sorts the protocols, given in the order of preference, by what is known about them on the network: the ones that
+    // can't be reached go last, the ones that failed to connect more often than not go after the others, and the
+    // reachable ones are ordered by latency where it differs by more than kLatencyStepMs. Otherwise the order stays.
+    QVector<types::Protocol> order(const QString &network, const QVector<types::Protocol> &protocols,
+                                   const QHash<int, ProtocolProber::Outcome> &outcomes) const;
+
+private:
+    struct NetworkStats
+    {
+        qint64 probeTime = 0;   // UTC in ms
+        qint64 updateTime = 0;  // UTC in ms
+        QHash<int, ProtocolStats> protocols;
+    };
+
+    static constexpr int kProbeValidityMs = 10 * 60 * 1000;
+    static constexpr int kLatencyStepMs = 150;
+    static constexpr int kMaxNetworks = 32;
+
+    const QString settingsKey_;
+    QHash<QString, NetworkStats> networks_;
+
+    static constexpr quint32 magic_ = 0x5B1E3A07;
+    static constexpr int versionForSerialization_ = 1;  // should increment the version if the data format is changed
+
+    NetworkStats &networkStats(const QString &network);
+    void saveToSettings();
+    void loadFromSettings();
+};
@@ -9,12 +9,12 @@
 #include "availableport.h"
 #include "engine/openvpnversioncontroller.h"
 #include "utils/ipvalidation.h"
+#include "utils/extraconfig.h"
 
 #ifdef Q_OS_WIN
     #include "adapterutils_win.h"
     #include "engine/helper/helper_win.h"
     #include "types/global_consts.h"
-    #include "utils/extraconfig.h"
 #elif defined (Q_OS_MAC) || defined (Q_OS_LINUX)
     #include "engine/helper/helper_posix.h"
 #endif
@@ -24,6 +24,13 @@ OpenVPNConnection::OpenVPNConnection(QObject *parent, IHelper *helper) : IConnec
     bStopThread_(false), currentState_(STATUS_DISCONNECTED),
     isAllowFirewallAfterCustomConfigConnection_(false), privKeyPassword_("")
 {
+    bool success;
+    bytecountInterval_ = ExtraConfig::instance().getOpenVpnBytecountInterval(success);
+    if (!success || bytecountInterval_ <= 0)
+    {
+        bytecountInterval_ = DEFAULT_BYTECOUNT_INTERVAL;
+    }
+
     connect(&killControllerTimer_, &QTimer::timeout, this, &OpenVPNConnection::onKillControllerTimer);
 }
 
@@ -244,10 +251,7 @@ void OpenVPNConnection::funcConnectToOpenVPN(const boost::system::error_code& er
         qCDebug(LOG_CONNECTION) << "Program connected to openvpn socket";
         helper_->suspendUnblockingCmd(stateVariables_.lastCmdId);
         setCurrentState(STATUS_CONNECTED_TO_SOCKET);
-        stateVariables_.buffer.reset(new boost::asio::streambuf());
-        boost::asio::async_read_until(*stateVariables_.socket, *stateVariables_.buffer, "\n",
-                boost::bind(&OpenVPNConnection::handleRead, this,
-                  boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+        asyncRead();
 
         if (bStopThread_)
         {
@@ -309,45 +313,120 @@ void OpenVPNConnection::funcConnectToOpenVPN(const boost::system::error_code& er
     }
 }
 
+void OpenVPNConnection::asyncRead()
+{
+    stateVariables_.socket->async_read_some(boost::asio::buffer(stateVariables_.parser.writePtr(), stateVariables_.parser.writeSize()),
+        boost::bind(&OpenVPNConnection::handleRead, this,
+          boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+}
+
 void OpenVPNConnection::handleRead(const boost::system::error_code &err, size_t bytes_transferred)
 {
-    Q_UNUSED(bytes_transferred);
     if (err.value() == 0)
     {
-        std::istream is(stateVariables_.buffer.get());
-        std::string resultLine;
-        std::getline(is, resultLine);
-
-        QString serverReply = QString::fromStdString(resultLine).trimmed();
+        stateVariables_.parser.commit(bytes_transferred);
 
         boost::system::error_code write_error;
-        // skip log out BYTECOUNT
-        if (!serverReply.contains(">BYTECOUNT:", Qt::CaseInsensitive))
+        OpenVPNManagementParser::Event event;
+        while (write_error.value() == 0 && stateVariables_.parser.next(event))
+        {
+            handleLine(event, write_error);
+        }
+
+        checkErrorAndContinue(write_error, true);
+    }
+    else
+    {
+        qCDebug(LOG_CONNECTION) << "Read from openvpn socket connection failed, error:" << QString::fromStdString(err.message());
+        setCurrentStateAndEmitDisconnected(STATUS_DISCONNECTED);
+    }
+}
+
+void OpenVPNConnection::handleLine(const OpenVPNManagementParser::Event &event, boost::system::error_code &write_error)
+{
+    // comes every bytecount interval, so it's handled without making a string of it; also not logged
+    if (event.type == OpenVPNManagementParser::Type::kByteCount)
+    {
+        if (stateVariables_.bFirstCalcStat)
+        {
+            stateVariables_.prevBytesRcved = event.bytesIn;
+            stateVariables_.prevBytesXmited = event.bytesOut;
+            emit statisticsUpdated(stateVariables_.prevBytesRcved, stateVariables_.prevBytesXmited, false);
+            stateVariables_.bFirstCalcStat = false;
+        }
+        else
         {
-            qCDebug(LOG_OPENVPN) << serverReply;
+            emit statisticsUpdated(event.bytesIn - stateVariables_.prevBytesRcved, event.bytesOut - stateVariables_.prevBytesXmited, false);
+            stateVariables_.prevBytesRcved = event.bytesIn;
+            stateVariables_.prevBytesXmited = event.bytesOut;
         }
+        return;
+    }
+
+    const QString serverReply = QString::fromUtf8(event.line.data(), (int)event.line.size()).trimmed();
+    qCDebug(LOG_OPENVPN) << serverReply;
+
+    switch (event.type)
+    {
+    case OpenVPNManagementParser::Type::kHold:
         if (serverReply.contains("HOLD:Waiting for hold release", Qt::CaseInsensitive))
         {
             boost::asio::write(*stateVariables_.socket, boost::asio::buffer("state on all\n"), boost::asio::transfer_all(), write_error);
         }
-        else if (serverReply.startsWith("END") && stateVariables_.bWasStateNotification)
+        break;
+
+    case OpenVPNManagementParser::Type::kEnd:
+        if (stateVariables_.bWasStateNotification)
         {
             boost::asio::write(*stateVariables_.socket, boost::asio::buffer("log on\n"), boost::asio::transfer_all(), write_error);
         }
-        else if (serverReply.contains("SUCCESS: real-time state notification set to ON", Qt::CaseInsensitive))
+        break;
+
+    case OpenVPNManagementParser::Type::kSuccess:
+        if (serverReply.contains("SUCCESS: real-time state notification set to ON", Qt::CaseInsensitive))
         {
             stateVariables_.bWasStateNotification = true;
             stateVariables_.isAcceptSigTermCommand_ = true;
         }
         else if (serverReply.contains("SUCCESS: real-time log notification set to ON", Qt::CaseInsensitive))
         {
-            boost::asio::write(*stateVariables_.socket, boost::asio::buffer("bytecount 1\n"), boost::asio::transfer_all(), write_error);
+            char message[64];
+            snprintf(message, sizeof(message), "bytecount %d\n", bytecountInterval_);
+            boost::asio::write(*stateVariables_.socket, boost::asio::buffer(message, strlen(message)), boost::asio::transfer_all(), write_error);
         }
         else if (serverReply.contains("SUCCESS: bytecount interval changed", Qt::CaseInsensitive))
         {
             boost::asio::write(*stateVariables_.socket, boost::asio::buffer("hold release\n"), boost::asio::transfer_all(), write_error);
         }
-        else if (serverReply.contains("PASSWORD:Need 'Auth' username/password", Qt::CaseInsensitive))
+        else if (serverReply.contains("'HTTP Proxy' username entered, but not yet verified", Qt::CaseInsensitive))
+        {
+            char message[1024];
+            snprintf(message, 1024, "password \"HTTP Proxy\" %s\n", proxySettings_.getPassword().toUtf8().data());
+            boost::asio::write(*stateVariables_.socket, boost::asio::buffer(message, strlen(message)), boost::asio::transfer_all(), write_error);
+        }
+        else if (serverReply.contains("'Auth' username entered, but not yet verified", Qt::CaseInsensitive))
+        {
+            if (!password_.isEmpty())
+            {
+                // See Command Parsing paragraph in management-notes.txt file of openvpn sources.
+                // There are escaping rules for the openvpn password command.
+                char message[1024];
+                QString escaped = password_;
+                escaped.replace("\\", "\\\\");
+                escaped.replace("\"", "\\\"");
+                escaped.replace("\t", "\\t");
+                snprintf(message, 1024, "password \"Auth\" \"%s\"\n", escaped.toUtf8().data());
+                boost::asio::write(*stateVariables_.socket, boost::asio::buffer(message, strlen(message)), boost::asio::transfer_all(), write_error);
+            }
+            else
+            {
+                emit requestPassword();
+            }
+        }
+        break;
+
+    case OpenVPNManagementParser::Type::kPassword:
+        if (serverReply.contains("PASSWORD:Need 'Auth' username/password", Qt::CaseInsensitive))
         {
             if (!username_.isEmpty())
             {
@@ -379,31 +458,6 @@ void OpenVPNConnection::handleRead(const boost::system::error_code &err, size_t
             snprintf(message, 1024, "username \"HTTP Proxy\" %s\n", proxySettings_.getUsername().toUtf8().data());
             boost::asio::write(*stateVariables_.socket, boost::asio::buffer(message,strlen(message)), boost::asio::transfer_all(), write_error);
         }
-        else if (serverReply.contains("'HTTP Proxy' username entered, but not yet verified", Qt::CaseInsensitive))
-        {
-            char message[1024];
-            snprintf(message, 1024, "password \"HTTP Proxy\" %s\n", proxySettings_.getPassword().toUtf8().data());
-            boost::asio::write(*stateVariables_.socket, boost::asio::buffer(message, strlen(message)), boost::asio::transfer_all(), write_error);
-        }
-        else if (serverReply.contains("'Auth' username entered, but not yet verified", Qt::CaseInsensitive))
-        {
-            if (!password_.isEmpty())
-            {
-                // See Command Parsing paragraph in management-notes.txt file of openvpn sources.
-                // There are escaping rules for the openvpn password command.
-                char message[1024];
-                QString escaped = password_;
-                escaped.replace("\\", "\\\\");
-                escaped.replace("\"", "\\\"");
-                escaped.replace("\t", "\\t");
-                snprintf(message, 1024, "password \"Auth\" \"%s\"\n", escaped.toUtf8().data());
-                boost::asio::write(*stateVariables_.socket, boost::asio::buffer(message, strlen(message)), boost::asio::transfer_all(), write_error);
-            }
-            else
-            {
-                emit requestPassword();
-            }
-        }
         else if (serverReply.contains("PASSWORD:Verification Failed: 'Auth'", Qt::CaseInsensitive))
         {
             emit error(CONNECT_ERROR::AUTH_ERROR);
@@ -414,7 +468,10 @@ void OpenVPNConnection::handleRead(const boost::system::error_code &err, size_t
                 stateVariables_.bSigTermSent = true;
             }
         }
-        else if (serverReply.contains("FATAL:Error: private key password verification failed", Qt::CaseInsensitive))
+        break;
+
+    case OpenVPNManagementParser::Type::kFatal:
+        if (serverReply.contains("FATAL:Error: private key password verification failed", Qt::CaseInsensitive))
         {
             emit error(CONNECT_ERROR::PRIV_KEY_PASSWORD_ERROR);
             if (!stateVariables_.bSigTermSent)
@@ -424,171 +481,158 @@ void OpenVPNConnection::handleRead(const boost::system::error_code &err, size_t
                 stateVariables_.bSigTermSent = true;
             }
         }
-        else if (serverReply.contains("There are no TAP-Windows", Qt::CaseInsensitive) && serverReply.contains("Wintun",Qt::CaseInsensitive) &&
-                 serverReply.contains("adapters on this system.",Qt::CaseInsensitive))
+        else if (isNoTunTapError(serverReply))
         {
-            if (!stateVariables_.bTapErrorEmited)
-            {
-                emit error(CONNECT_ERROR::NO_INSTALLED_TUN_TAP);
-                stateVariables_.bTapErrorEmited = true;
-                if (!stateVariables_.bSigTermSent)
-                {
-                    boost::asio::write(*stateVariables_.socket, boost::asio::buffer("signal SIGTERM\n"), boost::asio::transfer_all(), write_error);
-                    helper_->clearUnblockingCmd(stateVariables_.lastCmdId);
-                    stateVariables_.bSigTermSent = true;
-                }
-            }
+            emitNoTunTapError(write_error);
         }
-        else if (serverReply.startsWith(">BYTECOUNT:", Qt::CaseInsensitive))
+        else if (serverReply.contains(">FATAL:All wintun adapters on this system are currently in use", Qt::CaseInsensitive))
         {
-            QStringList pars = serverReply.split(":");
-            if (pars.count() > 1)
-            {
-                QStringList pars2 = pars[1].split(",");
-                if (pars2.count() == 2)
-                {
-                    quint64 l1 = pars2[0].toULongLong();
-                    quint64 l2 = pars2[1].toULongLong();
-                    if (stateVariables_.bFirstCalcStat)
-                    {
-                        stateVariables_.prevBytesRcved = l1;
-                        stateVariables_.prevBytesXmited = l2;
-                        emit statisticsUpdated(stateVariables_.prevBytesRcved, stateVariables_.prevBytesXmited, false);
-                        stateVariables_.bFirstCalcStat = false;
-                    }
-                    else
-                    {
-                        emit statisticsUpdated(l1 - stateVariables_.prevBytesRcved, l2 - stateVariables_.prevBytesXmited, false);
-                        stateVariables_.prevBytesRcved = l1;
-                        stateVariables_.prevBytesXmited = l2;
-                    }
-                }
-            }
+            emit error(CONNECT_ERROR::WINTUN_FATAL_ERROR);
         }
-        else if (serverReply.startsWith(">STATE:", Qt::CaseInsensitive))
+        break;
+
+    case OpenVPNManagementParser::Type::kState:
+        if (event.field(1) == "CONNECTED" && event.field(2) == "SUCCESS")
         {
-            if (serverReply.contains("CONNECTED,SUCCESS", Qt::CaseInsensitive))
-            {
 #ifdef Q_OS_WIN
-                AdapterGatewayInfo windscribeAdapter = AdapterUtils_win::getConnectedAdapterInfo(QString::fromWCharArray(kOpenVPNAdapterIdentifier));
-                if (!windscribeAdapter.isEmpty())
-                {
-                    if (connectionAdapterInfo_.adapterIp() != windscribeAdapter.adapterIp())
-                    {
-                        qCDebug(LOG_CONNECTION) << "Error: Adapter IP detected from openvpn log not equal to the adapter IP from AdapterUtils_win::getWindscribeConnectedAdapterInfo()";
-                        WS_ASSERT(false);
-                    }
-                    connectionAdapterInfo_.setAdapterName(windscribeAdapter.adapterName());
-                    connectionAdapterInfo_.setAdapterIp(windscribeAdapter.adapterIp());
-                    connectionAdapterInfo_.setDnsServers(windscribeAdapter.dnsServers());
-                    connectionAdapterInfo_.setIfIndex(windscribeAdapter.ifIndex());
-                }
-                else
+            AdapterGatewayInfo windscribeAdapter = AdapterUtils_win::getConnectedAdapterInfo(QString::fromWCharArray(kOpenVPNAdapterIdentifier));
+            if (!windscribeAdapter.isEmpty())
+            {
+                if (connectionAdapterInfo_.adapterIp() != windscribeAdapter.adapterIp())
                 {
-                    qCDebug(LOG_CONNECTION) << "Can't detect connected Windscribe adapter";
+                    qCDebug(LOG_CONNECTION) << "Error: Adapter IP detected from openvpn log not equal to the adapter IP from AdapterUtils_win::getWindscribeConnectedAdapterInfo()";
+                    WS_ASSERT(false);
                 }
+                connectionAdapterInfo_.setAdapterName(windscribeAdapter.adapterName());
+                connectionAdapterInfo_.setAdapterIp(windscribeAdapter.adapterIp());
+                connectionAdapterInfo_.setDnsServers(windscribeAdapter.dnsServers());
+                connectionAdapterInfo_.setIfIndex(windscribeAdapter.ifIndex());
+            }
+            else
+            {
+                qCDebug(LOG_CONNECTION) << "Can't detect connected Windscribe adapter";
+            }
 #endif
 
-                QString remoteIp;
-                if (parseConnectedSuccessReply(serverReply, remoteIp))
-                {
-                    connectionAdapterInfo_.setRemoteIp(remoteIp);
-                }
-                else
-                {
-                    qCDebug(LOG_CONNECTION) << "Can't parse CONNECTED,SUCCESS control message";
-                }
-                setCurrentState(STATUS_CONNECTED);
-                emit connected(connectionAdapterInfo_);
-            }
-            else if (serverReply.contains("CONNECTED,ERROR", Qt::CaseInsensitive))
+            QString remoteIp;
+            if (parseConnectedSuccessReply(event, remoteIp))
             {
-                setCurrentState(STATUS_CONNECTED);
-                emit error(CONNECT_ERROR::CONNECTED_ERROR);
+                connectionAdapterInfo_.setRemoteIp(remoteIp);
             }
-            else if (serverReply.contains("RECONNECTING", Qt::CaseInsensitive))
+            else
             {
-                stateVariables_.isAcceptSigTermCommand_ = false;
-                stateVariables_.bWasStateNotification = false;
-                setCurrentState(STATUS_CONNECTED_TO_SOCKET);
-                emit reconnecting();
+                qCDebug(LOG_CONNECTION) << "Can't parse CONNECTED,SUCCESS control message";
             }
+            setCurrentState(STATUS_CONNECTED);
+            emit connected(connectionAdapterInfo_);
         }
-        else if (serverReply.startsWith(">LOG:", Qt::CaseInsensitive))
+        else if (event.field(1) == "CONNECTED" && event.field(2) == "ERROR")
         {
-            bool bContainsUDPWord = serverReply.contains("UDP", Qt::CaseInsensitive);
-            if (bContainsUDPWord && serverReply.contains("No buffer space available (WSAENOBUFS) (code=10055)", Qt::CaseInsensitive))
-            {
-                emit error(CONNECT_ERROR::UDP_CANT_ASSIGN);
-            }
-            else if (bContainsUDPWord && serverReply.contains("No Route to Host (WSAEHOSTUNREACH) (code=10065)", Qt::CaseInsensitive))
-            {
-                emit error(CONNECT_ERROR::UDP_CANT_ASSIGN);
-            }
-            else if (bContainsUDPWord && serverReply.contains("Can't assign requested address (code=49)", Qt::CaseInsensitive))
-            {
-                emit error(CONNECT_ERROR::UDP_CANT_ASSIGN);
-            }
-            else if (bContainsUDPWord && serverReply.contains("No buffer space available (code=55)", Qt::CaseInsensitive))
-            {
-                emit error(CONNECT_ERROR::UDP_NO_BUFFER_SPACE);
-            }
-            else if (bContainsUDPWord && serverReply.contains("Network is down (code=50)", Qt::CaseInsensitive))
-            {
-                emit error(CONNECT_ERROR::UDP_NETWORK_DOWN);
-            }
-            else if (serverReply.contains("write_wintun", Qt::CaseInsensitive) && serverReply.contains("head/tail value is over capacity", Qt::CaseInsensitive))
-            {
-                emit error(CONNECT_ERROR::WINTUN_OVER_CAPACITY);
-            }
-            else if (serverReply.contains("TCP:", Qt::CaseInsensitive) && serverReply.contains("failed", Qt::CaseInsensitive))
-            {
-                emit error(CONNECT_ERROR::TCP_ERROR);
-            }
-            else if (serverReply.contains("Initialization Sequence Completed With Errors", Qt::CaseInsensitive))
-            {
-                emit error(CONNECT_ERROR::INITIALIZATION_SEQUENCE_COMPLETED_WITH_ERRORS);
-            }
+            setCurrentState(STATUS_CONNECTED);
+            emit error(CONNECT_ERROR::CONNECTED_ERROR);
+        }
+        else if (event.field(1) == "RECONNECTING")
+        {
+            stateVariables_.isAcceptSigTermCommand_ = false;
+            stateVariables_.bWasStateNotification = false;
+            setCurrentState(STATUS_CONNECTED_TO_SOCKET);
+            emit reconnecting();
+        }
+        break;
+
+    case OpenVPNManagementParser::Type::kLog:
+    {
+        bool bContainsUDPWord = serverReply.contains("UDP", Qt::CaseInsensitive);
+        if (isNoTunTapError(serverReply))
+        {
+            emitNoTunTapError(write_error);
+        }
+        else if (bContainsUDPWord && serverReply.contains("No buffer space available (WSAENOBUFS) (code=10055)", Qt::CaseInsensitive))
+        {
+            emit error(CONNECT_ERROR::UDP_CANT_ASSIGN);
+        }
+        else if (bContainsUDPWord && serverReply.contains("No Route to Host (WSAEHOSTUNREACH) (code=10065)", Qt::CaseInsensitive))
+        {
+            emit error(CONNECT_ERROR::UDP_CANT_ASSIGN);
+        }
+        else if (bContainsUDPWord && serverReply.contains("Can't assign requested address (code=49)", Qt::CaseInsensitive))
+        {
+            emit error(CONNECT_ERROR::UDP_CANT_ASSIGN);
+        }
+        else if (bContainsUDPWord && serverReply.contains("No buffer space available (code=55)", Qt::CaseInsensitive))
+        {
+            emit error(CONNECT_ERROR::UDP_NO_BUFFER_SPACE);
+        }
+        else if (bContainsUDPWord && serverReply.contains("Network is down (code=50)", Qt::CaseInsensitive))
+        {
+            emit error(CONNECT_ERROR::UDP_NETWORK_DOWN);
+        }
+        else if (serverReply.contains("write_wintun", Qt::CaseInsensitive) && serverReply.contains("head/tail value is over capacity", Qt::CaseInsensitive))
+        {
+            emit error(CONNECT_ERROR::WINTUN_OVER_CAPACITY);
+        }
+        else if (serverReply.contains("TCP:", Qt::CaseInsensitive) && serverReply.contains("failed", Qt::CaseInsensitive))
+        {
+            emit error(CONNECT_ERROR::TCP_ERROR);
+        }
+        else if (serverReply.contains("Initialization Sequence Completed With Errors", Qt::CaseInsensitive))
+        {
+            emit error(CONNECT_ERROR::INITIALIZATION_SEQUENCE_COMPLETED_WITH_ERRORS);
+        }
 #if defined (Q_OS_MAC) || defined (Q_OS_LINUX)
-            else if (serverReply.contains("device", Qt::CaseInsensitive) && serverReply.contains("opened", Qt::CaseInsensitive))
+        else if (serverReply.contains("device", Qt::CaseInsensitive) && serverReply.contains("opened", Qt::CaseInsensitive))
+        {
+            QString deviceName;
+            if (parseDeviceOpenedReply(serverReply, deviceName))
             {
-                QString deviceName;
-                if (parseDeviceOpenedReply(serverReply, deviceName))
-                {
-                    connectionAdapterInfo_.setAdapterName(deviceName);
-                }
+                connectionAdapterInfo_.setAdapterName(deviceName);
             }
+        }
 #endif
-            else if (serverReply.contains("PUSH: Received control message:", Qt::CaseInsensitive))
+        else if (serverReply.contains("PUSH: Received control message:", Qt::CaseInsensitive))
+        {
+            bool isRedirectDefaultGateway = true;
+            if (!parsePushReply(serverReply, connectionAdapterInfo_, isRedirectDefaultGateway))
             {
-                bool isRedirectDefaultGateway = true;
-                if (!parsePushReply(serverReply, connectionAdapterInfo_, isRedirectDefaultGateway))
-                {
-                    qCDebug(LOG_CONNECTION) << "Can't parse PUSH Received control message";
-                }
+                qCDebug(LOG_CONNECTION) << "Can't parse PUSH Received control message";
+            }
 
-                if (isRedirectDefaultGateway)
-                {
-                    // We are going to set up the default gateway, so firewall is allowed after
-                    // we have connected (unless the current custom config explicitly forbits this).
-                    isAllowFirewallAfterCustomConfigConnection_ = true;
-                }
-            } else if (serverReply.contains("write UDP: Unknown error (code=10065)") || serverReply.contains("write UDP: Unknown error (code=10054)")) {
-                // These errors indicate socket was closed or otherwise unavailable for writing.
-                setCurrentStateAndEmitDisconnected(STATUS_DISCONNECTED);
+            if (isRedirectDefaultGateway)
+            {
+                // We are going to set up the default gateway, so firewall is allowed after
+                // we have connected (unless the current custom config explicitly forbits this).
+                isAllowFirewallAfterCustomConfigConnection_ = true;
             }
+        } else if (serverReply.contains("write UDP: Unknown error (code=10065)") || serverReply.contains("write UDP: Unknown error (code=10054)")) {
+            // These errors indicate socket was closed or otherwise unavailable for writing.
+            setCurrentStateAndEmitDisconnected(STATUS_DISCONNECTED);
         }
-        else if (serverReply.contains(">FATAL:All wintun adapters on this system are currently in use", Qt::CaseInsensitive))
-        {
-            emit error(CONNECT_ERROR::WINTUN_FATAL_ERROR);
-        }
+        break;
+    }
 
-        checkErrorAndContinue(write_error, true);
+    default:
+        break;
     }
-    else
+}
+
+bool OpenVPNConnection::isNoTunTapError(const QString &serverReply)
+{
+    return serverReply.contains("There are no TAP-Windows", Qt::CaseInsensitive) && serverReply.contains("Wintun",Qt::CaseInsensitive) &&
+           serverReply.contains("adapters on this system.",Qt::CaseInsensitive);
+}
+
+void OpenVPNConnection::emitNoTunTapError(boost::system::error_code &write_error)
+{
+    if (!stateVariables_.bTapErrorEmited)
     {
-        qCDebug(LOG_CONNECTION) << "Read from openvpn socket connection failed, error:" << QString::fromStdString(err.message());
-        setCurrentStateAndEmitDisconnected(STATUS_DISCONNECTED);
+        emit error(CONNECT_ERROR::NO_INSTALLED_TUN_TAP);
+        stateVariables_.bTapErrorEmited = true;
+        if (!stateVariables_.bSigTermSent)
+        {
+            boost::asio::write(*stateVariables_.socket, boost::asio::buffer("signal SIGTERM\n"), boost::asio::transfer_all(), write_error);
+            helper_->clearUnblockingCmd(stateVariables_.lastCmdId);
+            stateVariables_.bSigTermSent = true;
+        }
     }
 }
 
@@ -622,9 +666,7 @@ void OpenVPNConnection::checkErrorAndContinue(boost::system::error_code &write_e
     {
         if (bWithAsyncReadCall)
         {
-            boost::asio::async_read_until(*stateVariables_.socket, *stateVariables_.buffer, "\n",
-                boost::bind(&OpenVPNConnection::handleRead, this,
-                  boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+            asyncRead();
         }
     }
 
@@ -793,18 +835,17 @@ bool OpenVPNConnection::parseDeviceOpenedReply(const QString &reply, QString &ou
     return !outDeviceName.isEmpty();
 }
 
-bool OpenVPNConnection::parseConnectedSuccessReply(const QString &reply, QString &outRemoteIp)
+bool OpenVPNConnection::parseConnectedSuccessReply(const OpenVPNManagementParser::Event &event, QString &outRemoteIp)
 {
-    QStringRef str(&reply);
-    const QVector<QStringRef> v = str.split(',');
-    if (v.count() != 8)
+    if (event.fieldCount != 8)
     {
         qCDebug(LOG_CONNECTION) << "Can't parse CONNECT SUCCESS message (inccorect number of words)";
         return false;
     }
     else
     {
-        outRemoteIp = v[4].toString();
+        const std::string_view remoteIp = event.field(4);
+        outRemoteIp = QString::fromUtf8(remoteIp.data(), (int)remoteIp.size());
         if (outRemoteIp.isEmpty())
         {
             qCDebug(LOG_CONNECTION) << "Can't parse CONNECT SUCCESS message (remote ip is empty)";
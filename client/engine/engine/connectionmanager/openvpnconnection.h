@@ -6,6 +6,7 @@
 #include <QMutex>
 #include "engine/helper/ihelper.h"
 #include "iconnection.h"
+#include "openvpnmanagementparser.h"
 #include "types/proxysettings.h"
 #include "utils/boost_includes.h"
 #include <atomic>
@@ -45,6 +46,8 @@ private slots:
 private:
     static constexpr int DEFAULT_PORT = 9544;
     static constexpr int MAX_WAIT_OPENVPN_ON_START = 20000;
+    // seconds, can be changed with ws-openvpn-bytecount-interval in the extra config
+    static constexpr int DEFAULT_BYTECOUNT_INTERVAL = 1;
 
     IHelper *helper_;
     std::atomic<bool> bStopThread_;
@@ -57,6 +60,7 @@ private:
     QString privKeyPassword_;
     types::ProxySettings proxySettings_;
     bool isCustomConfig_;
+    int bytecountInterval_;
 
     enum CONNECTION_STATUS {STATUS_DISCONNECTED, STATUS_CONNECTING, STATUS_CONNECTED_TO_SOCKET, STATUS_CONNECTED};
     CONNECTION_STATUS currentState_;
@@ -71,7 +75,7 @@ private:
     struct StateVariables
     {
         boost::scoped_ptr<boost::asio::ip::tcp::socket> socket;
-        boost::scoped_ptr<boost::asio::streambuf> buffer;
+        OpenVPNManagementParser parser;
         bool bTapErrorEmited;
         bool bWasStateNotification;
         bool bWasSecondAttemptToStartOpenVpn;
@@ -98,7 +102,7 @@ private:
         void reset()
         {
             socket.reset();
-            buffer.reset();
+            parser.reset();
 
             bSigTermSent = false;
             bTapErrorEmited = false;
@@ -125,7 +129,11 @@ private:
 
     void funcRunOpenVPN();
     void funcConnectToOpenVPN(const boost::system::error_code& err);
+    void asyncRead();
     void handleRead(const boost::system::error_code& err, size_t bytes_transferred);
+    void handleLine(const OpenVPNManagementParser::Event &event, boost::system::error_code &write_error);
+    bool isNoTunTapError(const QString &serverReply);
+    void emitNoTunTapError(boost::system::error_code &write_error);
     void funcDisconnect();
 
     void checkErrorAndContinue(boost::system::error_code &write_error, bool bWithAsyncReadCall);
@@ -135,5 +143,5 @@ private:
 
     bool parsePushReply(const QString &reply, AdapterGatewayInfo &outConnectionAdapterInfo, bool &outRedirectDefaultGateway);
     bool parseDeviceOpenedReply(const QString &reply, QString &outDeviceName);
-    bool parseConnectedSuccessReply(const QString &reply, QString &outRemoteIp);
+    bool parseConnectedSuccessReply(const OpenVPNManagementParser::Event &event, QString &outRemoteIp);
 };
@@ -0,0 +1,243 @@
+#include "openvpnmanagementparser.h"
+
+#include <cstring>
+
+namespace {
+
+bool hasPrefix(std::string_view line, std::string_view prefix)
+{
+    return line.size() >= prefix.size() && memcmp(line.data(), prefix.data(), prefix.size()) == 0;
+}
+
+// sets the type and the payload if the line starts with the prefix
+bool match(OpenVPNManagementParser::Event &event, std::string_view prefix, OpenVPNManagementParser::Type type)
+{
+    if (!hasPrefix(event.line, prefix)) {
+        return false;
+    }
+    event.type = type;
+    event.payload = event.line.substr(prefix.size());
+    return true;
+}
+
+} // namespace
+
+OpenVPNManagementParser::OpenVPNManagementParser(size_t capacity) : buffer_(capacity), line_(capacity)
+{
+    reset();
+}
+
+char *OpenVPNManagementParser::writePtr()
+{
+    return buffer_.data() + writePos_ % buffer_.size();
+}
+
+size_t OpenVPNManagementParser::writeSize() const
+{
+    const size_t free = buffer_.size() - (size_t)(writePos_ - readPos_);
+    const size_t toEnd = buffer_.size() - writePos_ % buffer_.size();
+    return free < toEnd ? free : toEnd;
+}
+
+void OpenVPNManagementParser::commit(size_t size)
+{
+    writePos_ += size;
+}
+
+size_t OpenVPNManagementParser::feed(const char *data, size_t size)
+{
+    size_t fed = 0;
+    while (fed < size) {
+        size_t chunk = writeSize();
+        if (chunk == 0) {
+            break;
+        }
+        if (chunk > size - fed) {
+            chunk = size - fed;
+        }
+        memcpy(writePtr(), data + fed, chunk);
+        commit(chunk);
+        fed += chunk;
+    }
+    return fed;
+}
+
+bool OpenVPNManagementParser::next(Event &event)
+{
+    uint64_t lineBreakPos;
+    while (findLineBreak(lineBreakPos)) {
+        const uint64_t start = readPos_;
+        readPos_ = lineBreakPos + 1;
+        scanPos_ = readPos_;
+        if (isSkippingLine_) {
+            // the end of an overlong line
+            isSkippingLine_ = false;
+            continue;
+        }
+
+        size_t size = (size_t)(lineBreakPos - start);
+        const size_t offset = start % buffer_.size();
+        const char *data;
+        if (offset + size <= buffer_.size()) {
+            data = buffer_.data() + offset;
+        } else {
+            const size_t firstPart = buffer_.size() - offset;
+            memcpy(line_.data(), buffer_.data() + offset, firstPart);
+            memcpy(line_.data() + firstPart, buffer_.data(), size - firstPart);
+            data = line_.data();
+        }
+        if (size > 0 && data[size - 1] == '\r') {
+            size--;
+        }
+
+        event = Event();
+        event.line = std::string_view(data, size);
+        classify(event);
+        return true;
+    }
+
+    if (writePos_ - readPos_ == buffer_.size()) {
+        // a line that doesn't fit, the rest of it is skipped when it comes
+        if (!isSkippingLine_) {
+            overlongLines_++;
+        }
+        isSkippingLine_ = true;
+        readPos_ = writePos_;
+        scanPos_ = writePos_;
+    }
+    return false;
+}
+
+void OpenVPNManagementParser::reset()
+{
+    readPos_ = 0;
+    writePos_ = 0;
+    scanPos_ = 0;
+    isSkippingLine_ = false;
+    overlongLines_ = 0;
+}
+
+bool OpenVPNManagementParser::findLineBreak(uint64_t &pos)
+{
+    // at most two contiguous parts, before and after the end of the buffer
+    while (scanPos_ < writePos_) {
+        const size_t offset = scanPos_ % buffer_.size();
+        size_t size = (size_t)(writePos_ - scanPos_);
+        if (offset + size > buffer_.size()) {
+            size = buffer_.size() - offset;
+        }
+        const char *found = static_cast<const char *>(memchr(buffer_.data() + offset, '\n', size));
+        if (found) {
+            pos = scanPos_ + (found - (buffer_.data() + offset));
+            return true;
+        }
+        scanPos_ += size;
+    }
+    return false;
+}
+
+void OpenVPNManagementParser::classify(Event &event)
+{
+    const std::string_view line = event.line;
+    if (line.empty()) {
+        return;
+    }
+
+    if (line[0] == '>') {
+        if (line.size() < 2) {
+            return;
+        }
+        switch (line[1]) {
+        case 'B':
+            if (match(event, ">BYTECOUNT:", Type::kByteCount)) {
+                const size_t comma = event.payload.find(',');
+                if (comma == std::string_view::npos ||
+                    !parseNumber(event.payload.substr(0, comma), event.bytesIn) ||
+                    !parseNumber(event.payload.substr(comma + 1), event.bytesOut)) {
+                    event.type = Type::kOther;
+                }
+            }
+            break;
+        case 'E':
+            match(event, ">ECHO:", Type::kEcho);
+            break;
+        case 'F':
+            match(event, ">FATAL:", Type::kFatal);
+            break;
+        case 'H':
+            match(event, ">HOLD:", Type::kHold);
+            break;
+        case 'I':
+            match(event, ">INFO:", Type::kInfo);
+            break;
+        case 'L':
+            if (match(event, ">LOG:", Type::kLog)) {
+                split(event.payload, 3, event);
+            }
+            break;
+        case 'N':
+            match(event, ">NEED-OK:", Type::kNeedOk);
+            break;
+        case 'P':
+            match(event, ">PASSWORD:", Type::kPassword);
+            break;
+        case 'S':
+            if (match(event, ">STATE:", Type::kState)) {
+                split(event.payload, MAX_FIELDS, event);
+            }
+            break;
+        default:
+            break;
+        }
+        return;
+    }
+
+    switch (line[0]) {
+    case 'E':
+        if (!match(event, "ERROR:", Type::kError) && line == "END") {
+            event.type = Type::kEnd;
+        }
+        break;
+    case 'S':
+        match(event, "SUCCESS:", Type::kSuccess);
+        break;
+    default:
+        return;
+    }
+    if (!event.payload.empty() && event.payload[0] == ' ') {
+        event.payload.remove_prefix(1);
+    }
+}
+
+void OpenVPNManagementParser::split(std::string_view str, size_t maxFields, Event &event)
+{
+    event.fieldCount = 0;
+    while (event.fieldCount + 1 < maxFields) {
+        const size_t comma = str.find(',');
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        event.fields[event.fieldCount++] = str.substr(0, comma);
+        str.remove_prefix(comma + 1);
+    }
+    event.fields[event.fieldCount++] = str;
+}
+
+bool OpenVPNManagementParser::parseNumber(std::string_view str, uint64_t &value)
+{
+    if (str.empty() || str.size() > 20) {
+        return false;
+    }
+    value = 0;
+    for (char c : str) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        const uint64_t digit = (uint64_t)(c - '0');
+        if (value > (UINT64_MAX - digit) / 10) {
+            return false;
+        }
+        value = value * 10 + digit;
+    }
+    return true;
+}
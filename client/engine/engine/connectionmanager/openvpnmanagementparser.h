@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Incremental parser of the output of the OpenVPN management interface. The socket is read straight into a ring
+// buffer (writePtr()/commit()), and next() hands out the complete lines as typed events, recognized by a switch on
+// their prefix. The events point into the buffer, so nothing is allocated per line; they stay valid until the buffer
+// is written to again.
+class OpenVPNManagementParser
+{
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 64 * 1024;
+    static constexpr size_t MAX_FIELDS = 10;
+
+    enum class Type {
+        kOther,
+        kSuccess,       // SUCCESS: <payload>
+        kError,         // ERROR: <payload>
+        kEnd,           // END of a multi-line reply
+        kByteCount,     // >BYTECOUNT:<in>,<out>
+        kState,         // >STATE:<time>,<state>,<description>,<local ip>,<remote ip>,...
+        kPassword,      // >PASSWORD:<payload>
+        kLog,           // >LOG:<time>,<flags>,<message>
+        kHold,          // >HOLD:<payload>
+        kFatal,         // >FATAL:<payload>
+        kInfo,          // >INFO:<payload>
+        kNeedOk,        // >NEED-OK:<payload>
+        kEcho           // >ECHO:<payload>
+    };
+
+    struct Event
+    {
+        Type type = Type::kOther;
+        std::string_view line;      // without the line break
+        std::string_view payload;   // after the prefix
+        // kState and kLog split at the commas; the message of kLog, the last field, keeps its commas
+        std::array<std::string_view, MAX_FIELDS> fields;
+        size_t fieldCount = 0;
+        // kByteCount
+        uint64_t bytesIn = 0;
+        uint64_t bytesOut = 0;
+
+        std::string_view field(size_t index) const { return index < fieldCount ? fields[index] : std::string_view(); }
+    };
+
+    explicit OpenVPNManagementParser(size_t capacity = DEFAULT_CAPACITY);
+
+    // contiguous free space of the buffer, to read into, followed by commit() of what was read
+    char *writePtr();
+    size_t writeSize() const;
+    void commit(size_t size);
+    // copies the data into the buffer, with the lines complete in it to be taken by next() first if it's full
+    size_t feed(const char *data, size_t size);
+
+    // false if there is no complete line
+    bool next(Event &event);
+
+    void reset();
+    // the lines longer than the buffer, which are skipped
+    uint64_t overlongLines() const { return overlongLines_; }
+
+private:
+    std::vector<char> buffer_;
+    // for a line that wraps around the end of buffer_
+    std::vector<char> line_;
+    // positions in the data since the start, buffer_ holds [readPos_, writePos_)
+    uint64_t readPos_;
+    uint64_t writePos_;
+    // up to which the data was searched for a line break
+    uint64_t scanPos_;
+    bool isSkippingLine_;
+    uint64_t overlongLines_;
+
+    bool findLineBreak(uint64_t &pos);
+    static void classify(Event &event);
+    static void split(std::string_view str, size_t maxFields, Event &event);
+    static bool parseNumber(std::string_view str, uint64_t &value);
+};
@@ -0,0 +1,271 @@
+#include "openvpnmanagementparser.test.h"
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRandomGenerator>
+
+#include "engine/connectionmanager/openvpnmanagementparser.h"
+
+namespace {
+
+typedef OpenVPNManagementParser::Type Type;
+
+QByteArray loadSession()
+{
+    QFile file(":data/tests/openvpnmanagement/session.txt");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+QString toString(std::string_view str)
+{
+    return QString::fromUtf8(str.data(), (int)str.size());
+}
+
+// an event copied out of the parser, which reuses its buffer
+struct ParsedLine
+{
+    Type type;
+    QString line;
+    QString payload;
+    QStringList fields;
+    quint64 bytesIn;
+    quint64 bytesOut;
+
+    bool operator==(const ParsedLine &other) const
+    {
+        return type == other.type && line == other.line && payload == other.payload && fields == other.fields &&
+               bytesIn == other.bytesIn && bytesOut == other.bytesOut;
+    }
+};
+
+ParsedLine copy(const OpenVPNManagementParser::Event &event)
+{
+    ParsedLine parsed;
+    parsed.type = event.type;
+    parsed.line = toString(event.line);
+    parsed.payload = toString(event.payload);
+    for (size_t i = 0; i < event.fieldCount; ++i) {
+        parsed.fields << toString(event.field(i));
+    }
+    parsed.bytesIn = event.bytesIn;
+    parsed.bytesOut = event.bytesOut;
+    return parsed;
+}
+
+// feeds the data in chunks of up to maxChunk bytes, as the socket would hand it out
+QVector<ParsedLine> parse(OpenVPNManagementParser &parser, const QByteArray &data, int maxChunk, QRandomGenerator *random = nullptr)
+{
+    QVector<ParsedLine> result;
+    OpenVPNManagementParser::Event event;
+    int pos = 0;
+    while (pos < data.size()) {
+        int chunk = random ? random->bounded(1, maxChunk + 1) : maxChunk;
+        chunk = qMin(chunk, data.size() - pos);
+        const size_t fed = parser.feed(data.constData() + pos, chunk);
+        pos += (int)fed;
+        while (parser.next(event)) {
+            result << copy(event);
+        }
+    }
+    return result;
+}
+
+QVector<ParsedLine> parse(const QByteArray &data)
+{
+    OpenVPNManagementParser parser;
+    return parse(parser, data, data.size());
+}
+
+} // namespace
+
+void OpenVPNManagementParser_test::testSession()
+{
+    const QByteArray session = loadSession();
+    QVERIFY(!session.isEmpty());
+
+    const QVector<ParsedLine> lines = parse(session);
+    const QVector<Type> expected = {
+        Type::kInfo, Type::kHold, Type::kSuccess, Type::kState, Type::kEnd, Type::kSuccess, Type::kSuccess, Type::kSuccess,
+        Type::kLog, Type::kState, Type::kState, Type::kLog, Type::kState, Type::kState, Type::kPassword, Type::kSuccess,
+        Type::kSuccess, Type::kLog, Type::kState, Type::kLog, Type::kState, Type::kLog, Type::kState, Type::kLog, Type::kState,
+        Type::kByteCount, Type::kByteCount, Type::kByteCount, Type::kLog, Type::kState, Type::kByteCount, Type::kFatal,
+        Type::kError, Type::kNeedOk, Type::kEcho, Type::kState
+    };
+    QCOMPARE(lines.size(), expected.size());
+    for (int i = 0; i < lines.size(); ++i) {
+        QVERIFY2(lines[i].type == expected[i], qPrintable(lines[i].line));
+        // the line breaks are \r\n
+        QVERIFY(!lines[i].line.endsWith('\r'));
+    }
+
+    QCOMPARE(lines[1].payload, QString("Waiting for hold release:0"));
+    QCOMPARE(lines[2].payload, QString("real-time state notification set to ON"));
+    QCOMPARE(lines[4].line, QString("END"));
+    QCOMPARE(lines[14].payload, QString("Need 'Auth' username/password"));
+    QCOMPARE(lines[32].payload, QString("unknown command, enter 'help' for more options"));
+
+    // the message of a log line keeps its commas
+    const ParsedLine &push = lines[19];
+    QCOMPARE(push.fields.size(), 3);
+    QCOMPARE(push.fields[0], QString("1697712003"));
+    QCOMPARE(push.fields[1], QString(""));
+    QVERIFY(push.fields[2].startsWith("PUSH: Received control message: 'PUSH_REPLY,redirect-gateway def1 bypass-dhcp,"));
+    QVERIFY(push.fields[2].endsWith("cipher AES-256-GCM'"));
+}
+
+void OpenVPNManagementParser_test::testStateFields()
+{
+    const QVector<ParsedLine> lines = parse(loadSession());
+    const ParsedLine &connected = lines[24];
+    QCOMPARE(connected.type, Type::kState);
+    QCOMPARE(connected.fields, QStringList({ "1697712004", "CONNECTED", "SUCCESS", "10.120.10.170", "185.232.22.10", "443",
+                                             "192.168.1.20", "51234" }));
+
+    const ParsedLine &reconnecting = lines[29];
+    QCOMPARE(reconnecting.fields.size(), 8);
+    QCOMPARE(reconnecting.fields[1], QString("RECONNECTING"));
+    QCOMPARE(reconnecting.fields[2], QString("connection-reset"));
+
+    // more commas than fields: the rest stays in the last one
+    const QVector<ParsedLine> many = parse(">STATE:1,2,3,4,5,6,7,8,9,10,11,12\n");
+    QCOMPARE(many.size(), 1);
+    QCOMPARE(many[0].fields.size(), (int)OpenVPNManagementParser::MAX_FIELDS);
+    QCOMPARE(many[0].fields.last(), QString("10,11,12"));
+}
+
+void OpenVPNManagementParser_test::testByteCount()
+{
+    const QVector<ParsedLine> lines = parse(">BYTECOUNT:2311842,120620\r\n"
+                                            ">BYTECOUNT:18446744073709551615,0\n"
+                                            ">BYTECOUNT:12\n"
+                                            ">BYTECOUNT:12,x\n"
+                                            ">BYTECOUNT:,5\n"
+                                            ">BYTECOUNT:99999999999999999999999,1\n");
+    QCOMPARE(lines.size(), 6);
+    QCOMPARE(lines[0].type, Type::kByteCount);
+    QCOMPARE(lines[0].bytesIn, 2311842ull);
+    QCOMPARE(lines[0].bytesOut, 120620ull);
+    QCOMPARE(lines[1].type, Type::kByteCount);
+    QCOMPARE(lines[1].bytesIn, 18446744073709551615ull);
+    // malformed ones are not taken for statistics
+    for (int i = 2; i < lines.size(); ++i) {
+        QVERIFY2(lines[i].type == Type::kOther, qPrintable(lines[i].line));
+    }
+}
+
+void OpenVPNManagementParser_test::testChunked()
+{
+    // whatever the reads are cut into, the events are the same
+    const QByteArray session = loadSession();
+    const QVector<ParsedLine> expected = parse(session);
+
+    QRandomGenerator random(12345);
+    for (int i = 0; i < 200; ++i) {
+        OpenVPNManagementParser parser;
+        const QVector<ParsedLine> lines = parse(parser, session, random.bounded(1, 64), &random);
+        QVERIFY(lines == expected);
+    }
+    for (int chunk = 1; chunk <= 16; ++chunk) {
+        OpenVPNManagementParser parser;
+        QVERIFY(parse(parser, session, chunk) == expected);
+    }
+}
+
+void OpenVPNManagementParser_test::testWrapAround()
+{
+    // a buffer just big enough for the longest line, so that lines keep wrapping around its end
+    const QByteArray session = loadSession();
+    const QVector<ParsedLine> expected = parse(session);
+    int longest = 0;
+    for (const QByteArray &line : session.split('\n')) {
+        longest = qMax(longest, line.size() + 1);
+    }
+
+    QRandomGenerator random(777);
+    for (int capacity = longest; capacity < longest + 64; ++capacity) {
+        OpenVPNManagementParser parser(capacity);
+        QByteArray data;
+        for (int i = 0; i < 20; ++i) {
+            data += session;
+        }
+        const QVector<ParsedLine> lines = parse(parser, data, capacity, &random);
+        QCOMPARE(lines.size(), expected.size() * 20);
+        for (int i = 0; i < lines.size(); ++i) {
+            QVERIFY(lines[i] == expected[i % expected.size()]);
+        }
+        QCOMPARE((quint64)parser.overlongLines(), 0ull);
+    }
+}
+
+void OpenVPNManagementParser_test::testOverlongLine()
+{
+    OpenVPNManagementParser parser(256);
+    const QByteArray data = ">HOLD:Waiting for hold release:0\n" + QByteArray(">LOG:1,I,") + QByteArray(10000, 'x') + "\n" +
+                            ">STATE:1,CONNECTED,SUCCESS,10.0.0.2,1.2.3.4,443,,\n";
+    const QVector<ParsedLine> lines = parse(parser, data, 100);
+    // the line that doesn't fit is skipped, the lines around it are not
+    QCOMPARE(lines.size(), 2);
+    QCOMPARE(lines[0].type, Type::kHold);
+    QCOMPARE(lines[1].type, Type::kState);
+    QCOMPARE(lines[1].fields[1], QString("CONNECTED"));
+    QCOMPARE((quint64)parser.overlongLines(), 1ull);
+}
+
+void OpenVPNManagementParser_test::testGarbage()
+{
+    QRandomGenerator random(4242);
+    const QByteArray session = loadSession();
+    for (int i = 0; i < 100; ++i) {
+        QByteArray data(random.bounded(1, 20000), '\0');
+        for (int j = 0; j < data.size(); ++j) {
+            // plenty of line breaks and prefix characters, to get to all the branches
+            const int r = random.bounded(8);
+            data[j] = r == 0 ? '\n' : r == 1 ? '>' : r == 2 ? ',' : (char)random.bounded(256);
+        }
+        OpenVPNManagementParser parser(random.bounded(512, 4096));
+        parse(parser, data, random.bounded(1, 2048), &random);
+
+        // back in step after the next line break
+        parse(parser, "\n", 1);
+        QVERIFY(parse(parser, session, 512) == parse(session));
+    }
+}
+
+void OpenVPNManagementParser_test::testThroughput()
+{
+    // the traffic statistics of a long session, once a second for a day, plus its log
+    QByteArray data;
+    for (int i = 0; i < 86400; ++i) {
+        data += ">BYTECOUNT:" + QByteArray::number(1000000ll * i) + "," + QByteArray::number(250000ll * i) + "\r\n";
+        if (i % 60 == 0) {
+            data += ">LOG:1697712004,I,Data Channel: using negotiated cipher 'AES-256-GCM'\r\n";
+        }
+    }
+
+    OpenVPNManagementParser parser;
+    OpenVPNManagementParser::Event event;
+    quint64 byteCounts = 0;
+    quint64 lastBytesIn = 0;
+    QElapsedTimer timer;
+    timer.start();
+    int pos = 0;
+    while (pos < data.size()) {
+        pos += (int)parser.feed(data.constData() + pos, qMin(4096, (int)data.size() - pos));
+        while (parser.next(event)) {
+            if (event.type == Type::kByteCount) {
+                byteCounts++;
+                lastBytesIn = event.bytesIn;
+            }
+        }
+    }
+    const qint64 elapsedMs = timer.elapsed();
+
+    QCOMPARE(byteCounts, 86400ull);
+    QCOMPARE(lastBytesIn, 1000000ull * 86399);
+    qInfo() << "Parsed" << data.size() << "bytes in" << elapsedMs << "ms";
+}
+
+QTEST_MAIN(OpenVPNManagementParser_test)
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <QObject>
+
+class OpenVPNManagementParser_test : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testSession();
+    void testStateFields();
+    void testByteCount();
+    void testChunked();
+    void testWrapAround();
+    void testOverlongLine();
+    void testGarbage();
+    void testThroughput();
+};
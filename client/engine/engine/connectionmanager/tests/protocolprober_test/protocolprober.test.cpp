@@ -0,0 +1,353 @@
+#include "protocolprober.test.h"
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QNetworkDatagram>
+#include <QSettings>
+#include <QSslCertificate>
+#include <QSslKey>
+#include <QSslSocket>
+#include <memory>
+
+#include "engine/connectionmanager/connsettingspolicy/protocolprobestore.h"
+
+namespace {
+
+const int kTimeoutMs = 1000;
+const QString kSettingsKey = "protocolProbeResultsTest";
+
+const QVector<types::Protocol> kPortMapOrder = { types::Protocol::WIREGUARD, types::Protocol::IKEV2, types::Protocol::OPENVPN_UDP,
+                                                 types::Protocol::OPENVPN_TCP, types::Protocol::STUNNEL, types::Protocol::WSTUNNEL };
+
+QByteArray load(const QString &name)
+{
+    QFile file(":data/tests/protocolprober/" + name);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+ProtocolProber::Outcome outcome(ProtocolProber::Result result, int latencyMs = -1)
+{
+    ProtocolProber::Outcome outcome;
+    outcome.result = result;
+    outcome.latencyMs = latencyMs;
+    return outcome;
+}
+
+QStringList names(const QVector<types::Protocol> &protocols)
+{
+    QStringList names;
+    for (const types::Protocol &protocol : protocols) {
+        names << protocol.toLongString();
+    }
+    return names;
+}
+
+} // namespace
+
+TlsServer::TlsServer(Mode mode) : mode_(mode)
+{
+    listen(QHostAddress::LocalHost);
+}
+
+void TlsServer::incomingConnection(qintptr socketDescriptor)
+{
+    if (mode_ == kResetAfterHello) {
+        // what a DPI box does once it has seen the ClientHello
+        QTcpSocket *socket = new QTcpSocket(this);
+        socket->setSocketDescriptor(socketDescriptor);
+        connect(socket, &QTcpSocket::readyRead, socket, [socket]() {
+            socket->abort();
+            socket->deleteLater();
+        });
+        return;
+    }
+
+    QSslSocket *socket = new QSslSocket(this);
+    socket->setSocketDescriptor(socketDescriptor);
+    socket->setLocalCertificate(QSslCertificate(load("server.crt")));
+    socket->setPrivateKey(QSslKey(load("server.key"), QSsl::Ec));
+    connect(socket, &QSslSocket::disconnected, socket, &QObject::deleteLater);
+    if (mode_ != kTls) {
+        std::shared_ptr<QByteArray> request(new QByteArray);
+        const QByteArray response = mode_ == kWebSocket
+            ? "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n\r\n"
+            : "HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\n\r\n";
+        connect(socket, &QSslSocket::readyRead, socket, [socket, request, response]() {
+            *request += socket->readAll();
+            if (request->contains("\r\n\r\n")) {
+                socket->write(response);
+            }
+        });
+    }
+    socket->startServerEncryption();
+}
+
+SimulatedNode::SimulatedNode(const QHash<int, Block> &blocks) : blocks_(blocks)
+{
+    const Block stunnel = block(types::Protocol::STUNNEL);
+    const Block wstunnel = block(types::Protocol::WSTUNNEL);
+    stunnelServer_ = new TlsServer(stunnel == kReset ? TlsServer::kResetAfterHello : TlsServer::kTls);
+    webSocketServer_ = new TlsServer(wstunnel == kReset ? TlsServer::kResetAfterHello
+                                     : (wstunnel == kBlockPage ? TlsServer::kWebSocketBlockPage : TlsServer::kWebSocket));
+    tcpServer_.listen(QHostAddress::LocalHost);
+    ikeSocket_.bind(QHostAddress::LocalHost);
+    openVpnSocket_.bind(QHostAddress::LocalHost);
+
+    const bool isIkeDropped = block(types::Protocol::IKEV2) == kDrop;
+    const bool isOpenVpnDropped = block(types::Protocol::OPENVPN_UDP) == kDrop;
+    QObject::connect(&ikeSocket_, &QUdpSocket::readyRead, [this, isIkeDropped]() {
+        if (isIkeDropped) {
+            while (ikeSocket_.hasPendingDatagrams()) {
+                ikeSocket_.receiveDatagram();
+            }
+        } else {
+            reply(&ikeSocket_, true);
+        }
+    });
+    QObject::connect(&openVpnSocket_, &QUdpSocket::readyRead, [this, isOpenVpnDropped]() {
+        if (isOpenVpnDropped) {
+            while (openVpnSocket_.hasPendingDatagrams()) {
+                openVpnSocket_.receiveDatagram();
+            }
+        } else {
+            reply(&openVpnSocket_, false);
+        }
+    });
+
+    // nothing on the node answers WireGuard without a known key anyway
+    ports_[types::Protocol::WIREGUARD] = closedPort(true);
+    ports_[types::Protocol::IKEV2] = block(types::Protocol::IKEV2) == kClosed ? closedPort(true) : ikeSocket_.localPort();
+    ports_[types::Protocol::OPENVPN_UDP] = block(types::Protocol::OPENVPN_UDP) == kClosed ? closedPort(true) : openVpnSocket_.localPort();
+    ports_[types::Protocol::OPENVPN_TCP] = block(types::Protocol::OPENVPN_TCP) == kClosed ? closedPort(false) : tcpServer_.serverPort();
+    ports_[types::Protocol::STUNNEL] = stunnel == kClosed ? closedPort(false) : stunnelServer_->serverPort();
+    ports_[types::Protocol::WSTUNNEL] = wstunnel == kClosed ? closedPort(false) : webSocketServer_->serverPort();
+}
+
+SimulatedNode::~SimulatedNode()
+{
+    delete stunnelServer_;
+    delete webSocketServer_;
+}
+
+QVector<ProtocolProber::Target> SimulatedNode::targets() const
+{
+    QVector<ProtocolProber::Target> targets;
+    for (const types::Protocol &protocol : kPortMapOrder) {
+        ProtocolProber::Target target;
+        target.protocol = protocol;
+        target.ip = "127.0.0.1";
+        target.port = ports_.value(protocol.toInt());
+        targets << target;
+    }
+    return targets;
+}
+
+SimulatedNode::Block SimulatedNode::block(types::Protocol protocol) const
+{
+    return blocks_.value(protocol.toInt(), kOpen);
+}
+
+uint SimulatedNode::closedPort(bool isUdp)
+{
+    uint port;
+    if (isUdp) {
+        QUdpSocket socket;
+        socket.bind(QHostAddress::LocalHost);
+        port = socket.localPort();
+    } else {
+        QTcpServer server;
+        server.listen(QHostAddress::LocalHost);
+        port = server.serverPort();
+    }
+    return port;
+}
+
+void SimulatedNode::reply(QUdpSocket *socket, bool isIke)
+{
+    while (socket->hasPendingDatagrams()) {
+        const QNetworkDatagram datagram = socket->receiveDatagram();
+        QByteArray reply;
+        if (isIke) {
+            // an IKE_SA_INIT response header with the SPI of the initiator
+            reply = datagram.data().left(8) + QByteArray(8, '\x5a') + QByteArray::fromHex("29202220000000000000001c");
+        } else {
+            // P_CONTROL_HARD_RESET_SERVER_V2
+            reply = QByteArray(1, static_cast<char>(8 << 3)) + QByteArray(8, '\x5a') + QByteArray(5, '\0');
+        }
+        socket->writeDatagram(reply, datagram.senderAddress(), datagram.senderPort());
+    }
+}
+
+void ProtocolProber_test::initTestCase()
+{
+    // keeps the stores of the tests out of the settings of the application
+    QCoreApplication::setOrganizationName("Windscribe");
+    QCoreApplication::setApplicationName("protocolprober.test");
+}
+
+void ProtocolProber_test::cleanup()
+{
+    QSettings settings;
+    settings.remove(kSettingsKey);
+}
+
+void ProtocolProber_test::testProbe_data()
+{
+    QTest::addColumn<int>("protocol");
+    QTest::addColumn<int>("block");
+    QTest::addColumn<int>("expected");
+
+    QTest::addRow("wireguard") << int(types::Protocol::WIREGUARD) << int(SimulatedNode::kOpen) << int(ProtocolProber::kUnknown);
+    QTest::addRow("ikev2") << int(types::Protocol::IKEV2) << int(SimulatedNode::kOpen) << int(ProtocolProber::kReachable);
+    QTest::addRow("ikev2 closed") << int(types::Protocol::IKEV2) << int(SimulatedNode::kClosed) << int(ProtocolProber::kUnreachable);
+    QTest::addRow("ikev2 dropped") << int(types::Protocol::IKEV2) << int(SimulatedNode::kDrop) << int(ProtocolProber::kUnreachable);
+    QTest::addRow("udp") << int(types::Protocol::OPENVPN_UDP) << int(SimulatedNode::kOpen) << int(ProtocolProber::kReachable);
+    QTest::addRow("udp closed") << int(types::Protocol::OPENVPN_UDP) << int(SimulatedNode::kClosed) << int(ProtocolProber::kUnreachable);
+    // could be a server with tls-auth just as well
+    QTest::addRow("udp dropped") << int(types::Protocol::OPENVPN_UDP) << int(SimulatedNode::kDrop) << int(ProtocolProber::kUnknown);
+    QTest::addRow("tcp") << int(types::Protocol::OPENVPN_TCP) << int(SimulatedNode::kOpen) << int(ProtocolProber::kReachable);
+    QTest::addRow("tcp closed") << int(types::Protocol::OPENVPN_TCP) << int(SimulatedNode::kClosed) << int(ProtocolProber::kUnreachable);
+    QTest::addRow("stunnel") << int(types::Protocol::STUNNEL) << int(SimulatedNode::kOpen) << int(ProtocolProber::kReachable);
+    QTest::addRow("stunnel reset") << int(types::Protocol::STUNNEL) << int(SimulatedNode::kReset) << int(ProtocolProber::kUnreachable);
+    QTest::addRow("wstunnel") << int(types::Protocol::WSTUNNEL) << int(SimulatedNode::kOpen) << int(ProtocolProber::kReachable);
+    QTest::addRow("wstunnel reset") << int(types::Protocol::WSTUNNEL) << int(SimulatedNode::kReset) << int(ProtocolProber::kUnreachable);
+    QTest::addRow("wstunnel block page") << int(types::Protocol::WSTUNNEL) << int(SimulatedNode::kBlockPage) << int(ProtocolProber::kUnreachable);
+}
+
+void ProtocolProber_test::testProbe()
+{
+    QFETCH(int, protocol);
+    QFETCH(int, block);
+    QFETCH(int, expected);
+
+    if ((protocol == types::Protocol::STUNNEL || protocol == types::Protocol::WSTUNNEL) && !QSslSocket::supportsSsl()) {
+        QSKIP("no TLS backend");
+    }
+
+    SimulatedNode node({ { protocol, SimulatedNode::Block(block) } });
+    QVector<ProtocolProber::Target> targets;
+    for (const ProtocolProber::Target &target : node.targets()) {
+        if (target.protocol == protocol) {
+            targets << target;
+        }
+    }
+
+    const QHash<int, ProtocolProber::Outcome> outcomes = probe(targets, kTimeoutMs);
+    QVERIFY(outcomes.contains(protocol));
+    QCOMPARE(int(outcomes[protocol].result), expected);
+    QCOMPARE(outcomes[protocol].latencyMs >= 0, expected == ProtocolProber::kReachable);
+}
+
+void ProtocolProber_test::testRestrictiveNetwork()
+{
+    if (!QSslSocket::supportsSsl()) {
+        QSKIP("no TLS backend");
+    }
+
+    // UDP doesn't get through, nor does TLS that isn't HTTPS, only wstunnel works
+    SimulatedNode node({ { types::Protocol::IKEV2, SimulatedNode::kDrop },
+                         { types::Protocol::OPENVPN_UDP, SimulatedNode::kDrop },
+                         { types::Protocol::OPENVPN_TCP, SimulatedNode::kClosed },
+                         { types::Protocol::STUNNEL, SimulatedNode::kReset } });
+    qint64 elapsedMs = 0;
+    const QHash<int, ProtocolProber::Outcome> outcomes = probe(node.targets(), kTimeoutMs, &elapsedMs);
+    // one timeout for all of them, where the attempts one after another take two connection timeouts per protocol
+    qDebug() << "probed in" << elapsedMs << "ms";
+    QVERIFY(elapsedMs < kTimeoutMs + 500);
+    QCOMPARE(int(outcomes[types::Protocol::WIREGUARD].result), int(ProtocolProber::kUnknown));
+    QCOMPARE(int(outcomes[types::Protocol::IKEV2].result), int(ProtocolProber::kUnreachable));
+    QCOMPARE(int(outcomes[types::Protocol::OPENVPN_UDP].result), int(ProtocolProber::kUnknown));
+    QCOMPARE(int(outcomes[types::Protocol::OPENVPN_TCP].result), int(ProtocolProber::kUnreachable));
+    QCOMPARE(int(outcomes[types::Protocol::STUNNEL].result), int(ProtocolProber::kUnreachable));
+    QCOMPARE(int(outcomes[types::Protocol::WSTUNNEL].result), int(ProtocolProber::kReachable));
+
+    ProtocolProbeStore store(kSettingsKey);
+    QCOMPARE(names(store.order("Office", kPortMapOrder, outcomes)),
+             names({ types::Protocol::WIREGUARD, types::Protocol::OPENVPN_UDP, types::Protocol::WSTUNNEL,
+                     types::Protocol::IKEV2, types::Protocol::OPENVPN_TCP, types::Protocol::STUNNEL }));
+
+    // the protocols that can't be probed go after wstunnel once they failed here
+    store.putConnectionResult("Office", types::Protocol::WIREGUARD, false);
+    store.putConnectionResult("Office", types::Protocol::OPENVPN_UDP, false);
+    QCOMPARE(names(store.order("Office", kPortMapOrder, outcomes)),
+             names({ types::Protocol::WSTUNNEL, types::Protocol::WIREGUARD, types::Protocol::OPENVPN_UDP,
+                     types::Protocol::IKEV2, types::Protocol::OPENVPN_TCP, types::Protocol::STUNNEL }));
+}
+
+void ProtocolProber_test::testOrderByLatency()
+{
+    QHash<int, ProtocolProber::Outcome> outcomes;
+    outcomes[types::Protocol::WIREGUARD] = outcome(ProtocolProber::kUnknown);
+    outcomes[types::Protocol::IKEV2] = outcome(ProtocolProber::kReachable, 20);
+    outcomes[types::Protocol::OPENVPN_UDP] = outcome(ProtocolProber::kReachable, 40);
+    outcomes[types::Protocol::OPENVPN_TCP] = outcome(ProtocolProber::kReachable, 400);
+    outcomes[types::Protocol::STUNNEL] = outcome(ProtocolProber::kReachable, 30);
+    outcomes[types::Protocol::WSTUNNEL] = outcome(ProtocolProber::kReachable, 200);
+
+    // small differences don't change the order of the port map
+    ProtocolProbeStore store(kSettingsKey);
+    QCOMPARE(names(store.order("Home", kPortMapOrder, outcomes)),
+             names({ types::Protocol::WIREGUARD, types::Protocol::IKEV2, types::Protocol::OPENVPN_UDP,
+                     types::Protocol::STUNNEL, types::Protocol::WSTUNNEL, types::Protocol::OPENVPN_TCP }));
+}
+
+void ProtocolProber_test::testConnectionHistory()
+{
+    ProtocolProbeStore store(kSettingsKey);
+    store.putConnectionResult("Cafe", types::Protocol::WIREGUARD, false);
+    store.putConnectionResult("Cafe", types::Protocol::WIREGUARD, false);
+    store.putConnectionResult("Cafe", types::Protocol::WIREGUARD, true);
+    const QVector<types::Protocol> demoted = { types::Protocol::IKEV2, types::Protocol::OPENVPN_UDP, types::Protocol::OPENVPN_TCP,
+                                               types::Protocol::STUNNEL, types::Protocol::WSTUNNEL, types::Protocol::WIREGUARD };
+    QCOMPARE(names(store.order("Cafe", kPortMapOrder, QHash<int, ProtocolProber::Outcome>())), names(demoted));
+    // other networks are not affected
+    QCOMPARE(names(store.order("Home", kPortMapOrder, QHash<int, ProtocolProber::Outcome>())), names(kPortMapOrder));
+
+    store.putConnectionResult("Cafe", types::Protocol::WIREGUARD, true);
+    QCOMPARE(names(store.order("Cafe", kPortMapOrder, QHash<int, ProtocolProber::Outcome>())), names(kPortMapOrder));
+}
+
+void ProtocolProber_test::testPersistence()
+{
+    QHash<int, ProtocolProber::Outcome> outcomes;
+    outcomes[types::Protocol::IKEV2] = outcome(ProtocolProber::kUnreachable);
+    outcomes[types::Protocol::WSTUNNEL] = outcome(ProtocolProber::kReachable, 35);
+    {
+        ProtocolProbeStore store(kSettingsKey);
+        store.setProbe("Home", outcomes);
+        store.putConnectionResult("Home", types::Protocol::WIREGUARD, false);
+    }
+
+    ProtocolProbeStore store(kSettingsKey);
+    QHash<int, ProtocolProber::Outcome> loaded;
+    QVERIFY(store.recentProbe("Home", loaded));
+    QCOMPARE(int(loaded[types::Protocol::IKEV2].result), int(ProtocolProber::kUnreachable));
+    QCOMPARE(int(loaded[types::Protocol::WSTUNNEL].result), int(ProtocolProber::kReachable));
+    QCOMPARE(loaded[types::Protocol::WSTUNNEL].latencyMs, 35);
+    QVERIFY(!store.recentProbe("Elsewhere", loaded));
+    QCOMPARE(names(store.order("Home", kPortMapOrder, outcomes)),
+             names({ types::Protocol::OPENVPN_UDP, types::Protocol::OPENVPN_TCP, types::Protocol::STUNNEL,
+                     types::Protocol::WSTUNNEL, types::Protocol::WIREGUARD, types::Protocol::IKEV2 }));
+}
+
+QHash<int, ProtocolProber::Outcome> ProtocolProber_test::probe(const QVector<ProtocolProber::Target> &targets, int timeoutMs,
+                                                               qint64 *elapsedMs)
+{
+    ProtocolProber prober;
+    QSignalSpy spy(&prober, &ProtocolProber::finished);
+    QElapsedTimer timer;
+    timer.start();
+    prober.start(targets, timeoutMs);
+    if (!spy.wait(timeoutMs + 2000)) {
+        return QHash<int, ProtocolProber::Outcome>();
+    }
+    if (elapsedMs) {
+        *elapsedMs = timer.elapsed();
+    }
+    return prober.outcomes();
+}
+
+QTEST_MAIN(ProtocolProber_test)
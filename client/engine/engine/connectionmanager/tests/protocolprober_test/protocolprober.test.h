@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QTcpServer>
+#include <QUdpSocket>
+
+#include "engine/connectionmanager/connsettingspolicy/protocolprober.h"
+
+// TLS on top of QTcpServer, the stunnel and wstunnel servers of SimulatedNode
+class TlsServer : public QTcpServer
+{
+public:
+    enum Mode { kTls, kWebSocket, kWebSocketBlockPage, kResetAfterHello };
+
+    explicit TlsServer(Mode mode);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    Mode mode_;
+};
+
+// A node on 127.0.0.1 with a server for each transport the prober checks. A blocked transport behaves like the usual
+// middleboxes: a closed port, a reset after the TLS ClientHello, a block page instead of the WebSocket upgrade, or UDP
+// that disappears.
+class SimulatedNode
+{
+public:
+    enum Block { kOpen, kClosed, kReset, kBlockPage, kDrop };
+
+    // the protocols not in blocks are open
+    explicit SimulatedNode(const QHash<int, Block> &blocks = QHash<int, Block>());
+    ~SimulatedNode();
+
+    // all six protocols, in the order of the port map
+    QVector<ProtocolProber::Target> targets() const;
+
+private:
+    QHash<int, Block> blocks_;
+    QTcpServer tcpServer_;
+    TlsServer *stunnelServer_;
+    TlsServer *webSocketServer_;
+    QUdpSocket ikeSocket_;
+    QUdpSocket openVpnSocket_;
+    QHash<int, uint> ports_;
+
+    Block block(types::Protocol protocol) const;
+    // binds and closes a port, so that nothing listens on it
+    static uint closedPort(bool isUdp);
+    static void reply(QUdpSocket *socket, bool isIke);
+};
+
+class ProtocolProber_test : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanup();
+
+    void testProbe_data();
+    void testProbe();
+    void testRestrictiveNetwork();
+    void testOrderByLatency();
+    void testConnectionHistory();
+    void testPersistence();
+
+private:
+    QHash<int, ProtocolProber::Outcome> probe(const QVector<ProtocolProber::Target> &targets, int timeoutMs, qint64 *elapsedMs = nullptr);
+};
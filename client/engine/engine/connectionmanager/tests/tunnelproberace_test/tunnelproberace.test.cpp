@@ -0,0 +1,188 @@
+#include "tunnelproberace.test.h"
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QSignalSpy>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include "utils/utils.h"
+
+FakeApiServer::FakeApiServer(const QString &ipAddress, int delayMs, int lossPercent, quint32 seed) :
+    ipAddress_(ipAddress), delayMs_(delayMs), lossPercent_(lossPercent), random_(seed)
+{
+    listen(QHostAddress::LocalHost);
+}
+
+QString FakeApiServer::url() const
+{
+    return QString("http://127.0.0.1:%1/").arg(serverPort());
+}
+
+void FakeApiServer::incomingConnection(qintptr socketDescriptor)
+{
+    QTcpSocket *socket = new QTcpSocket(this);
+    socket->setSocketDescriptor(socketDescriptor);
+    connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+    QByteArray *request = new QByteArray;
+    connect(socket, &QTcpSocket::destroyed, [request]() { delete request; });
+    connect(socket, &QTcpSocket::readyRead, socket, [this, socket, request]() {
+        request->append(socket->readAll());
+        if (!request->contains("\r\n\r\n")) {
+            return;
+        }
+        request->clear();
+        requests++;
+        if (loseFirst > 0 || (int)random_.bounded(100) < lossPercent_) {
+            // never answered, the client times out
+            if (loseFirst > 0) {
+                loseFirst--;
+            }
+            return;
+        }
+        QPointer<QTcpSocket> guard(socket);
+        QTimer::singleShot(delayMs_, this, [this, guard]() {
+            if (!guard || guard->state() != QAbstractSocket::ConnectedState) {
+                return;
+            }
+            const QByteArray body = ipAddress_.toLatin1();
+            guard->write("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nConnection: close\r\nContent-Length: " +
+                         QByteArray::number(body.size()) + "\r\n\r\n" + body);
+            guard->disconnectFromHost();
+            answered++;
+        });
+    });
+}
+
+void TunnelProbeRace_test::initTestCase()
+{
+    QVERIFY(wsnet::WSNet::initialize(Utils::getPlatformNameSafe().toStdString(), "2.0.0", false, ""));
+}
+
+void TunnelProbeRace_test::cleanupTestCase()
+{
+    wsnet::WSNet::cleanup();
+}
+
+void TunnelProbeRace_test::testFirstSuccessWins()
+{
+    FakeApiServer lost("10.0.0.1", 0, 100);
+    FakeApiServer slow("10.0.0.2", 200, 0);
+    TunnelProbeRace race(nullptr);
+
+    const Result result = run(race, { httpProbe("lost", lost), httpProbe("slow", slow) }, { 3000, 3000 });
+    QVERIFY(result.isFinished);
+    QVERIFY(result.success);
+    QCOMPARE(result.ipAddress, QString("10.0.0.2"));
+    QCOMPARE(race.winner(), QString("slow"));
+    // long before the lost request times out
+    QVERIFY2(result.elapsedMs < 2000, qPrintable(QString::number(result.elapsedMs)));
+    QVERIFY(race.firstPacketMs() >= 200 && race.firstPacketMs() <= result.elapsedMs);
+    QVERIFY(!race.isRunning());
+}
+
+void TunnelProbeRace_test::testRetryAfterLoss()
+{
+    FakeApiServer server("10.0.0.3", 0, 0);
+    server.loseFirst = 2;
+    TunnelProbeRace race(nullptr);
+
+    const Result result = run(race, { httpProbe("checkip", server) }, { 200, 400, 800 });
+    QVERIFY(result.success);
+    QCOMPARE(result.ipAddress, QString("10.0.0.3"));
+    QCOMPARE(server.requests, 3);
+    QCOMPARE(race.requestCount(), 3);
+    // the timeouts grow with the attempts
+    QVERIFY2(result.elapsedMs >= 550, qPrintable(QString::number(result.elapsedMs)));
+}
+
+void TunnelProbeRace_test::testAllLost()
+{
+    FakeApiServer a("10.0.0.4", 0, 100);
+    FakeApiServer b("10.0.0.5", 0, 100);
+    TunnelProbeRace race(nullptr);
+
+    const Result result = run(race, { httpProbe("a", a), httpProbe("b", b) }, { 200, 300 });
+    QVERIFY(result.isFinished);
+    QVERIFY(!result.success);
+    QVERIFY(result.ipAddress.isEmpty());
+    QCOMPARE(race.firstPacketMs(), qint64(-1));
+    QVERIFY2(result.elapsedMs >= 450 && result.elapsedMs < 3000, qPrintable(QString::number(result.elapsedMs)));
+    QVERIFY(a.requests >= 2 && b.requests >= 2);
+}
+
+void TunnelProbeRace_test::testStop()
+{
+    FakeApiServer server("10.0.0.7", 300, 0);
+    TunnelProbeRace race(nullptr);
+    QSignalSpy finishedSpy(&race, &TunnelProbeRace::finished);
+
+    race.start({ httpProbe("checkip", server) }, { 2000 });
+    QTest::qWait(100);
+    race.stop();
+    QVERIFY(!race.isRunning());
+    QTest::qWait(600);
+    QCOMPARE(finishedSpy.count(), 0);
+
+    // a new race isn't confused by the old one
+    const Result result = run(race, { httpProbe("checkip", server) }, { 2000 });
+    QVERIFY(result.success);
+    QCOMPARE(finishedSpy.count(), 1);
+}
+
+void TunnelProbeRace_test::testRaceVsSingleProbe()
+{
+    // tunnels that lose 30% of the requests and add 50 ms
+    const int kRuns = 20;
+    const QVector<uint> timeouts = { 300, 600, 1200 };
+    FakeApiServer a("10.0.1.1", 50, 30, 11);
+    FakeApiServer b("10.0.1.2", 50, 30, 22);
+    FakeApiServer c("10.0.1.3", 50, 30, 33);
+
+    qint64 singleTotalMs = 0;
+    int singleSuccesses = 0;
+    qint64 raceTotalMs = 0;
+    qint64 raceMaxMs = 0;
+    for (int i = 0; i < kRuns; ++i) {
+        TunnelProbeRace single(nullptr);
+        const Result singleResult = run(single, { httpProbe("a", a) }, timeouts);
+        QVERIFY(singleResult.isFinished);
+        singleTotalMs += singleResult.elapsedMs;
+        singleSuccesses += singleResult.success ? 1 : 0;
+
+        TunnelProbeRace race(nullptr);
+        const Result raceResult = run(race, { httpProbe("a", a), httpProbe("b", b), httpProbe("c", c) }, timeouts);
+        QVERIFY(raceResult.success);
+        raceTotalMs += raceResult.elapsedMs;
+        raceMaxMs = qMax(raceMaxMs, raceResult.elapsedMs);
+    }
+
+    qInfo() << "Single probe: mean" << singleTotalMs / kRuns << "ms," << singleSuccesses << "of" << kRuns << "succeeded";
+    qInfo() << "Race of 3 probes: mean" << raceTotalMs / kRuns << "ms, max" << raceMaxMs << "ms";
+}
+
+TunnelProbeRace::Probe TunnelProbeRace_test::httpProbe(const QString &name, const FakeApiServer &server)
+{
+    return { TunnelProbeRace::Probe::kHttp, name, server.url() };
+}
+
+TunnelProbeRace_test::Result TunnelProbeRace_test::run(TunnelProbeRace &race, const QVector<TunnelProbeRace::Probe> &probes,
+                                                       const QVector<uint> &timeouts, int waitMs)
+{
+    Result result;
+    QElapsedTimer timer;
+    const QMetaObject::Connection connection = QObject::connect(&race, &TunnelProbeRace::finished,
+        [&result, &timer](bool success, const QString &ipAddress) {
+        result.isFinished = true;
+        result.success = success;
+        result.ipAddress = ipAddress;
+        result.elapsedMs = timer.elapsed();
+    });
+    timer.start();
+    race.start(probes, timeouts);
+    QTest::qWaitFor([&result]() { return result.isFinished; }, waitMs);
+    QObject::disconnect(connection);
+    return result;
+}
+
+QTEST_MAIN(TunnelProbeRace_test)
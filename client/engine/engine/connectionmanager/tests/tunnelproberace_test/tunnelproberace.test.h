@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QObject>
+#include <QRandomGenerator>
+#include <QTcpServer>
+
+#include "engine/connectionmanager/tunnelproberace.h"
+
+// A tunnel test endpoint on 127.0.0.1 that answers with an IP address after a delay. A lost request gets no answer at
+// all, as when the packets are lost in a tunnel that isn't up yet.
+class FakeApiServer : public QTcpServer
+{
+public:
+    FakeApiServer(const QString &ipAddress, int delayMs, int lossPercent, quint32 seed = 1);
+
+    QString url() const;
+
+    // the first requests that are lost whatever lossPercent is
+    int loseFirst = 0;
+    int requests = 0;
+    int answered = 0;
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    QString ipAddress_;
+    int delayMs_;
+    int lossPercent_;
+    QRandomGenerator random_;
+};
+
+class TunnelProbeRace_test : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testFirstSuccessWins();
+    void testRetryAfterLoss();
+    void testAllLost();
+    void testStop();
+    void testRaceVsSingleProbe();
+
+private:
+    struct Result
+    {
+        bool isFinished = false;
+        bool success = false;
+        QString ipAddress;
+        qint64 elapsedMs = -1;
+    };
+
+    static TunnelProbeRace::Probe httpProbe(const QString &name, const FakeApiServer &server);
+    static Result run(TunnelProbeRace &race, const QVector<TunnelProbeRace::Probe> &probes, const QVector<uint> &timeouts,
+                      int waitMs = 10000);
+};
@@ -10,6 +10,8 @@ using namespace wsnet;
 TestVPNTunnel::TestVPNTunnel(QObject *parent) : QObject(parent),
     bRunning_(false), curTest_(1), cmdId_(0), doCustomTunnelTest_(false)
 {
+    race_ = new TunnelProbeRace(this);
+    connect(race_, &TunnelProbeRace::finished, this, &TestVPNTunnel::onRaceFinished);
 }
 
 TestVPNTunnel::~TestVPNTunnel()
@@ -91,6 +93,23 @@ void TestVPNTunnel::startTestImpl()
         qCDebug(LOG_CONNECTION) << "Running custom tunnel test with" << attempts << "attempts, timeout of" << timeout << "ms, and retry delay of" << testRetryDelay_ << "ms";
     }
 
+    if (!doCustomTunnelTest_) {
+        // the probes go to the host the server API would send the ping test to, which wsnet knows
+        bRunning_ = true;
+        elapsedOverallTimer_.start();
+        cmdId_++;
+        const quint64 cmdId = cmdId_;
+        WS_ASSERT(curRequest_ == nullptr);
+        curRequest_ = WSNet::instance()->serverAPI()->tunnelTestHostname([this, cmdId](const std::string &hostname)
+        {
+            // put in message loop
+            QMetaObject::invokeMethod(this, [this, cmdId, hostname]() {
+                startRace(cmdId, QString::fromStdString(hostname));
+            });
+        });
+        return;
+    }
+
     // start first test
     qCDebug(LOG_CONNECTION) << "Doing tunnel test 1";
     bRunning_ = true;
@@ -106,6 +125,8 @@ void TestVPNTunnel::startTestImpl()
 
 void TestVPNTunnel::stopTests()
 {
+    // also while the race waits for the IP after it was won
+    race_->stop();
     if (bRunning_) {
         bRunning_ = false;
         if (curRequest_) {
@@ -116,6 +137,23 @@ void TestVPNTunnel::stopTests()
     }
 }
 
+void TestVPNTunnel::startRace(quint64 cmdId, const QString &checkIpHost)
+{
+    if (!bRunning_ || cmdId != cmdId_) {
+        return;
+    }
+    curRequest_.reset();
+
+    // the probes get the same time in total as the tests one after another did
+    const QVector<TunnelProbeRace::Probe> probes = raceProbes(checkIpHost);
+    QStringList names;
+    for (const TunnelProbeRace::Probe &probe : probes) {
+        names << probe.name;
+    }
+    qCDebug(LOG_CONNECTION) << "Racing tunnel test probes:" << names.join(", ") << "to" << checkIpHost;
+    race_->start(probes, timeouts_);
+}
+
 void TestVPNTunnel::onPingTestAnswer(wsnet::ServerApiRetCode serverApiRetCode, const std::string &ipAddress)
 {
     WS_ASSERT(curRequest_ != nullptr);
@@ -183,12 +221,38 @@ void TestVPNTunnel::doNextPingTest()
 }
 
 
+void TestVPNTunnel::onRaceFinished(bool success, const QString &ipAddress)
+{
+    bRunning_ = false;
+    if (success) {
+        qCDebug(LOG_CONNECTION) << "Tunnel test successfully finished with IP:" << ipAddress << ", first answer from" << race_->winner()
+                                << "after" << race_->firstPacketMs() << "ms, total test time =" << elapsedOverallTimer_.elapsed()
+                                << ", requests =" << race_->requestCount();
+    } else {
+        qCDebug(LOG_CONNECTION) << "Tunnel test failed, total test time =" << elapsedOverallTimer_.elapsed() << ", requests =" << race_->requestCount();
+    }
+    emit testsFinished(success, ipAddress);
+}
+
 void TestVPNTunnel::onTestsSkipped()
 {
     qCDebug(LOG_CONNECTION) << "Tunnel tests disabled";
     emit testsFinished(true, "");
 }
 
+QVector<TunnelProbeRace::Probe> TestVPNTunnel::raceProbes(const QString &checkIpHost) const
+{
+    // the tunnel test endpoint via the server API and the same endpoint on a connection of its own; only the first one
+    // if there is no host to reach the endpoint by name
+    QVector<TunnelProbeRace::Probe> probes;
+    probes << TunnelProbeRace::Probe { TunnelProbeRace::Probe::kServerApi, "api", QString() };
+    if (checkIpHost.isEmpty()) {
+        return probes;
+    }
+    probes << TunnelProbeRace::Probe { TunnelProbeRace::Probe::kHttp, "checkip", "https://" + checkIpHost };
+    return probes;
+}
+
 std::shared_ptr<WSNetCancelableCallback> TestVPNTunnel::callPingTest(std::uint32_t timeoutMs)
 {
     auto request = WSNet::instance()->serverAPI()->pingTest(timeoutMs, [this](wsnet::ServerApiRetCode serverApiRetCode, const std::string &ipAddress)
@@ -6,9 +6,12 @@
 #include <QTime>
 #include <QVector>
 #include <wsnet/WSNet.h>
+#include "tunnelproberace.h"
 #include "types/protocol.h"
 
 // do set of tests after VPN tunnel is established
+// By default the tests race several probes through the tunnel (see TunnelProbeRace). With the tunnel test
+// settings of the extra config they are the requests one after another, as set there.
 class TestVPNTunnel : public QObject
 {
     Q_OBJECT
@@ -28,6 +31,8 @@ private slots:
     void doNextPingTest();
     void startTestImpl();
     void onTestsSkipped();
+    void onRaceFinished(bool success, const QString &ipAddress);
+    void startRace(quint64 cmdId, const QString &checkIpHost);
 
 private:
     bool bRunning_;
@@ -42,8 +47,11 @@ private:
     QVector<uint> timeouts_;
 
     types::Protocol protocol_;
+    TunnelProbeRace *race_;
 
     std::shared_ptr<wsnet::WSNetCancelableCallback> curRequest_;
 
     std::shared_ptr<wsnet::WSNetCancelableCallback> callPingTest(std::uint32_t timeoutMs);
+    // checkIpHost is empty if the tunnel test endpoint can be reached through the server API only
+    QVector<TunnelProbeRace::Probe> raceProbes(const QString &checkIpHost) const;
 };
@@ -0,0 +1,150 @@
+#include "tunnelproberace.h"
+#include "utils/ipvalidation.h"
+#include "utils/logger.h"
+#include "utils/spantracer.h"
+#include "utils/ws_assert.h"
+
+using namespace wsnet;
+
+TunnelProbeRace::TunnelProbeRace(QObject *parent) : QObject(parent),
+    generation_(0), requestId_(0), isRunning_(false), startNs_(0), firstPacketNs_(-1),
+    requestCount_(0)
+{
+    deadlineTimer_.setSingleShot(true);
+    connect(&deadlineTimer_, &QTimer::timeout, this, &TunnelProbeRace::onDeadline);
+}
+
+TunnelProbeRace::~TunnelProbeRace()
+{
+    cancelRequests();
+}
+
+void TunnelProbeRace::start(const QVector<Probe> &probes, const QVector<uint> &timeouts)
+{
+    WS_ASSERT(!probes.isEmpty() && !timeouts.isEmpty());
+    stop();
+
+    generation_++;
+    lanes_.clear();
+    for (const Probe &probe : probes) {
+        Lane lane;
+        lane.probe = probe;
+        lanes_ << lane;
+    }
+    timeouts_ = timeouts;
+    isRunning_ = true;
+    startNs_ = SpanTracer::nowNs();
+    firstPacketNs_ = -1;
+    winner_.clear();
+    requestCount_ = 0;
+
+    uint totalMs = 0;
+    for (uint timeout : timeouts_) {
+        totalMs += timeout;
+    }
+    deadlineTimer_.start(totalMs);
+
+    for (int i = 0; i < lanes_.size(); ++i) {
+        startProbe(i);
+    }
+}
+
+void TunnelProbeRace::stop()
+{
+    cancelRequests();
+    deadlineTimer_.stop();
+    isRunning_ = false;
+    generation_++;
+}
+
+qint64 TunnelProbeRace::firstPacketMs() const
+{
+    return firstPacketNs_ < 0 ? -1 : (firstPacketNs_ - startNs_) / 1000000;
+}
+
+void TunnelProbeRace::startProbe(int index)
+{
+    Lane &lane = lanes_[index];
+    WS_ASSERT(lane.request == nullptr);
+
+    // a request doesn't outlast the race
+    qint64 timeout = timeouts_[qMin(lane.attempt, (int)timeouts_.size() - 1)];
+    timeout = qBound<qint64>(1, qMin<qint64>(timeout, deadlineTimer_.remainingTime()), 65535);
+
+    const quint64 generation = generation_;
+    lane.requestStartNs = SpanTracer::nowNs();
+    requestCount_++;
+
+    if (lane.probe.type == Probe::kServerApi) {
+        lane.request = WSNet::instance()->serverAPI()->pingTest(timeout, [this, generation, index](ServerApiRetCode serverApiRetCode, const std::string &data)
+        {
+            const QString ipAddress = QString::fromStdString(data).trimmed();
+            const bool success = serverApiRetCode == ServerApiRetCode::kSuccess && IpValidation::isIp(ipAddress);
+            QMetaObject::invokeMethod(this, [this, generation, index, success, ipAddress]() {
+                onProbeResult(generation, index, success, success ? ipAddress : QString());
+            });
+        });
+    } else {
+        auto request = WSNet::instance()->httpNetworkManager()->createGetRequest(lane.probe.target.toStdString(), timeout);
+        // resolved through the tunnel as well
+        request->setUseDnsCache(false);
+        lane.request = WSNet::instance()->httpNetworkManager()->executeRequest(request, ++requestId_,
+            [this, generation, index](std::uint64_t requestId, std::uint32_t elapsedMs, NetworkError errCode, const std::string &data)
+        {
+            Q_UNUSED(requestId);
+            Q_UNUSED(elapsedMs);
+            const QString ipAddress = QString::fromStdString(data).trimmed();
+            const bool success = errCode == NetworkError::kSuccess && IpValidation::isIp(ipAddress);
+            QMetaObject::invokeMethod(this, [this, generation, index, success, ipAddress]() {
+                onProbeResult(generation, index, success, success ? ipAddress : QString());
+            });
+        });
+    }
+}
+
+void TunnelProbeRace::onProbeResult(quint64 generation, int index, bool success, const QString &ipAddress)
+{
+    if (generation != generation_) {
+        return;
+    }
+
+    Lane &lane = lanes_[index];
+    lane.request.reset();
+    const qint64 nowNs = SpanTracer::nowNs();
+    SpanTracer::instance().addSpan("tunnel test", lane.probe.name, success ? "answered" : "failed", lane.requestStartNs, nowNs);
+
+    if (success) {
+        firstPacketNs_ = nowNs;
+        winner_ = lane.probe.name;
+        SpanTracer::instance().addSpan("connection", "tunnel first packet", winner_, startNs_, nowNs);
+        stop();
+        emit finished(true, ipAddress);
+        return;
+    }
+
+    if (isRunning_) {
+        const int delayMs = qMin(RETRY_DELAY_MS << qMin(lane.attempt, 5), MAX_RETRY_DELAY_MS);
+        lane.attempt++;
+        QTimer::singleShot(delayMs, this, [this, generation, index]() {
+            if (generation == generation_) {
+                startProbe(index);
+            }
+        });
+    }
+}
+
+void TunnelProbeRace::onDeadline()
+{
+    stop();
+    emit finished(false, QString());
+}
+
+void TunnelProbeRace::cancelRequests()
+{
+    for (Lane &lane : lanes_) {
+        if (lane.request) {
+            lane.request->cancel();
+            lane.request.reset();
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+#include <wsnet/WSNet.h>
+
+// Verifies a tunnel by racing probes through it: requests to tunnel test endpoints, which answer with the external IP.
+// Each probe is repeated until it succeeds or the time is up, and the first success wins. There is no DNS probe: the
+// answer may come from a local cache such as systemd-resolved while the tunnel is down.
+class TunnelProbeRace : public QObject
+{
+    Q_OBJECT
+public:
+    struct Probe
+    {
+        enum Type { kServerApi, kHttp };
+
+        Type type;
+        QString name;
+        // the URL of kHttp
+        QString target;
+    };
+
+    explicit TunnelProbeRace(QObject *parent);
+    ~TunnelProbeRace();
+
+    // timeouts of the consecutive requests of a probe, the last one repeats; the race is lost after their sum
+    void start(const QVector<Probe> &probes, const QVector<uint> &timeouts);
+    void stop();
+    bool isRunning() const { return isRunning_; }
+
+    // of the last race: from its start to the first answer through the tunnel, -1 if there was none
+    qint64 firstPacketMs() const;
+    // the probe that got the first answer
+    QString winner() const { return winner_; }
+    int requestCount() const { return requestCount_; }
+
+signals:
+    void finished(bool success, const QString &ipAddress);
+
+private:
+    // the delay before a probe is repeated doubles with each attempt up to the max, so that an endpoint that fails
+    // fast isn't flooded with requests
+    static constexpr int RETRY_DELAY_MS = 100;
+    static constexpr int MAX_RETRY_DELAY_MS = 2000;
+
+    struct Lane
+    {
+        Probe probe;
+        int attempt = 0;
+        qint64 requestStartNs = 0;
+        std::shared_ptr<wsnet::WSNetCancelableCallback> request;
+    };
+
+    QVector<Lane> lanes_;
+    QVector<uint> timeouts_;
+    QTimer deadlineTimer_;
+    // the callbacks of an earlier race are ignored
+    quint64 generation_;
+    quint64 requestId_;
+    bool isRunning_;
+    qint64 startNs_;
+    qint64 firstPacketNs_;
+    QString winner_;
+    int requestCount_;
+
+    void startProbe(int index);
+    void onProbeResult(quint64 generation, int index, bool success, const QString &ipAddress);
+    void onDeadline();
+    void cancelRequests();
+};
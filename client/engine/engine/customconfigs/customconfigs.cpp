@@ -1,16 +1,30 @@
 #include "customconfigs.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
 #include <QDir>
+#include <QSaveFile>
+#include <QStandardPaths>
 #include "utils/logger.h"
+#include "version/appversion.h"
 #include "parseovpnconfigline.h"
 #include "ovpncustomconfig.h"
 #include "wireguardcustomconfig.h"
 
 namespace customconfigs {
 
-CustomConfigs::CustomConfigs(QObject *parent) : QObject(parent), dirWatcher_(NULL)
+CustomConfigs::CustomConfigs(QObject *parent) : QObject(parent), dirWatcher_(NULL), generation_(0), pendingParses_(0),
+    isCacheChanged_(false)
 {
 }
 
+CustomConfigs::~CustomConfigs()
+{
+    // the parsing that is running posts its result to this object
+    threadPool_.clear();
+    threadPool_.waitForDone();
+}
+
 void CustomConfigs::changeDir(const QString &path)
 {
     if (dirWatcher_)
@@ -24,13 +38,21 @@ void CustomConfigs::changeDir(const QString &path)
     }
     else if (path.isEmpty())
     {
+        QFile::remove(cachePath());
         return;
     }
 
+    cache_.clear();
     if (!path.isEmpty())
     {
         dirWatcher_ = new CustomConfigsDirWatcher(this, path);
         connect(dirWatcher_, &CustomConfigsDirWatcher::dirChanged, this, &CustomConfigs::onDirectoryChanged);
+        loadCache();
+    }
+    else
+    {
+        // custom configs are turned off, the cache would only keep the paths and hosts of the old ones
+        QFile::remove(cachePath());
     }
     parseDir();
     emit changed();
@@ -44,27 +66,146 @@ QVector<QSharedPointer<const ICustomConfig> > CustomConfigs::getConfigs()
 void CustomConfigs::onDirectoryChanged()
 {
     qDebug(LOG_CUSTOM_OVPN) << "custom_configs directory is changed";
-    parseDir();
-    emit changed();
+    if (parseDir())
+    {
+        emit changed();
+    }
 }
 
-void CustomConfigs::parseDir()
+bool CustomConfigs::parseDir()
 {
-    configs_.clear();
+    // the results of the previous parsing are of no use anymore
+    generation_++;
+    pendingParses_ = 0;
 
     if (!dirWatcher_)
+    {
+        files_.clear();
+        cache_.clear();
+        return updateConfigs();
+    }
+
+    files_ = dirWatcher_->curFiles();
+    QHash<QString, CachedConfig> cache;
+    for (const QString &filename : qAsConst(files_))
+    {
+        const QString filepath = dirWatcher_->curDir() + "/" + filename;
+        const QFileInfo fi(filepath);
+        const auto it = cache_.constFind(filename);
+        QByteArray prevHash;
+        if (it != cache_.constEnd())
+        {
+            // the previous config is shown until the file is parsed again
+            cache.insert(filename, it.value());
+            if (it->size == fi.size() && it->modifiedMs == fi.lastModified().toMSecsSinceEpoch())
+            {
+                continue;
+            }
+            prevHash = it->hash;
+        }
+
+        pendingParses_++;
+        const quint64 generation = generation_;
+        threadPool_.start([this, generation, filename, filepath, prevHash]() {
+            const CachedConfig parsed = parseFile(filepath, prevHash);
+            QMetaObject::invokeMethod(this, [this, generation, filename, parsed]() {
+                onFileParsed(generation, filename, parsed);
+            });
+        });
+    }
+    if (cache.size() != cache_.size())
+    {
+        isCacheChanged_ = true;
+    }
+    cache_ = cache;
+
+    qDebug(LOG_CUSTOM_OVPN) << "Custom configs:" << files_.size() << "files," << pendingParses_ << "to parse";
+    const bool isChanged = updateConfigs();
+    if (pendingParses_ == 0)
+    {
+        saveCache();
+    }
+    return isChanged;
+}
+
+void CustomConfigs::onFileParsed(quint64 generation, const QString &filename, const CachedConfig &parsed)
+{
+    if (generation != generation_)
+    {
         return;
+    }
+
+    auto it = cache_.find(filename);
+    if (parsed.config.isNull() && it != cache_.end())
+    {
+        // touched, but the content is the same
+        it->size = parsed.size;
+        it->modifiedMs = parsed.modifiedMs;
+    }
+    else
+    {
+        cache_[filename] = parsed;
+    }
+    isCacheChanged_ = true;
+
+    pendingParses_--;
+    if (pendingParses_ == 0)
+    {
+        if (updateConfigs())
+        {
+            emit changed();
+        }
+        saveCache();
+    }
+}
 
-    QStringList fileList = dirWatcher_->curFiles();
-    for (const QString &filename : fileList)
+bool CustomConfigs::updateConfigs()
+{
+    QVector<QSharedPointer<const ICustomConfig>> configs;
+    for (const QString &filename : qAsConst(files_))
     {
-        QString filepath = dirWatcher_->curDir() + "/" + filename;
-        QSharedPointer<const ICustomConfig> config = makeCustomConfigFromFile(filepath);
-        if (!config.isNull())
+        const auto it = cache_.constFind(filename);
+        if (it != cache_.constEnd() && !it->config.isNull())
         {
-            configs_ << config;
+            configs << it->config;
         }
     }
+
+    if (configs == configs_)
+    {
+        return false;
+    }
+    configs_ = configs;
+    return true;
+}
+
+// runs on the thread pool
+CustomConfigs::CachedConfig CustomConfigs::parseFile(const QString &filepath, const QByteArray &prevHash)
+{
+    CachedConfig parsed;
+    // before the content, so that a change in between is seen the next time
+    const QFileInfo fi(filepath);
+    parsed.size = fi.size();
+    parsed.modifiedMs = fi.lastModified().toMSecsSinceEpoch();
+    // a file written again within the resolution of the modification time could look the same, so such a recent one
+    // is checked by the hash the next time too
+    if (parsed.modifiedMs > QDateTime::currentMSecsSinceEpoch() - RACY_MODIFICATION_MS)
+    {
+        parsed.modifiedMs = -1;
+    }
+
+    QFile file(filepath);
+    if (file.open(QIODevice::ReadOnly))
+    {
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        hash.addData(&file);
+        parsed.hash = hash.result();
+    }
+    if (parsed.hash.isEmpty() || parsed.hash != prevHash)
+    {
+        parsed.config = makeCustomConfigFromFile(filepath);
+    }
+    return parsed;
 }
 
 QSharedPointer<const ICustomConfig> CustomConfigs::makeCustomConfigFromFile(const QString &filepath)
@@ -83,4 +224,113 @@ QSharedPointer<const ICustomConfig> CustomConfigs::makeCustomConfigFromFile(cons
     return NULL;
 }
 
+QString CustomConfigs::cachePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/custom_configs_cache";
+}
+
+void CustomConfigs::loadCache()
+{
+    QFile file(cachePath());
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        return;
+    }
+    QDataStream ds(&file);
+    quint32 magic, version;
+    ds >> magic >> version;
+    if (magic != magic_ || version != versionForSerialization_)
+    {
+        return;
+    }
+    // the parsers of another version may give other results
+    QString appVersion, dir;
+    ds >> appVersion >> dir;
+    if (appVersion != AppVersion::instance().fullVersionString() || dir != dirWatcher_->curDir())
+    {
+        return;
+    }
+
+    quint32 count;
+    ds >> count;
+    for (quint32 i = 0; i < count && ds.status() == QDataStream::Ok; ++i)
+    {
+        QString filename;
+        CachedConfig cached;
+        bool hasConfig;
+        ds >> filename >> cached.size >> cached.modifiedMs >> cached.hash >> hasConfig;
+        if (hasConfig)
+        {
+            int type;
+            ds >> type;
+            if (type == CUSTOM_CONFIG_OPENVPN)
+            {
+                OvpnCustomConfig *config = new OvpnCustomConfig();
+                ds >> *config;
+                cached.config.reset(config);
+            }
+            else if (type == CUSTOM_CONFIG_WIREGUARD)
+            {
+                WireguardCustomConfig *config = new WireguardCustomConfig();
+                ds >> *config;
+                cached.config.reset(config);
+            }
+            else
+            {
+                ds.setStatus(QDataStream::ReadCorruptData);
+            }
+        }
+        cache_.insert(filename, cached);
+    }
+
+    if (ds.status() != QDataStream::Ok)
+    {
+        qDebug(LOG_CUSTOM_OVPN) << "The custom configs cache is corrupted";
+        cache_.clear();
+        return;
+    }
+    qDebug(LOG_CUSTOM_OVPN) << "Loaded" << cache_.size() << "custom configs from the cache";
+    isCacheChanged_ = false;
+}
+
+void CustomConfigs::saveCache()
+{
+    if (!isCacheChanged_ || !dirWatcher_)
+    {
+        return;
+    }
+    isCacheChanged_ = false;
+
+    QByteArray arr;
+    {
+        QDataStream ds(&arr, QIODevice::WriteOnly);
+        ds << magic_ << versionForSerialization_;
+        ds << AppVersion::instance().fullVersionString() << dirWatcher_->curDir();
+        ds << (quint32)cache_.size();
+        for (auto it = cache_.constBegin(); it != cache_.constEnd(); ++it)
+        {
+            ds << it.key() << it->size << it->modifiedMs << it->hash << !it->config.isNull();
+            if (it->config.isNull())
+            {
+                continue;
+            }
+            ds << (int)it->config->type();
+            if (it->config->type() == CUSTOM_CONFIG_OPENVPN)
+            {
+                ds << *static_cast<const OvpnCustomConfig *>(it->config.data());
+            }
+            else
+            {
+                ds << *static_cast<const WireguardCustomConfig *>(it->config.data());
+            }
+        }
+    }
+
+    QSaveFile file(cachePath());
+    if (!file.open(QIODevice::WriteOnly) || file.write(arr) < 0 || !file.commit())
+    {
+        qDebug(LOG_CUSTOM_OVPN) << "Failed to save the custom configs cache";
+    }
+}
+
 } //namespace customconfigs
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <QHash>
 #include <QObject>
 #include <QSharedPointer>
+#include <QThreadPool>
 #include <QVector>
 #include "icustomconfig.h"
 #include "customconfigsdirwatcher.h"
@@ -9,11 +11,15 @@
 namespace customconfigs {
 
 // parse custom configs directory, make ovpn configs location
+// Only the files whose size, modification time and then content hash changed are parsed again, on a thread pool. The
+// parsed configs are kept in a cache file, so that a restart doesn't parse the directory again. The cache has no keys,
+// those are read from the config file when connecting.
 class CustomConfigs : public QObject
 {
     Q_OBJECT
 public:
     explicit CustomConfigs(QObject *parent);
+    ~CustomConfigs();
 
     void changeDir(const QString &path);
     QVector<QSharedPointer<const ICustomConfig>> getConfigs();
@@ -25,12 +31,41 @@ private slots:
     void onDirectoryChanged();
 
 private:
-    void parseDir();
+    struct CachedConfig
+    {
+        qint64 size = -1;
+        qint64 modifiedMs = 0;
+        QByteArray hash;
+        QSharedPointer<const ICustomConfig> config;
+    };
 
-    QSharedPointer<const ICustomConfig> makeCustomConfigFromFile(const QString &filepath);
+    // the resolution of the modification time on FAT
+    static constexpr qint64 RACY_MODIFICATION_MS = 2000;
+    static constexpr quint32 magic_ = 0x3C8A51E7;
+    static constexpr quint32 versionForSerialization_ = 2;  // should increment the version if the data format is changed
 
     CustomConfigsDirWatcher *dirWatcher_;
     QVector<QSharedPointer<const ICustomConfig>> configs_;
+    QStringList files_;
+    // by filename, for the files of the current directory
+    QHash<QString, CachedConfig> cache_;
+    QThreadPool threadPool_;
+    // of the last parseDir(), for the results of the parsing that are still to come
+    quint64 generation_;
+    int pendingParses_;
+    bool isCacheChanged_;
+
+    // returns true if configs_ changed; the files that are still being parsed update it later and emit changed()
+    bool parseDir();
+    void onFileParsed(quint64 generation, const QString &filename, const CachedConfig &parsed);
+    bool updateConfigs();
+
+    static CachedConfig parseFile(const QString &filepath, const QByteArray &prevHash);
+    static QSharedPointer<const ICustomConfig> makeCustomConfigFromFile(const QString &filepath);
+
+    static QString cachePath();
+    void loadCache();
+    void saveCache();
 };
 
 } //namespace customconfigs
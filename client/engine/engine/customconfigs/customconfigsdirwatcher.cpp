@@ -1,6 +1,7 @@
 #include "customconfigsdirwatcher.h"
 
 #include <QDir>
+#include <QSet>
 #include <QStandardPaths>
 #include "utils/logger.h"
 
@@ -46,12 +47,6 @@ void CustomConfigsDirWatcher::onEmitTimer()
 
 void CustomConfigsDirWatcher::checkFiles(bool bWithEmitSignal, bool bFileChanged)
 {
-    // remove prev files from watch paths
-    for (const QString &filename : qAsConst(curFiles_))
-    {
-        dirWatcher_.removePath(path_ + "/" + filename);
-    }
-
     QDir dir(path_);
     QStringList filters;
     filters << "*.ovpn" << "*.conf";
@@ -67,8 +62,32 @@ void CustomConfigsDirWatcher::checkFiles(bool bWithEmitSignal, bool bFileChanged
             continue;
         }
         newFileList << filename;
+    }
 
-        dirWatcher_.addPath(path_ + "/" + filename);
+    // only the files that came or went are added to or removed from watch paths, not all of them on every change;
+    // a file replaced by an editor is no longer watched, so it's added again too
+    const QStringList watchedFileList = dirWatcher_.files();
+    const QSet<QString> watchedFiles(watchedFileList.begin(), watchedFileList.end());
+    const QSet<QString> newFiles(newFileList.begin(), newFileList.end());
+    for (const QString &filename : qAsConst(curFiles_))
+    {
+        if (!newFiles.contains(filename))
+        {
+            dirWatcher_.removePath(path_ + "/" + filename);
+        }
+    }
+    QStringList addedPaths;
+    for (const QString &filename : qAsConst(newFileList))
+    {
+        const QString filepath = path_ + "/" + filename;
+        if (!watchedFiles.contains(filepath))
+        {
+            addedPaths << filepath;
+        }
+    }
+    if (!addedPaths.isEmpty())
+    {
+        dirWatcher_.addPaths(addedPaths);
     }
 
     if ((!bFileChanged && newFileList != curFiles_) || bFileChanged)
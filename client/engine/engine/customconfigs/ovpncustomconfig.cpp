@@ -3,6 +3,7 @@
 #include "parseovpnconfigline.h"
 
 #include <QFileInfo>
+#include <QScopedPointer>
 
 namespace customconfigs {
 
@@ -98,7 +99,12 @@ QString OvpnCustomConfig::globalProtocol() const
 
 QString OvpnCustomConfig::getOvpnData() const
 {
-    return ovpnData_;
+    if (!isFromCache_)
+    {
+        return ovpnData_;
+    }
+    QScopedPointer<ICustomConfig> config(makeFromFile(filepath_));
+    return static_cast<const OvpnCustomConfig *>(config.data())->ovpnData_;
 }
 
 // retrieves all hostnames/IPs "remote ..." commands
@@ -239,5 +245,33 @@ void OvpnCustomConfig::process()
 #endif
 }
 
+QDataStream& operator <<(QDataStream &stream, const OvpnCustomConfig &o)
+{
+    stream << o.isCorrect_ << o.errMessage_ << o.name_ << o.nick_ << o.filename_ << o.filepath_;
+    stream << (quint32)o.remotes_.size();
+    for (const RemoteCommandLine &r : o.remotes_) {
+        stream << r.hostname << r.originalRemoteCommand << r.port << r.protocol;
+    }
+    stream << o.globalPort_ << o.globalProtocol_ << o.isAllowFirewallAfterConnection_;
+    return stream;
+}
+
+QDataStream& operator >>(QDataStream &stream, OvpnCustomConfig &o)
+{
+    stream >> o.isCorrect_ >> o.errMessage_ >> o.name_ >> o.nick_ >> o.filename_ >> o.filepath_;
+    o.ovpnData_.clear();
+    o.isFromCache_ = true;
+    quint32 remotesCount;
+    stream >> remotesCount;
+    o.remotes_.clear();
+    for (quint32 i = 0; i < remotesCount && stream.status() == QDataStream::Ok; ++i) {
+        RemoteCommandLine r;
+        stream >> r.hostname >> r.originalRemoteCommand >> r.port >> r.protocol;
+        o.remotes_ << r;
+    }
+    stream >> o.globalPort_ >> o.globalProtocol_ >> o.isAllowFirewallAfterConnection_;
+    return stream;
+}
+
 } //namespace customconfigs
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <QDataStream>
 #include <QVector>
 #include "icustomconfig.h"
 
@@ -32,8 +33,13 @@ public:
     QVector<RemoteCommandLine> remotes() const;
     uint globalPort() const;
     QString globalProtocol() const;
+    // read from the file again if the config came from the cache
     QString getOvpnData() const;
 
+    // for the cache of parsed configs, without the ovpn data: it has the keys
+    friend QDataStream& operator <<(QDataStream &stream, const OvpnCustomConfig &o);
+    friend QDataStream& operator >>(QDataStream &stream, OvpnCustomConfig &o);
+
 private:
     bool isCorrect_ = false;
     QString errMessage_;
@@ -49,6 +55,7 @@ private:
     uint globalPort_ = 0;       // 0 if not set
     QString globalProtocol_;    // empty if not set
     bool isAllowFirewallAfterConnection_ = true;
+    bool isFromCache_ = false;
 
 
     void process();
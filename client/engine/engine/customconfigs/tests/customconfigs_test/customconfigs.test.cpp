@@ -0,0 +1,298 @@
+#include "customconfigs.test.h"
+#include <QtTest>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QLoggingCategory>
+#include <QStandardPaths>
+
+#include "engine/customconfigs/customconfigs.h"
+#include "engine/customconfigs/ovpncustomconfig.h"
+#include "engine/customconfigs/wireguardcustomconfig.h"
+
+namespace {
+
+// like the certificates inlined by VPN providers
+QString inlineBlock(const QString &tag)
+{
+    QString block = "<" + tag + ">\n-----BEGIN CERTIFICATE-----\n";
+    for (int i = 0; i < 30; ++i) {
+        block += QString(64, QChar('A' + i % 26)) + "\n";
+    }
+    return block + "-----END CERTIFICATE-----\n</" + tag + ">\n";
+}
+
+const QString kPrivateKey = "aGVsbG8gd29ybGQgaGVsbG8gd29ybGQgaGVsbG8gd28=";
+
+// as QDataStream writes a string, without the size
+QByteArray serialized(const QString &str)
+{
+    QByteArray arr;
+    QDataStream ds(&arr, QIODevice::WriteOnly);
+    ds << str;
+    return arr.mid(sizeof(quint32));
+}
+
+QString filename(int index)
+{
+    // a fifth of the configs are WireGuard ones
+    return QString("server%1.%2").arg(index, 4, 10, QChar('0')).arg(index % 5 == 0 ? "conf" : "ovpn");
+}
+
+QString hostname(int index)
+{
+    return QString("node%1.example.com").arg(index);
+}
+
+void setOld(const QString &path)
+{
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.setFileTime(QDateTime::currentDateTime().addSecs(-3600), QFileDevice::FileModificationTime));
+}
+
+} // namespace
+
+StallMeter::StallMeter()
+{
+    connect(&timer_, &QTimer::timeout, [this]() {
+        maxStallMs_ = qMax(maxStallMs_, elapsed_.restart());
+    });
+    timer_.setTimerType(Qt::PreciseTimer);
+    timer_.start(1);
+    elapsed_.start();
+}
+
+void CustomConfigs_test::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QDir().mkpath(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation));
+    // the parsers log every line they take out of a config
+    QLoggingCategory::setFilterRules("*.debug=false");
+    QVERIFY(dir_.isValid());
+}
+
+void CustomConfigs_test::init()
+{
+    QDir dir(dir_.path());
+    for (const QString &file : dir.entryList(QDir::Files)) {
+        QVERIFY(dir.remove(file));
+    }
+    QFile::remove(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/custom_configs_cache");
+}
+
+void CustomConfigs_test::testParse()
+{
+    writeDir(20);
+    customconfigs::CustomConfigs customConfigs(nullptr);
+    customConfigs.changeDir(dir_.path());
+    QTRY_COMPARE(customConfigs.getConfigs().size(), 20);
+
+    const auto configs = customConfigs.getConfigs();
+    for (int i = 0; i < 20; ++i) {
+        QCOMPARE(configs[i]->filename(), filename(i));
+        QCOMPARE(configs[i]->nick(), hostname(i));
+        QVERIFY(configs[i]->isCorrect());
+    }
+    QCOMPARE(configs[0]->type(), CUSTOM_CONFIG_WIREGUARD);
+    QCOMPARE(configs[1]->type(), CUSTOM_CONFIG_OPENVPN);
+}
+
+void CustomConfigs_test::testChangeOneFile()
+{
+    writeDir(50);
+    customconfigs::CustomConfigs customConfigs(nullptr);
+    customConfigs.changeDir(dir_.path());
+    QTRY_COMPARE(customConfigs.getConfigs().size(), 50);
+    const auto before = customConfigs.getConfigs();
+
+    QSignalSpy spy(&customConfigs, &customconfigs::CustomConfigs::changed);
+    writeOvpn(dir_.filePath(filename(7)), "changed.example.com");
+    QTRY_VERIFY_WITH_TIMEOUT(spy.count() > 0 && nick(filename(7), customConfigs.getConfigs()) == "changed.example.com", 10000);
+
+    // the others weren't parsed again
+    const auto after = customConfigs.getConfigs();
+    QCOMPARE(after.size(), 50);
+    for (int i = 0; i < 50; ++i) {
+        if (i != 7) {
+            QCOMPARE(after[i], before[i]);
+        }
+    }
+    QVERIFY(after[7] != before[7]);
+}
+
+void CustomConfigs_test::testTouch()
+{
+    writeDir(10);
+    customconfigs::CustomConfigs customConfigs(nullptr);
+    customConfigs.changeDir(dir_.path());
+    QTRY_COMPARE(customConfigs.getConfigs().size(), 10);
+    const auto before = customConfigs.getConfigs();
+
+    // the same content with another modification time
+    QSignalSpy spy(&customConfigs, &customconfigs::CustomConfigs::changed);
+    {
+        QFile file(dir_.filePath(filename(3)));
+        QVERIFY(file.open(QIODevice::ReadWrite));
+        QVERIFY(file.setFileTime(QDateTime::currentDateTime().addSecs(-60), QFileDevice::FileModificationTime));
+    }
+    QTest::qWait(2500);
+    QCOMPARE(spy.count(), 0);
+    QCOMPARE(customConfigs.getConfigs(), before);
+}
+
+void CustomConfigs_test::testAddRemove()
+{
+    writeDir(10);
+    customconfigs::CustomConfigs customConfigs(nullptr);
+    customConfigs.changeDir(dir_.path());
+    QTRY_COMPARE(customConfigs.getConfigs().size(), 10);
+    const auto before = customConfigs.getConfigs();
+
+    QVERIFY(QFile::remove(dir_.filePath(filename(2))));
+    writeOvpn(dir_.filePath("added.ovpn"), "added.example.com");
+    QTRY_VERIFY_WITH_TIMEOUT(nick("added.ovpn", customConfigs.getConfigs()) == "added.example.com", 10000);
+
+    const auto after = customConfigs.getConfigs();
+    QCOMPARE(after.size(), 10);
+    QVERIFY(nick(filename(2), after).isNull());
+    QVERIFY(after.contains(before[3]));
+}
+
+void CustomConfigs_test::testCache()
+{
+    writeDir(50);
+    {
+        customconfigs::CustomConfigs customConfigs(nullptr);
+        customConfigs.changeDir(dir_.path());
+        QTRY_COMPARE(customConfigs.getConfigs().size(), 50);
+    }
+
+    // changed while the app wasn't running
+    writeOvpn(dir_.filePath(filename(11)), "changed.example.com");
+
+    // the configs are there at once, the changed one is parsed again
+    customconfigs::CustomConfigs customConfigs(nullptr);
+    customConfigs.changeDir(dir_.path());
+    QCOMPARE(customConfigs.getConfigs().size(), 50);
+    QCOMPARE(nick(filename(12), customConfigs.getConfigs()), hostname(12));
+    QTRY_COMPARE(nick(filename(11), customConfigs.getConfigs()), QString("changed.example.com"));
+
+    const auto wireGuard = customConfigs.getConfigs()[10].dynamicCast<const customconfigs::WireguardCustomConfig>();
+    QVERIFY(wireGuard);
+    QCOMPARE(wireGuard->getEndpointPort(), 51820u);
+    QVERIFY(wireGuard->isCorrect());
+    const auto ovpn = customConfigs.getConfigs()[12].dynamicCast<const customconfigs::OvpnCustomConfig>();
+    QVERIFY(ovpn);
+    QCOMPARE(ovpn->remotes().size(), 1);
+    QCOMPARE(ovpn->remotes()[0].port, 1194u);
+    QVERIFY(ovpn->getOvpnData().contains("<ca>"));
+
+    // the keys are in the config files only
+    const QString cachePath = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/custom_configs_cache";
+    QFile cache(cachePath);
+    QVERIFY(cache.open(QIODevice::ReadOnly));
+    const QByteArray cacheData = cache.readAll();
+    cache.close();
+    QCOMPARE(wireGuard->getWireGuardConfig("10.0.0.1")->clientPrivateKey(), kPrivateKey);
+    QVERIFY(!cacheData.contains(serialized(kPrivateKey)));
+    QVERIFY(!cacheData.contains(serialized(inlineBlock("key"))));
+
+    customConfigs.changeDir("");
+    QVERIFY(!QFile::exists(cachePath));
+}
+
+void CustomConfigs_test::testBenchmark()
+{
+    writeDir(kFileCount);
+
+    // what was done on every change before: all of the files parsed on the engine thread
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < kFileCount; ++i) {
+        const QString path = dir_.filePath(filename(i));
+        QScopedPointer<customconfigs::ICustomConfig> config(i % 5 == 0 ? customconfigs::WireguardCustomConfig::makeFromFile(path)
+                                                                         : customconfigs::OvpnCustomConfig::makeFromFile(path));
+        QVERIFY(config->isCorrect());
+    }
+    const qint64 fullParseMs = timer.elapsed();
+
+    qint64 coldMs, coldStallMs, changeStallMs, restartMs;
+    {
+        StallMeter stallMeter;
+        customconfigs::CustomConfigs customConfigs(nullptr);
+        timer.restart();
+        customConfigs.changeDir(dir_.path());
+        QTRY_COMPARE_WITH_TIMEOUT(customConfigs.getConfigs().size(), kFileCount, 60000);
+        coldMs = timer.elapsed();
+        coldStallMs = stallMeter.maxStallMs();
+
+        StallMeter changeStallMeter;
+        QSignalSpy spy(&customConfigs, &customconfigs::CustomConfigs::changed);
+        writeOvpn(dir_.filePath(filename(501)), "changed.example.com");
+        QTRY_VERIFY_WITH_TIMEOUT(spy.count() > 0, 10000);
+        changeStallMs = changeStallMeter.maxStallMs();
+        QCOMPARE(nick(filename(501), customConfigs.getConfigs()), QString("changed.example.com"));
+    }
+    {
+        customconfigs::CustomConfigs customConfigs(nullptr);
+        timer.restart();
+        customConfigs.changeDir(dir_.path());
+        restartMs = timer.elapsed();
+        QCOMPARE(customConfigs.getConfigs().size(), kFileCount);
+    }
+
+    qInfo() << kFileCount << "configs: parse of all on the engine thread" << fullParseMs << "ms;"
+            << "first parse" << coldMs << "ms, the engine thread stalled for at most" << coldStallMs << "ms;"
+            << "one file changed, stalled for at most" << changeStallMs << "ms;"
+            << "restart from the cache" << restartMs << "ms";
+    QVERIFY(restartMs < fullParseMs);
+    QVERIFY(changeStallMs < fullParseMs);
+}
+
+void CustomConfigs_test::writeOvpn(const QString &path, const QString &hostname)
+{
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    QString data = "client\ndev tun\nproto udp\nremote " + hostname + " 1194\nresolv-retry infinite\nnobind\n"
+                   "persist-key\npersist-tun\nremote-cert-tls server\ncipher AES-256-GCM\nauth SHA512\nverb 3\n";
+    data += inlineBlock("ca") + inlineBlock("cert") + inlineBlock("key");
+    QVERIFY(file.write(data.toUtf8()) > 0);
+}
+
+void CustomConfigs_test::writeWireGuard(const QString &path, const QString &hostname)
+{
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    const QString data = "[Interface]\nPrivateKey = " + kPrivateKey + "\nAddress = 10.64.0.2/32\n"
+                         "DNS = 10.255.255.1\n\n[Peer]\nPublicKey = d29ybGQgaGVsbG8gd29ybGQgaGVsbG8gd29ybGQgaGU=\n"
+                         "AllowedIPs = 0.0.0.0/0\nEndpoint = " + hostname + ":51820\n";
+    QVERIFY(file.write(data.toUtf8()) > 0);
+}
+
+void CustomConfigs_test::writeDir(int count)
+{
+    for (int i = 0; i < count; ++i) {
+        const QString path = dir_.filePath(filename(i));
+        if (i % 5 == 0) {
+            writeWireGuard(path, hostname(i));
+        } else {
+            writeOvpn(path, hostname(i));
+        }
+        // like a directory that was there for a while
+        setOld(path);
+    }
+}
+
+QString CustomConfigs_test::nick(const QString &filename, const QVector<QSharedPointer<const customconfigs::ICustomConfig>> &configs)
+{
+    for (const auto &config : configs) {
+        if (config->filename() == filename) {
+            return config->nick();
+        }
+    }
+    return QString();
+}
+
+QTEST_MAIN(CustomConfigs_test)
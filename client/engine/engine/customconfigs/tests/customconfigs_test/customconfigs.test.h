@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QSharedPointer>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <QVector>
+#include "engine/customconfigs/icustomconfig.h"
+
+// The longest time the event loop didn't run a 1 ms timer, i.e. how long the engine thread stalled.
+class StallMeter : public QObject
+{
+    Q_OBJECT
+public:
+    StallMeter();
+
+    qint64 maxStallMs() const { return maxStallMs_; }
+
+private:
+    QTimer timer_;
+    QElapsedTimer elapsed_;
+    qint64 maxStallMs_ = 0;
+};
+
+class CustomConfigs_test : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+
+    void testParse();
+    void testChangeOneFile();
+    void testTouch();
+    void testAddRemove();
+    void testCache();
+    void testBenchmark();
+
+private:
+    QTemporaryDir dir_;
+
+    static const int kFileCount = 1000;
+
+    static void writeOvpn(const QString &path, const QString &hostname);
+    static void writeWireGuard(const QString &path, const QString &hostname);
+    void writeDir(int count);
+    static QString nick(const QString &filename, const QVector<QSharedPointer<const customconfigs::ICustomConfig>> &configs);
+};
@@ -2,6 +2,7 @@
 #include "utils/logger.h"
 
 #include <QFileInfo>
+#include <QScopedPointer>
 #include <QSettings>
 
 namespace customconfigs {
@@ -51,6 +52,10 @@ QString WireguardCustomConfig::getErrorForIncorrect() const
 
 QSharedPointer<WireGuardConfig> WireguardCustomConfig::getWireGuardConfig(const QString &endpointIp) const
 {
+    if (isFromCache_) {
+        QScopedPointer<ICustomConfig> config(makeFromFile(filepath_));
+        return static_cast<const WireguardCustomConfig *>(config.data())->getWireGuardConfig(endpointIp);
+    }
     auto *config = new WireGuardConfig(privateKey_, ipAddress_, dnsAddress_, publicKey_,
                                        presharedKey_, endpointIp + endpointPort_, allowedIps_);
     return QSharedPointer<WireGuardConfig>(config);
@@ -63,6 +68,7 @@ ICustomConfig *WireguardCustomConfig::makeFromFile(const QString &filepath)
     QFileInfo fi(filepath);
     config->name_ = fi.completeBaseName();
     config->filename_ = fi.fileName();
+    config->filepath_ = filepath;
     config->loadFromFile(filepath);  // here the config can change to incorrect
     config->validate();
     return config;
@@ -140,5 +146,24 @@ void WireguardCustomConfig::validate()
         errMessage_ = QObject::tr("Missing \"Endpoint\" in the \"Peer\" section");
 }
 
+QDataStream& operator <<(QDataStream &stream, const WireguardCustomConfig &o)
+{
+    stream << o.errMessage_ << o.name_ << o.nick_ << o.filename_ << o.filepath_ << o.ipAddress_ << o.dnsAddress_
+           << o.publicKey_ << o.allowedIps_ << o.endpointHostname_ << o.endpointPort_
+           << o.endpointPortNumber_ << o.isAllowFirewallAfterConnection_;
+    return stream;
+}
+
+QDataStream& operator >>(QDataStream &stream, WireguardCustomConfig &o)
+{
+    stream >> o.errMessage_ >> o.name_ >> o.nick_ >> o.filename_ >> o.filepath_ >> o.ipAddress_ >> o.dnsAddress_
+           >> o.publicKey_ >> o.allowedIps_ >> o.endpointHostname_ >> o.endpointPort_
+           >> o.endpointPortNumber_ >> o.isAllowFirewallAfterConnection_;
+    o.privateKey_.clear();
+    o.presharedKey_.clear();
+    o.isFromCache_ = true;
+    return stream;
+}
+
 } //namespace customconfigs
 
@@ -2,6 +2,7 @@
 
 #include "icustomconfig.h"
 #include "engine/wireguardconfig/wireguardconfig.h"
+#include <QDataStream>
 #include <QSharedPointer>
 
 namespace customconfigs {
@@ -20,11 +21,16 @@ public:
     bool isCorrect() const override;
     QString getErrorForIncorrect() const override;
 
+    // the keys are read from the file again if the config came from the cache
     QSharedPointer<WireGuardConfig> getWireGuardConfig(const QString &endpointIp) const;
     uint getEndpointPort() const { return endpointPortNumber_; }
 
     static ICustomConfig *makeFromFile(const QString &filepath);
 
+    // for the cache of parsed configs, without the private and preshared keys
+    friend QDataStream& operator <<(QDataStream &stream, const WireguardCustomConfig &o);
+    friend QDataStream& operator >>(QDataStream &stream, WireguardCustomConfig &o);
+
 private:
     void loadFromFile(const QString &filepath);
     void validate();
@@ -33,6 +39,7 @@ private:
     QString name_;
     QString nick_;
     QString filename_;
+    QString filepath_;
 
     QString privateKey_;
     QString ipAddress_;
@@ -44,6 +51,7 @@ private:
     QString endpointPort_;
     uint endpointPortNumber_ = 0;
     bool isAllowFirewallAfterConnection_ = true;
+    bool isFromCache_ = false;
 };
 
 } //namespace customconfigs
@@ -1,13 +1,14 @@
 #include "engine.h"
 
+#include <QBuffer>
 #include <QCoreApplication>
-#include <QCryptographicHash>
 #include <wsnet/WSNet.h>
 #include "utils/ws_assert.h"
 #include "utils/utils.h"
 #include "version/appversion.h"
 #include "utils/logger.h"
 #include "utils/mergelog.h"
+#include "utils/spantracer.h"
 #include "utils/extraconfig.h"
 #include "utils/ipvalidation.h"
 #include "utils/hardcodedsettings.h"
@@ -435,6 +436,30 @@ QString Engine::getProxySharingAddress()
     }
 }
 
+QVector<types::ProxySharingClientStats> Engine::getProxySharingClientsStats()
+{
+    QMutexLocker locker(&mutex_);
+    WS_ASSERT(bInitialized_);
+    if (bInitialized_)
+    {
+        return vpnShareController_->getProxySharingClientsStats();
+    }
+    else
+    {
+        return QVector<types::ProxySharingClientStats>();
+    }
+}
+
+void Engine::setProxySharingRateLimit(const QString &address, quint32 kbytesPerSec)
+{
+    QMutexLocker locker(&mutex_);
+    WS_ASSERT(bInitialized_);
+    if (bInitialized_)
+    {
+        vpnShareController_->setProxySharingRateLimit(address, kbytesPerSec);
+    }
+}
+
 QString Engine::getSharingCaption()
 {
     QMutexLocker locker(&mutex_);
@@ -958,11 +983,14 @@ void Engine::connectClickImpl(const LocationID &locationId, const types::Connect
     // if connected, then first disconnect
     if (!connectionManager_->isDisconnected())
     {
+        SpanTracer::instance().beginTrace("disconnect");
         connectionManager_->setProperty("senderSource", "reconnect");
         connectionManager_->clickDisconnect();
         return;
     }
 
+    SpanTracer::instance().beginTrace("connect");
+
     if (isBlockConnect_ && !locationId_.isCustomConfigsLocation())
     {
         connectStateController_->setDisconnectedState(DISCONNECTED_WITH_ERROR, CONNECT_ERROR::CONNECTION_BLOCKED);
@@ -984,6 +1012,7 @@ void Engine::connectClickImpl(const LocationID &locationId, const types::Connect
     {
         bool bFirewallStateOn = firewallController_->firewallActualState();
         if (!bFirewallStateOn) {
+            SpanTracer::Span span("engine", "firewall on");
             qCDebug(LOG_BASIC) << "Automatic enable firewall before connection";
             firewallController_->firewallOn(
                 firewallExceptions_.connectingIp(),
@@ -998,6 +1027,7 @@ void Engine::connectClickImpl(const LocationID &locationId, const types::Connect
 
 void Engine::disconnectClickImpl()
 {
+    SpanTracer::instance().beginTrace("disconnect");
     stopFetchingServerCredentials();
     connectionManager_->setProperty("senderSource", QVariant());
     connectionManager_->clickDisconnect();
@@ -1009,12 +1039,14 @@ void Engine::sendDebugLogImpl()
     if (apiResourcesManager_)
         userName = apiResourcesManager_->sessionStatus().getUsername();
 
-    QString log = MergeLog::mergePrevLogs(true);
-    log += "================================================================================================================================================================================================\n";
-    log += "================================================================================================================================================================================================\n";
-    log += MergeLog::mergeLogs(true);
+    QBuffer log;
+    log.open(QIODevice::WriteOnly);
+    MergeLog::mergePrevLogs(&log, true);
+    log.write("================================================================================================================================================================================================\n");
+    log.write("================================================================================================================================================================================================\n");
+    MergeLog::mergeLogs(&log, true);
 
-    WSNet::instance()->serverAPI()->debugLog(userName.toStdString(), log.toStdString(),
+    WSNet::instance()->serverAPI()->debugLog(userName.toStdString(), log.data().toStdString(),
         [this](ServerApiRetCode serverApiRetCode, const std::string &jsonData) {
             if (serverApiRetCode == ServerApiRetCode::kSuccess)
                 qCDebug(LOG_BASIC) << "DebugLog sent";
@@ -1310,6 +1342,7 @@ void Engine::onConnectionManagerConnected()
         {
             if (!firewallController_->firewallActualState())
             {
+                SpanTracer::Span span("engine", "firewall on");
                 qCDebug(LOG_BASIC) << "Automatic enable firewall after connection";
                 firewallController_->firewallOn(
                     connectionManager_->getLastConnectedIp(),
@@ -1325,6 +1358,7 @@ void Engine::onConnectionManagerConnected()
         {
             if (firewallController_->firewallActualState())
             {
+                SpanTracer::Span span("engine", "firewall off");
                 qCDebug(LOG_BASIC) << "Automatic disable firewall after connection";
                 firewallController_->firewallOff();
                 emit firewallStateChanged(false);
@@ -1347,15 +1381,20 @@ void Engine::onConnectionManagerConnected()
     helper_win->setIPv6EnabledInFirewall(false);
 #endif
 
-    bool result = helper_->sendConnectStatus(true, engineSettings_.isTerminateSockets(), engineSettings_.isAllowLanTraffic(),
-                                             connectionManager_->getDefaultAdapterInfo(), connectionManager_->getVpnAdapterInfo(),
-                                             connectionManager_->getLastConnectedIp(), lastConnectingProtocol_);
+    bool result;
+    {
+        SpanTracer::Span span("engine", "send connect status");
+        result = helper_->sendConnectStatus(true, engineSettings_.isTerminateSockets(), engineSettings_.isAllowLanTraffic(),
+                                            connectionManager_->getDefaultAdapterInfo(), connectionManager_->getVpnAdapterInfo(),
+                                            connectionManager_->getLastConnectedIp(), lastConnectingProtocol_);
+    }
     if (!result) {
         emit helperSplitTunnelingStartFailed();
     }
 
     if (firewallController_->firewallActualState() && !isFirewallAlreadyEnabled)
     {
+        SpanTracer::Span span("engine", "firewall rules for connected state");
         firewallController_->firewallOn(
             connectionManager_->getLastConnectedIp(),
             firewallExceptions_.getIPAddressesForFirewallForConnectedState(),
@@ -1388,6 +1427,7 @@ void Engine::onConnectionManagerConnected()
 
             if (mtuForProtocol > 0)
             {
+                SpanTracer::Span span("engine", "change mtu");
                 qCDebug(LOG_PACKET_SIZE) << "Applying MTU on " << adapterName << ": " << mtuForProtocol;
                 helper_->changeMtu(adapterName, mtuForProtocol);
             }
@@ -1408,11 +1448,14 @@ void Engine::onConnectionManagerConnected()
         qCDebug(LOG_CONNECTION) << "the firewall rules are added for static IPs location, ports:" << connectionManager_->getStatisIps().getAsStringWithDelimiters();
     }
 
-    // disable proxy
-    WSNet::instance()->httpNetworkManager()->setProxySettings();
+    {
+        SpanTracer::Span span("wsnet", "proxy and dns servers");
+        // disable proxy
+        WSNet::instance()->httpNetworkManager()->setProxySettings();
 
-    DnsServersConfiguration::instance().setConnectedState(connectionManager_->getVpnAdapterInfo().dnsServers());
-    WSNet::instance()->dnsResolver()->setDnsServers(DnsServersConfiguration::instance().getCurrentDnsServers());
+        DnsServersConfiguration::instance().setConnectedState(connectionManager_->getVpnAdapterInfo().dnsServers());
+        WSNet::instance()->dnsResolver()->setDnsServers(DnsServersConfiguration::instance().getCurrentDnsServers());
+    }
 
     if (engineSettings_.isTerminateSockets())
     {
@@ -1423,9 +1466,15 @@ void Engine::onConnectionManagerConnected()
     }
 
     // Update ICS sharing. The operation may take a few seconds.
-    vpnShareController_->onConnectedToVPNEvent(adapterName);
+    {
+        SpanTracer::Span span("engine", "vpn share");
+        vpnShareController_->onConnectedToVPNEvent(adapterName);
+    }
 
-    connectStateController_->setConnectedState(locationId_);
+    {
+        SpanTracer::Span span("engine", "set connected state");
+        connectStateController_->setConnectedState(locationId_);
+    }
     connectionManager_->startTunnelTests(); // It is important that startTunnelTests() are after setConnectedState().
 
     // If we have connected and are still not logged in, then try again.
@@ -1456,7 +1505,10 @@ void Engine::onConnectionManagerDisconnected(DISCONNECT_REASON reason)
         connectionManager_->setProperty("senderSource", QVariant());
     }
 
-    doDisconnectRestoreStuff();
+    {
+        SpanTracer::Span span("engine", "restore after disconnect");
+        doDisconnectRestoreStuff();
+    }
 
 #ifdef Q_OS_WIN
     DnsInfo_win::outputDebugDnsInfo();
@@ -1472,6 +1524,7 @@ void Engine::onConnectionManagerDisconnected(DISCONNECT_REASON reason)
     }
     else if (senderSource == "reconnect")
     {
+        SpanTracer::instance().endTrace("disconnected to reconnect");
         connectClickImpl(locationId_, connectionSettingsOverride_);
         return;
     }
@@ -1495,6 +1548,10 @@ void Engine::onConnectionManagerDisconnected(DISCONNECT_REASON reason)
 void Engine::onConnectionManagerReconnecting()
 {
     qCDebug(LOG_BASIC) << "on reconnecting event";
+    // the connection dropped by itself, a connect from the user is traced already
+    if (!SpanTracer::instance().isTracing()) {
+        SpanTracer::instance().beginTrace("reconnect");
+    }
 
     DnsServersConfiguration::instance().setDisconnectedState();
     WSNet::instance()->dnsResolver()->setDnsServers(DnsServersConfiguration::instance().getCurrentDnsServers());
@@ -1636,6 +1693,8 @@ void Engine::onConnectionManagerProtocolPortChanged(const types::Protocol &proto
 
 void Engine::onConnectionManagerTestTunnelResult(bool success, const QString &ipAddress)
 {
+    // the connect ends here, with the first tunnel test after the connection
+    SpanTracer::instance().endTrace(success ? "connected" : "connected, tunnel test failed");
     emit testTunnelResult(success); // stops protocol/port flashing
     if (!ipAddress.isEmpty())
     {
@@ -1827,7 +1886,8 @@ void Engine::onDownloadHelperFinished(const DownloadHelper::DownloadState &state
         return;
     }
 
-    if (!verifyContentsSha256(installerPath_, installerHash_)) // installerPath_
+    // hashed by the downloader while the installer came in
+    if (downloadHelper_->sha256(installerPath_) != installerHash_)
     {
         qCDebug(LOG_AUTO_UPDATER) << "Incorrect hash, removing installer";
         if (QFile::exists(installerPath_)) QFile::remove(installerPath_);
@@ -2342,7 +2402,11 @@ void Engine::addCustomRemoteIpToFirewallIfNeed()
 
 void Engine::doConnect(bool bEmitAuthError)
 {
-    QSharedPointer<locationsmodel::BaseLocationInfo> bli = locationsModel_->getMutableLocationInfoById(locationId_);
+    QSharedPointer<locationsmodel::BaseLocationInfo> bli;
+    {
+        SpanTracer::Span span("engine", "select node");
+        bli = locationsModel_->getMutableLocationInfoById(locationId_);
+    }
     if (bli.isNull())
     {
         connectStateController_->setDisconnectedState(DISCONNECTED_WITH_ERROR, CONNECT_ERROR::LOCATION_NOT_EXIST);
@@ -2452,14 +2516,20 @@ void Engine::stopPacketDetectionImpl()
     packetSizeController_->earlyStop();
 }
 
-void Engine::onConnectStateChanged(CONNECT_STATE state, DISCONNECT_REASON /*reason*/, CONNECT_ERROR /*err*/, const LocationID & /*location*/)
+void Engine::onConnectStateChanged(CONNECT_STATE state, DISCONNECT_REASON reason, CONNECT_ERROR err, const LocationID & /*location*/)
 {
     if (helper_) {
         if (state != CONNECT_STATE_CONNECTED) {
+            SpanTracer::Span span("engine", "send connect status");
             helper_->sendConnectStatus(false, engineSettings_.isTerminateSockets(), engineSettings_.isAllowLanTraffic(), AdapterGatewayInfo::detectAndCreateDefaultAdapterInfo(), AdapterGatewayInfo(), QString(), types::Protocol());
         }
     }
     WSNet::instance()->setIsConnectedToVpnState(state == CONNECT_STATE_CONNECTED);
+
+    // a connect that failed or was cancelled, or a disconnect
+    if (state == CONNECT_STATE_DISCONNECTED) {
+        SpanTracer::instance().endTrace(QString("disconnected, reason %1, error %2").arg(static_cast<int>(reason)).arg(static_cast<int>(err)));
+    }
 }
 
 void Engine::updateProxySettings()
@@ -2472,23 +2542,6 @@ void Engine::updateProxySettings()
     }
 }
 
-bool Engine::verifyContentsSha256(const QString &filename, const QString &compareHash)
-{
-    QFile file(filename);
-    if (!file.open(QIODevice::ReadOnly))
-    {
-        qCDebug(LOG_BASIC) << "Failed to open installer for reading";
-        return false;
-    }
-    QByteArray contentsBytes = file.readAll();
-    QString sha256Hash = QCryptographicHash::hash(contentsBytes, QCryptographicHash::Sha256).toHex();
-    if (sha256Hash == compareHash)
-    {
-        return true;
-    }
-    return false;
-}
-
 #ifdef Q_OS_WIN
 void Engine::enableDohSettings()
 {
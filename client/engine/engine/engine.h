@@ -109,6 +109,8 @@ public:
     void startProxySharing(PROXY_SHARING_TYPE proxySharingType);
     void stopProxySharing();
     QString getProxySharingAddress();
+    QVector<types::ProxySharingClientStats> getProxySharingClientsStats();
+    void setProxySharingRateLimit(const QString &address, quint32 kbytesPerSec);
     QString getSharingCaption();
 
     void applicationActivated();
@@ -310,7 +312,6 @@ private slots:
 private:
     void initPart2();
     void updateProxySettings();
-    bool verifyContentsSha256(const QString &filename, const QString &compareHash);
 
 #ifdef Q_OS_WIN
     void enableDohSettings();
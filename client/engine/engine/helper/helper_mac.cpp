@@ -1,5 +1,6 @@
 #include "helper_mac.h"
 #include "utils/logger.h"
+#include "utils/spantracer.h"
 #include <QStandardPaths>
 #include "utils/ws_assert.h"
 #include <QCoreApplication>
@@ -163,6 +164,8 @@ void Helper_mac::doDisconnectAndReconnect()
 
 bool Helper_mac::runCommand(int cmdId, const std::string &data, CMD_ANSWER &answer)
 {
+    const QString spanName = QString("command %1").arg(cmdId);
+    SpanTracer::Span span("helper", spanName);
     xpc_object_t message = xpc_dictionary_create(NULL, NULL, 0);
     xpc_dictionary_set_int64(message, "cmdId", cmdId);
     xpc_dictionary_set_data(message, "data", data.c_str(), data.size());
@@ -179,6 +182,7 @@ bool Helper_mac::runCommand(int cmdId, const std::string &data, CMD_ANSWER &answ
             std::istringstream stream(str);
             boost::archive::text_iarchive ia(stream, boost::archive::no_header);
             ia >> answer;
+            SpanTracer::instance().addRemoteSpan("helper", spanName, answer.serviceTimeUs * 1000);
             return true;
         } else {
             return false;
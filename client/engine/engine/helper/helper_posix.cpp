@@ -1,6 +1,7 @@
 #include "helper_posix.h"
 #include "utils/crashhandler.h"
 #include "utils/logger.h"
+#include "utils/spantracer.h"
 #include <QElapsedTimer>
 #include <QDir>
 #include <QFile>
@@ -693,12 +694,18 @@ void Helper_posix::doDisconnectAndReconnect()
 
 bool Helper_posix::runCommand(int cmdId, const std::string &data, CMD_ANSWER &answer)
 {
+    const QString spanName = QString("command %1").arg(cmdId);
+    SpanTracer::Span span("helper", spanName);
     bool ret = sendCmdToHelper(cmdId, data);
     if (!ret) {
         return ret;
     }
 
-    return readAnswer(answer);
+    ret = readAnswer(answer);
+    if (ret) {
+        SpanTracer::instance().addRemoteSpan("helper", spanName, answer.serviceTimeUs * 1000);
+    }
+    return ret;
 }
 
 bool Helper_posix::readAnswer(CMD_ANSWER &outAnswer)
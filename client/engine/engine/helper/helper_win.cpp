@@ -16,6 +16,7 @@
 #include "types/wireguardtypes.h"
 #include "utils/executable_signature/executable_signature.h"
 #include "utils/logger.h"
+#include "utils/spantracer.h"
 #include "utils/ws_assert.h"
 #include "utils/winutils.h"
 
@@ -716,6 +717,9 @@ void Helper_win::run()
 
 MessagePacketResult Helper_win::sendCmdToHelper(int cmdId, const std::string &data)
 {
+    // the service doesn't report its own share of the round trip
+    SpanTracer::Span span("helper", QString("command %1").arg(cmdId));
+
     if (helperPipe_.isValid()) {
         // Check if our IPC connection has become invalid (e.g. the helper is restarted while the app is running).
         DWORD flags;
@@ -1,6 +1,8 @@
 #include "customconfiglocationsmodel.h"
 
+#include <QDateTime>
 #include <QFile>
+#include <QSet>
 #include <QTextStream>
 
 #include "utils/ws_assert.h"
@@ -21,10 +23,10 @@ CustomConfigLocationsModel::CustomConfigLocationsModel(QObject *parent, IConnect
 void CustomConfigLocationsModel::setCustomConfigs(const QVector<QSharedPointer<const customconfigs::ICustomConfig> > &customConfigs)
 {
     // todo synchronize ping time for two instances of PingIpsController
-    // todo: check if configs actually changed
-    // todo: dns-resolver cache
 
+    const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
     QStringList hostnamesForResolve;
+    QSet<QString> hostnamesForResolveSet;
     // fill pingInfos_ array
     pingInfos_.clear();
     for (const auto &config : customConfigs)
@@ -46,7 +48,20 @@ void CustomConfigLocationsModel::setCustomConfigs(const QVector<QSharedPointer<c
             }
             else
             {
-                hostnamesForResolve << hostname;
+                const auto resolvedIt = resolvedHostnames_.constFind(hostname);
+                if (resolvedIt != resolvedHostnames_.constEnd() && resolvedIt->expiresMs > nowMs)
+                {
+                    ri.isResolved = true;
+                    for (const QString &ip : resolvedIt->ips)
+                    {
+                        ri.ips << IpItem { ip, pingManager_.getPing(ip) };
+                    }
+                }
+                else if (!hostnamesForResolveSet.contains(hostname))
+                {
+                    hostnamesForResolveSet.insert(hostname);
+                    hostnamesForResolve << hostname;
+                }
             }
 
             cc.remotes << ri;
@@ -81,6 +96,7 @@ void CustomConfigLocationsModel::setCustomConfigs(const QVector<QSharedPointer<c
 void CustomConfigLocationsModel::clear()
 {
     pingInfos_.clear();
+    resolvedHostnames_.clear();
     pingManager_.clearIps();
     QSharedPointer<types::Location> empty(new types::Location());
     emit locationsUpdated(empty);
@@ -115,6 +131,18 @@ void CustomConfigLocationsModel::onPingInfoChanged(const QString &ip, int timems
 
 void CustomConfigLocationsModel::onDnsRequestFinished(const QString &hostname, std::shared_ptr<wsnet::WSNetDnsRequestResult> result)
 {
+    // a failure is resolved again the next time
+    if (!result->isError() && !result->ips().empty())
+    {
+        ResolvedHostname resolved;
+        for (const auto &ip : result->ips())
+        {
+            resolved.ips << QString::fromStdString(ip);
+        }
+        resolved.expiresMs = QDateTime::currentMSecsSinceEpoch() + (result->ttl() > 0 ? result->ttl() * 1000LL : RESOLVED_HOSTNAME_TTL_MS);
+        resolvedHostnames_[hostname] = resolved;
+    }
+
     for (auto it = pingInfos_.begin(); it != pingInfos_.end(); ++it)
     {
         for (auto remoteIt = it->remotes.begin(); remoteIt != it->remotes.end(); ++remoteIt)
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <QHash>
 #include <QHostInfo>
 #include <QObject>
 #include <wsnet/WSNet.h>
@@ -68,6 +69,16 @@ private:
 
     QVector<CustomConfigWithPingInfo> pingInfos_;
 
+    // the hostnames of the configs resolved before, so that a change of a few configs doesn't resolve all of them again
+    struct ResolvedHostname
+    {
+        QStringList ips;
+        qint64 expiresMs;
+    };
+    // for the results without a TTL
+    static constexpr qint64 RESOLVED_HOSTNAME_TTL_MS = 5 * 60 * 1000;
+    QHash<QString, ResolvedHostname> resolvedHostnames_;
+
 
     bool isAllResolved() const;
     void startPingAndWhitelistIps();
@@ -9,36 +9,26 @@
 #include <linux/wireless.h>
 
 #include "utils/logger.h"
-#include "utils/network_utils/network_utils_linux.h"
 #include "utils/utils.h"
 
 const int typeIdNetworkInterface = qRegisterMetaType<types::NetworkInterface>("types::NetworkInterface");
+const int typeIdDefaultInterface = qRegisterMetaType<NetlinkTable_linux::DefaultInterface>("NetlinkTable_linux::DefaultInterface");
 
 NetworkDetectionManager_linux::NetworkDetectionManager_linux(QObject *parent, IHelper *helper) : INetworkDetectionManager(parent)
 {
     Q_UNUSED(helper);
 
+    routeMonitor_ = new RouteMonitor_linux(this);
+
     networkInterface_ = types::NetworkInterface::noNetworkInterface();
-    getDefaultRouteInterface(isOnline_);
-    updateNetworkInfo(false);
-
-    routeMonitorThread_ = new QThread;
-    routeMonitor_ = new RouteMonitor_linux;
-    connect(routeMonitor_, &RouteMonitor_linux::routesChanged, this, &NetworkDetectionManager_linux::onRoutesChanged);
-    connect(routeMonitorThread_, &QThread::started, routeMonitor_, &RouteMonitor_linux::init);
-    connect(routeMonitorThread_, &QThread::finished, routeMonitor_, &RouteMonitor_linux::finish);
-    connect(routeMonitorThread_, &QThread::finished, routeMonitor_, &RouteMonitor_linux::deleteLater);
-    routeMonitor_->moveToThread(routeMonitorThread_);
-    routeMonitorThread_->start(QThread::LowPriority);
+    isOnline_ = routeMonitor_->defaultInterface().isOnline;
+    updateNetworkInfo(routeMonitor_->defaultInterface(), false);
+
+    connect(routeMonitor_, &RouteMonitor_linux::defaultInterfaceChanged, this, &NetworkDetectionManager_linux::onDefaultInterfaceChanged);
 }
 
 NetworkDetectionManager_linux::~NetworkDetectionManager_linux()
 {
-    if (routeMonitorThread_) {
-        routeMonitorThread_->quit();
-        routeMonitorThread_->wait();
-        routeMonitorThread_->deleteLater();
-    }
 }
 
 void NetworkDetectionManager_linux::getCurrentNetworkInterface(types::NetworkInterface &networkInterface)
@@ -51,27 +41,24 @@ bool NetworkDetectionManager_linux::isOnline()
     return isOnline_;
 }
 
-void NetworkDetectionManager_linux::onRoutesChanged()
+void NetworkDetectionManager_linux::onDefaultInterfaceChanged(const NetlinkTable_linux::DefaultInterface &defaultInterface)
 {
-    updateNetworkInfo(true);
+    updateNetworkInfo(defaultInterface, true);
 }
 
-void NetworkDetectionManager_linux::updateNetworkInfo(bool bWithEmitSignal)
+void NetworkDetectionManager_linux::updateNetworkInfo(const NetlinkTable_linux::DefaultInterface &defaultInterface, bool bWithEmitSignal)
 {
-    bool newIsOnline;
-    QString ifname = getDefaultRouteInterface(newIsOnline);
-
-    if (isOnline_ != newIsOnline)
+    if (isOnline_ != defaultInterface.isOnline)
     {
-        isOnline_ = newIsOnline;
+        isOnline_ = defaultInterface.isOnline;
         emit onlineStateChanged(isOnline_);
     }
 
 
     types::NetworkInterface newNetworkInterface = types::NetworkInterface::noNetworkInterface();
-    if (!ifname.isEmpty())
+    if (defaultInterface.isOnline)
     {
-        getInterfacePars(ifname, newNetworkInterface);
+        getInterfacePars(defaultInterface, newNetworkInterface);
     }
 
     if (newNetworkInterface != networkInterface_)
@@ -84,99 +71,25 @@ void NetworkDetectionManager_linux::updateNetworkInfo(bool bWithEmitSignal)
     }
 }
 
-QString NetworkDetectionManager_linux::getDefaultRouteInterface(bool &isOnline)
-{
-    QString gateway;
-    QString interface;
-    QString adapterIp;
-
-    NetworkUtils_linux::getDefaultRoute(gateway, interface, adapterIp, true);
-    if (gateway.isEmpty() || interface.isEmpty()) {
-        isOnline = false;
-        return QString();
-    }
-    isOnline = true;
-    return interface;
-}
-
-void NetworkDetectionManager_linux::getInterfacePars(const QString &ifname, types::NetworkInterface &outNetworkInterface)
+void NetworkDetectionManager_linux::getInterfacePars(const NetlinkTable_linux::DefaultInterface &defaultInterface, types::NetworkInterface &outNetworkInterface)
 {
-    outNetworkInterface.interfaceName = ifname;
-    outNetworkInterface.interfaceIndex = if_nametoindex(ifname.toStdString().c_str());
-    QString macAddress = getMacAddressByIfName(ifname);
-    outNetworkInterface.physicalAddress = macAddress;
-
-    bool isWifi = checkWirelessByIfName(ifname);
-    if (isWifi)
+    outNetworkInterface.interfaceName = defaultInterface.name;
+    outNetworkInterface.interfaceIndex = defaultInterface.ifIndex;
+    outNetworkInterface.physicalAddress = defaultInterface.macAddress;
+
+    bool isWifi = checkWirelessByIfName(defaultInterface.name);
+    outNetworkInterface.interfaceType = isWifi ? NETWORK_INTERFACE_WIFI : NETWORK_INTERFACE_ETH;
+    QString friendlyName = networkManager_.networkName(defaultInterface.name);
+    if (!friendlyName.isEmpty())
     {
-        outNetworkInterface.interfaceType = NETWORK_INTERFACE_WIFI;
-        QString friendlyName = getFriendlyNameByIfName(ifname);
-        if (!friendlyName.isEmpty())
-        {
-            outNetworkInterface.networkOrSsid = friendlyName;
-        }
-        else
-        {
-            outNetworkInterface.networkOrSsid = macAddress;
-        }
+        outNetworkInterface.networkOrSsid = friendlyName;
     }
     else
     {
-        outNetworkInterface.interfaceType = NETWORK_INTERFACE_ETH;
-        QString friendlyName = getFriendlyNameByIfName(ifname);
-        if (!friendlyName.isEmpty())
-        {
-            outNetworkInterface.networkOrSsid = friendlyName;
-        }
-        else
-        {
-            outNetworkInterface.networkOrSsid = macAddress;
-        }
+        outNetworkInterface.networkOrSsid = defaultInterface.macAddress;
     }
 
-    outNetworkInterface.active = isActiveByIfName(ifname);
-}
-
-QString NetworkDetectionManager_linux::getMacAddressByIfName(const QString &ifname)
-{
-    QString ret;
-
-    int fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (fd != -1)
-    {
-        struct ifreq ifr;
-        memset(&ifr, 0, sizeof(ifr));
-        ifr.ifr_addr.sa_family = AF_INET;
-        strncpy(ifr.ifr_name , ifname.toStdString().c_str() , IFNAMSIZ-1);
-        if (ioctl(fd, SIOCGIFHWADDR, &ifr) == 0)
-        {
-            unsigned char *mac = (unsigned char *)ifr.ifr_hwaddr.sa_data;
-            // format mac address
-            ret = QString::asprintf("%.2X:%.2X:%.2X:%.2X:%.2X:%.2X" , mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-        }
-        close(fd);
-    }
-    return ret;
-}
-
-bool NetworkDetectionManager_linux::isActiveByIfName(const QString &ifname)
-{
-    bool ret = false;
-
-    int fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (fd != -1)
-    {
-        struct ifreq ifr;
-        memset(&ifr, 0, sizeof(ifr));
-        ifr.ifr_addr.sa_family = AF_INET;
-        strncpy(ifr.ifr_name , ifname.toStdString().c_str() , IFNAMSIZ-1);
-        if (ioctl(fd, SIOCGIFFLAGS, &ifr) == 0)
-        {
-            ret = (ifr.ifr_flags & ( IFF_UP | IFF_RUNNING )) == ( IFF_UP | IFF_RUNNING );
-        }
-        close(fd);
-    }
-    return ret;
+    outNetworkInterface.active = defaultInterface.isActive;
 }
 
 bool NetworkDetectionManager_linux::checkWirelessByIfName(const QString &ifname)
@@ -197,33 +110,3 @@ bool NetworkDetectionManager_linux::checkWirelessByIfName(const QString &ifname)
     }
     return ret;
 }
-
-QString NetworkDetectionManager_linux::getFriendlyNameByIfName(const QString &ifname)
-{
-    QString strReply;
-    FILE *file = popen("nmcli -t -f NAME,DEVICE c show", "r");
-    if (file)
-    {
-        char szLine[4096];
-        while(fgets(szLine, sizeof(szLine), file) != 0)
-        {
-            strReply += szLine;
-        }
-        pclose(file);
-    }
-
-    const QStringList lines = strReply.split('\n', Qt::SkipEmptyParts);
-    for (auto &it : lines)
-    {
-        const QStringList pars = it.split(':', Qt::SkipEmptyParts);
-        if (pars.size() == 2)
-        {
-            if (pars[1] == ifname)
-            {
-                return pars[0];
-            }
-        }
-    }
-    return QString();
-}
-
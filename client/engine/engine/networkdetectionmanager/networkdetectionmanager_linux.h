@@ -5,6 +5,7 @@
 
 #include "engine/helper/ihelper.h"
 #include "inetworkdetectionmanager.h"
+#include "networkmanagerdbus_linux.h"
 #include "routemonitor_linux.h"
 
 class NetworkDetectionManager_linux : public INetworkDetectionManager
@@ -17,20 +18,16 @@ public:
     bool isOnline() override;
 
 private slots:
-    void onRoutesChanged();
+    void onDefaultInterfaceChanged(const NetlinkTable_linux::DefaultInterface &defaultInterface);
 
 private:
     bool isOnline_ = false;
     types::NetworkInterface networkInterface_;
 
-    QThread *routeMonitorThread_ = nullptr;
     RouteMonitor_linux *routeMonitor_ = nullptr;
+    NetworkManagerDbus_linux networkManager_;
 
-    void updateNetworkInfo(bool bWithEmitSignal);
-    QString getDefaultRouteInterface(bool &isOnline);
-    void getInterfacePars(const QString &ifname, types::NetworkInterface &outNetworkInterface);
-    QString getMacAddressByIfName(const QString &ifname);
-    bool isActiveByIfName(const QString &ifname);
+    void updateNetworkInfo(const NetlinkTable_linux::DefaultInterface &defaultInterface, bool bWithEmitSignal);
+    void getInterfacePars(const NetlinkTable_linux::DefaultInterface &defaultInterface, types::NetworkInterface &outNetworkInterface);
     bool checkWirelessByIfName(const QString &ifname);
-    QString getFriendlyNameByIfName(const QString &ifname);
 };
@@ -0,0 +1,88 @@
+#include "networkmanagerdbus_linux.h"
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusObjectPath>
+#include <QDBusVariant>
+
+namespace {
+
+const QString kService = "org.freedesktop.NetworkManager";
+const QString kDeviceInterface = "org.freedesktop.NetworkManager.Device";
+
+bool isValidPath(const QString &path)
+{
+    return !path.isEmpty() && path != "/";
+}
+
+} // namespace
+
+QString NetworkManagerDbus_linux::networkName(const QString &ifname)
+{
+    if (names_.size() > kMaxCachedNames) {
+        names_.clear();
+    }
+
+    QString path = devicePath(ifname);
+    if (path.isEmpty()) {
+        return QString();
+    }
+
+    // the devices get new paths when they are re-added, such as an USB adapter plugged in again
+    QString activeConnectionPath = objectPathProperty(path, kDeviceInterface, "ActiveConnection");
+    if (activeConnectionPath.isEmpty()) {
+        devicePaths_.remove(ifname);
+        path = devicePath(ifname);
+        activeConnectionPath = path.isEmpty() ? QString() : objectPathProperty(path, kDeviceInterface, "ActiveConnection");
+    }
+    if (!isValidPath(activeConnectionPath)) {
+        return QString();
+    }
+
+    // every activation gets a new path, so the cached name can't belong to some other connection
+    auto it = names_.constFind(activeConnectionPath);
+    if (it != names_.constEnd()) {
+        return *it;
+    }
+    const QString id = property(activeConnectionPath, "org.freedesktop.NetworkManager.Connection.Active", "Id").toString();
+    if (!id.isEmpty()) {
+        names_[activeConnectionPath] = id;
+    }
+    return id;
+}
+
+QString NetworkManagerDbus_linux::devicePath(const QString &ifname)
+{
+    auto it = devicePaths_.constFind(ifname);
+    if (it != devicePaths_.constEnd()) {
+        return *it;
+    }
+
+    QDBusMessage message = QDBusMessage::createMethodCall(kService, "/org/freedesktop/NetworkManager", kService, "GetDeviceByIpIface");
+    message << ifname;
+    const QDBusMessage reply = QDBusConnection::systemBus().call(message, QDBus::Block, kTimeoutMs);
+    if (reply.type() != QDBusMessage::ReplyMessage || reply.arguments().isEmpty()) {
+        return QString();
+    }
+    const QString path = reply.arguments().first().value<QDBusObjectPath>().path();
+    if (!path.isEmpty()) {
+        devicePaths_[ifname] = path;
+    }
+    return path;
+}
+
+QString NetworkManagerDbus_linux::objectPathProperty(const QString &path, const QString &interface, const QString &name)
+{
+    return property(path, interface, name).value<QDBusObjectPath>().path();
+}
+
+QVariant NetworkManagerDbus_linux::property(const QString &path, const QString &interface, const QString &name)
+{
+    QDBusMessage message = QDBusMessage::createMethodCall(kService, path, "org.freedesktop.DBus.Properties", "Get");
+    message << interface << name;
+    const QDBusMessage reply = QDBusConnection::systemBus().call(message, QDBus::Block, kTimeoutMs);
+    if (reply.type() != QDBusMessage::ReplyMessage || reply.arguments().isEmpty()) {
+        return QVariant();
+    }
+    return reply.arguments().first().value<QDBusVariant>().variant();
+}
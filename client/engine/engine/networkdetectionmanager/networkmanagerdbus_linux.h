@@ -0,0 +1,26 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QVariant>
+
+// Connection names from NetworkManager over D-Bus, instead of running nmcli. The object paths and the names are cached,
+// so a lookup for a network that didn't change costs one property read.
+class NetworkManagerDbus_linux
+{
+public:
+    // the name (Id) of the active connection of the interface, the same as "nmcli c show" lists, also for Wi-Fi: the
+    // networks are whitelisted under it. Empty if NetworkManager isn't running or doesn't manage the interface
+    QString networkName(const QString &ifname);
+
+private:
+    static constexpr int kTimeoutMs = 1000;
+    static constexpr int kMaxCachedNames = 64;
+
+    QHash<QString, QString> devicePaths_;   // interface name -> device object path
+    QHash<QString, QString> names_;         // active connection object path -> name
+
+    QString devicePath(const QString &ifname);
+    QString objectPathProperty(const QString &path, const QString &interface, const QString &name);
+    QVariant property(const QString &path, const QString &interface, const QString &name);
+};
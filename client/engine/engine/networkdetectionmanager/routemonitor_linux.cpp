@@ -1,65 +1,58 @@
 #include "routemonitor_linux.h"
 
-#include <linux/netlink.h>
-#include <linux/rtnetlink.h>
-#include <stdio.h>
-#include <sys/socket.h>
-#include <unistd.h>
-
-#include "utils/logger.h"
-#include "utils/ws_assert.h"
-
-RouteMonitor_linux::RouteMonitor_linux(QObject *parent) : QObject(parent)
+RouteMonitor_linux::RouteMonitor_linux(QObject *parent, NetlinkWatcher_linux &watcher) : QObject(parent),
+    watcher_(watcher)
 {
+    debounceTimer_ = new QTimer(this);
+    debounceTimer_->setSingleShot(true);
+    connect(debounceTimer_, &QTimer::timeout, this, &RouteMonitor_linux::onDebounceTimeout);
+
+    lastDefaultInterface_ = watcher_.defaultInterface(false);
+    lastDefaultInterfaceIPv6_ = watcher_.defaultInterface(true);
+
+    // the watcher calls on its own thread
+    listenerId_ = watcher_.addListener([this](const QSet<int> &changedIfIndexes) {
+        QMetaObject::invokeMethod(this, [this, changedIfIndexes]() {
+            onWatcherChanged(changedIfIndexes);
+        }, Qt::QueuedConnection);
+    });
 }
 
 RouteMonitor_linux::~RouteMonitor_linux()
 {
-    if (fd_ >= 0) {
-        close(fd_);
-    }
+    watcher_.removeListener(listenerId_);
 }
 
-void RouteMonitor_linux::init()
+NetlinkTable_linux::DefaultInterface RouteMonitor_linux::defaultInterface() const
 {
-    if ((fd_ = socket(AF_NETLINK, SOCK_DGRAM, NETLINK_ROUTE)) < 0) {
-        qCDebug(LOG_BASIC) << "RouteMonitor_linux could not open netlink socket";
-        WS_ASSERT(false);
-        return;
-    }
-
-    struct sockaddr_nl addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.nl_family = AF_NETLINK;
-    addr.nl_pid    = getpid();
-    addr.nl_groups = RTMGRP_IPV4_ROUTE;
-
-    if (bind(fd_, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
-        qCDebug(LOG_BASIC) << "RouteMonitor_linux could not bind address";
-        WS_ASSERT(false);
-        return;
-    }
-
-    notifier_ = new QSocketNotifier(fd_, QSocketNotifier::Read, this);
-    connect(notifier_, &QSocketNotifier::activated, this, &RouteMonitor_linux::netlinkSocketReady);
-    notifier_->setEnabled(true);
+    return lastDefaultInterface_.isOnline ? lastDefaultInterface_ : lastDefaultInterfaceIPv6_;
 }
 
-void RouteMonitor_linux::finish()
+void RouteMonitor_linux::onWatcherChanged(const QSet<int> &changedIfIndexes)
 {
-    if (notifier_) {
-        notifier_->setEnabled(false);
+    if (!debounceTimer_->isActive()) {
+        burstTimer_.start();
+    }
+    changedIfIndexes_.unite(changedIfIndexes);
+    // restart the quiet period, unless the burst has been going on for too long already
+    if (burstTimer_.elapsed() < kMaxDelayMs - kDebounceMs) {
+        debounceTimer_->start(kDebounceMs);
     }
 }
 
-void RouteMonitor_linux::netlinkSocketReady(QSocketDescriptor socket, QSocketNotifier::Type activationEvent)
+void RouteMonitor_linux::onDebounceTimeout()
 {
-    Q_UNUSED(socket)
-    Q_UNUSED(activationEvent)
-
-    char buffer[4096];
-    ssize_t len = recv(fd_, buffer, sizeof(buffer), MSG_DONTWAIT);
-    if (len >= 0) {
-        emit routesChanged();
+    const NetlinkTable_linux::DefaultInterface defaultInterface = watcher_.defaultInterface(false);
+    const NetlinkTable_linux::DefaultInterface defaultInterfaceIPv6 = watcher_.defaultInterface(true);
+    const bool isChanged = defaultInterface != lastDefaultInterface_ || defaultInterfaceIPv6 != lastDefaultInterfaceIPv6_ ||
+                           changedIfIndexes_.contains(defaultInterface.ifIndex) ||
+                           changedIfIndexes_.contains(defaultInterfaceIPv6.ifIndex) ||
+                           changedIfIndexes_.contains(lastDefaultInterface_.ifIndex) ||
+                           changedIfIndexes_.contains(lastDefaultInterfaceIPv6_.ifIndex);
+    changedIfIndexes_.clear();
+    if (isChanged) {
+        lastDefaultInterface_ = defaultInterface;
+        lastDefaultInterfaceIPv6_ = defaultInterfaceIPv6;
+        emit defaultInterfaceChanged(this->defaultInterface());
     }
 }
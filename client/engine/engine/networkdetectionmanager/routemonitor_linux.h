@@ -1,26 +1,45 @@
 #pragma once
 
+#include <QElapsedTimer>
 #include <QObject>
-#include <QSocketNotifier>
+#include <QSet>
+#include <QTimer>
 
+#include "utils/network_utils/netlinkwatcher_linux.h"
+
+// Reports the default interface once per burst of NetlinkWatcher_linux changes: a Wi-Fi roam or a container runtime
+// creating its bridges sends dozens of messages in a row. IPv4 is preferred, on IPv6-only networks the interface of
+// the IPv6 default route is reported.
 class RouteMonitor_linux : public QObject
 {
     Q_OBJECT
 public:
-    explicit RouteMonitor_linux(QObject *parent = nullptr);
+    explicit RouteMonitor_linux(QObject *parent, NetlinkWatcher_linux &watcher = NetlinkWatcher_linux::instance());
     ~RouteMonitor_linux();
 
-signals:
-    void routesChanged();
+    NetlinkTable_linux::DefaultInterface defaultInterface() const;
 
-public slots:
-    void init();
-    void finish();
+signals:
+    // the default interface of either family changed, or its link, addresses or routes did and the network behind it
+    // may be a different one now
+    void defaultInterfaceChanged(const NetlinkTable_linux::DefaultInterface &defaultInterface);
 
 private slots:
-    void netlinkSocketReady(QSocketDescriptor socket, QSocketNotifier::Type activationEvent);
+    void onDebounceTimeout();
 
 private:
-    int fd_ = -1;
-    QSocketNotifier *notifier_ = nullptr;
+    // quiet period that ends a burst, and the longest a change may wait while messages keep coming
+    static constexpr int kDebounceMs = 300;
+    static constexpr int kMaxDelayMs = 2000;
+
+    NetlinkWatcher_linux &watcher_;
+    int listenerId_;
+    QTimer *debounceTimer_;
+    QElapsedTimer burstTimer_;
+
+    NetlinkTable_linux::DefaultInterface lastDefaultInterface_;
+    NetlinkTable_linux::DefaultInterface lastDefaultInterfaceIPv6_;
+    QSet<int> changedIfIndexes_;
+
+    void onWatcherChanged(const QSet<int> &changedIfIndexes);
 };
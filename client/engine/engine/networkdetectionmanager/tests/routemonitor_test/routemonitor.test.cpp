@@ -0,0 +1,236 @@
+#include "routemonitor.test.h"
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QFile>
+
+#include <linux/netlink.h>
+
+#include "utils/network_utils/network_utils_linux.h"
+#include "utils/utils.h"
+
+namespace {
+
+// a little above RouteMonitor_linux::kDebounceMs
+const int kSettleMs = 500;
+
+NetlinkTable_linux::DefaultInterface signalArgument(const QSignalSpy &spy, int index)
+{
+    return spy.at(index).at(0).value<NetlinkTable_linux::DefaultInterface>();
+}
+
+} // namespace
+
+void RouteMonitor_test::initTestCase()
+{
+    qRegisterMetaType<NetlinkTable_linux::DefaultInterface>("NetlinkTable_linux::DefaultInterface");
+}
+
+void RouteMonitor_test::init()
+{
+    watcher_.reset(new NetlinkWatcher_linux());
+    monitor_.reset(new RouteMonitor_linux(nullptr, *watcher_));
+    QSignalSpy spy(monitor_.get(), &RouteMonitor_linux::defaultInterfaceChanged);
+    const QByteArray dump = load("dump.bin");
+    QVERIFY(!dump.isEmpty());
+    watcher_->processMessages(dump.constData(), dump.size());
+    QVERIFY(spy.wait(kSettleMs * 2));
+    QCOMPARE(spy.count(), 1);
+}
+
+void RouteMonitor_test::cleanup()
+{
+    monitor_.reset();
+    watcher_.reset();
+}
+
+void RouteMonitor_test::testInitialTable()
+{
+    const NetlinkTable_linux::DefaultInterface defaultInterface = monitor_->defaultInterface();
+    QVERIFY(defaultInterface.isOnline);
+    QCOMPARE(defaultInterface.name, QString("eth0"));
+    QCOMPARE(defaultInterface.ifIndex, 4);
+    QCOMPARE(defaultInterface.macAddress, QString("02:FC:00:00:00:01"));
+    QVERIFY(defaultInterface.isActive);
+    QCOMPARE(defaultInterface.gateway, QHostAddress("192.0.2.1"));
+}
+
+void RouteMonitor_test::testIPv6Table()
+{
+    const NetlinkTable_linux::DefaultInterface defaultInterface = watcher_->defaultInterface(true);
+    QVERIFY(defaultInterface.isOnline);
+    QCOMPARE(defaultInterface.name, QString("eth0"));
+    QCOMPARE(defaultInterface.gateway, QHostAddress("fd00::1"));
+
+    const QList<QHostAddress> addresses = watcher_->addresses("eth0", true);
+    QVERIFY(addresses.contains(QHostAddress("fd00::2")));
+    QVERIFY(addresses.contains(QHostAddress("fe80::fc:ff:fe00:1")));
+    QCOMPARE(watcher_->addresses("eth0", false), QList<QHostAddress>() << QHostAddress("192.0.2.2"));
+    QCOMPARE(watcher_->globalAddresses(false), QList<QHostAddress>() << QHostAddress("192.0.2.2"));
+    QCOMPARE(watcher_->globalAddresses(true), QList<QHostAddress>() << QHostAddress("fd00::2"));
+
+    // the IPv6 default follows the bridge and comes back when it goes down
+    replay(load("bridge_burst.bin"));
+    replay(load("default_via_bridge.bin"));
+    QCOMPARE(watcher_->defaultInterface(true).name, QString("wsbr0"));
+    QCOMPARE(watcher_->defaultInterface(true).gateway, QHostAddress("fd17::fe"));
+    QVERIFY(watcher_->addresses("wsbr0", true).contains(QHostAddress("fd17::1")));
+    replay(load("bridge_down.bin"));
+    QCOMPARE(watcher_->defaultInterface(true).name, QString("eth0"));
+    QVERIFY(watcher_->addresses("wsbr0", true).isEmpty());
+}
+
+void RouteMonitor_test::testBurstWithoutDefaultChange()
+{
+    // the bridge and the veth pair take 30 messages, none of them concerns eth0
+    QSignalSpy spy(monitor_.get(), &RouteMonitor_linux::defaultInterfaceChanged);
+    const QByteArray burst = load("bridge_burst.bin");
+    QVERIFY(split(burst).size() > 20);
+    replay(burst, 1);
+    QTest::qWait(kSettleMs);
+    QCOMPARE(spy.count(), 0);
+    QCOMPARE(monitor_->defaultInterface().name, QString("eth0"));
+}
+
+void RouteMonitor_test::testDefaultRouteSwitch()
+{
+    QSignalSpy spy(monitor_.get(), &RouteMonitor_linux::defaultInterfaceChanged);
+    replay(load("bridge_burst.bin"));
+    replay(load("default_via_bridge.bin"));
+    QVERIFY(spy.wait(kSettleMs * 2));
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(signalArgument(spy, 0).name, QString("wsbr0"));
+    QCOMPARE(signalArgument(spy, 0).gateway, QHostAddress("172.17.0.254"));
+
+    // the kernel drops the routes of a link that goes down without a RTM_DELROUTE for each
+    replay(load("bridge_down.bin"));
+    QVERIFY(spy.wait(kSettleMs * 2));
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(signalArgument(spy, 1).name, QString("eth0"));
+
+    replay(load("bridge_removed.bin"));
+    QTest::qWait(kSettleMs);
+    QCOMPARE(spy.count(), 2);
+}
+
+void RouteMonitor_test::testAddressChangeOnDefaultInterface()
+{
+    // the interface stays the same, but the network behind it may not, so the manager gets a chance to look again
+    QSignalSpy spy(monitor_.get(), &RouteMonitor_linux::defaultInterfaceChanged);
+    replay(load("address_renew.bin"), 5);
+    QVERIFY(spy.wait(kSettleMs * 2));
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(signalArgument(spy, 0), monitor_->defaultInterface());
+    QCOMPARE(signalArgument(spy, 0).name, QString("eth0"));
+}
+
+void RouteMonitor_test::testTransientSwitchIsCollapsed()
+{
+    // the default moves to the bridge and back within one burst, which ends where it started
+    QSignalSpy spy(monitor_.get(), &RouteMonitor_linux::defaultInterfaceChanged);
+    QByteArray all = load("bridge_burst.bin") + load("default_via_bridge.bin") + load("bridge_down.bin") + load("bridge_removed.bin");
+    replay(all);
+    QTest::qWait(kSettleMs);
+    QCOMPARE(spy.count(), 0);
+}
+
+void RouteMonitor_test::testLongBurstIsCapped()
+{
+    // a change that keeps coming every 100 ms never leaves a quiet period, it's reported within two seconds anyway
+    QSignalSpy spy(monitor_.get(), &RouteMonitor_linux::defaultInterfaceChanged);
+    const QList<QByteArray> messages = split(load("address_renew.bin"));
+    QVERIFY(!messages.isEmpty());
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; spy.isEmpty() && timer.elapsed() < 4000; ++i) {
+        const QByteArray &message = messages[i % messages.size()];
+        watcher_->processMessages(message.constData(), message.size());
+        QTest::qWait(100);
+    }
+    QCOMPARE(spy.count(), 1);
+    QVERIFY(timer.elapsed() < 2200);
+}
+
+void RouteMonitor_test::benchmarkApply()
+{
+    const QByteArray burst = load("dump.bin") + load("bridge_burst.bin") + load("default_via_bridge.bin") +
+                             load("bridge_down.bin") + load("bridge_removed.bin");
+    qDebug() << "messages per iteration:" << split(burst).size();
+    QBENCHMARK {
+        NetlinkTable_linux table;
+        QSet<int> changedIfIndexes;
+        table.apply(burst.constData(), burst.size(), changedIfIndexes);
+        QVERIFY(table.defaultInterface().isOnline);
+    }
+}
+
+void RouteMonitor_test::benchmarkQueries_data()
+{
+    QTest::addColumn<bool>("isShell");
+
+    QTest::addRow("netlink") << false;
+    QTest::addRow("shell") << true;
+}
+
+void RouteMonitor_test::benchmarkQueries()
+{
+    // the default route, its adapter address and the local IP of this machine: from the live in-memory table, and the
+    // way NetworkUtils_linux used to get them, from /proc/net/route and the ip and hostname pipelines
+    QFETCH(bool, isShell);
+
+    QString gateway, interface, adapterIp;
+    NetworkUtils_linux::getDefaultRoute(gateway, interface, adapterIp, true);
+    if (interface.isEmpty()) {
+        QSKIP("no default route");
+    }
+    QString localIP;
+    QBENCHMARK {
+        if (isShell) {
+            QFile routes("/proc/net/route");
+            QVERIFY(routes.open(QIODevice::ReadOnly));
+            QVERIFY(routes.readAll().contains(interface.toUtf8()));
+            adapterIp = Utils::execCmd(QString("ip -br -4 addr show %1 | grep UP | awk '{print $3}' | cut -d '/' -f 1").arg(interface)).trimmed();
+            localIP = Utils::execCmd("hostname -I | awk '{print $1}'").trimmed();
+        } else {
+            NetworkUtils_linux::getDefaultRoute(gateway, interface, adapterIp, true);
+            localIP = NetworkUtils_linux::getLocalIP();
+        }
+    }
+    qDebug() << interface << gateway << adapterIp << localIP;
+}
+
+QByteArray RouteMonitor_test::load(const QString &name)
+{
+    QFile file(":data/tests/routemonitor/" + name);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+QList<QByteArray> RouteMonitor_test::split(const QByteArray &recording)
+{
+    QList<QByteArray> messages;
+    int offset = 0;
+    while (recording.size() - offset >= static_cast<int>(sizeof(nlmsghdr))) {
+        const nlmsghdr *header = reinterpret_cast<const nlmsghdr *>(recording.constData() + offset);
+        const int len = NLMSG_ALIGN(header->nlmsg_len);
+        if (header->nlmsg_len < sizeof(nlmsghdr) || offset + len > recording.size()) {
+            break;
+        }
+        messages << recording.mid(offset, len);
+        offset += len;
+    }
+    return messages;
+}
+
+void RouteMonitor_test::replay(const QByteArray &recording, int intervalMs)
+{
+    for (const QByteArray &message : split(recording)) {
+        watcher_->processMessages(message.constData(), message.size());
+        if (intervalMs > 0) {
+            QTest::qWait(intervalMs);
+        }
+    }
+}
+
+QTEST_MAIN(RouteMonitor_test)
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QObject>
+#include <QScopedPointer>
+
+#include "engine/networkdetectionmanager/routemonitor_linux.h"
+#include "utils/network_utils/netlinkwatcher_linux.h"
+
+// Replays rtnetlink streams recorded from a socket subscribed to the link, address and route groups of both families
+// (data/tests/routemonitor). The host had eth0 with 192.0.2.2/24 and fd00::2/64, a default route via 192.0.2.1 with
+// metric 100 and one via fd00::1 with metric 1024:
+//   dump.bin                the RTM_GETLINK, RTM_GETADDR and RTM_GETROUTE dumps
+//   bridge_burst.bin        ip link add wsbr0 type bridge, a veth pair in it, everything up, addresses and a route
+//   default_via_bridge.bin  ip route add default via 172.17.0.254 dev wsbr0 metric 50, and the same for IPv6
+//   bridge_down.bin         ip link set wsbr0 down
+//   address_renew.bin       192.0.2.3/24 added to eth0 and removed
+//   bridge_removed.bin      ip link del of the veth pair and the bridge
+class RouteMonitor_test : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+
+    void testInitialTable();
+    void testIPv6Table();
+    void testBurstWithoutDefaultChange();
+    void testDefaultRouteSwitch();
+    void testAddressChangeOnDefaultInterface();
+    void testTransientSwitchIsCollapsed();
+    void testLongBurstIsCapped();
+    void benchmarkApply();
+    void benchmarkQueries_data();
+    void benchmarkQueries();
+
+private:
+    QScopedPointer<NetlinkWatcher_linux> watcher_;
+    QScopedPointer<RouteMonitor_linux> monitor_;
+
+    static QByteArray load(const QString &name);
+    // splits a recording into the separate messages
+    static QList<QByteArray> split(const QByteArray &recording);
+    // feeds the messages one by one with intervalMs between them, as they would arrive from the socket
+    void replay(const QByteArray &recording, int intervalMs = 0);
+};
@@ -3,6 +3,9 @@
 #include "utils/ipvalidation.h"
 #include "utils/logger.h"
 #include "utils/network_utils/network_utils.h"
+#ifdef Q_OS_LINUX
+#include "utils/network_utils/network_utils_linux.h"
+#endif
 
 PacketSizeController::PacketSizeController(QObject *parent)
     : QObject(parent),
@@ -76,7 +79,7 @@ void PacketSizeController::detectAppropriatePacketSizeImpl(const QString &hostna
 
 int PacketSizeController::getIdealPacketSize(const QString &hostname)
 {
-    int mtu = 1470;
+    int mtu = kMaxMtu;
     QString modifiedHostname = hostname;
 
     // if this is IP, use without change
@@ -93,8 +96,19 @@ int PacketSizeController::getIdealPacketSize(const QString &hostname)
 
     qCDebug(LOG_PACKET_SIZE) << "Detecting packet size via:" << modifiedHostname;
 
+#ifdef Q_OS_LINUX
+    mtu = NetworkUtils_linux::discoverMtu(modifiedHostname, kMinMtu, kMaxMtu, [this]() {
+        QMutexLocker locker(&mutex_);
+        return earlyStop_;
+    });
+    if (mtu < 0)
+    {
+        qCDebug(LOG_PACKET_SIZE) << "Couldn't find appropriate MTU -- check internet connection";
+    }
+    return mtu;
+#else
     bool success = false;
-    while (mtu >= 1300)
+    while (mtu >= kMinMtu)
     {
         QMutexLocker locker(&mutex_);
         if (earlyStop_)
@@ -119,4 +133,5 @@ int PacketSizeController::getIdealPacketSize(const QString &hostname)
     }
 
     return mtu;
+#endif
 }
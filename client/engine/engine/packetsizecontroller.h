@@ -30,6 +30,10 @@ private slots:
     void detectAppropriatePacketSizeImpl(const QString &hostname);
 
 private:
+    // ICMP payload sizes, probed with the DF flag set
+    static constexpr int kMinMtu = 1300;
+    static constexpr int kMaxMtu = 1470;
+
     QMutex mutex_;
     bool earlyStop_;
     types::PacketSize packetSize_;
@@ -0,0 +1,159 @@
+#include "packetsizecontroller.test.h"
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QProcess>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "engine/packetsizecontroller.h"
+#include "utils/network_utils/network_utils.h"
+#include "utils/network_utils/network_utils_linux.h"
+
+namespace {
+
+const QString kServer = "10.251.1.2";
+const int kMinMtu = 1300;
+const int kMaxMtu = 1470;
+// IPv4 and ICMP headers
+const int kHeadersSize = 28;
+
+} // namespace
+
+void PacketSizeController_test::initTestCase()
+{
+    if (geteuid() != 0) {
+        QSKIP("needs root to create network namespaces");
+    }
+
+    removeNamespaces();
+    const QStringList commands = {
+        "ip netns add wsmtu_client",
+        "ip netns add wsmtu_router",
+        "ip netns add wsmtu_server",
+        "ip link add wsmtu_c0 netns wsmtu_client type veth peer name wsmtu_r0 netns wsmtu_router",
+        "ip link add wsmtu_r1 netns wsmtu_router type veth peer name wsmtu_s0 netns wsmtu_server",
+        "ip -n wsmtu_client addr add 10.251.0.2/24 dev wsmtu_c0",
+        "ip -n wsmtu_router addr add 10.251.0.1/24 dev wsmtu_r0",
+        "ip -n wsmtu_router addr add 10.251.1.1/24 dev wsmtu_r1",
+        "ip -n wsmtu_server addr add 10.251.1.2/24 dev wsmtu_s0",
+        "ip -n wsmtu_client link set wsmtu_c0 up",
+        "ip -n wsmtu_router link set wsmtu_r0 up",
+        "ip -n wsmtu_router link set wsmtu_r1 up",
+        "ip -n wsmtu_server link set wsmtu_s0 up",
+        "ip -n wsmtu_client route add default via 10.251.0.1",
+        "ip -n wsmtu_server route add default via 10.251.1.1",
+        "ip netns exec wsmtu_router sysctl -qw net.ipv4.ip_forward=1",
+        // ICMP datagram sockets are off in a new namespace
+        "ip netns exec wsmtu_client sysctl -qw net.ipv4.ping_group_range=\"0 2147483647\"",
+    };
+    for (const QString &command : commands) {
+        QVERIFY2(run(command), qPrintable(command));
+    }
+
+    originalNamespaceFd_ = open("/proc/self/ns/net", O_RDONLY | O_CLOEXEC);
+    const int fd = open("/run/netns/wsmtu_client", O_RDONLY | O_CLOEXEC);
+    QVERIFY(fd >= 0);
+    QCOMPARE(setns(fd, CLONE_NEWNET), 0);
+    close(fd);
+}
+
+void PacketSizeController_test::cleanupTestCase()
+{
+    if (originalNamespaceFd_ >= 0) {
+        setns(originalNamespaceFd_, CLONE_NEWNET);
+        close(originalNamespaceFd_);
+        originalNamespaceFd_ = -1;
+    }
+    removeNamespaces();
+}
+
+void PacketSizeController_test::testDiscover_data()
+{
+    QTest::addColumn<int>("routerMtu");
+    QTest::addColumn<int>("expectedMtu");
+
+    QTest::addRow("unclamped") << 1500 << kMaxMtu;
+    QTest::addRow("1400") << 1400 << 1400 - kHeadersSize;
+    QTest::addRow("1350") << 1350 << 1350 - kHeadersSize;
+    QTest::addRow("just above the range") << kMinMtu + kHeadersSize + 1 << kMinMtu + 1;
+    QTest::addRow("the smallest") << kMinMtu + kHeadersSize << kMinMtu;
+    QTest::addRow("below the range") << kMinMtu + kHeadersSize - 1 << -1;
+}
+
+void PacketSizeController_test::testDiscover()
+{
+    QFETCH(int, routerMtu);
+    QFETCH(int, expectedMtu);
+
+    QVERIFY(setRouterMtu(routerMtu));
+    QElapsedTimer timer;
+    timer.start();
+    QCOMPARE(NetworkUtils_linux::discoverMtu(kServer, kMinMtu, kMaxMtu), expectedMtu);
+    // a few round trips on the veths, while the old linear search needed up to 18 pings
+    QVERIFY(timer.elapsed() < 500);
+}
+
+void PacketSizeController_test::testLocalLinkMtu()
+{
+    // the probes above the MTU of the outgoing interface fail on sendto() without leaving the host
+    QVERIFY(setRouterMtu(1500));
+    QVERIFY(run("ip -n wsmtu_client link set wsmtu_c0 mtu 1420"));
+    QCOMPARE(NetworkUtils_linux::discoverMtu(kServer, kMinMtu, kMaxMtu), 1420 - kHeadersSize);
+    QVERIFY(run("ip -n wsmtu_client link set wsmtu_c0 mtu 1500"));
+}
+
+void PacketSizeController_test::testPingWithMtu()
+{
+    QVERIFY(setRouterMtu(1400));
+    QVERIFY(NetworkUtils::pingWithMtu(kServer, 1400 - kHeadersSize));
+    QVERIFY(!NetworkUtils::pingWithMtu(kServer, 1400 - kHeadersSize + 1));
+}
+
+void PacketSizeController_test::testUnreachableHost()
+{
+    QVERIFY(setRouterMtu(1500));
+    QCOMPARE(NetworkUtils_linux::discoverMtu(kServer, kMinMtu, kMaxMtu, []() { return true; }), -1);
+    // nothing answers, every round waits for the timeout
+    QElapsedTimer timer;
+    timer.start();
+    QCOMPARE(NetworkUtils_linux::discoverMtu("10.251.9.9", kMinMtu, kMaxMtu), -1);
+    qDebug() << "gave up after" << timer.elapsed() << "ms";
+}
+
+void PacketSizeController_test::testPacketSizeController()
+{
+    QVERIFY(setRouterMtu(1400));
+    PacketSizeController controller;
+    QSignalSpy changedSpy(&controller, &PacketSizeController::packetSizeChanged);
+    QSignalSpy finishedSpy(&controller, &PacketSizeController::finishedPacketSizeDetection);
+    // the controller lives in this thread, so the detection runs right away
+    controller.detectAppropriatePacketSize(kServer);
+    QCOMPARE(finishedSpy.count(), 1);
+    QCOMPARE(finishedSpy.at(0).at(0).toBool(), false);
+    QCOMPARE(changedSpy.count(), 1);
+    QCOMPARE(changedSpy.at(0).at(1).toInt(), 1400 - kHeadersSize);
+}
+
+bool PacketSizeController_test::run(const QString &command)
+{
+    QStringList arguments = QProcess::splitCommand(command);
+    const QString program = arguments.takeFirst();
+    return QProcess::execute(program, arguments) == 0;
+}
+
+bool PacketSizeController_test::setRouterMtu(int mtu)
+{
+    return run(QString("ip -n wsmtu_router link set wsmtu_r1 mtu %1").arg(mtu)) &&
+           run(QString("ip -n wsmtu_server link set wsmtu_s0 mtu %1").arg(mtu));
+}
+
+void PacketSizeController_test::removeNamespaces()
+{
+    for (const QString &name : { "wsmtu_client", "wsmtu_router", "wsmtu_server" }) {
+        QProcess::execute("ip", QStringList() << "netns" << "del" << name);
+    }
+}
+
+QTEST_MAIN(PacketSizeController_test)
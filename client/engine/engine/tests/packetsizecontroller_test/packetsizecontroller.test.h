@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QObject>
+#include <QString>
+
+// Path MTU discovery through a router with an MTU-clamped veth. Needs root: the test builds three network namespaces
+//   client 10.251.0.2 -- 10.251.0.1 router 10.251.1.1 -- 10.251.1.2 server
+// and runs in the client one. The router forwards and answers the probes that don't fit into its server side link
+// with fragmentation-needed.
+class PacketSizeController_test : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testDiscover_data();
+    void testDiscover();
+    void testLocalLinkMtu();
+    void testPingWithMtu();
+    void testUnreachableHost();
+    void testPacketSizeController();
+
+private:
+    int originalNamespaceFd_ = -1;
+
+    static bool run(const QString &command);
+    static bool setRouterMtu(int mtu);
+    static void removeNamespaces();
+};
@@ -0,0 +1,126 @@
+#include "clienttrafficstats.h"
+#include <chrono>
+
+int ClientTraffic::consume(quint64 bytes)
+{
+    const qint64 rate = rateLimitBytesPerSec_.load(std::memory_order_relaxed);
+    if (rate <= 0)
+    {
+        return 0;
+    }
+
+    const qint64 now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    const qint64 costNs = static_cast<qint64>(bytes * 1000000000.0 / rate);
+    qint64 fullAt = fullAtNs_.load(std::memory_order_relaxed);
+    qint64 newFullAt;
+    do
+    {
+        newFullAt = std::max(fullAt, now) + costNs;
+    } while (!fullAtNs_.compare_exchange_weak(fullAt, newFullAt, std::memory_order_relaxed));
+
+    // whatever doesn't fit in the burst has to be waited out
+    const qint64 excessNs = newFullAt - now - kBurstNs;
+    return excessNs > 0 ? static_cast<int>((excessNs + 999999) / 1000000) : 0;
+}
+
+ClientTrafficStats::ClientTrafficStats() : defaultRateLimit_(0), isEnabled_(true)
+{
+}
+
+std::shared_ptr<ClientTraffic> ClientTrafficStats::connectionOpened(const QHostAddress &address)
+{
+    if (!isEnabled_)
+    {
+        return nullptr;
+    }
+
+    QMutexLocker locker(&mutex_);
+    std::shared_ptr<ClientTraffic> &traffic = clients_[address];
+    if (!traffic)
+    {
+        traffic = std::make_shared<ClientTraffic>();
+        traffic->rateLimitBytesPerSec_ = static_cast<qint64>(rateLimitFor(address)) * 1024;
+    }
+    traffic->activeConnections_++;
+    traffic->totalConnections_++;
+    return traffic;
+}
+
+void ClientTrafficStats::connectionClosed(const std::shared_ptr<ClientTraffic> &traffic)
+{
+    if (traffic)
+    {
+        traffic->activeConnections_--;
+    }
+}
+
+void ClientTrafficStats::setRateLimit(const QHostAddress &address, quint32 kbytesPerSec)
+{
+    QMutexLocker locker(&mutex_);
+    if (kbytesPerSec > 0)
+    {
+        rateLimits_[address] = kbytesPerSec;
+    }
+    else
+    {
+        rateLimits_.remove(address);
+    }
+    auto it = clients_.find(address);
+    if (it != clients_.end())
+    {
+        it.value()->rateLimitBytesPerSec_ = static_cast<qint64>(rateLimitFor(address)) * 1024;
+    }
+}
+
+void ClientTrafficStats::setDefaultRateLimit(quint32 kbytesPerSec)
+{
+    QMutexLocker locker(&mutex_);
+    defaultRateLimit_ = kbytesPerSec;
+    for (auto it = clients_.begin(); it != clients_.end(); ++it)
+    {
+        it.value()->rateLimitBytesPerSec_ = static_cast<qint64>(rateLimitFor(it.key())) * 1024;
+    }
+}
+
+QVector<types::ProxySharingClientStats> ClientTrafficStats::snapshot() const
+{
+    QMutexLocker locker(&mutex_);
+    QVector<types::ProxySharingClientStats> stats;
+    stats.reserve(clients_.size());
+    for (auto it = clients_.cbegin(); it != clients_.cend(); ++it)
+    {
+        const ClientTraffic &traffic = *it.value();
+        types::ProxySharingClientStats s;
+        s.address = it.key().toString();
+        s.activeConnections = traffic.activeConnections_.load(std::memory_order_relaxed);
+        s.totalConnections = traffic.totalConnections_.load(std::memory_order_relaxed);
+        s.bytesUploaded = traffic.bytesUploaded_.load(std::memory_order_relaxed);
+        s.bytesDownloaded = traffic.bytesDownloaded_.load(std::memory_order_relaxed);
+        s.rateLimitKBps = traffic.rateLimitBytesPerSec_.load(std::memory_order_relaxed) / 1024;
+        stats << s;
+    }
+    return stats;
+}
+
+void ClientTrafficStats::reset()
+{
+    QMutexLocker locker(&mutex_);
+    for (auto it = clients_.begin(); it != clients_.end(); )
+    {
+        ClientTraffic &traffic = *it.value();
+        if (traffic.activeConnections_ <= 0)
+        {
+            it = clients_.erase(it);
+            continue;
+        }
+        traffic.bytesUploaded_ = 0;
+        traffic.bytesDownloaded_ = 0;
+        traffic.totalConnections_ = traffic.activeConnections_.load();
+        ++it;
+    }
+}
+
+quint32 ClientTrafficStats::rateLimitFor(const QHostAddress &address) const
+{
+    return rateLimits_.value(address, defaultRateLimit_);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QHash>
+#include <QHostAddress>
+#include <QMutex>
+#include <QVector>
+#include <atomic>
+#include <memory>
+#include "types/proxysharingclientstats.h"
+
+// Counters of one LAN client. All its connections update them on their relay paths, from any thread and without locks.
+class ClientTraffic
+{
+public:
+    void addUploaded(quint64 bytes) { bytesUploaded_.fetch_add(bytes, std::memory_order_relaxed); }
+    void addDownloaded(quint64 bytes) { bytesDownloaded_.fetch_add(bytes, std::memory_order_relaxed); }
+
+    bool isRateLimited() const { return rateLimitBytesPerSec_.load(std::memory_order_relaxed) > 0; }
+    // Takes the bytes from the client's token bucket, which is shared by both directions of all its connections.
+    // Returns how many milliseconds the caller should pause before transferring more, 0 if it's within the limit.
+    int consume(quint64 bytes);
+
+private:
+    friend class ClientTrafficStats;
+    // the bucket holds this much time worth of traffic
+    static constexpr qint64 kBurstNs = 250 * 1000 * 1000;
+
+    std::atomic<quint64> bytesUploaded_{0};
+    std::atomic<quint64> bytesDownloaded_{0};
+    std::atomic<int> activeConnections_{0};
+    std::atomic<quint64> totalConnections_{0};
+    std::atomic<qint64> rateLimitBytesPerSec_{0};
+    // the bucket as in GCRA: the moment it would be full again, so that a single CAS takes tokens and refills it
+    std::atomic<qint64> fullAtNs_{0};
+};
+
+// Traffic of the proxy sharing clients, keyed by their binary (normalized) addresses. Thread safe; the registry is only
+// locked when connections open and close and for snapshots, never while relaying.
+class ClientTrafficStats
+{
+public:
+    static ClientTrafficStats &instance()
+    {
+        static ClientTrafficStats s;
+        return s;
+    }
+
+    // the accounting can be turned off to measure its overhead
+    bool isEnabled() const { return isEnabled_; }
+    void setEnabled(bool isEnabled) { isEnabled_ = isEnabled; }
+
+    // returns nullptr if the accounting is disabled
+    std::shared_ptr<ClientTraffic> connectionOpened(const QHostAddress &address);
+    void connectionClosed(const std::shared_ptr<ClientTraffic> &traffic);
+
+    // 0 removes the limit; the default limit applies to the clients without a limit of their own
+    void setRateLimit(const QHostAddress &address, quint32 kbytesPerSec);
+    void setDefaultRateLimit(quint32 kbytesPerSec);
+
+    QVector<types::ProxySharingClientStats> snapshot() const;
+    // forgets the clients without connections and zeroes the counters of the others, the limits are kept
+    void reset();
+
+private:
+    ClientTrafficStats();
+
+    mutable QMutex mutex_;
+    QHash<QHostAddress, std::shared_ptr<ClientTraffic>> clients_;
+    QHash<QHostAddress, quint32> rateLimits_;
+    quint32 defaultRateLimit_;
+    std::atomic<bool> isEnabled_;
+
+    quint32 rateLimitFor(const QHostAddress &address) const;
+};
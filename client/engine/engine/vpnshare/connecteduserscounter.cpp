@@ -6,23 +6,23 @@ ConnectedUsersCounter::ConnectedUsersCounter(QObject *parent) : QObject(parent)
     lastCnt_ = 0;
 }
 
-void ConnectedUsersCounter::newUserConnected(const QString &hostname)
+void ConnectedUsersCounter::newUserConnected(const QHostAddress &address)
 {
-    auto it = connections_.find(hostname);
+    auto it = connections_.find(address);
     if (it != connections_.end())
     {
         it.value()++;
     }
     else
     {
-        connections_[hostname] = 1;
+        connections_[address] = 1;
     }
     checkUsersCount();
 }
 
-void ConnectedUsersCounter::userDiconnected(const QString &hostname)
+void ConnectedUsersCounter::userDiconnected(const QHostAddress &address)
 {
-    auto it = connections_.find(hostname);
+    auto it = connections_.find(address);
     if (it != connections_.end())
     {
         it.value()--;
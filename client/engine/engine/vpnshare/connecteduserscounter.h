@@ -1,15 +1,17 @@
 #pragma once
 
 #include <QObject>
-#include <QMap>
+#include <QHash>
+#include <QHostAddress>
 
+// Counts the devices with open proxy connections, keyed by their binary (normalized) addresses.
 class ConnectedUsersCounter : public QObject
 {
     Q_OBJECT
 public:
     explicit ConnectedUsersCounter(QObject *parent);
-    void newUserConnected(const QString &hostname);
-    void userDiconnected(const QString &hostname);
+    void newUserConnected(const QHostAddress &address);
+    void userDiconnected(const QHostAddress &address);
     void reset();
 
     int getConnectedUsersCount();
@@ -19,7 +21,7 @@ signals:
 
 private:
     enum { MAX_NOT_ACTIVITY_TIME = 10000 };
-    QMap<QString, int> connections_;
+    QHash<QHostAddress, int> connections_;
     int lastCnt_;
 
     void checkUsersCount();
@@ -1,21 +1,37 @@
 #include "httpproxyconnection.h"
 #include <QThread>
+#include <QTimer>
 #include <QHostAddress>
 #include "utils/ws_assert.h"
 #include "utils/logger.h"
 
+#ifdef Q_OS_LINUX
+    #include <unistd.h>
+    #include "../socketutils/splicerelay.h"
+#endif
+
 namespace HttpProxyServer {
 
 
-HttpProxyConnection::HttpProxyConnection(qintptr socketDescriptor, const QString &hostname, QObject *parent) : QObject(parent),
+HttpProxyConnection::HttpProxyConnection(qintptr socketDescriptor, const QHostAddress &peerAddress, QObject *parent) : QObject(parent),
     socket_(nullptr), socketExternal_(nullptr), socketDescriptor_(socketDescriptor),
-    hostname_(hostname), state_(READ_CLIENT_REQUEST), writeAllSocket_(nullptr),
-    writeAllSocketExternal_(nullptr), httpError_(), bAlreadyClosedAndEmitFinished_(false)
+    peerAddress_(peerAddress), hostname_(peerAddress.toString()), state_(READ_CLIENT_REQUEST), writeAllSocket_(nullptr),
+    writeAllSocketExternal_(nullptr), httpError_(), bAlreadyClosedAndEmitFinished_(false), isThrottled_(false), spliceRelayId_(0)
 {
     httpError_.status = HttpProxyReply::ok;
     //qDebug() << QThread::currentThreadId();
 }
 
+HttpProxyConnection::~HttpProxyConnection()
+{
+#ifdef Q_OS_LINUX
+    if (spliceRelayId_ != 0)
+    {
+        SpliceRelay::instance().remove(spliceRelayId_);
+    }
+#endif
+}
+
 void HttpProxyConnection::forceClose()
 {
     closeSocketsAndEmitFinished();
@@ -31,6 +47,8 @@ void HttpProxyConnection::start()
     }
 
     state_ = READ_CLIENT_REQUEST;
+    traffic_ = ClientTrafficStats::instance().connectionOpened(peerAddress_);
+    socket_->setReadBufferSize(SocketWriteAll::kPeerReadBufferSize);
     connect(socket_, &QTcpSocket::disconnected, this, &HttpProxyConnection::onSocketDisconnected);
     connect(socket_, &QTcpSocket::readyRead, this, &HttpProxyConnection::onSocketReadyRead);
     writeAllSocket_ = new SocketWriteAll(this, socket_);
@@ -44,6 +62,12 @@ void HttpProxyConnection::onSocketDisconnected()
 
 void HttpProxyConnection::onSocketReadyRead()
 {
+    if ((state_ == RELAY_BETWEEN_CLIENT_SERVER || state_ == READ_HEADERS_FROM_WEBSERVER) && (isThrottled_ || writeAllSocketExternal_->isFull()))
+    {
+        // leave the data in the socket's bounded read buffer until the external server catches up
+        return;
+    }
+
     QByteArray arr = socket_->readAll();
 
     if (state_ == READ_CLIENT_REQUEST)
@@ -62,6 +86,7 @@ void HttpProxyConnection::onSocketReadyRead()
             if (requestParser_.getRequest().extractHostAndPort())
             {
                 socketExternal_ = new QTcpSocket(this);
+                socketExternal_->setReadBufferSize(SocketWriteAll::kPeerReadBufferSize);
 
                 connect(socketExternal_, &QTcpSocket::connected, this, &HttpProxyConnection::onExternalSocketConnected);
                 connect(socketExternal_, &QTcpSocket::disconnected, this, &HttpProxyConnection::onExternalSocketDisconnected);
@@ -69,6 +94,9 @@ void HttpProxyConnection::onSocketReadyRead()
                 connect(socketExternal_, &QTcpSocket::errorOccurred, this, &HttpProxyConnection::onExternalSocketError);
 
                 writeAllSocketExternal_ = new SocketWriteAll(this, socketExternal_);
+                // resume reading from the side that was paused because the other side's write queue was full
+                connect(writeAllSocketExternal_, &SocketWriteAll::writeQueueDrained, this, &HttpProxyConnection::onSocketReadyRead);
+                connect(writeAllSocket_, &SocketWriteAll::writeQueueDrained, this, &HttpProxyConnection::onExternalSocketReadyRead);
 
                 state_ = CONNECTING_TO_EXTERNAL_SERVER;
                 socketExternal_->connectToHost(QString::fromStdString(requestParser_.getRequest().host), requestParser_.getRequest().port);
@@ -100,6 +128,7 @@ void HttpProxyConnection::onSocketReadyRead()
     else if (state_ == RELAY_BETWEEN_CLIENT_SERVER  || state_ == READ_HEADERS_FROM_WEBSERVER)
     {
         writeAllSocketExternal_->write(arr);
+        accountTraffic(arr.size(), true);
     }
     else
     {
@@ -126,6 +155,11 @@ void HttpProxyConnection::onExternalSocketConnected()
                 extraContent_.clear();
             }
             state_ = RELAY_BETWEEN_CLIENT_SERVER;
+
+            // the tunnel is handed to the kernel relay once the reply and everything queued so far are written
+            connect(socket_, &QTcpSocket::bytesWritten, this, &HttpProxyConnection::tryStartSpliceRelay);
+            connect(socketExternal_, &QTcpSocket::bytesWritten, this, &HttpProxyConnection::tryStartSpliceRelay);
+            tryStartSpliceRelay();
         }
         else
         {
@@ -178,7 +212,14 @@ void HttpProxyConnection::onExternalSocketDisconnected()
 
 void HttpProxyConnection::onExternalSocketReadyRead()
 {
+    if (isThrottled_ || writeAllSocket_->isFull())
+    {
+        // leave the data in the socket's bounded read buffer until the client catches up
+        return;
+    }
+
     QByteArray arr = socketExternal_->readAll();
+    accountTraffic(arr.size(), false);
     if (state_ == RELAY_BETWEEN_CLIENT_SERVER)
     {
         writeAllSocket_->write(arr);
@@ -228,11 +269,118 @@ void HttpProxyConnection::onExternalSocketError(QAbstractSocket::SocketError soc
     }
 }
 
+void HttpProxyConnection::tryStartSpliceRelay()
+{
+#ifdef Q_OS_LINUX
+    if (state_ != RELAY_BETWEEN_CLIENT_SERVER || spliceRelayId_ != 0 || bAlreadyClosedAndEmitFinished_ || !SpliceRelay::instance().isEnabled())
+    {
+        return;
+    }
+    // the kernel relay can't be paused, the rate limited clients stay on the Qt path
+    if (traffic_ && traffic_->isRateLimited())
+    {
+        return;
+    }
+    // data buffered by Qt or SocketWriteAll would be reordered with the spliced data, so wait until both sides are drained
+    if (!writeAllSocket_->isEmpty() || !writeAllSocketExternal_->isEmpty() ||
+        socket_->bytesToWrite() > 0 || socketExternal_->bytesToWrite() > 0 ||
+        socket_->bytesAvailable() > 0 || socketExternal_->bytesAvailable() > 0)
+    {
+        return;
+    }
+
+    int fd = dup(socket_->socketDescriptor());
+    int fdExternal = dup(socketExternal_->socketDescriptor());
+    if (fd < 0 || fdExternal < 0)
+    {
+        if (fd >= 0) close(fd);
+        if (fdExternal >= 0) close(fdExternal);
+        return;
+    }
+
+    std::function<void(int, size_t)> onTransferred;
+    if (traffic_)
+    {
+        onTransferred = [traffic = traffic_](int side, size_t bytes) {
+            side == 0 ? traffic->addUploaded(bytes) : traffic->addDownloaded(bytes);
+        };
+    }
+    spliceRelayId_ = SpliceRelay::instance().add(fd, fdExternal, [this]() {
+        QMetaObject::invokeMethod(this, [this]() { onSpliceRelayFinished(); }, Qt::QueuedConnection);
+    }, onTransferred);
+    if (spliceRelayId_ == 0)
+    {
+        // keep relaying through Qt
+        return;
+    }
+
+    // the relay owns duplicates of the descriptors now, Qt must not read from them anymore
+    socket_->disconnect();
+    socketExternal_->disconnect();
+    socket_->abort();
+    socketExternal_->abort();
+#endif
+}
+
+void HttpProxyConnection::onThrottleTimeout()
+{
+    isThrottled_ = false;
+    if (!bAlreadyClosedAndEmitFinished_ && (state_ == RELAY_BETWEEN_CLIENT_SERVER || state_ == READ_HEADERS_FROM_WEBSERVER))
+    {
+        onSocketReadyRead();
+        onExternalSocketReadyRead();
+    }
+}
+
+void HttpProxyConnection::accountTraffic(qint64 bytes, bool isUpload)
+{
+    if (!traffic_ || bytes <= 0)
+    {
+        return;
+    }
+    isUpload ? traffic_->addUploaded(bytes) : traffic_->addDownloaded(bytes);
+    const int delayMs = traffic_->consume(bytes);
+    if (delayMs > 0 && !isThrottled_)
+    {
+        isThrottled_ = true;
+        QTimer::singleShot(delayMs, this, &HttpProxyConnection::onThrottleTimeout);
+    }
+}
+
+void HttpProxyConnection::onSpliceRelayFinished()
+{
+    spliceRelayId_ = 0;
+    closeSocketsAndEmitFinished();
+}
+
+void HttpProxyConnection::logQueueStats()
+{
+    // only the connections that had to pause reading are worth a line in the log
+    const SocketWriteAll::QueueStats client = writeAllSocket_ ? writeAllSocket_->queueStats() : SocketWriteAll::QueueStats();
+    const SocketWriteAll::QueueStats external = writeAllSocketExternal_ ? writeAllSocketExternal_->queueStats() : SocketWriteAll::QueueStats();
+    if (client.pausesCount > 0 || external.pausesCount > 0)
+    {
+        qCDebug(LOG_HTTP_SERVER) << "Write queues of" << hostname_ << "- to client: max" << client.maxQueuedBytes << "bytes,"
+                                 << client.pausesCount << "pauses; to server: max" << external.maxQueuedBytes << "bytes,"
+                                 << external.pausesCount << "pauses";
+    }
+}
+
 void HttpProxyConnection::closeSocketsAndEmitFinished()
 {
     if (!bAlreadyClosedAndEmitFinished_)
     {
         bAlreadyClosedAndEmitFinished_ = true;
+        logQueueStats();
+        ClientTrafficStats::instance().connectionClosed(traffic_);
+        traffic_.reset();
+#ifdef Q_OS_LINUX
+        if (spliceRelayId_ != 0)
+        {
+            SpliceRelay::instance().remove(spliceRelayId_);
+            spliceRelayId_ = 0;
+        }
+#endif
         if (socket_)
         {
             socket_->close();
@@ -241,7 +389,7 @@ void HttpProxyConnection::closeSocketsAndEmitFinished()
         {
             socketExternal_->close();
         }
-        emit finished(hostname_);
+        emit finished(peerAddress_);
     }
 }
 
@@ -6,6 +6,7 @@
 #include "httpproxywebanswerparser.h"
 #include "httpproxyreply.h"
 #include "../socketutils/socketwriteall.h"
+#include "../clienttrafficstats.h"
 
 namespace HttpProxyServer {
 
@@ -13,7 +14,8 @@ class HttpProxyConnection : public QObject
 {
     Q_OBJECT
 public:
-    explicit HttpProxyConnection(qintptr socketDescriptor, const QString &hostname, QObject *parent = nullptr);
+    explicit HttpProxyConnection(qintptr socketDescriptor, const QHostAddress &peerAddress, QObject *parent = nullptr);
+    ~HttpProxyConnection();
 
     bool start(qintptr socketDescriptor);
 
@@ -22,7 +24,7 @@ public slots:
     void forceClose();
 
 signals:
-    void finished(const QString &hostname);
+    void finished(const QHostAddress &peerAddress);
 
 private slots:
     void onSocketDisconnected();
@@ -35,10 +37,15 @@ private slots:
     void onExternalSocketReadyRead();
     void onExternalSocketError(QAbstractSocket::SocketError socketError);
 
+    void tryStartSpliceRelay();
+    void onThrottleTimeout();
+
 private:
     QTcpSocket *socket_;
     QTcpSocket *socketExternal_;
     qintptr socketDescriptor_;
+    QHostAddress peerAddress_;
+    // the peer address as a string for the log
     QString hostname_;
 
     const char *reply_established_ = "HTTP/1.0 200 Connection established\r\nProxy-agent: Windscribe\r\n\r\n";
@@ -56,6 +63,16 @@ private:
 
     bool bAlreadyClosedAndEmitFinished_;
     void closeSocketsAndEmitFinished();
+    void logQueueStats();
+
+    std::shared_ptr<ClientTraffic> traffic_;
+    // both directions are paused while the client is over its rate limit
+    bool isThrottled_;
+    void accountTraffic(qint64 bytes, bool isUpload);
+
+    // id of the kernel relay (Linux only) that took over the sockets of an established CONNECT tunnel, 0 if none
+    quint64 spliceRelayId_;
+    void onSpliceRelayFinished();
 };
 
 } // namespace HttpProxyServer
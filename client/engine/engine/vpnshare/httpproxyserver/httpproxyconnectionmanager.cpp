@@ -3,6 +3,7 @@
 #include <QThread>
 #include <QTimer>
 #include "utils/ws_assert.h"
+#include "../socketutils/peeraddress.h"
 
 namespace HttpProxyServer {
 
@@ -20,18 +21,10 @@ HttpProxyConnectionManager::HttpProxyConnectionManager(QObject *parent, int thre
 
 void HttpProxyConnectionManager::newConnection(qintptr socketDescriptor)
 {
-#ifdef Q_OS_WIN
-    SOCKADDR_IN  addr = {0};
-    int addr_len = sizeof(addr);
-#elif defined (Q_OS_MAC) || defined (Q_OS_LINUX)
-    sockaddr_in addr;
-    socklen_t addr_len = sizeof(addr);
-#endif
-    getpeername(socketDescriptor, (sockaddr*)&addr, &addr_len);
-    char *ip = inet_ntoa(addr.sin_addr);
-    usersCounter_->newUserConnected(ip);
+    const QHostAddress peerAddress = PeerAddress::ofSocket(socketDescriptor);
+    usersCounter_->newUserConnected(peerAddress);
     QThread *thread = getLessBusyThread();
-    HttpProxyConnection *connection = new HttpProxyConnection(socketDescriptor, ip);
+    HttpProxyConnection *connection = new HttpProxyConnection(socketDescriptor, peerAddress);
     connect(connection, &HttpProxyConnection::finished, this, &HttpProxyConnectionManager::onConnectionFinished);
     addConnectionToThread(thread, connection);
 
@@ -58,10 +51,10 @@ void HttpProxyConnectionManager::stop()
     }
 }
 
-void HttpProxyConnectionManager::onConnectionFinished(const QString &hostname)
+void HttpProxyConnectionManager::onConnectionFinished(const QHostAddress &peerAddress)
 {
     HttpProxyConnection *connection = static_cast<HttpProxyConnection *>(sender());
-    usersCounter_->userDiconnected(hostname);
+    usersCounter_->userDiconnected(peerAddress);
     //qDebug() << "Connection finished:" << connection;
     QMap<HttpProxyConnection *, QThread *>::iterator it = connections_.find(connection);
     WS_ASSERT(it != connections_.end());
@@ -231,11 +231,8 @@ int HttpProxyRequest::extractUrl(const char *url, int default_port)
 
     port = (portRet != 0) ? portRet : default_port;
 
-    // Remove any surrounding '[' and ']' from IPv6 literals
-    host.insert(host.begin(), '[');
-    host.insert(host.end(), ']');
-    p = strrchr ((char *)host.c_str(), ']');
-    if (p && (*(host.c_str()) == '['))
+    // Remove any surrounding '[' and ']' from IPv6 literals, so that "[::1]:443" connects to ::1
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']')
     {
         host.erase(host.begin());
         host.erase(host.end() - 1);
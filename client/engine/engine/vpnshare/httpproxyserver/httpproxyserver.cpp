@@ -1,6 +1,9 @@
 #include "httpproxyserver.h"
 #include "utils/ws_assert.h"
 #include "utils/logger.h"
+#include "../socketutils/peeraddress.h"
+
+#include <QTcpSocket>
 
 namespace HttpProxyServer {
 
@@ -20,7 +23,8 @@ bool HttpProxyServer::startServer(quint16 port)
 {
     WS_ASSERT(!isListening());
 
-    if (listen(QHostAddress::AnyIPv4, port))
+    // QHostAddress::Any is a dual-stack socket, IPv4 only is the fallback for the systems with IPv6 disabled
+    if (listen(QHostAddress::Any, port) || listen(QHostAddress::AnyIPv4, port))
     {
         qCDebug(LOG_HTTP_SERVER) << "Http proxy server started on port" << serverPort();
         return true;
@@ -55,6 +59,13 @@ void HttpProxyServer::closeActiveConnections()
 
 void HttpProxyServer::incomingConnection(qintptr socketDescriptor)
 {
+    if (!PeerAddress::isLocalNetwork(PeerAddress::ofSocket(socketDescriptor)))
+    {
+        QTcpSocket socket;
+        socket.setSocketDescriptor(socketDescriptor);
+        socket.abort();
+        return;
+    }
     connectionManager_->newConnection(socketDescriptor);
 }
 
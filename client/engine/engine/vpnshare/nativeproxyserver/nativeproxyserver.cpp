@@ -0,0 +1,149 @@
+#include "nativeproxyserver.h"
+#include "utils/ws_assert.h"
+#include "utils/logger.h"
+
+namespace NativeProxyServer {
+
+NativeProxyServer::NativeProxyServer(QObject *parent, NativeProxyProtocol protocol) : QObject(parent),
+    protocol_(protocol), logCategory_(protocol == NativeProxyProtocol::kHttp ? LOG_HTTP_SERVER : LOG_SOCKS_SERVER), port_(0)
+{
+    usersCounter_ = new ConnectedUsersCounter(this);
+    connect(usersCounter_, &ConnectedUsersCounter::usersCountChanged, this, &NativeProxyServer::usersCountChanged);
+}
+
+NativeProxyServer::~NativeProxyServer()
+{
+    stopServer();
+}
+
+bool NativeProxyServer::startServer(quint16 port)
+{
+    WS_ASSERT(workers_.empty());
+
+    // the counter is not thread safe, the workers report to it through this thread's event loop
+    NativeProxyWorker::Callbacks callbacks;
+    callbacks.onSessionOpened = [this](const QHostAddress &peerAddress) {
+        QMetaObject::invokeMethod(usersCounter_, [this, peerAddress]() {
+            usersCounter_->newUserConnected(peerAddress);
+        }, Qt::QueuedConnection);
+    };
+    callbacks.onSessionClosed = [this](const QHostAddress &peerAddress) {
+        QMetaObject::invokeMethod(usersCounter_, [this, peerAddress]() {
+            usersCounter_->userDiconnected(peerAddress);
+        }, Qt::QueuedConnection);
+    };
+
+    const unsigned int workersCount = qBound(1u, std::thread::hardware_concurrency(), kMaxWorkers);
+    for (unsigned int i = 0; i < workersCount; ++i)
+    {
+        workers_.emplace_back(new NativeProxyWorker(protocol_, callbacks));
+    }
+
+#ifdef Q_OS_LINUX
+    const bool isReusePort = true;
+#else
+    // elsewhere SO_REUSEPORT doesn't balance the connections between the sockets
+    const bool isReusePort = false;
+#endif
+
+    // dual-stack, IPv4 only is the fallback for the systems with IPv6 disabled
+    boost::system::error_code ec;
+    boost::asio::ip::address anyAddress = boost::asio::ip::address_v6::any();
+    if (!workers_[0]->listen(boost::asio::ip::tcp::endpoint(anyAddress, port), isReusePort, ec))
+    {
+        anyAddress = boost::asio::ip::address_v4::any();
+        workers_[0]->listen(boost::asio::ip::tcp::endpoint(anyAddress, port), isReusePort, ec);
+    }
+    if (ec)
+    {
+        qCDebug(logCategory_) << "Can't start native proxy server on port" << port << ":" << QString::fromStdString(ec.message());
+        workers_.clear();
+        return false;
+    }
+    port_ = workers_[0]->localPort();
+
+    bool isAcceptorPerWorker = isReusePort;
+    for (size_t i = 1; i < workers_.size() && isAcceptorPerWorker; ++i)
+    {
+        isAcceptorPerWorker = workers_[i]->listen(boost::asio::ip::tcp::endpoint(anyAddress, port_), true, ec);
+    }
+    if (!isAcceptorPerWorker)
+    {
+        std::vector<NativeProxyWorker *> targets;
+        for (auto &worker : workers_)
+        {
+            targets.push_back(worker.get());
+        }
+        workers_[0]->setAcceptTargets(targets);
+        // a worker that did get its acceptor keeps it, the kernel still spreads connections between the two
+    }
+
+    for (auto &worker : workers_)
+    {
+        worker->start();
+    }
+    qCDebug(logCategory_) << "Native proxy server started on port" << port_ << "with" << workers_.size() << "workers,"
+                          << (isAcceptorPerWorker ? "acceptor per worker" : "shared acceptor");
+    return true;
+}
+
+void NativeProxyServer::stopServer()
+{
+    if (!workers_.empty())
+    {
+        qCDebug(logCategory_) << "Native proxy server stopped on port" << port_;
+    }
+    for (auto &worker : workers_)
+    {
+        worker->stop();
+    }
+    workers_.clear();
+}
+
+quint16 NativeProxyServer::serverPort() const
+{
+    return port_;
+}
+
+int NativeProxyServer::getConnectedUsersCount()
+{
+    return usersCounter_->getConnectedUsersCount();
+}
+
+void NativeProxyServer::closeActiveConnections()
+{
+    for (auto &worker : workers_)
+    {
+        worker->closeAllSessions();
+    }
+}
+
+void NativeProxyServer::setIdleTimeouts(int handshakeTimeoutMs, int relayTimeoutMs)
+{
+    for (auto &worker : workers_)
+    {
+        worker->setIdleTimeouts(handshakeTimeoutMs, relayTimeoutMs);
+    }
+}
+
+int NativeProxyServer::activeConnectionsCount() const
+{
+    int count = 0;
+    for (const auto &worker : workers_)
+    {
+        count += worker->sessionsCount();
+    }
+    return count;
+}
+
+quint64 NativeProxyServer::reapedConnectionsCount() const
+{
+    quint64 count = 0;
+    for (const auto &worker : workers_)
+    {
+        count += worker->reapedCount();
+    }
+    return count;
+}
+
+} // namespace NativeProxyServer
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QLoggingCategory>
+#include <QObject>
+#include <memory>
+#include <vector>
+#include "nativeproxyworker.h"
+#include "../connecteduserscounter.h"
+
+namespace NativeProxyServer {
+
+// Optional replacement of HttpProxyServer and SocksProxyServer with the same interface: one boost::asio io_service
+// thread per core instead of QThreads with a Qt event loop per connection.
+class NativeProxyServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit NativeProxyServer(QObject *parent, NativeProxyProtocol protocol);
+    virtual ~NativeProxyServer();
+
+    bool startServer(quint16 port);
+    void stopServer();
+    quint16 serverPort() const;
+
+    int getConnectedUsersCount();
+
+    void closeActiveConnections();
+
+    // for tests, the defaults are 30 seconds until the proxy request is handled and 10 minutes of silence while relaying
+    void setIdleTimeouts(int handshakeTimeoutMs, int relayTimeoutMs);
+    int activeConnectionsCount() const;
+    quint64 reapedConnectionsCount() const;
+
+signals:
+    void usersCountChanged();
+
+private:
+    static constexpr unsigned int kMaxWorkers = 8;
+
+    NativeProxyProtocol protocol_;
+    const QLoggingCategory &(*logCategory_)();
+    std::vector<std::unique_ptr<NativeProxyWorker>> workers_;
+    quint16 port_;
+    ConnectedUsersCounter *usersCounter_;
+};
+
+} // namespace NativeProxyServer
@@ -0,0 +1,535 @@
+#include "nativeproxysession.h"
+#include "nativeproxyworker.h"
+#include "../httpproxyserver/httpproxyreply.h"
+
+namespace NativeProxyServer {
+
+namespace {
+
+QHostAddress toQHostAddress(const boost::asio::ip::address &address)
+{
+    if (address.is_v4())
+    {
+        return QHostAddress(address.to_v4().to_uint());
+    }
+    const boost::asio::ip::address_v6 v6 = address.to_v6();
+    if (v6.is_v4_mapped())
+    {
+        return QHostAddress(boost::asio::ip::make_address_v4(boost::asio::ip::v4_mapped, v6).to_uint());
+    }
+    return QHostAddress(v6.to_bytes().data());
+}
+
+// VER REP RSV ATYP BND.ADDR BND.PORT, with the address in network byte order
+std::string socksReply(char reply, const boost::asio::ip::address &address, unsigned short port)
+{
+    std::string resp("\x05\x00\x00", 3);
+    resp[1] = reply;
+    if (address.is_v4() || address.to_v6().is_v4_mapped())
+    {
+        const boost::asio::ip::address_v4::bytes_type bytes = address.is_v4() ?
+            address.to_v4().to_bytes() : boost::asio::ip::make_address_v4(boost::asio::ip::v4_mapped, address.to_v6()).to_bytes();
+        resp += '\x01';
+        resp.append(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    }
+    else
+    {
+        const boost::asio::ip::address_v6::bytes_type bytes = address.to_v6().to_bytes();
+        resp += '\x04';
+        resp.append(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    }
+    resp += static_cast<char>(port >> 8);
+    resp += static_cast<char>(port & 0xFF);
+    return resp;
+}
+
+} // namespace
+
+NativeProxySession::NativeProxySession(NativeProxyWorker &worker, NativeProxyProtocol protocol, boost::asio::ip::tcp::socket socket)
+    : worker_(worker), protocol_(protocol),
+    state_(protocol == NativeProxyProtocol::kHttp ? State::kReadHttpRequest : State::kReadSocksIdent),
+    client_(std::move(socket)), server_(client_.get_executor()), isReadingServerHeaders_(false)
+{
+    boost::system::error_code ec;
+    const boost::asio::ip::tcp::endpoint remote = client_.remote_endpoint(ec);
+    if (!ec)
+    {
+        peerAddress_ = toQHostAddress(remote.address());
+    }
+    touch();
+}
+
+NativeProxySession::~NativeProxySession()
+{
+}
+
+void NativeProxySession::start()
+{
+    boost::system::error_code ignored;
+    client_.set_option(boost::asio::ip::tcp::no_delay(true), ignored);
+    directions_[kClientToServer].buffer.reset(new char[kBufferSize]);
+    traffic_ = ClientTrafficStats::instance().connectionOpened(peerAddress_);
+    readHandshake();
+}
+
+void NativeProxySession::close()
+{
+    if (state_ == State::kClosed)
+    {
+        return;
+    }
+    state_ = State::kClosed;
+
+    boost::system::error_code ec;
+    client_.close(ec);
+    server_.close(ec);
+    if (resolver_)
+    {
+        resolver_->cancel();
+    }
+    if (udpAssociation_)
+    {
+        udpAssociation_->close();
+        udpAssociation_.reset();
+    }
+    for (Direction &d : directions_)
+    {
+        if (d.throttleTimer)
+        {
+            d.throttleTimer->cancel(ec);
+        }
+    }
+    ClientTrafficStats::instance().connectionClosed(traffic_);
+    traffic_.reset();
+    // the pending handlers keep the session alive until they are called with operation_aborted
+    worker_.removeSession(this);
+}
+
+void NativeProxySession::readHandshake()
+{
+    auto self = shared_from_this();
+    client_.async_read_some(boost::asio::buffer(directions_[kClientToServer].buffer.get(), kBufferSize),
+                            [this, self](const boost::system::error_code &ec, size_t bytes) {
+        if (ec || state_ == State::kClosed)
+        {
+            close();
+            return;
+        }
+        touch();
+        onHandshakeData(directions_[kClientToServer].buffer.get(), bytes);
+    });
+}
+
+void NativeProxySession::onHandshakeData(const char *data, size_t size)
+{
+    if (state_ == State::kReadHttpRequest)
+    {
+        onHttpRequestData(data, size);
+    }
+    else if (state_ == State::kReadSocksIdent)
+    {
+        onSocksIdentData(data, size);
+    }
+    else if (state_ == State::kReadSocksCommand)
+    {
+        onSocksCommandData(data, size);
+    }
+}
+
+void NativeProxySession::onHttpRequestData(const char *data, size_t size)
+{
+    quint32 parsed;
+    HttpProxyServer::TRI_BOOL ret = requestParser_.parse(QByteArray::fromRawData(data, size), parsed);
+    if (ret == HttpProxyServer::TRI_INDETERMINATE)
+    {
+        readHandshake();
+        return;
+    }
+    if (ret == HttpProxyServer::TRI_FALSE)
+    {
+        writeAndClose(HttpProxyServer::HttpProxyReply::stock_reply(HttpProxyServer::HttpProxyReply::service_unavailable).toBuffer().toStdString());
+        return;
+    }
+
+    HttpProxyServer::HttpProxyRequest &request = requestParser_.getRequest();
+    if (!request.extractHostAndPort())
+    {
+        close();
+        return;
+    }
+
+    Direction &toServer = directions_[kClientToServer];
+    if (request.isConnectMethod())
+    {
+        directions_[kServerToClient].pending = kReplyEstablished;
+    }
+    else
+    {
+        toServer.pending = request.getEstablishHttpConnectionMessage() + request.processClientHeaders();
+        isReadingServerHeaders_ = true;
+    }
+    toServer.pending.append(data + parsed, size - parsed);
+
+    // nothing is read from the client while connecting, whatever it sends meanwhile waits in the socket
+    resolveAndConnect(request.host, request.port);
+}
+
+void NativeProxySession::onSocksIdentData(const char *data, size_t size)
+{
+    quint32 parsed;
+    if (!identReqParser_.parse(QByteArray::fromRawData(data, size), parsed))
+    {
+        readHandshake();
+        return;
+    }
+
+    bool isNoAuthMethodFound = false;
+    for (unsigned char i = 0; i < identReqParser_.identReq().NumberOfMethods; ++i)
+    {
+        if (identReqParser_.identReq().Methods[i] == 0x00)
+        {
+            isNoAuthMethodFound = true;
+            break;
+        }
+    }
+    if (!isNoAuthMethodFound || identReqParser_.identReq().Version != 0x05)
+    {
+        writeAndClose(std::string("\x05\xFF", 2));
+        return;
+    }
+
+    // the client waits for the answer before sending the command, but it's allowed to pipeline it
+    state_ = State::kReadSocksCommand;
+    Direction &toClient = directions_[kServerToClient];
+    toClient.pending.assign("\x05\x00", 2);
+    const std::string rest(data + parsed, size - parsed);
+    auto self = shared_from_this();
+    boost::asio::async_write(client_, boost::asio::buffer(toClient.pending), [this, self, rest](const boost::system::error_code &ec, size_t) {
+        if (ec || state_ == State::kClosed)
+        {
+            close();
+            return;
+        }
+        directions_[kServerToClient].pending.clear();
+        if (rest.empty())
+        {
+            readHandshake();
+        }
+        else
+        {
+            onSocksCommandData(rest.data(), rest.size());
+        }
+    });
+}
+
+void NativeProxySession::onSocksCommandData(const char *data, size_t size)
+{
+    quint32 parsed;
+    SocksProxyServer::TRI_BOOL ret = commandParser_.parse(QByteArray::fromRawData(data, size), parsed);
+    if (ret == SocksProxyServer::TRI_INDETERMINATE)
+    {
+        readHandshake();
+        return;
+    }
+    if (ret == SocksProxyServer::TRI_FALSE)
+    {
+        close();
+        return;
+    }
+
+    const SocksProxyServer::socks5_req &cmd = commandParser_.cmd();
+    if (cmd.Cmd == 0x03)
+    {
+        // DestPort is the port the client will send from, 0 if it doesn't know it yet
+        startUdpAssociation(cmd.DestPort);
+        return;
+    }
+    if (cmd.Cmd != 0x01)
+    {
+        // BIND, which the Qt engine doesn't serve either
+        writeAndClose(std::string("\x05\x07\x00\x01\x00\x00\x00\x00\x00\x00", 10));
+        return;
+    }
+
+    // the reply is sent once the connection is made, it reports the address it was made from
+    directions_[kClientToServer].pending.append(data + parsed, size - parsed);
+
+    // the parser stores the IPv4 address and the port in host byte order, the IPv6 address in network byte order
+    if (cmd.AddrType == 0x01)
+    {
+        quint32 ipv4;
+        memcpy(&ipv4, &cmd.DestAddr.IPv4, sizeof(ipv4));
+        state_ = State::kConnecting;
+        connectTo(boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4(ipv4), cmd.DestPort));
+    }
+    else if (cmd.AddrType == 0x04)
+    {
+        boost::asio::ip::address_v6::bytes_type bytes;
+        memcpy(bytes.data(), &cmd.DestAddr.IPv6, bytes.size());
+        state_ = State::kConnecting;
+        connectTo(boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v6(bytes), cmd.DestPort));
+    }
+    else
+    {
+        resolveAndConnect(std::string(cmd.DestAddr.Domain, cmd.DestAddr.DomainLen), cmd.DestPort);
+    }
+}
+
+void NativeProxySession::startUdpAssociation(quint16 clientPort)
+{
+    boost::system::error_code ec;
+    boost::system::error_code peerError;
+    const boost::asio::ip::address localAddress = client_.local_endpoint(ec).address();
+    const boost::asio::ip::address peerAddress = client_.remote_endpoint(peerError).address();
+    udpAssociation_ = std::make_shared<NativeProxyUdpAssociation>(client_.get_executor(), peerAddress, clientPort, traffic_,
+                                                                  [this]() { touch(); });
+    // an IPv4 client of the dual-stack listener gets a plain IPv4 relay socket
+    if (ec || peerError || !udpAssociation_->start(localAddress, ec))
+    {
+        udpAssociation_->close();
+        udpAssociation_.reset();
+        // general SOCKS server failure
+        writeAndClose(std::string("\x05\x01\x00\x01\x00\x00\x00\x00\x00\x00", 10));
+        return;
+    }
+
+    // the client sends its datagrams to this address
+    state_ = State::kUdpAssociate;
+    const boost::asio::ip::udp::endpoint relay = udpAssociation_->localEndpoint();
+    Direction &toClient = directions_[kServerToClient];
+    toClient.pending = socksReply(0x00, relay.address(), relay.port());
+    auto self = shared_from_this();
+    boost::asio::async_write(client_, boost::asio::buffer(toClient.pending), [this, self](const boost::system::error_code &ec, size_t) {
+        if (ec || state_ == State::kClosed)
+        {
+            close();
+            return;
+        }
+        directions_[kServerToClient].pending.clear();
+        readUdpControl();
+    });
+}
+
+void NativeProxySession::readUdpControl()
+{
+    auto self = shared_from_this();
+    client_.async_read_some(boost::asio::buffer(directions_[kClientToServer].buffer.get(), kBufferSize),
+                            [this, self](const boost::system::error_code &ec, size_t) {
+        // the control connection carries nothing after the reply, the association ends with it
+        if (ec || state_ == State::kClosed)
+        {
+            close();
+            return;
+        }
+        readUdpControl();
+    });
+}
+
+void NativeProxySession::resolveAndConnect(const std::string &host, quint16 port)
+{
+    state_ = State::kConnecting;
+
+    boost::system::error_code ec;
+    const boost::asio::ip::address address = boost::asio::ip::make_address(host, ec);
+    if (!ec)
+    {
+        connectTo(boost::asio::ip::tcp::endpoint(address, port));
+        return;
+    }
+
+    resolver_.reset(new boost::asio::ip::tcp::resolver(client_.get_executor()));
+    auto self = shared_from_this();
+    resolver_->async_resolve(host, std::to_string(port),
+                             [this, self](const boost::system::error_code &ec, boost::asio::ip::tcp::resolver::results_type results) {
+        if (state_ == State::kClosed)
+        {
+            return;
+        }
+        if (ec)
+        {
+            onConnected(ec);
+            return;
+        }
+        boost::asio::async_connect(server_, results, [this, self](const boost::system::error_code &ec, const boost::asio::ip::tcp::endpoint &) {
+            onConnected(ec);
+        });
+    });
+}
+
+void NativeProxySession::connectTo(const boost::asio::ip::tcp::endpoint &endpoint)
+{
+    auto self = shared_from_this();
+    server_.async_connect(endpoint, [this, self](const boost::system::error_code &ec) {
+        onConnected(ec);
+    });
+}
+
+void NativeProxySession::onConnected(const boost::system::error_code &ec)
+{
+    if (state_ == State::kClosed)
+    {
+        return;
+    }
+    if (ec)
+    {
+        if (protocol_ == NativeProxyProtocol::kHttp)
+        {
+            writeAndClose(HttpProxyServer::HttpProxyReply::stock_reply(HttpProxyServer::HttpProxyReply::internal_server_error).toBuffer().toStdString());
+        }
+        else
+        {
+            // host unreachable
+            writeAndClose(std::string("\x05\x04\x00\x01\x00\x00\x00\x00\x00\x00", 10));
+        }
+        return;
+    }
+
+    touch();
+    boost::system::error_code ignored;
+    server_.set_option(boost::asio::ip::tcp::no_delay(true), ignored);
+    if (protocol_ == NativeProxyProtocol::kSocks)
+    {
+        const boost::asio::ip::tcp::endpoint local = server_.local_endpoint(ignored);
+        directions_[kServerToClient].pending = socksReply(0x00, local.address(), local.port());
+    }
+    directions_[kServerToClient].buffer.reset(new char[kBufferSize]);
+    state_ = State::kRelay;
+    startRelay();
+}
+
+void NativeProxySession::startRelay()
+{
+    for (int direction : { kClientToServer, kServerToClient })
+    {
+        Direction &d = directions_[direction];
+        if (d.pending.empty())
+        {
+            relay(direction);
+        }
+        else
+        {
+            relayWrite(direction, d.pending.data(), d.pending.size());
+        }
+    }
+}
+
+void NativeProxySession::relay(int direction)
+{
+    auto self = shared_from_this();
+    source(direction).async_read_some(boost::asio::buffer(directions_[direction].buffer.get(), kBufferSize),
+                                      [this, self, direction](const boost::system::error_code &ec, size_t bytes) {
+        onRelayRead(direction, ec, bytes);
+    });
+}
+
+void NativeProxySession::onRelayRead(int direction, const boost::system::error_code &ec, size_t bytes)
+{
+    if (state_ == State::kClosed)
+    {
+        return;
+    }
+    Direction &d = directions_[direction];
+    if (ec == boost::asio::error::eof)
+    {
+        // pass the half-close on, the other direction may still be transferring
+        boost::system::error_code ignored;
+        destination(direction).shutdown(boost::asio::ip::tcp::socket::shutdown_send, ignored);
+        d.isDone = true;
+        if (directions_[1 - direction].isDone)
+        {
+            close();
+        }
+        return;
+    }
+    if (ec)
+    {
+        close();
+        return;
+    }
+    touch();
+
+    if (traffic_)
+    {
+        direction == kClientToServer ? traffic_->addUploaded(bytes) : traffic_->addDownloaded(bytes);
+        d.throttleMs = traffic_->consume(bytes);
+    }
+
+    if (direction == kServerToClient && isReadingServerHeaders_)
+    {
+        quint32 parsed;
+        HttpProxyServer::TRI_BOOL ret = webAnswerParser_.parse(QByteArray::fromRawData(d.buffer.get(), bytes), parsed);
+        if (ret == HttpProxyServer::TRI_INDETERMINATE)
+        {
+            relay(direction);
+            return;
+        }
+        if (ret == HttpProxyServer::TRI_FALSE)
+        {
+            close();
+            return;
+        }
+        const HttpProxyServer::HttpProxyRequest &request = requestParser_.getRequest();
+        isReadingServerHeaders_ = false;
+        d.pending = webAnswerParser_.getAnswer().processServerHeaders(request.http_version_major, request.http_version_minor);
+        d.pending.append(d.buffer.get() + parsed, bytes - parsed);
+        relayWrite(direction, d.pending.data(), d.pending.size());
+        return;
+    }
+
+    relayWrite(direction, d.buffer.get(), bytes);
+}
+
+void NativeProxySession::relayWrite(int direction, const char *data, size_t size)
+{
+    // the next read is only issued once the data is written, which is the backpressure for this direction
+    auto self = shared_from_this();
+    boost::asio::async_write(destination(direction), boost::asio::buffer(data, size),
+                             [this, self, direction](const boost::system::error_code &ec, size_t) {
+        if (ec || state_ == State::kClosed)
+        {
+            close();
+            return;
+        }
+        directions_[direction].pending.clear();
+        touch();
+        relayNext(direction);
+    });
+}
+
+void NativeProxySession::relayNext(int direction)
+{
+    Direction &d = directions_[direction];
+    if (d.throttleMs <= 0)
+    {
+        relay(direction);
+        return;
+    }
+
+    if (!d.throttleTimer)
+    {
+        d.throttleTimer.reset(new boost::asio::steady_timer(client_.get_executor()));
+    }
+    d.throttleTimer->expires_from_now(std::chrono::milliseconds(d.throttleMs));
+    d.throttleMs = 0;
+    auto self = shared_from_this();
+    d.throttleTimer->async_wait([this, self, direction](const boost::system::error_code &ec) {
+        if (ec || state_ == State::kClosed)
+        {
+            return;
+        }
+        touch();
+        relay(direction);
+    });
+}
+
+void NativeProxySession::writeAndClose(const std::string &data)
+{
+    Direction &toClient = directions_[kServerToClient];
+    toClient.pending = data;
+    auto self = shared_from_this();
+    boost::asio::async_write(client_, boost::asio::buffer(toClient.pending), [this, self](const boost::system::error_code &, size_t) {
+        close();
+    });
+}
+
+} // namespace NativeProxyServer
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <QHostAddress>
+#include "utils/boost_includes.h"
+#include "../httpproxyserver/httpproxyrequestparser.h"
+#include "../httpproxyserver/httpproxywebanswerparser.h"
+#include "../socksproxyserver/socksproxyidentreqparser.h"
+#include "../socksproxyserver/socksproxycommandparser.h"
+#include "../clienttrafficstats.h"
+#include "nativeproxyudpassociation.h"
+
+namespace NativeProxyServer {
+
+enum class NativeProxyProtocol { kHttp, kSocks };
+
+class NativeProxyWorker;
+
+// One proxied connection of the native engine. It lives on its worker's io_service thread only, so it needs no
+// locking; the parsers are the same ones the Qt connections use. Supports HTTP (CONNECT and plain requests) and
+// SOCKS5 CONNECT and UDP ASSOCIATE, the same commands as the Qt engine.
+class NativeProxySession : public std::enable_shared_from_this<NativeProxySession>
+{
+public:
+    NativeProxySession(NativeProxyWorker &worker, NativeProxyProtocol protocol, boost::asio::ip::tcp::socket socket);
+    ~NativeProxySession();
+
+    void start();
+    void close();
+
+    bool isRelaying() const { return state_ == State::kRelay || state_ == State::kUdpAssociate; }
+    std::chrono::steady_clock::time_point lastActivity() const { return lastActivity_; }
+    const QHostAddress &peerAddress() const { return peerAddress_; }
+
+private:
+    // per direction buffer, two of them for a relaying connection
+    static constexpr size_t kBufferSize = 16 * 1024;
+    static constexpr const char *kReplyEstablished = "HTTP/1.0 200 Connection established\r\nProxy-agent: Windscribe\r\n\r\n";
+
+    enum class State { kReadSocksIdent, kReadSocksCommand, kReadHttpRequest, kConnecting, kRelay, kUdpAssociate, kClosed };
+    enum { kClientToServer = 0, kServerToClient = 1 };
+
+    struct Direction
+    {
+        std::unique_ptr<char[]> buffer;
+        // sent to the destination before relaying starts: the reply to the client or the rewritten request for the server
+        std::string pending;
+        bool isDone = false;
+        // the rate limit pauses the direction for this long before its next read
+        int throttleMs = 0;
+        std::unique_ptr<boost::asio::steady_timer> throttleTimer;
+    };
+
+    NativeProxyWorker &worker_;
+    NativeProxyProtocol protocol_;
+    State state_;
+    boost::asio::ip::tcp::socket client_;
+    boost::asio::ip::tcp::socket server_;
+    // only created for the targets given by name
+    std::unique_ptr<boost::asio::ip::tcp::resolver> resolver_;
+    // normalized, an IPv4 client of the dual-stack acceptor is reported as IPv4
+    QHostAddress peerAddress_;
+    std::chrono::steady_clock::time_point lastActivity_;
+    Direction directions_[2];
+    std::shared_ptr<ClientTraffic> traffic_;
+    // the control connection only keeps it alive
+    std::shared_ptr<NativeProxyUdpAssociation> udpAssociation_;
+
+    HttpProxyServer::HttpProxyRequestParser requestParser_;
+    HttpProxyServer::HttpProxyWebAnswerParser webAnswerParser_;
+    bool isReadingServerHeaders_;
+    SocksProxyServer::SocksProxyIdentReqParser identReqParser_;
+    SocksProxyServer::SocksProxyCommandParser commandParser_;
+
+    void touch() { lastActivity_ = std::chrono::steady_clock::now(); }
+
+    void readHandshake();
+    void onHandshakeData(const char *data, size_t size);
+    void onHttpRequestData(const char *data, size_t size);
+    void onSocksIdentData(const char *data, size_t size);
+    void onSocksCommandData(const char *data, size_t size);
+
+    void startUdpAssociation(quint16 clientPort);
+    // reads the control connection of the UDP association until the client closes it
+    void readUdpControl();
+
+    void resolveAndConnect(const std::string &host, quint16 port);
+    void connectTo(const boost::asio::ip::tcp::endpoint &endpoint);
+    void onConnected(const boost::system::error_code &ec);
+
+    void startRelay();
+    void relay(int direction);
+    // reads the next chunk once the direction's rate limit pause is over
+    void relayNext(int direction);
+    void onRelayRead(int direction, const boost::system::error_code &ec, size_t bytes);
+    void relayWrite(int direction, const char *data, size_t size);
+
+    // writes a reply or an error to the client and closes the session
+    void writeAndClose(const std::string &data);
+
+    boost::asio::ip::tcp::socket &source(int direction) { return direction == kClientToServer ? client_ : server_; }
+    boost::asio::ip::tcp::socket &destination(int direction) { return direction == kClientToServer ? server_ : client_; }
+};
+
+} // namespace NativeProxyServer
@@ -0,0 +1,351 @@
+#include "nativeproxyudpassociation.h"
+#include <cstring>
+#include "utils/logger.h"
+
+namespace NativeProxyServer {
+
+namespace {
+
+// the dual-stack sockets report IPv4 peers as IPv4-mapped IPv6 addresses
+boost::asio::ip::address normalized(const boost::asio::ip::address &address)
+{
+    if (address.is_v6() && address.to_v6().is_v4_mapped())
+    {
+        return boost::asio::ip::make_address_v4(boost::asio::ip::v4_mapped, address.to_v6());
+    }
+    return address;
+}
+
+} // namespace
+
+NativeProxyUdpAssociation::NativeProxyUdpAssociation(const boost::asio::ip::tcp::socket::executor_type &executor,
+                                                     const boost::asio::ip::address &clientAddress, unsigned short clientPort,
+                                                     const std::shared_ptr<ClientTraffic> &traffic,
+                                                     const std::function<void()> &onActivity)
+    : clientSocket_(executor), externalSocket_(executor), clientAddress_(normalized(clientAddress)), clientPort_(clientPort),
+    traffic_(traffic), onActivity_(onActivity), isExternalDualStack_(false), isClosed_(false), domainUseCounter_(0),
+    clientBuffer_(kMaxDatagramSize), externalBuffer_(kReplyHeaderRoom + kMaxDatagramSize),
+    datagramsToTargets_(0), datagramsToClient_(0), datagramsDropped_(0)
+{
+}
+
+NativeProxyUdpAssociation::~NativeProxyUdpAssociation()
+{
+}
+
+bool NativeProxyUdpAssociation::start(const boost::asio::ip::address &localAddress, boost::system::error_code &ec)
+{
+    const boost::asio::ip::address local = normalized(localAddress);
+    clientSocket_.open(local.is_v4() ? boost::asio::ip::udp::v4() : boost::asio::ip::udp::v6(), ec);
+    if (!ec)
+    {
+        clientSocket_.bind(boost::asio::ip::udp::endpoint(local, 0), ec);
+    }
+    if (ec)
+    {
+        return false;
+    }
+
+    // dual-stack, so that the targets of both families are reachable; IPv4 only if the host has no IPv6
+    boost::system::error_code v6Error;
+    externalSocket_.open(boost::asio::ip::udp::v6(), v6Error);
+    if (!v6Error)
+    {
+        externalSocket_.set_option(boost::asio::ip::v6_only(false), v6Error);
+    }
+    if (!v6Error)
+    {
+        externalSocket_.bind(boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v6(), 0), v6Error);
+    }
+    isExternalDualStack_ = !v6Error;
+    if (v6Error)
+    {
+        boost::system::error_code ignored;
+        externalSocket_.close(ignored);
+        externalSocket_.open(boost::asio::ip::udp::v4(), ec);
+        if (!ec)
+        {
+            externalSocket_.bind(boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), 0), ec);
+        }
+        if (ec)
+        {
+            return false;
+        }
+    }
+
+    // a datagram that doesn't fit in the send buffer is dropped rather than blocking the worker
+    clientSocket_.non_blocking(true, ec);
+    if (!ec)
+    {
+        externalSocket_.non_blocking(true, ec);
+    }
+    if (ec)
+    {
+        return false;
+    }
+
+    receiveFromClient();
+    receiveFromExternal();
+    return true;
+}
+
+void NativeProxyUdpAssociation::close()
+{
+    if (isClosed_)
+    {
+        return;
+    }
+    isClosed_ = true;
+
+    boost::system::error_code ec;
+    clientSocket_.close(ec);
+    externalSocket_.close(ec);
+    if (resolver_)
+    {
+        resolver_->cancel();
+    }
+    qCDebug(LOG_SOCKS_SERVER) << "UDP association of" << QString::fromStdString(clientAddress_.to_string())
+                              << "closed, datagrams to targets:" << datagramsToTargets_ << "to client:" << datagramsToClient_
+                              << "dropped:" << datagramsDropped_;
+}
+
+boost::asio::ip::udp::endpoint NativeProxyUdpAssociation::localEndpoint() const
+{
+    boost::system::error_code ec;
+    return clientSocket_.local_endpoint(ec);
+}
+
+void NativeProxyUdpAssociation::receiveFromClient()
+{
+    auto self = shared_from_this();
+    clientSocket_.async_receive_from(boost::asio::buffer(clientBuffer_), clientSender_,
+                                     [this, self](const boost::system::error_code &ec, size_t size) {
+        if (ec == boost::asio::error::operation_aborted || isClosed_)
+        {
+            return;
+        }
+        // other errors, such as an ICMP port unreachable reported on the socket, don't end the association
+        if (!ec)
+        {
+            onClientDatagram(size);
+        }
+        receiveFromClient();
+    });
+}
+
+void NativeProxyUdpAssociation::receiveFromExternal()
+{
+    auto self = shared_from_this();
+    externalSocket_.async_receive_from(boost::asio::buffer(externalBuffer_.data() + kReplyHeaderRoom, kMaxDatagramSize), externalSender_,
+                                       [this, self](const boost::system::error_code &ec, size_t size) {
+        if (ec == boost::asio::error::operation_aborted || isClosed_)
+        {
+            return;
+        }
+        if (!ec)
+        {
+            onExternalDatagram(size);
+        }
+        receiveFromExternal();
+    });
+}
+
+void NativeProxyUdpAssociation::onClientDatagram(size_t size)
+{
+    boost::asio::ip::udp::endpoint target;
+    const size_t headerSize = isFromClient(clientSender_) ?
+                              parseClientHeader(reinterpret_cast<const unsigned char *>(clientBuffer_.data()), size, target) : 0;
+    if (headerSize == 0)
+    {
+        datagramsDropped_++;
+        return;
+    }
+
+    if (target.address().is_v4() && isExternalDualStack_)
+    {
+        target.address(boost::asio::ip::make_address_v6(boost::asio::ip::v4_mapped, target.address().to_v4()));
+    }
+    boost::system::error_code ec;
+    externalSocket_.send_to(boost::asio::buffer(clientBuffer_.data() + headerSize, size - headerSize), target, 0, ec);
+    if (ec)
+    {
+        datagramsDropped_++;
+        return;
+    }
+    datagramsToTargets_++;
+    if (traffic_)
+    {
+        traffic_->addUploaded(size - headerSize);
+    }
+    onActivity_();
+}
+
+void NativeProxyUdpAssociation::onExternalDatagram(size_t size)
+{
+    if (clientPort_ == 0)
+    {
+        // the client hasn't sent anything yet, so there's nowhere to send this to
+        datagramsDropped_++;
+        return;
+    }
+
+    // write the header right in front of the payload
+    char *payload = externalBuffer_.data() + kReplyHeaderRoom;
+    char *header;
+    const boost::asio::ip::address source = normalized(externalSender_.address());
+    if (source.is_v4())
+    {
+        const boost::asio::ip::address_v4::bytes_type bytes = source.to_v4().to_bytes();
+        header = payload - 10;
+        header[3] = 0x01;
+        memcpy(header + 4, bytes.data(), bytes.size());
+    }
+    else
+    {
+        const boost::asio::ip::address_v6::bytes_type bytes = source.to_v6().to_bytes();
+        header = payload - 22;
+        header[3] = 0x04;
+        memcpy(header + 4, bytes.data(), bytes.size());
+    }
+    header[0] = header[1] = header[2] = 0x00;
+    payload[-2] = static_cast<char>(externalSender_.port() >> 8);
+    payload[-1] = static_cast<char>(externalSender_.port() & 0xFF);
+
+    boost::system::error_code ec;
+    clientSocket_.send_to(boost::asio::buffer(header, payload + size - header), boost::asio::ip::udp::endpoint(clientAddress_, clientPort_), 0, ec);
+    if (ec)
+    {
+        datagramsDropped_++;
+        return;
+    }
+    datagramsToClient_++;
+    if (traffic_)
+    {
+        traffic_->addDownloaded(size);
+    }
+    onActivity_();
+}
+
+void NativeProxyUdpAssociation::onLookupFinished(const std::string &domain, const boost::system::error_code &ec,
+                                                 const boost::asio::ip::udp::resolver::results_type &results)
+{
+    pendingLookups_.erase(domain);
+    if (ec || results.empty() || isClosed_)
+    {
+        return;
+    }
+
+    if (resolvedDomains_.size() >= kMaxCachedDomains)
+    {
+        auto oldest = resolvedDomains_.begin();
+        for (auto it = resolvedDomains_.begin(); it != resolvedDomains_.end(); ++it)
+        {
+            if (it->second.lastUsed < oldest->second.lastUsed)
+            {
+                oldest = it;
+            }
+        }
+        resolvedDomains_.erase(oldest);
+    }
+    boost::asio::ip::address address = results.begin()->endpoint().address();
+    for (const auto &result : results)
+    {
+        if (result.endpoint().address().is_v4())
+        {
+            address = result.endpoint().address();
+            break;
+        }
+    }
+    resolvedDomains_[domain] = ResolvedDomain{address, ++domainUseCounter_};
+}
+
+bool NativeProxyUdpAssociation::isFromClient(const boost::asio::ip::udp::endpoint &sender)
+{
+    if (normalized(sender.address()) != clientAddress_)
+    {
+        return false;
+    }
+    if (clientPort_ == 0)
+    {
+        clientPort_ = sender.port();
+    }
+    return sender.port() == clientPort_;
+}
+
+size_t NativeProxyUdpAssociation::parseClientHeader(const unsigned char *data, size_t size, boost::asio::ip::udp::endpoint &outTarget)
+{
+    // fragmentation is optional and not supported, fragments are dropped
+    if (size < 4 || data[2] != 0x00)
+    {
+        return 0;
+    }
+
+    size_t headerSize;
+    if (data[3] == 0x01)  // ip4
+    {
+        headerSize = 4 + 4 + 2;
+        if (size < headerSize)
+        {
+            return 0;
+        }
+        boost::asio::ip::address_v4::bytes_type bytes;
+        memcpy(bytes.data(), data + 4, bytes.size());
+        outTarget.address(boost::asio::ip::address_v4(bytes));
+    }
+    else if (data[3] == 0x04)  // ip6
+    {
+        headerSize = 4 + 16 + 2;
+        if (size < headerSize)
+        {
+            return 0;
+        }
+        boost::asio::ip::address_v6::bytes_type bytes;
+        memcpy(bytes.data(), data + 4, bytes.size());
+        outTarget.address(normalized(boost::asio::ip::address_v6(bytes)));
+    }
+    else if (data[3] == 0x03)  // domain name
+    {
+        if (size < 5)
+        {
+            return 0;
+        }
+        headerSize = 4 + 1 + data[4] + 2;
+        if (size < headerSize)
+        {
+            return 0;
+        }
+
+        // looked up without copying the name out of the datagram
+        const std::string_view domain(reinterpret_cast<const char *>(data + 5), data[4]);
+        auto it = resolvedDomains_.find(domain);
+        if (it == resolvedDomains_.end())
+        {
+            if (pendingLookups_.find(domain) == pendingLookups_.end())
+            {
+                const std::string name(domain);
+                pendingLookups_.insert(name);
+                if (!resolver_)
+                {
+                    resolver_.reset(new boost::asio::ip::udp::resolver(clientSocket_.get_executor()));
+                }
+                auto self = shared_from_this();
+                resolver_->async_resolve(name, std::string(),
+                                         [this, self, name](const boost::system::error_code &ec, boost::asio::ip::udp::resolver::results_type results) {
+                    onLookupFinished(name, ec, results);
+                });
+            }
+            return 0;
+        }
+        it->second.lastUsed = ++domainUseCounter_;
+        outTarget.address(it->second.address);
+    }
+    else
+    {
+        return 0;
+    }
+
+    outTarget.port(static_cast<unsigned short>((data[headerSize - 2] << 8) | data[headerSize - 1]));
+    return headerSize;
+}
+
+} // namespace NativeProxyServer
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "utils/boost_includes.h"
+#include "../clienttrafficstats.h"
+
+namespace NativeProxyServer {
+
+// Relays the datagrams of one SOCKS5 UDP ASSOCIATE (RFC 1928, section 7) on the io_service of the session that asked
+// for it, the native counterpart of SocksProxyServer::SocksProxyUdpAssociation. Each direction has one preallocated
+// buffer, the SOCKS header is parsed and prepended in place, so the relay path doesn't allocate.
+class NativeProxyUdpAssociation : public std::enable_shared_from_this<NativeProxyUdpAssociation>
+{
+public:
+    // clientPort is the port the client announced in its request, 0 if it will be learned from the first datagram;
+    // onActivity is called for every relayed datagram
+    NativeProxyUdpAssociation(const boost::asio::ip::tcp::socket::executor_type &executor,
+                              const boost::asio::ip::address &clientAddress, unsigned short clientPort,
+                              const std::shared_ptr<ClientTraffic> &traffic, const std::function<void()> &onActivity);
+    ~NativeProxyUdpAssociation();
+
+    // binds the client socket to localAddress (the address the client reached the proxy on) and the external socket
+    bool start(const boost::asio::ip::address &localAddress, boost::system::error_code &ec);
+    void close();
+
+    boost::asio::ip::udp::endpoint localEndpoint() const;
+
+private:
+    static constexpr size_t kMaxDatagramSize = 65535;
+    // RSV(2) FRAG(1) ATYP(1) IPv6(16) PORT(2), the biggest header of the datagrams sent back to the client
+    static constexpr size_t kReplyHeaderRoom = 22;
+    static constexpr size_t kMaxCachedDomains = 64;
+
+    struct ResolvedDomain
+    {
+        boost::asio::ip::address address;
+        unsigned long long lastUsed;
+    };
+
+    boost::asio::ip::udp::socket clientSocket_;
+    boost::asio::ip::udp::socket externalSocket_;
+    // only created for the targets given by name
+    std::unique_ptr<boost::asio::ip::udp::resolver> resolver_;
+    boost::asio::ip::address clientAddress_;
+    unsigned short clientPort_;
+    std::shared_ptr<ClientTraffic> traffic_;
+    std::function<void()> onActivity_;
+    // the IPv4 targets are then sent to as IPv4-mapped addresses
+    bool isExternalDualStack_;
+    bool isClosed_;
+
+    // targets given as domain names, looked up by the bytes of the name in the datagram; datagrams for a name that is
+    // still being resolved are dropped. The least recently used name makes room for a new one.
+    std::map<std::string, ResolvedDomain, std::less<>> resolvedDomains_;
+    std::set<std::string, std::less<>> pendingLookups_;
+    unsigned long long domainUseCounter_;
+
+    std::vector<char> clientBuffer_;
+    std::vector<char> externalBuffer_;
+    boost::asio::ip::udp::endpoint clientSender_;
+    boost::asio::ip::udp::endpoint externalSender_;
+
+    unsigned long long datagramsToTargets_;
+    unsigned long long datagramsToClient_;
+    unsigned long long datagramsDropped_;
+
+    void receiveFromClient();
+    void receiveFromExternal();
+    void onClientDatagram(size_t size);
+    void onExternalDatagram(size_t size);
+    void onLookupFinished(const std::string &domain, const boost::system::error_code &ec,
+                          const boost::asio::ip::udp::resolver::results_type &results);
+
+    bool isFromClient(const boost::asio::ip::udp::endpoint &sender);
+    // returns the size of the header or 0 if the datagram must be dropped
+    size_t parseClientHeader(const unsigned char *data, size_t size, boost::asio::ip::udp::endpoint &outTarget);
+};
+
+} // namespace NativeProxyServer
@@ -0,0 +1,233 @@
+#include "nativeproxyworker.h"
+#include "../socketutils/peeraddress.h"
+
+namespace NativeProxyServer {
+
+namespace {
+
+bool isLocalNetworkPeer(const boost::asio::ip::tcp::socket &socket)
+{
+    boost::system::error_code ec;
+    const boost::asio::ip::tcp::endpoint remote = socket.remote_endpoint(ec);
+    return !ec && PeerAddress::isLocalNetwork(QHostAddress(remote.data()));
+}
+
+} // namespace
+
+NativeProxyWorker::NativeProxyWorker(NativeProxyProtocol protocol, const Callbacks &callbacks)
+    : protocol_(protocol), callbacks_(callbacks), nextAcceptTarget_(0), reapTimer_(ioService_),
+    handshakeTimeoutMs_(kDefaultHandshakeTimeoutMs), relayTimeoutMs_(kDefaultRelayTimeoutMs),
+    sessionsCount_(0), reapedCount_(0)
+{
+    acceptTargets_.push_back(this);
+}
+
+NativeProxyWorker::~NativeProxyWorker()
+{
+    stop();
+}
+
+bool NativeProxyWorker::listen(const boost::asio::ip::tcp::endpoint &endpoint, bool isReusePort, boost::system::error_code &ec)
+{
+    acceptor_.reset(new boost::asio::ip::tcp::acceptor(ioService_));
+    acceptor_->open(endpoint.protocol(), ec);
+    if (!ec)
+    {
+        acceptor_->set_option(boost::asio::ip::tcp::acceptor::reuse_address(true), ec);
+    }
+    if (!ec && endpoint.address().is_v6())
+    {
+        // dual-stack, the IPv4 clients come as IPv4-mapped addresses
+        acceptor_->set_option(boost::asio::ip::v6_only(false), ec);
+    }
+#ifdef SO_REUSEPORT
+    if (!ec && isReusePort)
+    {
+        acceptor_->set_option(boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true), ec);
+    }
+#else
+    Q_UNUSED(isReusePort);
+#endif
+    if (!ec)
+    {
+        acceptor_->bind(endpoint, ec);
+    }
+    if (!ec)
+    {
+        acceptor_->listen(boost::asio::socket_base::max_listen_connections, ec);
+    }
+    if (ec)
+    {
+        acceptor_.reset();
+        return false;
+    }
+    return true;
+}
+
+unsigned short NativeProxyWorker::localPort() const
+{
+    boost::system::error_code ec;
+    return acceptor_ ? acceptor_->local_endpoint(ec).port() : 0;
+}
+
+void NativeProxyWorker::setAcceptTargets(const std::vector<NativeProxyWorker *> &targets)
+{
+    acceptTargets_ = targets;
+}
+
+void NativeProxyWorker::start()
+{
+    work_.reset(new boost::asio::io_service::work(ioService_));
+    if (acceptor_)
+    {
+        accept();
+    }
+    scheduleReap();
+    thread_ = std::thread([this]() { ioService_.run(); });
+}
+
+void NativeProxyWorker::stop()
+{
+    if (!thread_.joinable())
+    {
+        return;
+    }
+    ioService_.post([this]() {
+        boost::system::error_code ec;
+        if (acceptor_)
+        {
+            acceptor_->close(ec);
+        }
+        reapTimer_.cancel(ec);
+        closeAllSessionsNow();
+    });
+    // run() returns once the closed sessions got their aborted handlers
+    work_.reset();
+    thread_.join();
+    ioService_.reset();
+}
+
+void NativeProxyWorker::closeAllSessions()
+{
+    ioService_.post([this]() { closeAllSessionsNow(); });
+}
+
+void NativeProxyWorker::setIdleTimeouts(int handshakeTimeoutMs, int relayTimeoutMs)
+{
+    ioService_.post([this, handshakeTimeoutMs, relayTimeoutMs]() {
+        handshakeTimeoutMs_ = handshakeTimeoutMs;
+        relayTimeoutMs_ = relayTimeoutMs;
+        boost::system::error_code ec;
+        reapTimer_.cancel(ec);
+        scheduleReap();
+    });
+}
+
+void NativeProxyWorker::removeSession(NativeProxySession *session)
+{
+    auto it = sessions_.find(session);
+    if (it != sessions_.end())
+    {
+        // the session may be destroyed right here, so take what's needed first
+        const QHostAddress peerAddress = session->peerAddress();
+        sessions_.erase(it);
+        sessionsCount_--;
+        if (callbacks_.onSessionClosed)
+        {
+            callbacks_.onSessionClosed(peerAddress);
+        }
+    }
+}
+
+void NativeProxyWorker::accept()
+{
+    NativeProxyWorker *target = acceptTargets_[nextAcceptTarget_++ % acceptTargets_.size()];
+    acceptor_->async_accept(target->ioService_, [this, target](const boost::system::error_code &ec, boost::asio::ip::tcp::socket socket) {
+        if (ec == boost::asio::error::operation_aborted || !acceptor_->is_open())
+        {
+            return;
+        }
+        if (!ec && !isLocalNetworkPeer(socket))
+        {
+            boost::system::error_code ignored;
+            socket.close(ignored);
+        }
+        else if (!ec)
+        {
+            if (target == this)
+            {
+                addSession(std::move(socket));
+            }
+            else
+            {
+                // the socket belongs to the target's io_service, the session must live on its thread
+                auto s = std::make_shared<boost::asio::ip::tcp::socket>(std::move(socket));
+                target->ioService_.post([target, s]() { target->addSession(std::move(*s)); });
+            }
+        }
+        // on errors like EMFILE keep accepting, the next attempt may succeed once some sessions are closed
+        accept();
+    });
+}
+
+void NativeProxyWorker::addSession(boost::asio::ip::tcp::socket socket)
+{
+    auto session = std::make_shared<NativeProxySession>(*this, protocol_, std::move(socket));
+    sessions_[session.get()] = session;
+    sessionsCount_++;
+    if (callbacks_.onSessionOpened)
+    {
+        callbacks_.onSessionOpened(session->peerAddress());
+    }
+    session->start();
+}
+
+void NativeProxyWorker::closeAllSessionsNow()
+{
+    // closing removes the session from the map
+    std::vector<std::shared_ptr<NativeProxySession>> sessions;
+    sessions.reserve(sessions_.size());
+    for (const auto &it : sessions_)
+    {
+        sessions.push_back(it.second);
+    }
+    for (const auto &session : sessions)
+    {
+        session->close();
+    }
+}
+
+void NativeProxyWorker::scheduleReap()
+{
+    const int intervalMs = std::max(100, std::min(kMaxReapIntervalMs, std::min(handshakeTimeoutMs_, relayTimeoutMs_) / 4));
+    reapTimer_.expires_from_now(std::chrono::milliseconds(intervalMs));
+    reapTimer_.async_wait([this](const boost::system::error_code &ec) {
+        if (ec)
+        {
+            return;
+        }
+        reapIdleSessions();
+        scheduleReap();
+    });
+}
+
+void NativeProxyWorker::reapIdleSessions()
+{
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<NativeProxySession>> idle;
+    for (const auto &it : sessions_)
+    {
+        const int timeoutMs = it.second->isRelaying() ? relayTimeoutMs_ : handshakeTimeoutMs_;
+        if (now - it.second->lastActivity() > std::chrono::milliseconds(timeoutMs))
+        {
+            idle.push_back(it.second);
+        }
+    }
+    for (const auto &session : idle)
+    {
+        session->close();
+    }
+    reapedCount_ += idle.size();
+}
+
+} // namespace NativeProxyServer
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "nativeproxysession.h"
+
+namespace NativeProxyServer {
+
+// An io_service thread of the native proxy engine. It owns the sessions accepted on it and reaps the idle ones. With
+// SO_REUSEPORT every worker has its own acceptor on the shared port and the kernel spreads the connections; without
+// it the first worker accepts for all of them.
+class NativeProxyWorker
+{
+public:
+    struct Callbacks
+    {
+        // called on the worker thread with the address of the client
+        std::function<void(const QHostAddress &peerAddress)> onSessionOpened;
+        std::function<void(const QHostAddress &peerAddress)> onSessionClosed;
+    };
+
+    NativeProxyWorker(NativeProxyProtocol protocol, const Callbacks &callbacks);
+    ~NativeProxyWorker();
+
+    bool listen(const boost::asio::ip::tcp::endpoint &endpoint, bool isReusePort, boost::system::error_code &ec);
+    unsigned short localPort() const;
+    // the workers the accepted sockets are handed to in turn, by default only this one
+    void setAcceptTargets(const std::vector<NativeProxyWorker *> &targets);
+
+    void start();
+    void stop();
+
+    void closeAllSessions();
+    void setIdleTimeouts(int handshakeTimeoutMs, int relayTimeoutMs);
+
+    int sessionsCount() const { return sessionsCount_; }
+    quint64 reapedCount() const { return reapedCount_; }
+
+    // called by the sessions on the worker thread
+    void removeSession(NativeProxySession *session);
+
+private:
+    static constexpr int kDefaultHandshakeTimeoutMs = 30000;
+    static constexpr int kDefaultRelayTimeoutMs = 10 * 60 * 1000;
+    static constexpr int kMaxReapIntervalMs = 5000;
+
+    NativeProxyProtocol protocol_;
+    Callbacks callbacks_;
+    boost::asio::io_service ioService_;
+    std::unique_ptr<boost::asio::io_service::work> work_;
+    std::unique_ptr<boost::asio::ip::tcp::acceptor> acceptor_;
+    std::vector<NativeProxyWorker *> acceptTargets_;
+    size_t nextAcceptTarget_;
+    std::thread thread_;
+
+    // one timer per worker instead of one per session keeps the sessions small
+    boost::asio::steady_timer reapTimer_;
+    int handshakeTimeoutMs_;
+    int relayTimeoutMs_;
+
+    std::unordered_map<NativeProxySession *, std::shared_ptr<NativeProxySession>> sessions_;
+    std::atomic<int> sessionsCount_;
+    std::atomic<quint64> reapedCount_;
+
+    void accept();
+    void addSession(boost::asio::ip::tcp::socket socket);
+    void closeAllSessionsNow();
+    void scheduleReap();
+    void reapIdleSessions();
+};
+
+} // namespace NativeProxyServer
@@ -0,0 +1,81 @@
+#include "peeraddress.h"
+
+#include <QNetworkInterface>
+
+#ifdef Q_OS_WIN
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <sys/socket.h>
+#endif
+
+namespace PeerAddress {
+
+QHostAddress normalized(const QHostAddress &address)
+{
+    if (address.protocol() == QAbstractSocket::IPv6Protocol)
+    {
+        bool isIPv4;
+        const quint32 ipv4 = address.toIPv4Address(&isIPv4);
+        if (isIPv4)
+        {
+            return QHostAddress(ipv4);
+        }
+    }
+    return address;
+}
+
+QHostAddress ofSocket(qintptr socketDescriptor)
+{
+    sockaddr_storage addr = {};
+#ifdef Q_OS_WIN
+    int addrLen = sizeof(addr);
+#else
+    socklen_t addrLen = sizeof(addr);
+#endif
+    if (getpeername(socketDescriptor, reinterpret_cast<sockaddr *>(&addr), &addrLen) != 0)
+    {
+        return QHostAddress();
+    }
+    return normalized(QHostAddress(reinterpret_cast<const sockaddr *>(&addr)));
+}
+
+bool isLocalNetwork(const QHostAddress &address)
+{
+    const QHostAddress peer = normalized(address);
+    if (peer.protocol() == QAbstractSocket::IPv4Protocol)
+    {
+        return true;
+    }
+    if (peer.protocol() != QAbstractSocket::IPv6Protocol)
+    {
+        return false;
+    }
+    if (peer.isLoopback() || peer.isLinkLocal() || peer.isUniqueLocalUnicast())
+    {
+        return true;
+    }
+
+    // a global address, only clients of a network we're on are served
+    const QList<QNetworkInterface> interfaces = QNetworkInterface::allInterfaces();
+    for (const QNetworkInterface &iface : interfaces)
+    {
+        if (!(iface.flags() & QNetworkInterface::IsUp))
+        {
+            continue;
+        }
+        const QList<QNetworkAddressEntry> entries = iface.addressEntries();
+        for (const QNetworkAddressEntry &entry : entries)
+        {
+            // a /128 address, such as the one of the tunnel, has no other hosts on its link
+            if (entry.ip().protocol() == QAbstractSocket::IPv6Protocol && entry.prefixLength() > 0 &&
+                entry.prefixLength() < 128 && peer.isInSubnet(entry.ip(), entry.prefixLength()))
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+} // namespace PeerAddress
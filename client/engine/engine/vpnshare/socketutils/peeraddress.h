@@ -0,0 +1,17 @@
+#pragma once
+
+#include <QHostAddress>
+
+// Addresses of the proxy clients. The listeners are dual-stack, so IPv4 clients show up as IPv4-mapped IPv6 addresses;
+// they are converted back to IPv4 so that a device is the same client whichever way it connected.
+namespace PeerAddress {
+
+QHostAddress normalized(const QHostAddress &address);
+// the normalized address of the peer of a connected socket, a null address if it can't be determined
+QHostAddress ofSocket(qintptr socketDescriptor);
+// Whether a client may use the proxy, which has no authentication. The IPv4 clients are on the LAN or the hotspot,
+// behind NAT. The dual-stack listeners are reachable from the whole IPv6 internet, so of the IPv6 clients only those of
+// the local networks are: loopback, link-local and unique local addresses, and the on-link prefixes of the interfaces.
+bool isLocalNetwork(const QHostAddress &address);
+
+} // namespace PeerAddress
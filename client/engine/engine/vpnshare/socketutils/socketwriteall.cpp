@@ -1,45 +1,100 @@
 #include "socketwriteall.h"
 
 SocketWriteAll::SocketWriteAll(QObject *parent, QTcpSocket *socket) : QObject(parent),
-    socket_(socket), bEmitAllDataWritten_(false)
+    socket_(socket), frontOffset_(0), chunksBytes_(0), isFull_(false), bEmitAllDataWritten_(false)
 {
     connect(socket_, &QTcpSocket::bytesWritten, this, &SocketWriteAll::onBytesWritten);
 }
 
 void SocketWriteAll::write(const QByteArray &arr)
 {
-    if (arr_.isEmpty())
+    if (arr.isEmpty())
     {
-        arr_ = arr;
-        socket_->write(arr_);
+        return;
     }
-    else
+
+    chunks_.push_back(arr);
+    chunksBytes_ += arr.size();
+    feedSocket();
+
+    const qint64 queued = queuedBytes();
+    if (queued > stats_.maxQueuedBytes)
+    {
+        stats_.maxQueuedBytes = queued;
+    }
+    if (!isFull_ && queued >= kHighWatermark)
     {
-        arr_.append(arr);
+        isFull_ = true;
+        stats_.pausesCount++;
     }
 }
 
 void SocketWriteAll::setEmitAllDataWritten()
 {
-    if (arr_.isEmpty())
+    if (queuedBytes() == 0)
     {
         emit allDataWriteFinished();
     }
     bEmitAllDataWritten_ = true;
 }
 
+bool SocketWriteAll::isEmpty() const
+{
+    return chunks_.empty();
+}
+
+bool SocketWriteAll::isFull() const
+{
+    return isFull_;
+}
+
+SocketWriteAll::QueueStats SocketWriteAll::queueStats() const
+{
+    QueueStats stats = stats_;
+    stats.queuedBytes = queuedBytes();
+    return stats;
+}
+
 void SocketWriteAll::onBytesWritten(qint64 bytes)
 {
-    arr_.remove(0, bytes);
-    if (!arr_.isEmpty())
+    stats_.totalBytesWritten += bytes;
+    feedSocket();
+
+    const qint64 queued = queuedBytes();
+    if (isFull_ && queued <= kLowWatermark)
+    {
+        isFull_ = false;
+        emit writeQueueDrained();
+    }
+    if (queued == 0 && bEmitAllDataWritten_)
     {
-        socket_->write(arr_);
+        emit allDataWriteFinished();
     }
-    else
+}
+
+void SocketWriteAll::feedSocket()
+{
+    while (!chunks_.empty() && socket_->bytesToWrite() < kSocketBufferSize)
     {
-        if (bEmitAllDataWritten_)
+        const QByteArray &front = chunks_.front();
+        const qint64 len = qMin(front.size() - frontOffset_, kSocketBufferSize - socket_->bytesToWrite());
+        const qint64 written = socket_->write(front.constData() + frontOffset_, len);
+        if (written <= 0)
         {
-            emit allDataWriteFinished();
+            break;
+        }
+
+        frontOffset_ += written;
+        chunksBytes_ -= written;
+        if (frontOffset_ == front.size())
+        {
+            chunks_.pop_front();
+            frontOffset_ = 0;
         }
     }
 }
+
+qint64 SocketWriteAll::queuedBytes() const
+{
+    return chunksBytes_ + socket_->bytesToWrite();
+}
@@ -2,24 +2,58 @@
 
 #include <QObject>
 #include <QTcpSocket>
+#include <deque>
 
+// Writes everything it is given to the socket, keeping the data that doesn't fit into the socket's buffer in a queue.
+// The queue is bounded by watermarks: once it holds more than kHighWatermark bytes isFull() returns true and the owner
+// should stop reading from the peer socket until writeQueueDrained() is emitted.
 class SocketWriteAll : public QObject
 {
     Q_OBJECT
 public:
+    // read buffer size for the peer sockets, so that not reading from them actually pushes back on the sender
+    static constexpr qint64 kPeerReadBufferSize = 256 * 1024;
+
+    struct QueueStats
+    {
+        qint64 queuedBytes = 0;
+        qint64 maxQueuedBytes = 0;
+        quint32 pausesCount = 0;
+        qint64 totalBytesWritten = 0;
+    };
+
     explicit SocketWriteAll(QObject *parent, QTcpSocket *socket);
     void write(const QByteArray &arr);
 
     void setEmitAllDataWritten();
+    bool isEmpty() const;
+    bool isFull() const;
+
+    QueueStats queueStats() const;
 
 signals:
     void allDataWriteFinished();
+    void writeQueueDrained();
 
 private slots:
     void onBytesWritten(qint64 bytes);
 
 private:
+    // at most this much is handed to the socket's own buffer, the rest waits in chunks_
+    static constexpr qint64 kSocketBufferSize = 64 * 1024;
+    static constexpr qint64 kHighWatermark = 1024 * 1024;
+    static constexpr qint64 kLowWatermark = 256 * 1024;
+
     QTcpSocket *socket_;
-    QByteArray arr_;
+    // chunks are kept as they were received and released as soon as they are fully handed to the socket,
+    // frontOffset_ is the number of bytes of the first chunk already handed over
+    std::deque<QByteArray> chunks_;
+    qint64 frontOffset_;
+    qint64 chunksBytes_;
+    bool isFull_;
     bool bEmitAllDataWritten_;
+    QueueStats stats_;
+
+    void feedSocket();
+    qint64 queuedBytes() const;
 };
@@ -0,0 +1,237 @@
+#include "splicerelay.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+SpliceRelay::SpliceRelay() : isEnabled_(true), lastId_(0), epollFd_(-1), wakeupFd_(-1)
+{
+}
+
+SpliceRelay::~SpliceRelay()
+{
+    if (thread_.joinable()) {
+        std::uint64_t value = 1;
+        if (write(wakeupFd_, &value, sizeof(value)) == sizeof(value)) {
+            thread_.join();
+        } else {
+            thread_.detach();
+        }
+    }
+
+    std::lock_guard<std::mutex> locker(mutex_);
+    for (auto &it : pairs_) {
+        closePair(it.second);
+    }
+    pairs_.clear();
+    if (wakeupFd_ >= 0) {
+        close(wakeupFd_);
+    }
+    if (epollFd_ >= 0) {
+        close(epollFd_);
+    }
+}
+
+std::uint64_t SpliceRelay::add(int fd1, int fd2, std::function<void()> onFinished,
+                                std::function<void(int side, size_t bytes)> onTransferred)
+{
+    std::lock_guard<std::mutex> locker(mutex_);
+
+    Pair *pair = new Pair;
+    pair->fd[0] = fd1;
+    pair->fd[1] = fd2;
+    pair->onFinished = onFinished;
+    pair->onTransferred = onTransferred;
+
+    bool isOk = start();
+    for (int i = 0; i < 2 && isOk; ++i) {
+        // SPLICE_F_NONBLOCK only applies to the pipe, reading from a socket blocks unless the socket itself is non-blocking
+        fcntl(pair->fd[i], F_SETFL, fcntl(pair->fd[i], F_GETFL) | O_NONBLOCK);
+        if (pipe2(pair->dir[i].pipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+            isOk = false;
+        } else {
+            // larger pipes let every splice() call move more data, it's fine if the kernel refuses
+            fcntl(pair->dir[i].pipe[1], F_SETPIPE_SZ, kPipeSize);
+        }
+    }
+    if (!isOk) {
+        closePair(pair);
+        return 0;
+    }
+
+    pair->id = ++lastId_;
+    // the low bit of the epoll data tells which socket of the pair is ready, 0 is reserved for the wakeup eventfd
+    for (int i = 0; i < 2; ++i) {
+        epoll_event ev = {};
+        ev.data.u64 = (pair->id << 1) | i;
+        if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, pair->fd[i], &ev) != 0) {
+            closePair(pair);
+            return 0;
+        }
+    }
+    pairs_[pair->id] = pair;
+    updateEvents(pair);
+
+    return pair->id;
+}
+
+void SpliceRelay::remove(std::uint64_t id)
+{
+    std::lock_guard<std::mutex> locker(mutex_);
+    auto it = pairs_.find(id);
+    if (it != pairs_.end()) {
+        closePair(it->second);
+        pairs_.erase(it);
+    }
+}
+
+bool SpliceRelay::start()
+{
+    if (thread_.joinable()) {
+        return true;
+    }
+
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    wakeupFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd_ < 0 || wakeupFd_ < 0) {
+        return false;
+    }
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = 0;
+    if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeupFd_, &ev) != 0) {
+        return false;
+    }
+
+    thread_ = std::thread(&SpliceRelay::run, this);
+    return true;
+}
+
+void SpliceRelay::run()
+{
+    epoll_event events[kMaxEvents];
+    while (true) {
+        int count = epoll_wait(epollFd_, events, kMaxEvents, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        std::lock_guard<std::mutex> locker(mutex_);
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.u64 == 0) {
+                return;
+            }
+            // the pair may have been removed or finished while handling an earlier event of this batch
+            auto it = pairs_.find(events[i].data.u64 >> 1);
+            if (it != pairs_.end()) {
+                handleEvent(it->second, events[i].data.u64 & 1, events[i].events);
+            }
+        }
+    }
+}
+
+void SpliceRelay::handleEvent(Pair *pair, int side, std::uint32_t events)
+{
+    bool isOk = pump(pair, 0) && pump(pair, 1);
+
+    // after a hangup or an error nothing more can be written to this socket; whatever could still be read from it
+    // was moved by the pump above
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        isOk = isOk && pair->dir[side].isDone && pair->dir[1 - side].isDone;
+    }
+
+    if (!isOk || (pair->dir[0].isDone && pair->dir[1].isDone)) {
+        pairs_.erase(pair->id);
+        if (pair->onFinished) {
+            pair->onFinished();
+        }
+        closePair(pair);
+        return;
+    }
+    updateEvents(pair);
+}
+
+bool SpliceRelay::pump(Pair *pair, int i)
+{
+    Direction &d = pair->dir[i];
+    const int from = pair->fd[i];
+    const int to = pair->fd[1 - i];
+
+    while (!d.isDone) {
+        // only read into an empty pipe, so that EAGAIN unambiguously means there is no data in the socket
+        if (d.pipeBytes == 0 && !d.isEof) {
+            ssize_t n = splice(from, nullptr, d.pipe[1], nullptr, kPipeSize, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n > 0) {
+                d.pipeBytes = n;
+                if (pair->onTransferred) {
+                    pair->onTransferred(i, n);
+                }
+            } else if (n == 0) {
+                d.isEof = true;
+            } else if (errno == EAGAIN) {
+                return true;
+            } else if (errno != EINTR) {
+                return false;
+            }
+        }
+
+        if (d.pipeBytes > 0) {
+            ssize_t n = splice(d.pipe[0], nullptr, to, nullptr, d.pipeBytes, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n > 0) {
+                d.pipeBytes -= n;
+            } else if (n < 0 && errno == EAGAIN) {
+                return true;
+            } else if (n < 0 && errno != EINTR) {
+                return false;
+            }
+        }
+
+        if (d.isEof && d.pipeBytes == 0) {
+            shutdown(to, SHUT_WR);
+            d.isDone = true;
+        }
+    }
+    return true;
+}
+
+void SpliceRelay::updateEvents(Pair *pair)
+{
+    for (int i = 0; i < 2; ++i) {
+        std::uint32_t events = 0;
+        if (!pair->dir[i].isDone && !pair->dir[i].isEof && pair->dir[i].pipeBytes == 0) {
+            events |= EPOLLIN;
+        }
+        if (pair->dir[1 - i].pipeBytes > 0) {
+            events |= EPOLLOUT;
+        }
+        if (events != pair->events[i]) {
+            epoll_event ev = {};
+            ev.events = events;
+            ev.data.u64 = (pair->id << 1) | i;
+            epoll_ctl(epollFd_, EPOLL_CTL_MOD, pair->fd[i], &ev);
+            pair->events[i] = events;
+        }
+    }
+}
+
+void SpliceRelay::closePair(Pair *pair)
+{
+    // closing the descriptors also removes them from the epoll set
+    for (int i = 0; i < 2; ++i) {
+        if (pair->fd[i] >= 0) {
+            close(pair->fd[i]);
+        }
+        for (int p = 0; p < 2; ++p) {
+            if (pair->dir[i].pipe[p] >= 0) {
+                close(pair->dir[i].pipe[p]);
+            }
+        }
+    }
+    delete pair;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+// Linux only. Relays data between two connected TCP sockets without copying it to user space: each direction is
+// moved with splice() through its own pipe. All relayed pairs are served by one dedicated epoll thread.
+class SpliceRelay
+{
+public:
+    static SpliceRelay &instance()
+    {
+        static SpliceRelay i;
+        return i;
+    }
+
+    bool isEnabled() const { return isEnabled_; }
+    void setEnabled(bool isEnabled) { isEnabled_ = isEnabled; }
+
+    // Takes ownership of both descriptors and returns the id of the pair, or 0 on failure (the descriptors are closed then).
+    // onFinished is called on the relay thread once both directions are shut down or an error occurred, unless the pair
+    // was removed before that. onTransferred, if set, is called on the relay thread with the number of bytes read from
+    // fd1 (side 0) or fd2 (side 1).
+    std::uint64_t add(int fd1, int fd2, std::function<void()> onFinished,
+                      std::function<void(int side, size_t bytes)> onTransferred = nullptr);
+    // closes the pair, onFinished is not called after this returns
+    void remove(std::uint64_t id);
+
+private:
+    SpliceRelay();
+    ~SpliceRelay();
+    SpliceRelay(const SpliceRelay &) = delete;
+    SpliceRelay &operator=(const SpliceRelay &) = delete;
+
+    static constexpr int kPipeSize = 256 * 1024;
+    static constexpr int kMaxEvents = 64;
+
+    struct Direction
+    {
+        int pipe[2] = { -1, -1 };
+        size_t pipeBytes = 0;
+        bool isEof = false;
+        bool isDone = false;
+    };
+
+    // dir[i] moves data from fd[i] to fd[1 - i]
+    struct Pair
+    {
+        std::uint64_t id = 0;
+        int fd[2] = { -1, -1 };
+        std::uint32_t events[2] = { 0, 0 };
+        Direction dir[2];
+        std::function<void()> onFinished;
+        std::function<void(int side, size_t bytes)> onTransferred;
+    };
+
+    std::atomic<bool> isEnabled_;
+    std::mutex mutex_;
+    std::map<std::uint64_t, Pair *> pairs_;
+    std::uint64_t lastId_;
+    int epollFd_;
+    int wakeupFd_;
+    std::thread thread_;
+
+    bool start();
+    void run();
+    void handleEvent(Pair *pair, int side, std::uint32_t events);
+    bool pump(Pair *pair, int i);
+    void updateEvents(Pair *pair);
+    void closePair(Pair *pair);
+};
@@ -100,8 +100,9 @@ TRI_BOOL SocksProxyCommandParser::consume(char input)
     }
     else if (state_ == address_ipv6)
     {
+        // unlike the IPv4 address and the port, an IPv6 address is not a number, so it stays in network byte order
         char *p = (char *)&cmd_.DestAddr.IPv6;
-        p[sizeof(cmd_.DestAddr.IPv6) - addressReaded_ - 1] = input;
+        p[addressReaded_] = input;
         addressReaded_++;
         if (addressReaded_ == sizeof(cmd_.DestAddr.IPv6))
         {
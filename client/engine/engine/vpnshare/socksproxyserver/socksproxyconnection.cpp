@@ -1,18 +1,35 @@
 #include "socksproxyconnection.h"
 #include <QHostAddress>
 #include <QThread>
+#include <QTimer>
 #include "utils/ws_assert.h"
 #include "utils/logger.h"
+#include "../socketutils/peeraddress.h"
+
+#ifdef Q_OS_LINUX
+    #include <unistd.h>
+    #include "../socketutils/splicerelay.h"
+#endif
 
 namespace SocksProxyServer {
 
 
-SocksProxyConnection::SocksProxyConnection(qintptr socketDescriptor, const QString &hostname,
+SocksProxyConnection::SocksProxyConnection(qintptr socketDescriptor, const QHostAddress &peerAddress,
                                            QObject *parent)
     : QObject(parent), socket_(nullptr), socketExternal_(nullptr),
-    socketDescriptor_(socketDescriptor), hostname_(hostname), state_(READ_IDENT_REQ),
-    writeAllSocket_(0), writeAllSocketExternal_(0), bAlreadyClosedAndEmitFinished_(false)
+    socketDescriptor_(socketDescriptor), peerAddress_(peerAddress), hostname_(peerAddress.toString()), state_(READ_IDENT_REQ),
+    writeAllSocket_(0), writeAllSocketExternal_(0), udpAssociation_(nullptr), bAlreadyClosedAndEmitFinished_(false), isThrottled_(false), spliceRelayId_(0)
+{
+}
+
+SocksProxyConnection::~SocksProxyConnection()
 {
+#ifdef Q_OS_LINUX
+    if (spliceRelayId_ != 0)
+    {
+        SpliceRelay::instance().remove(spliceRelayId_);
+    }
+#endif
 }
 
 void SocksProxyConnection::start()
@@ -24,6 +41,8 @@ void SocksProxyConnection::start()
         return;
     }
     state_ = READ_IDENT_REQ;
+    traffic_ = ClientTrafficStats::instance().connectionOpened(peerAddress_);
+    socket_->setReadBufferSize(SocketWriteAll::kPeerReadBufferSize);
     readExactly_.reset(new SocksProxyReadExactly(sizeof(socks5_ident_req)));
     connect(socket_, &QTcpSocket::disconnected, this, &SocksProxyConnection::onSocketDisconnected);
     connect(socket_, &QTcpSocket::readyRead, this, &SocksProxyConnection::onSocketReadyRead);
@@ -43,6 +62,12 @@ void SocksProxyConnection::onSocketDisconnected()
 
 void SocksProxyConnection::onSocketReadyRead()
 {
+    if (state_ == RELAY_BETWEEN_CLIENT_SERVER && (isThrottled_ || writeAllSocketExternal_->isFull()))
+    {
+        // leave the data in the socket's bounded read buffer until the external server catches up
+        return;
+    }
+
     socketReadArr_.append(socket_->readAll());
 
     if (state_ == READ_IDENT_REQ)
@@ -104,6 +129,7 @@ void SocksProxyConnection::onSocketReadyRead()
             {
                 WS_ASSERT(socketExternal_ == NULL);
                 socketExternal_ = new QTcpSocket(this);
+                socketExternal_->setReadBufferSize(SocketWriteAll::kPeerReadBufferSize);
 
                 connect(socketExternal_, &QTcpSocket::connected, this, &SocksProxyConnection::onExternalSocketConnected);
                 connect(socketExternal_, &QTcpSocket::disconnected, this, &SocksProxyConnection::onExternalSocketDisconnected);
@@ -111,6 +137,9 @@ void SocksProxyConnection::onSocketReadyRead()
                 connect(socketExternal_, &QTcpSocket::errorOccurred, this, &SocksProxyConnection::onExternalSocketError);
 
                 writeAllSocketExternal_ = new SocketWriteAll(this, socketExternal_);
+                // resume reading from the side that was paused because the other side's write queue was full
+                connect(writeAllSocketExternal_, &SocketWriteAll::writeQueueDrained, this, &SocksProxyConnection::onSocketReadyRead);
+                connect(writeAllSocket_, &SocketWriteAll::writeQueueDrained, this, &SocksProxyConnection::onExternalSocketReadyRead);
                 state_ = CONNECT_TO_HOST;
 
                 if (commandParser_.cmd().AddrType == 0x01)  // ip4
@@ -137,7 +166,7 @@ void SocksProxyConnection::onSocketReadyRead()
             }
             else if (commandParser_.cmd().Cmd == 0x03)  // udp associate
             {
-                WS_ASSERT(false);
+                startUdpAssociation();
             }
             else
             {
@@ -160,6 +189,12 @@ void SocksProxyConnection::onSocketReadyRead()
     else if (state_ == RELAY_BETWEEN_CLIENT_SERVER)
     {
         writeAllSocketExternal_->write(socketReadArr_);
+        accountTraffic(socketReadArr_.size(), true);
+        socketReadArr_.clear();
+    }
+    else if (state_ == UDP_ASSOCIATE)
+    {
+        // the control connection carries nothing after the reply, it only keeps the association alive
         socketReadArr_.clear();
     }
     else
@@ -181,12 +216,17 @@ void SocksProxyConnection::onExternalSocketConnected()
     if (state_ == CONNECT_TO_HOST)
     {
         socks5_resp resp;
-        memcpy(&resp, &commandParser_.cmd(), sizeof(resp));
+        memset(&resp, 0, sizeof(resp));
+        resp.Version = 0x05;
         resp.Reply = 0x00;
-        //resp.BindPort = 0x00;
-        //memset(&resp.BindAddr.IPv4, 0, sizeof(resp.BindAddr.IPv4));
+        setBindAddress(resp, socketExternal_->localAddress(), socketExternal_->localPort());
         writeAllSocket_->write(getByteArrayFromSocks5Resp(resp));
         state_ = RELAY_BETWEEN_CLIENT_SERVER;
+
+        // the connection is handed to the kernel relay once the reply and everything queued so far are written
+        connect(socket_, &QTcpSocket::bytesWritten, this, &SocksProxyConnection::tryStartSpliceRelay);
+        connect(socketExternal_, &QTcpSocket::bytesWritten, this, &SocksProxyConnection::tryStartSpliceRelay);
+        tryStartSpliceRelay();
     }
     else
     {
@@ -210,10 +250,17 @@ void SocksProxyConnection::onExternalSocketDisconnected()
 
 void SocksProxyConnection::onExternalSocketReadyRead()
 {
+    if (isThrottled_ || writeAllSocket_->isFull())
+    {
+        // leave the data in the socket's bounded read buffer until the client catches up
+        return;
+    }
+
     QByteArray arr = socketExternal_->readAll();
     if (state_ == RELAY_BETWEEN_CLIENT_SERVER)
     {
         writeAllSocket_->write(arr);
+        accountTraffic(arr.size(), false);
     }
     /*else if (state_ == READ_HEADERS_FROM_WEBSERVER)
     {
@@ -263,11 +310,146 @@ void SocksProxyConnection::onExternalSocketError(QAbstractSocket::SocketError so
     }*/
 }
 
+void SocksProxyConnection::startUdpAssociation()
+{
+    // DestPort is the port the client will send from, 0 if it doesn't know it yet
+    udpAssociation_ = new SocksProxyUdpAssociation(peerAddress_, commandParser_.cmd().DestPort, traffic_, this);
+    connect(udpAssociation_, &SocksProxyUdpAssociation::idleTimeout, this, &SocksProxyConnection::closeSocketsAndEmitFinished);
+
+    socks5_resp resp;
+    memset(&resp, 0, sizeof(resp));
+    resp.Version = 0x05;
+    resp.AddrType = 0x01;
+    // an IPv4 client of the dual-stack listener gets a plain IPv4 relay socket
+    if (!udpAssociation_->start(PeerAddress::normalized(socket_->localAddress())))
+    {
+        resp.Reply = 0x01;  // general SOCKS server failure
+        writeAllSocket_->write(getByteArrayFromSocks5Resp(resp));
+        connect(writeAllSocket_, &SocketWriteAll::allDataWriteFinished, this, &SocksProxyConnection::closeSocketsAndEmitFinished);
+        writeAllSocket_->setEmitAllDataWritten();
+        return;
+    }
+
+    // the client sends its datagrams to this address
+    setBindAddress(resp, udpAssociation_->bindAddress(), udpAssociation_->bindPort());
+
+    qCDebug(LOG_SOCKS_SERVER) << "UDP association for" << hostname_ << "on port" << udpAssociation_->bindPort();
+    state_ = UDP_ASSOCIATE;
+    writeAllSocket_->write(getByteArrayFromSocks5Resp(resp));
+}
+
+void SocksProxyConnection::tryStartSpliceRelay()
+{
+#ifdef Q_OS_LINUX
+    if (state_ != RELAY_BETWEEN_CLIENT_SERVER || spliceRelayId_ != 0 || bAlreadyClosedAndEmitFinished_ || !SpliceRelay::instance().isEnabled())
+    {
+        return;
+    }
+    // the kernel relay can't be paused, the rate limited clients stay on the Qt path
+    if (traffic_ && traffic_->isRateLimited())
+    {
+        return;
+    }
+    // data buffered by Qt or SocketWriteAll would be reordered with the spliced data, so wait until both sides are drained
+    if (!socketReadArr_.isEmpty() || !writeAllSocket_->isEmpty() || !writeAllSocketExternal_->isEmpty() ||
+        socket_->bytesToWrite() > 0 || socketExternal_->bytesToWrite() > 0 ||
+        socket_->bytesAvailable() > 0 || socketExternal_->bytesAvailable() > 0)
+    {
+        return;
+    }
+
+    int fd = dup(socket_->socketDescriptor());
+    int fdExternal = dup(socketExternal_->socketDescriptor());
+    if (fd < 0 || fdExternal < 0)
+    {
+        if (fd >= 0) close(fd);
+        if (fdExternal >= 0) close(fdExternal);
+        return;
+    }
+
+    std::function<void(int, size_t)> onTransferred;
+    if (traffic_)
+    {
+        onTransferred = [traffic = traffic_](int side, size_t bytes) {
+            side == 0 ? traffic->addUploaded(bytes) : traffic->addDownloaded(bytes);
+        };
+    }
+    spliceRelayId_ = SpliceRelay::instance().add(fd, fdExternal, [this]() {
+        QMetaObject::invokeMethod(this, [this]() { onSpliceRelayFinished(); }, Qt::QueuedConnection);
+    }, onTransferred);
+    if (spliceRelayId_ == 0)
+    {
+        // keep relaying through Qt
+        return;
+    }
+
+    // the relay owns duplicates of the descriptors now, Qt must not read from them anymore
+    socket_->disconnect();
+    socketExternal_->disconnect();
+    socket_->abort();
+    socketExternal_->abort();
+#endif
+}
+
+void SocksProxyConnection::onThrottleTimeout()
+{
+    isThrottled_ = false;
+    if (!bAlreadyClosedAndEmitFinished_ && state_ == RELAY_BETWEEN_CLIENT_SERVER)
+    {
+        onSocketReadyRead();
+        onExternalSocketReadyRead();
+    }
+}
+
+void SocksProxyConnection::accountTraffic(qint64 bytes, bool isUpload)
+{
+    if (!traffic_ || bytes <= 0)
+    {
+        return;
+    }
+    isUpload ? traffic_->addUploaded(bytes) : traffic_->addDownloaded(bytes);
+    const int delayMs = traffic_->consume(bytes);
+    if (delayMs > 0 && !isThrottled_)
+    {
+        isThrottled_ = true;
+        QTimer::singleShot(delayMs, this, &SocksProxyConnection::onThrottleTimeout);
+    }
+}
+
+void SocksProxyConnection::onSpliceRelayFinished()
+{
+    spliceRelayId_ = 0;
+    closeSocketsAndEmitFinished();
+}
+
+void SocksProxyConnection::logQueueStats()
+{
+    // only the connections that had to pause reading are worth a line in the log
+    const SocketWriteAll::QueueStats client = writeAllSocket_ ? writeAllSocket_->queueStats() : SocketWriteAll::QueueStats();
+    const SocketWriteAll::QueueStats external = writeAllSocketExternal_ ? writeAllSocketExternal_->queueStats() : SocketWriteAll::QueueStats();
+    if (client.pausesCount > 0 || external.pausesCount > 0)
+    {
+        qCDebug(LOG_SOCKS_SERVER) << "Write queues of" << hostname_ << "- to client: max" << client.maxQueuedBytes << "bytes,"
+                                  << client.pausesCount << "pauses; to server: max" << external.maxQueuedBytes << "bytes,"
+                                  << external.pausesCount << "pauses";
+    }
+}
+
 void SocksProxyConnection::closeSocketsAndEmitFinished()
 {
     if (!bAlreadyClosedAndEmitFinished_)
     {
         bAlreadyClosedAndEmitFinished_ = true;
+        logQueueStats();
+        ClientTrafficStats::instance().connectionClosed(traffic_);
+        traffic_.reset();
+#ifdef Q_OS_LINUX
+        if (spliceRelayId_ != 0)
+        {
+            SpliceRelay::instance().remove(spliceRelayId_);
+            spliceRelayId_ = 0;
+        }
+#endif
         if (socket_)
         {
             socket_->close();
@@ -276,8 +458,32 @@ void SocksProxyConnection::closeSocketsAndEmitFinished()
         {
             socketExternal_->close();
         }
-        emit finished(hostname_);
+        if (udpAssociation_)
+        {
+            udpAssociation_->deleteLater();
+            udpAssociation_ = nullptr;
+        }
+        emit finished(peerAddress_);
+    }
+}
+
+void SocksProxyConnection::setBindAddress(socks5_resp &resp, const QHostAddress &address, quint16 port)
+{
+    // in network byte order, unlike the addresses of the parsed command
+    bool isIPv4;
+    const quint32 ipv4 = address.toIPv4Address(&isIPv4);
+    if (isIPv4)
+    {
+        resp.AddrType = 0x01;
+        resp.BindAddr.IPv4.s_addr = htonl(ipv4);
+    }
+    else
+    {
+        resp.AddrType = 0x04;
+        const Q_IPV6ADDR ipv6 = address.toIPv6Address();
+        memcpy(&resp.BindAddr.IPv6, &ipv6, sizeof(ipv6));
     }
+    resp.BindPort = htons(port);
 }
 
 QByteArray SocksProxyConnection::getByteArrayFromSocks5Resp(const socks5_resp &resp)
@@ -8,6 +8,8 @@
 #include "socksproxyidentreqparser.h"
 #include "../socketutils/socketwriteall.h"
 #include "socksproxycommandparser.h"
+#include "socksproxyudpassociation.h"
+#include "../clienttrafficstats.h"
 
 namespace SocksProxyServer {
 
@@ -15,7 +17,8 @@ class SocksProxyConnection : public QObject
 {
     Q_OBJECT
 public:
-    explicit SocksProxyConnection(qintptr socketDescriptor, const QString &hostname, QObject *parent = nullptr);
+    explicit SocksProxyConnection(qintptr socketDescriptor, const QHostAddress &peerAddress, QObject *parent = nullptr);
+    ~SocksProxyConnection();
 
     bool start(qintptr socketDescriptor);
 
@@ -24,7 +27,7 @@ public slots:
     void forceClose();
 
 signals:
-    void finished(const QString &hostname);
+    void finished(const QHostAddress &peerAddress);
 
 private slots:
     void onSocketDisconnected();
@@ -36,15 +39,20 @@ private slots:
     void onExternalSocketDisconnected();
     void onExternalSocketReadyRead();
     void onExternalSocketError(QAbstractSocket::SocketError socketError);
+
+    void tryStartSpliceRelay();
+    void onThrottleTimeout();
 private slots:
     void closeSocketsAndEmitFinished();
 private:
     QTcpSocket *socket_;
     QTcpSocket *socketExternal_;
     qintptr socketDescriptor_;
+    QHostAddress peerAddress_;
+    // the peer address as a string for the log
     QString hostname_;
 
-    enum { READ_IDENT_REQ, READ_COMMANDS, CONNECT_TO_HOST, RELAY_BETWEEN_CLIENT_SERVER } state_;
+    enum { READ_IDENT_REQ, READ_COMMANDS, CONNECT_TO_HOST, RELAY_BETWEEN_CLIENT_SERVER, UDP_ASSOCIATE } state_;
 
     QByteArray socketReadArr_;
     SocketWriteAll *writeAllSocket_;
@@ -54,8 +62,23 @@ private:
     SocksProxyCommandParser commandParser_;
     QScopedPointer<SocksProxyReadExactly> readExactly_;
 
+    // the UDP relay of an UDP ASSOCIATE command, it lives as long as this control connection
+    SocksProxyUdpAssociation *udpAssociation_;
+    void startUdpAssociation();
+
     bool bAlreadyClosedAndEmitFinished_;
+    void logQueueStats();
+
+    std::shared_ptr<ClientTraffic> traffic_;
+    // both directions are paused while the client is over its rate limit
+    bool isThrottled_;
+    void accountTraffic(qint64 bytes, bool isUpload);
+
+    // id of the kernel relay (Linux only) that took over the sockets of an established connection, 0 if none
+    quint64 spliceRelayId_;
+    void onSpliceRelayFinished();
 
+    void setBindAddress(socks5_resp &resp, const QHostAddress &address, quint16 port);
     QByteArray getByteArrayFromSocks5Resp(const socks5_resp &resp);
 
 };
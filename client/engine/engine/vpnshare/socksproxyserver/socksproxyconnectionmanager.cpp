@@ -3,6 +3,7 @@
 #include <QThread>
 #include <QTimer>
 #include "utils/ws_assert.h"
+#include "../socketutils/peeraddress.h"
 
 namespace SocksProxyServer {
 
@@ -20,19 +21,11 @@ SocksProxyConnectionManager::SocksProxyConnectionManager(QObject *parent, int th
 
 void SocksProxyConnectionManager::newConnection(qintptr socketDescriptor)
 {
-#ifdef Q_OS_WIN
-    SOCKADDR_IN  addr = {0};
-    int addr_len = sizeof(addr);
-#elif defined (Q_OS_MAC) || defined (Q_OS_LINUX)
-    sockaddr_in addr;
-    socklen_t addr_len = sizeof(addr);
-#endif
-    getpeername(socketDescriptor, (sockaddr*)&addr, &addr_len);
-    char *ip = inet_ntoa(addr.sin_addr);
-    usersCounter_->newUserConnected(ip);
+    const QHostAddress peerAddress = PeerAddress::ofSocket(socketDescriptor);
+    usersCounter_->newUserConnected(peerAddress);
 
     QThread *thread = getLessBusyThread();
-    SocksProxyConnection *connection = new SocksProxyConnection(socketDescriptor, ip);
+    SocksProxyConnection *connection = new SocksProxyConnection(socketDescriptor, peerAddress);
     connect(connection, &SocksProxyConnection::finished, this, &SocksProxyConnectionManager::onConnectionFinished);
     addConnectionToThread(thread, connection);
     //qCDebug(LOG_SOCKS_SERVER) << "Count of connections:" << connections_.count();
@@ -58,9 +51,9 @@ void SocksProxyConnectionManager::stop()
     }
 }
 
-void SocksProxyConnectionManager::onConnectionFinished(const QString &hostname)
+void SocksProxyConnectionManager::onConnectionFinished(const QHostAddress &peerAddress)
 {
-    usersCounter_->userDiconnected(hostname);
+    usersCounter_->userDiconnected(peerAddress);
 
     SocksProxyConnection *connection = static_cast<SocksProxyConnection *>(sender());
     //qCDebug(LOG_SOCKS_SERVER) << "Connection finished:" << connection;
@@ -19,7 +19,7 @@ public:
     void stop();
 
 private slots:
-    void onConnectionFinished(const QString &hostname);
+    void onConnectionFinished(const QHostAddress &peerAddress);
 
 private:
     QMap<QThread *, quint32> threads_;
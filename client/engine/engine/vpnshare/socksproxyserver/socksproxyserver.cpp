@@ -1,6 +1,9 @@
 #include "socksproxyserver.h"
 #include "utils/ws_assert.h"
 #include "utils/logger.h"
+#include "../socketutils/peeraddress.h"
+
+#include <QTcpSocket>
 
 namespace SocksProxyServer {
 
@@ -20,7 +23,8 @@ bool SocksProxyServer::startServer(quint16 port)
 {
     WS_ASSERT(!isListening());
 
-    if (listen(QHostAddress::AnyIPv4, port))
+    // QHostAddress::Any is a dual-stack socket, IPv4 only is the fallback for the systems with IPv6 disabled
+    if (listen(QHostAddress::Any, port) || listen(QHostAddress::AnyIPv4, port))
     {
         qCDebug(LOG_SOCKS_SERVER) << "Socks proxy server started on port" << serverPort();
         return true;
@@ -54,6 +58,13 @@ void SocksProxyServer::closeActiveConnections()
 
 void SocksProxyServer::incomingConnection(qintptr socketDescriptor)
 {
+    if (!PeerAddress::isLocalNetwork(PeerAddress::ofSocket(socketDescriptor)))
+    {
+        QTcpSocket socket;
+        socket.setSocketDescriptor(socketDescriptor);
+        socket.abort();
+        return;
+    }
     connectionManager_->newConnection(socketDescriptor);
 }
 
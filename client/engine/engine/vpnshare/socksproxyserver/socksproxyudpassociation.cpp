@@ -0,0 +1,249 @@
+#include "socksproxyudpassociation.h"
+#include <QtEndian>
+#include "utils/logger.h"
+
+namespace SocksProxyServer {
+
+SocksProxyUdpAssociation::SocksProxyUdpAssociation(const QHostAddress &clientAddress, quint16 clientPort,
+                                                   const std::shared_ptr<ClientTraffic> &traffic, QObject *parent)
+    : QObject(parent), clientSocket_(new QUdpSocket(this)), externalSocket_(new QUdpSocket(this)),
+    clientAddress_(clientAddress), clientPort_(clientPort), traffic_(traffic), idleTimer_(this),
+    domainUseCounter_(0), buffer_(kReplyHeaderRoom + kMaxDatagramSize), datagramPort_(0),
+    datagramsToTargets_(0), datagramsToClient_(0), datagramsDropped_(0)
+{
+    connect(clientSocket_, &QUdpSocket::readyRead, this, &SocksProxyUdpAssociation::onClientReadyRead);
+    connect(externalSocket_, &QUdpSocket::readyRead, this, &SocksProxyUdpAssociation::onExternalReadyRead);
+    connect(&idleTimer_, &QTimer::timeout, this, &SocksProxyUdpAssociation::onIdleCheck);
+}
+
+SocksProxyUdpAssociation::~SocksProxyUdpAssociation()
+{
+    qCDebug(LOG_SOCKS_SERVER) << "UDP association of" << clientAddress_.toString() << "closed, datagrams to targets:" << datagramsToTargets_
+                              << "to client:" << datagramsToClient_ << "dropped:" << datagramsDropped_;
+}
+
+bool SocksProxyUdpAssociation::start(const QHostAddress &localAddress)
+{
+    if (!clientSocket_->bind(localAddress, 0))
+    {
+        qCDebug(LOG_SOCKS_SERVER) << "Can't bind UDP association socket:" << clientSocket_->errorString();
+        return false;
+    }
+    if (!externalSocket_->bind(QHostAddress::Any, 0))
+    {
+        qCDebug(LOG_SOCKS_SERVER) << "Can't bind UDP association external socket:" << externalSocket_->errorString();
+        return false;
+    }
+
+    lastActivity_.start();
+    idleTimer_.start(kIdleCheckIntervalMs);
+    return true;
+}
+
+QHostAddress SocksProxyUdpAssociation::bindAddress() const
+{
+    return clientSocket_->localAddress();
+}
+
+quint16 SocksProxyUdpAssociation::bindPort() const
+{
+    return clientSocket_->localPort();
+}
+
+void SocksProxyUdpAssociation::onClientReadyRead()
+{
+    while (clientSocket_->hasPendingDatagrams())
+    {
+        const qint64 size = clientSocket_->readDatagram(buffer_.data(), kMaxDatagramSize, &datagramAddress_, &datagramPort_);
+        if (size < 0)
+        {
+            break;
+        }
+
+        quint16 targetPort;
+        const int headerSize = isFromClient(datagramAddress_, datagramPort_) ?
+                               parseClientHeader(reinterpret_cast<const unsigned char *>(buffer_.data()), size, targetPort) : 0;
+        if (headerSize == 0)
+        {
+            datagramsDropped_++;
+            continue;
+        }
+
+        externalSocket_->writeDatagram(buffer_.data() + headerSize, size - headerSize, targetAddress_, targetPort);
+        datagramsToTargets_++;
+        if (traffic_)
+        {
+            traffic_->addUploaded(size - headerSize);
+        }
+        lastActivity_.restart();
+    }
+}
+
+void SocksProxyUdpAssociation::onExternalReadyRead()
+{
+    char *payload = buffer_.data() + kReplyHeaderRoom;
+    while (externalSocket_->hasPendingDatagrams())
+    {
+        const qint64 size = externalSocket_->readDatagram(payload, kMaxDatagramSize, &datagramAddress_, &datagramPort_);
+        if (size < 0)
+        {
+            break;
+        }
+        if (clientPort_ == 0)
+        {
+            // the client hasn't sent anything yet, so there's nowhere to send this to
+            datagramsDropped_++;
+            continue;
+        }
+
+        // write the header right in front of the payload
+        char *header;
+        bool isIPv4;
+        const quint32 ipv4 = datagramAddress_.toIPv4Address(&isIPv4);
+        if (isIPv4)
+        {
+            header = payload - 10;
+            header[3] = 0x01;
+            qToBigEndian(ipv4, header + 4);
+        }
+        else
+        {
+            header = payload - 22;
+            header[3] = 0x04;
+            const Q_IPV6ADDR ipv6 = datagramAddress_.toIPv6Address();
+            memcpy(header + 4, &ipv6, sizeof(ipv6));
+        }
+        header[0] = header[1] = header[2] = 0x00;
+        qToBigEndian(datagramPort_, payload - 2);
+
+        clientSocket_->writeDatagram(header, payload + size - header, clientAddress_, clientPort_);
+        datagramsToClient_++;
+        if (traffic_)
+        {
+            traffic_->addDownloaded(size);
+        }
+        lastActivity_.restart();
+    }
+}
+
+void SocksProxyUdpAssociation::onIdleCheck()
+{
+    if (lastActivity_.elapsed() > kIdleTimeoutMs)
+    {
+        qCDebug(LOG_SOCKS_SERVER) << "UDP association of" << clientAddress_.toString() << "is idle, closing";
+        idleTimer_.stop();
+        emit idleTimeout();
+    }
+}
+
+void SocksProxyUdpAssociation::onLookupFinished(const QHostInfo &info)
+{
+    const QByteArray domain = info.hostName().toLatin1();
+    pendingLookups_.remove(domain);
+    if (info.error() != QHostInfo::NoError || info.addresses().isEmpty())
+    {
+        return;
+    }
+
+    if (resolvedDomains_.size() >= kMaxCachedDomains)
+    {
+        auto oldest = resolvedDomains_.begin();
+        for (auto it = resolvedDomains_.begin(); it != resolvedDomains_.end(); ++it)
+        {
+            if (it->lastUsed < oldest->lastUsed)
+            {
+                oldest = it;
+            }
+        }
+        resolvedDomains_.erase(oldest);
+    }
+    QHostAddress address = info.addresses().first();
+    for (const QHostAddress &a : info.addresses())
+    {
+        if (a.protocol() == QAbstractSocket::IPv4Protocol)
+        {
+            address = a;
+            break;
+        }
+    }
+    resolvedDomains_.insert(domain, ResolvedDomain{address, ++domainUseCounter_});
+}
+
+bool SocksProxyUdpAssociation::isFromClient(const QHostAddress &address, quint16 port)
+{
+    if (!address.isEqual(clientAddress_, QHostAddress::ConvertV4MappedToIPv4))
+    {
+        return false;
+    }
+    if (clientPort_ == 0)
+    {
+        clientPort_ = port;
+    }
+    return port == clientPort_;
+}
+
+int SocksProxyUdpAssociation::parseClientHeader(const unsigned char *data, qint64 size, quint16 &outPort)
+{
+    // fragmentation is optional and not supported, fragments are dropped
+    if (size < 4 || data[2] != 0x00)
+    {
+        return 0;
+    }
+
+    int headerSize;
+    if (data[3] == 0x01)  // ip4
+    {
+        headerSize = 4 + 4 + 2;
+        if (size < headerSize)
+        {
+            return 0;
+        }
+        targetAddress_.setAddress(qFromBigEndian<quint32>(data + 4));
+    }
+    else if (data[3] == 0x04)  // ip6
+    {
+        headerSize = 4 + 16 + 2;
+        if (size < headerSize)
+        {
+            return 0;
+        }
+        targetAddress_.setAddress(data + 4);
+    }
+    else if (data[3] == 0x03)  // domain name
+    {
+        if (size < 5)
+        {
+            return 0;
+        }
+        headerSize = 4 + 1 + data[4] + 2;
+        if (size < headerSize)
+        {
+            return 0;
+        }
+
+        // looked up without copying the name out of the datagram
+        const QByteArray domain = QByteArray::fromRawData(reinterpret_cast<const char *>(data + 5), data[4]);
+        auto it = resolvedDomains_.find(domain);
+        if (it == resolvedDomains_.end())
+        {
+            if (!pendingLookups_.contains(domain))
+            {
+                const QByteArray name(domain.constData(), domain.size());
+                pendingLookups_.insert(name);
+                QHostInfo::lookupHost(QString::fromLatin1(name), this, &SocksProxyUdpAssociation::onLookupFinished);
+            }
+            return 0;
+        }
+        it->lastUsed = ++domainUseCounter_;
+        targetAddress_ = it->address;
+    }
+    else
+    {
+        return 0;
+    }
+
+    outPort = qFromBigEndian<quint16>(data + headerSize - 2);
+    return headerSize;
+}
+
+} // namespace SocksProxyServer
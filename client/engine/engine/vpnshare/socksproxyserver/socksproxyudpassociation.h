@@ -0,0 +1,89 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QHostInfo>
+#include <QObject>
+#include <QSet>
+#include <QTimer>
+#include <QUdpSocket>
+#include <memory>
+#include <vector>
+#include "../clienttrafficstats.h"
+
+namespace SocksProxyServer {
+
+// Relays the datagrams of one SOCKS5 UDP ASSOCIATE (RFC 1928, section 7). The client sends encapsulated datagrams to
+// the client socket; they are unwrapped and sent to their targets from the external socket, and the answers are
+// wrapped and sent back to the client. Datagrams are read into one preallocated buffer and the SOCKS header is
+// parsed and prepended in place, so the relay path doesn't allocate.
+class SocksProxyUdpAssociation : public QObject
+{
+    Q_OBJECT
+public:
+    // clientPort is the port the client announced in its request, 0 if it will be learned from the first datagram.
+    // The datagrams are counted in traffic if it's set; they are never delayed, the rate limit applies to TCP only.
+    explicit SocksProxyUdpAssociation(const QHostAddress &clientAddress, quint16 clientPort,
+                                      const std::shared_ptr<ClientTraffic> &traffic, QObject *parent = nullptr);
+    ~SocksProxyUdpAssociation();
+
+    // binds the client socket to localAddress (the address the client reached the proxy on) and the external socket
+    bool start(const QHostAddress &localAddress);
+
+    QHostAddress bindAddress() const;
+    quint16 bindPort() const;
+
+signals:
+    void idleTimeout();
+
+private slots:
+    void onClientReadyRead();
+    void onExternalReadyRead();
+    void onIdleCheck();
+    void onLookupFinished(const QHostInfo &info);
+
+private:
+    static constexpr int kIdleTimeoutMs = 120000;
+    static constexpr int kIdleCheckIntervalMs = 10000;
+    static constexpr int kMaxDatagramSize = 65535;
+    // RSV(2) FRAG(1) ATYP(1) IPv6(16) PORT(2), the biggest header of the datagrams sent back to the client
+    static constexpr int kReplyHeaderRoom = 22;
+    static constexpr int kMaxCachedDomains = 64;
+
+    QUdpSocket *clientSocket_;
+    QUdpSocket *externalSocket_;
+    QHostAddress clientAddress_;
+    quint16 clientPort_;
+    std::shared_ptr<ClientTraffic> traffic_;
+
+    QElapsedTimer lastActivity_;
+    QTimer idleTimer_;
+
+    struct ResolvedDomain
+    {
+        QHostAddress address;
+        quint64 lastUsed;
+    };
+
+    // targets given as domain names, keyed by the bytes of the name in the datagram; datagrams for a name that is
+    // still being resolved are dropped. The least recently used name makes room for a new one.
+    QHash<QByteArray, ResolvedDomain> resolvedDomains_;
+    QSet<QByteArray> pendingLookups_;
+    quint64 domainUseCounter_;
+
+    std::vector<char> buffer_;
+    QHostAddress datagramAddress_;
+    quint16 datagramPort_;
+    QHostAddress targetAddress_;
+
+    quint64 datagramsToTargets_;
+    quint64 datagramsToClient_;
+    quint64 datagramsDropped_;
+
+    bool isFromClient(const QHostAddress &address, quint16 port);
+    // returns the size of the header or 0 if the datagram must be dropped; fills targetAddress_
+    int parseClientHeader(const unsigned char *data, qint64 size, quint16 &outPort);
+};
+
+} // namespace SocksProxyServer
@@ -0,0 +1,866 @@
+#include "vpnsharebenchmark.test.h"
+#include <QtTest>
+#include <QElapsedTimer>
+
+#include <QFile>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "engine/vpnshare/clienttrafficstats.h"
+#include "engine/vpnshare/httpproxyserver/httpproxyserver.h"
+#include "engine/vpnshare/nativeproxyserver/nativeproxyserver.h"
+#include "engine/vpnshare/socketutils/peeraddress.h"
+#include "engine/vpnshare/socksproxyserver/socksproxyserver.h"
+#ifdef Q_OS_LINUX
+    #include "engine/vpnshare/socketutils/splicerelay.h"
+#endif
+
+namespace {
+
+// total amount of data pulled through the proxy in every run, split between the connections
+const quint64 kTotalBytes = 1024ull * 1024 * 1024;
+
+// concurrent connections of the load test
+const int kLoadConnections = 5000;
+
+// 127.0.0.1 or ::1
+socklen_t loopbackAddress(quint16 port, bool isIPv6, sockaddr_storage &outAddr)
+{
+    outAddr = {};
+    if (isIPv6) {
+        sockaddr_in6 *addr = reinterpret_cast<sockaddr_in6 *>(&outAddr);
+        addr->sin6_family = AF_INET6;
+        addr->sin6_addr = in6addr_loopback;
+        addr->sin6_port = htons(port);
+        return sizeof(sockaddr_in6);
+    }
+    sockaddr_in *addr = reinterpret_cast<sockaddr_in *>(&outAddr);
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr->sin_port = htons(port);
+    return sizeof(sockaddr_in);
+}
+
+int listenLoopback(quint16 &outPort, bool isIPv6 = false)
+{
+    int fd = socket(isIPv6 ? AF_INET6 : AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_storage addr;
+    socklen_t len = loopbackAddress(0, isIPv6, addr);
+    if (bind(fd, (sockaddr *)&addr, len) != 0 || listen(fd, SOMAXCONN) != 0 || getsockname(fd, (sockaddr *)&addr, &len) != 0) {
+        close(fd);
+        return -1;
+    }
+    outPort = ntohs(isIPv6 ? reinterpret_cast<sockaddr_in6 *>(&addr)->sin6_port : reinterpret_cast<sockaddr_in *>(&addr)->sin_port);
+    return fd;
+}
+
+int connectLoopback(quint16 port, bool isIPv6 = false)
+{
+    int fd = socket(isIPv6 ? AF_INET6 : AF_INET, SOCK_STREAM, 0);
+    sockaddr_storage addr;
+    const socklen_t len = loopbackAddress(port, isIPv6, addr);
+    if (::connect(fd, (sockaddr *)&addr, len) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool sendAll(int fd, const void *data, size_t size)
+{
+    const char *p = static_cast<const char *>(data);
+    while (size > 0) {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool recvExactly(int fd, void *data, size_t size)
+{
+    char *p = static_cast<char *>(data);
+    while (size > 0) {
+        ssize_t n = recv(fd, p, size, 0);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+// reads the proxy's answer up to the empty line, returns true if it is a 200
+bool recvHttpConnectReply(int fd)
+{
+    QByteArray reply;
+    char c;
+    while (!reply.endsWith("\r\n\r\n")) {
+        if (recv(fd, &c, 1, 0) != 1) {
+            return false;
+        }
+        reply.append(c);
+    }
+    return reply.startsWith("HTTP/1.0 200") || reply.startsWith("HTTP/1.1 200");
+}
+
+// CONNECT to the loopback port, with ATYP 4 (::1) if isIPv6
+bool socksConnect(int fd, quint16 port, bool isIPv6 = false)
+{
+    const unsigned char ident[] = { 0x05, 0x01, 0x00 };
+    unsigned char answer[2];
+    if (!sendAll(fd, ident, sizeof(ident)) || !recvExactly(fd, answer, sizeof(answer)) || answer[1] != 0x00) {
+        return false;
+    }
+    QByteArray request = isIPv6 ? QByteArray("\x05\x01\x00\x04", 4) + QByteArray(15, 0) + '\x01' : QByteArray("\x05\x01\x00\x01\x7F\x00\x00\x01", 8);
+    request.append(char(port >> 8)).append(char(port & 0xFF));
+    // the bound address in the reply has the family of the connection to the target
+    unsigned char reply[22];
+    return sendAll(fd, request.constData(), request.size()) && recvExactly(fd, reply, isIPv6 ? 22 : 10) && reply[1] == 0x00 &&
+           reply[3] == (isIPv6 ? 0x04 : 0x01);
+}
+
+// asks the HTTP or the SOCKS proxy for a tunnel to the loopback port
+bool proxyConnect(int fd, bool isHttp, quint16 port, bool isIPv6)
+{
+    if (!isHttp) {
+        return socksConnect(fd, port, isIPv6);
+    }
+    const QByteArray host = isIPv6 ? "[::1]" : "127.0.0.1";
+    const QByteArray request = "CONNECT " + host + ":" + QByteArray::number(port) + " HTTP/1.1\r\nHost: " + host + "\r\n\r\n";
+    return sendAll(fd, request.constData(), request.size()) && recvHttpConnectReply(fd);
+}
+
+// the UDP associate request of a client that doesn't know its port yet; returns the relay endpoint of the proxy
+bool socksUdpAssociate(int fd, sockaddr_in &outRelay)
+{
+    const unsigned char ident[] = { 0x05, 0x01, 0x00 };
+    unsigned char answer[2];
+    if (!sendAll(fd, ident, sizeof(ident)) || !recvExactly(fd, answer, sizeof(answer)) || answer[1] != 0x00) {
+        return false;
+    }
+    const unsigned char request[] = { 0x05, 0x03, 0x00, 0x01, 0, 0, 0, 0, 0, 0 };
+    unsigned char reply[10];
+    if (!sendAll(fd, request, sizeof(request)) || !recvExactly(fd, reply, sizeof(reply)) || reply[1] != 0x00 || reply[3] != 0x01) {
+        return false;
+    }
+    outRelay = {};
+    outRelay.sin_family = AF_INET;
+    memcpy(&outRelay.sin_addr, reply + 4, 4);
+    memcpy(&outRelay.sin_port, reply + 8, 2);
+    return true;
+}
+
+int udpLoopback(quint16 &outPort)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (sockaddr *)&addr, len) != 0 || getsockname(fd, (sockaddr *)&addr, &len) != 0) {
+        close(fd);
+        return -1;
+    }
+    timeval tv = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    outPort = ntohs(addr.sin_port);
+    return fd;
+}
+
+// resident set size of this process in bytes, 0 if unknown
+qint64 currentRss()
+{
+    QFile file("/proc/self/statm");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    const QList<QByteArray> fields = file.readAll().split(' ');
+    return fields.size() > 1 ? fields[1].toLongLong() * sysconf(_SC_PAGESIZE) : 0;
+}
+
+} // namespace
+
+VpnShareBenchmark_test::VpnShareBenchmark_test()
+{
+}
+
+void VpnShareBenchmark_test::benchmarkHttpConnectRelay_data()
+{
+    QTest::addColumn<int>("connections");
+    QTest::addColumn<bool>("isSplice");
+
+    for (int connections : { 1, 10, 100 }) {
+        QTest::addRow("qt, %d connections", connections) << connections << false;
+#ifdef Q_OS_LINUX
+        QTest::addRow("splice, %d connections", connections) << connections << true;
+#endif
+    }
+}
+
+void VpnShareBenchmark_test::benchmarkHttpConnectRelay()
+{
+    QFETCH(int, connections);
+    QFETCH(bool, isSplice);
+
+#ifdef Q_OS_LINUX
+    SpliceRelay::instance().setEnabled(isSplice);
+#else
+    Q_UNUSED(isSplice);
+#endif
+    double speed = runRelay(ProxyType::kHttp, connections, kTotalBytes / connections);
+    QVERIFY(speed > 0);
+    qDebug() << "HTTP CONNECT," << (isSplice ? "splice" : "qt") << "relay," << connections << "connections:" << speed << "MB/s";
+}
+
+void VpnShareBenchmark_test::benchmarkSocksRelay_data()
+{
+    benchmarkHttpConnectRelay_data();
+}
+
+void VpnShareBenchmark_test::benchmarkSocksRelay()
+{
+    QFETCH(int, connections);
+    QFETCH(bool, isSplice);
+
+#ifdef Q_OS_LINUX
+    SpliceRelay::instance().setEnabled(isSplice);
+#else
+    Q_UNUSED(isSplice);
+#endif
+    double speed = runRelay(ProxyType::kSocks, connections, kTotalBytes / connections);
+    QVERIFY(speed > 0);
+    qDebug() << "SOCKS5," << (isSplice ? "splice" : "qt") << "relay," << connections << "connections:" << speed << "MB/s";
+}
+
+void VpnShareBenchmark_test::stressSlowConsumer()
+{
+#ifdef Q_OS_LINUX
+    // the kernel relay keeps the data out of the process, this is about the queues of the Qt path
+    SpliceRelay::instance().setEnabled(false);
+#endif
+    if (currentRss() == 0) {
+        QSKIP("RSS is not available on this platform");
+    }
+
+    // a fast source and clients reading 64 KB per millisecond at most; without backpressure the proxy would
+    // buffer most of the 512 MB
+    const int kConnections = 4;
+    qint64 peakRssGrowth = 0;
+    double speed = runRelay(ProxyType::kHttp, kConnections, 128ull * 1024 * 1024, 1000, &peakRssGrowth);
+    QVERIFY(speed > 0);
+    qDebug() << "Slow consumers:" << speed << "MB/s, peak RSS growth" << peakRssGrowth / 1024 << "KB";
+    QVERIFY(peakRssGrowth < 64 * 1024 * 1024);
+}
+
+void VpnShareBenchmark_test::benchmarkSocksUdpRelay_data()
+{
+    QTest::addColumn<bool>("isNative");
+    QTest::addRow("qt engine") << false;
+    QTest::addRow("native engine") << true;
+}
+
+void VpnShareBenchmark_test::benchmarkSocksUdpRelay()
+{
+    QFETCH(bool, isNative);
+
+    // the echo server answers every datagram to its sender until it's closed
+    quint16 echoPort;
+    int echoFd = udpLoopback(echoPort);
+    QVERIFY(echoFd >= 0);
+    std::atomic<bool> isStopped(false);
+    std::thread echo([echoFd, &isStopped]() {
+        char buf[2048];
+        sockaddr_in from;
+        while (!isStopped) {
+            socklen_t len = sizeof(from);
+            ssize_t n = recvfrom(echoFd, buf, sizeof(buf), 0, (sockaddr *)&from, &len);
+            if (n > 0) {
+                sendto(echoFd, buf, n, 0, (sockaddr *)&from, len);
+            }
+        }
+    });
+
+    QScopedPointer<SocksProxyServer::SocksProxyServer> socksProxy;
+    QScopedPointer<NativeProxyServer::NativeProxyServer> nativeProxy;
+    quint16 proxyPort;
+    if (isNative) {
+        nativeProxy.reset(new NativeProxyServer::NativeProxyServer(nullptr, NativeProxyServer::NativeProxyProtocol::kSocks));
+        QVERIFY(nativeProxy->startServer(0));
+        proxyPort = nativeProxy->serverPort();
+    } else {
+        socksProxy.reset(new SocksProxyServer::SocksProxyServer(nullptr));
+        QVERIFY(socksProxy->startServer(0));
+        proxyPort = socksProxy->serverPort();
+    }
+
+    const int kPayloadSize = 64;
+    const int kPingPongs = 5000;
+    const int kInFlight = 64;
+    const int kBlastMs = 2000;
+
+    std::atomic<bool> isFinished(false);
+    bool isOk = false;
+    double directRttUs = 0, relayRttUs = 0, pps = 0;
+    std::thread client([&]() {
+        quint16 clientPort;
+        int udpFd = udpLoopback(clientPort);
+        int controlFd = connectLoopback(proxyPort);
+        sockaddr_in relay;
+        if (udpFd < 0 || controlFd < 0 || !socksUdpAssociate(controlFd, relay)) {
+            isFinished = true;
+            return;
+        }
+
+        sockaddr_in echoAddr = {};
+        echoAddr.sin_family = AF_INET;
+        echoAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        echoAddr.sin_port = htons(echoPort);
+
+        // RSV FRAG ATYP DST.ADDR DST.PORT followed by the payload
+        unsigned char datagram[10 + kPayloadSize] = { 0x00, 0x00, 0x00, 0x01, 127, 0, 0, 1 };
+        datagram[8] = echoPort >> 8;
+        datagram[9] = echoPort & 0xFF;
+        unsigned char answer[2048];
+
+        auto measureRtt = [&](const sockaddr_in &to, const unsigned char *data, size_t size) -> double {
+            QElapsedTimer timer;
+            timer.start();
+            for (int i = 0; i < kPingPongs; ++i) {
+                if (sendto(udpFd, data, size, 0, (const sockaddr *)&to, sizeof(to)) != (ssize_t)size ||
+                    recv(udpFd, answer, sizeof(answer), 0) != (ssize_t)size) {
+                    return -1;
+                }
+            }
+            return timer.nsecsElapsed() / 1000.0 / kPingPongs;
+        };
+
+        directRttUs = measureRtt(echoAddr, datagram + 10, kPayloadSize);
+        relayRttUs = measureRtt(relay, datagram, sizeof(datagram));
+        // the answers must come back wrapped with the echo server as the source
+        isOk = directRttUs > 0 && relayRttUs > 0 && answer[3] == 0x01 && answer[8] == datagram[8] && answer[9] == datagram[9];
+
+        // keep kInFlight datagrams on the way, a lost one is replaced on the next receive timeout
+        if (isOk) {
+            timeval tv = { 0, 100000 };
+            setsockopt(udpFd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            for (int i = 0; i < kInFlight; ++i) {
+                sendto(udpFd, datagram, sizeof(datagram), 0, (sockaddr *)&relay, sizeof(relay));
+            }
+            quint64 received = 0;
+            QElapsedTimer timer;
+            timer.start();
+            while (timer.elapsed() < kBlastMs) {
+                if (recv(udpFd, answer, sizeof(answer), 0) > 0) {
+                    received++;
+                }
+                sendto(udpFd, datagram, sizeof(datagram), 0, (sockaddr *)&relay, sizeof(relay));
+            }
+            pps = received * 1000.0 / timer.elapsed();
+        }
+
+        close(controlFd);
+        close(udpFd);
+        isFinished = true;
+    });
+
+    // the proxy server accepts the control connection on this thread's event loop
+    QTest::qWaitFor([&]() { return isFinished.load(); }, 60000);
+    client.join();
+    isStopped = true;
+    echo.join();
+    close(echoFd);
+    if (nativeProxy) {
+        nativeProxy->closeActiveConnections();
+        nativeProxy->stopServer();
+    } else {
+        socksProxy->closeActiveConnections();
+        socksProxy->stopServer();
+    }
+
+    QVERIFY(isOk);
+    qDebug() << (isNative ? "Native" : "Qt") << "engine, SOCKS5 UDP relay:" << pps << "datagrams/s of" << kPayloadSize << "bytes, round trip" << relayRttUs << "us vs"
+             << directRttUs << "us direct, added latency" << (relayRttUs - directRttUs) / 2 << "us per direction";
+}
+
+void VpnShareBenchmark_test::loadManyConnections_data()
+{
+    QTest::addColumn<bool>("isNative");
+    QTest::addRow("qt engine") << false;
+    QTest::addRow("native engine") << true;
+}
+
+void VpnShareBenchmark_test::loadManyConnections()
+{
+    QFETCH(bool, isNative);
+
+    // every proxied connection takes four descriptors of this process: the client, the two proxy sockets and the target
+    rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    const int connections = qMin<qint64>(kLoadConnections, ((qint64)limit.rlim_cur - 256) / 4);
+    if (connections < kLoadConnections) {
+        qDebug() << "The descriptors limit only allows" << connections << "connections";
+    }
+    QVERIFY(connections > 0);
+
+    // the target accepts and holds the connections until it's closed
+    quint16 targetPort;
+    int targetFd = listenLoopback(targetPort);
+    QVERIFY(targetFd >= 0);
+    std::vector<int> targetConnections;
+    std::thread target([targetFd, &targetConnections]() {
+        while (true) {
+            int fd = accept(targetFd, nullptr, nullptr);
+            if (fd < 0) {
+                break;
+            }
+            targetConnections.push_back(fd);
+        }
+    });
+
+    QScopedPointer<SocksProxyServer::SocksProxyServer> socksProxy;
+    QScopedPointer<NativeProxyServer::NativeProxyServer> nativeProxy;
+    quint16 proxyPort;
+    if (isNative) {
+        nativeProxy.reset(new NativeProxyServer::NativeProxyServer(nullptr, NativeProxyServer::NativeProxyProtocol::kSocks));
+        QVERIFY(nativeProxy->startServer(0));
+        proxyPort = nativeProxy->serverPort();
+    } else {
+        socksProxy.reset(new SocksProxyServer::SocksProxyServer(nullptr));
+        QVERIFY(socksProxy->startServer(0));
+        proxyPort = socksProxy->serverPort();
+    }
+
+    // the accept latency is the time from connect() to the answer to the SOCKS greeting, so it includes handing the
+    // socket to a thread and the first read
+    const qint64 initialRss = currentRss();
+    std::vector<int> clientConnections;
+    std::vector<qint64> acceptLatenciesUs;
+    std::atomic<bool> isFinished(false);
+    bool isOk = true;
+    std::thread client([&]() {
+        for (int i = 0; i < connections && isOk; ++i) {
+            QElapsedTimer timer;
+            timer.start();
+            int fd = connectLoopback(proxyPort);
+            const unsigned char ident[] = { 0x05, 0x01, 0x00 };
+            unsigned char answer[2];
+            isOk = fd >= 0 && sendAll(fd, ident, sizeof(ident)) && recvExactly(fd, answer, sizeof(answer));
+            acceptLatenciesUs.push_back(timer.nsecsElapsed() / 1000);
+
+            const unsigned char request[] = { 0x05, 0x01, 0x00, 0x01, 127, 0, 0, 1, (unsigned char)(targetPort >> 8), (unsigned char)(targetPort & 0xFF) };
+            unsigned char reply[10];
+            isOk = isOk && sendAll(fd, request, sizeof(request)) && recvExactly(fd, reply, sizeof(reply)) && reply[1] == 0x00;
+            if (fd >= 0) {
+                clientConnections.push_back(fd);
+            }
+        }
+        isFinished = true;
+    });
+    // the Qt engine accepts on this thread's event loop
+    QTest::qWaitFor([&]() { return isFinished.load(); }, 300000);
+    client.join();
+    const qint64 rssGrowth = currentRss() - initialRss;
+
+    if (isOk) {
+        std::sort(acceptLatenciesUs.begin(), acceptLatenciesUs.end());
+        qDebug() << (isNative ? "Native" : "Qt") << "engine," << connections << "connections:"
+                 << (initialRss > 0 ? rssGrowth / connections : -1) << "bytes of RSS per connection, accept latency p50"
+                 << acceptLatenciesUs[acceptLatenciesUs.size() / 2] << "us, p99" << acceptLatenciesUs[acceptLatenciesUs.size() * 99 / 100]
+                 << "us, max" << acceptLatenciesUs.back() << "us";
+    }
+
+    bool isReaped = true;
+    if (isOk && isNative) {
+        QCOMPARE(nativeProxy->activeConnectionsCount(), connections);
+        // none of the connections moves any data, so they all go once they count as idle
+        nativeProxy->setIdleTimeouts(500, 500);
+        isReaped = QTest::qWaitFor([&]() { return nativeProxy->activeConnectionsCount() == 0; }, 10000);
+        isReaped = isReaped && nativeProxy->reapedConnectionsCount() == (quint64)connections;
+    }
+
+    for (int fd : clientConnections) {
+        close(fd);
+    }
+    if (socksProxy) {
+        socksProxy->closeActiveConnections();
+        socksProxy->stopServer();
+    }
+    if (nativeProxy) {
+        nativeProxy->stopServer();
+    }
+    shutdown(targetFd, SHUT_RDWR);
+    close(targetFd);
+    target.join();
+    for (int fd : targetConnections) {
+        close(fd);
+    }
+
+    QVERIFY(isOk);
+    QVERIFY(isReaped);
+}
+
+void VpnShareBenchmark_test::benchmarkTrafficAccounting_data()
+{
+    QTest::addColumn<bool>("isSplice");
+
+    QTest::addRow("qt") << false;
+#ifdef Q_OS_LINUX
+    QTest::addRow("splice") << true;
+#endif
+}
+
+void VpnShareBenchmark_test::benchmarkTrafficAccounting()
+{
+    QFETCH(bool, isSplice);
+
+#ifdef Q_OS_LINUX
+    SpliceRelay::instance().setEnabled(isSplice);
+#else
+    Q_UNUSED(isSplice);
+#endif
+    // the runs alternate and the best of each is taken, so that a noisy moment doesn't count against either
+    const int kConnections = 10;
+    const int kRuns = 3;
+    double bestWithout = 0;
+    double bestWith = 0;
+    for (int run = 0; run < kRuns; ++run) {
+        ClientTrafficStats::instance().setEnabled(false);
+        const double without = runRelay(ProxyType::kHttp, kConnections, kTotalBytes / kConnections);
+        ClientTrafficStats::instance().setEnabled(true);
+        ClientTrafficStats::instance().reset();
+        const double with = runRelay(ProxyType::kHttp, kConnections, kTotalBytes / kConnections);
+        QVERIFY(without > 0 && with > 0);
+        bestWithout = qMax(bestWithout, without);
+        bestWith = qMax(bestWith, with);
+
+        // every byte the clients received went through the counters
+        const QVector<types::ProxySharingClientStats> stats = ClientTrafficStats::instance().snapshot();
+        QCOMPARE(stats.size(), 1);
+        QCOMPARE(stats[0].address, QString("127.0.0.1"));
+        QVERIFY(stats[0].totalConnections >= quint64(kConnections));
+        QVERIFY(stats[0].bytesDownloaded >= kTotalBytes);
+    }
+
+    const double overheadPercent = (bestWithout - bestWith) * 100.0 / bestWithout;
+    qDebug() << "Traffic accounting," << (isSplice ? "splice" : "qt") << "relay:" << bestWithout << "MB/s without,"
+             << bestWith << "MB/s with, overhead" << overheadPercent << "%";
+    if (overheadPercent > 2.0) {
+        qWarning() << "The accounting overhead is above 2%";
+    }
+}
+
+void VpnShareBenchmark_test::benchmarkTrafficCounters()
+{
+    // the relay path of a rate limited client: two counters and one token bucket CAS per chunk
+    const QHostAddress client("192.0.2.1");
+    ClientTrafficStats::instance().setEnabled(true);
+    ClientTrafficStats::instance().setRateLimit(client, 0xFFFFFFFF);
+    std::shared_ptr<ClientTraffic> traffic = ClientTrafficStats::instance().connectionOpened(client);
+    QVERIFY(traffic);
+    int delayMs = 0;
+    QBENCHMARK {
+        traffic->addDownloaded(16 * 1024);
+        delayMs += traffic->consume(16 * 1024);
+    }
+    QCOMPARE(delayMs, 0);
+    ClientTrafficStats::instance().connectionClosed(traffic);
+    ClientTrafficStats::instance().setRateLimit(client, 0);
+    ClientTrafficStats::instance().reset();
+}
+
+void VpnShareBenchmark_test::checkRateLimit()
+{
+    // the clients are paused on the Qt path, the kernel relay is skipped for them
+    const quint32 kLimitKBps = 4096;
+    ClientTrafficStats::instance().setEnabled(true);
+    ClientTrafficStats::instance().setDefaultRateLimit(kLimitKBps);
+    for (ProxyType type : { ProxyType::kHttp, ProxyType::kSocks }) {
+        // two connections share the limit of the client; 16 MB take about 4 seconds
+        const double speed = runRelay(type, 2, 8 * 1024 * 1024);
+        qDebug() << (type == ProxyType::kHttp ? "HTTP" : "SOCKS5") << "with a" << kLimitKBps << "KB/s limit:" << speed << "MB/s";
+        QVERIFY(speed > 0);
+        QVERIFY(speed > kLimitKBps / 1024.0 * 0.8 && speed < kLimitKBps / 1024.0 * 1.2);
+    }
+    ClientTrafficStats::instance().setDefaultRateLimit(0);
+}
+
+void VpnShareBenchmark_test::checkPeerAddressFilter()
+{
+    QVERIFY(PeerAddress::isLocalNetwork(QHostAddress("192.168.1.20")));
+    QVERIFY(PeerAddress::isLocalNetwork(QHostAddress("::ffff:10.0.0.2")));
+    QVERIFY(PeerAddress::isLocalNetwork(QHostAddress("::1")));
+    QVERIFY(PeerAddress::isLocalNetwork(QHostAddress("fe80::1234")));
+    QVERIFY(PeerAddress::isLocalNetwork(QHostAddress("fd00:1234::5")));
+    // documentation prefix, no interface is on it
+    QVERIFY(!PeerAddress::isLocalNetwork(QHostAddress("2001:db8::1")));
+    QVERIFY(!PeerAddress::isLocalNetwork(QHostAddress()));
+}
+
+void VpnShareBenchmark_test::benchmarkIPv6Loopback_data()
+{
+    QTest::addColumn<int>("type");
+
+    QTest::addRow("http") << int(ProxyType::kHttp);
+    QTest::addRow("socks") << int(ProxyType::kSocks);
+}
+
+void VpnShareBenchmark_test::benchmarkIPv6Loopback()
+{
+    QFETCH(int, type);
+
+    // skipped rather than failed on the machines without IPv6
+    quint16 port;
+    int probeFd = listenLoopback(port, true);
+    if (probeFd < 0) {
+        QSKIP("::1 is not available");
+    }
+    close(probeFd);
+
+    ClientTrafficStats::instance().setEnabled(true);
+    ClientTrafficStats::instance().reset();
+    const int kConnections = 10;
+    const double speedIPv4 = runRelay(ProxyType(type), kConnections, kTotalBytes / kConnections);
+    const double speedIPv6 = runRelay(ProxyType(type), kConnections, kTotalBytes / kConnections, 0, nullptr, true);
+    QVERIFY(speedIPv4 > 0);
+    QVERIFY(speedIPv6 > 0);
+
+    // both families are accounted separately, under the addresses the clients came from
+    const QVector<types::ProxySharingClientStats> stats = ClientTrafficStats::instance().snapshot();
+    QCOMPARE(stats.size(), 2);
+    for (const types::ProxySharingClientStats &client : stats) {
+        QVERIFY(client.address == "127.0.0.1" || client.address == "::1");
+        QVERIFY(client.bytesDownloaded >= kTotalBytes);
+    }
+
+    const int kRoundTrips = 2000;
+    const std::vector<double> latencyIPv4 = measureRoundTrips(ProxyType(type), kRoundTrips, false);
+    const std::vector<double> latencyIPv6 = measureRoundTrips(ProxyType(type), kRoundTrips, true);
+    QCOMPARE(int(latencyIPv4.size()), kRoundTrips);
+    QCOMPARE(int(latencyIPv6.size()), kRoundTrips);
+
+    const char *name = ProxyType(type) == ProxyType::kHttp ? "HTTP" : "SOCKS5";
+    qDebug() << name << "127.0.0.1:" << speedIPv4 << "MB/s, round trip p50" << latencyIPv4[kRoundTrips / 2]
+             << "us, p99" << latencyIPv4[kRoundTrips * 99 / 100] << "us";
+    qDebug() << name << "::1:" << speedIPv6 << "MB/s, round trip p50" << latencyIPv6[kRoundTrips / 2]
+             << "us, p99" << latencyIPv6[kRoundTrips * 99 / 100] << "us";
+    ClientTrafficStats::instance().reset();
+}
+
+double VpnShareBenchmark_test::runRelay(ProxyType type, int connections, quint64 bytesPerConnection, int clientReadDelayUs,
+                                        qint64 *outPeakRssGrowth, bool isIPv6)
+{
+    const qint64 initialRss = currentRss();
+    qint64 peakRss = initialRss;
+
+    // the source writes bytesPerConnection to every accepted connection and closes it
+    quint16 sourcePort;
+    int sourceFd = listenLoopback(sourcePort, isIPv6);
+    if (sourceFd < 0) {
+        return -1;
+    }
+    std::thread source([sourceFd, connections, bytesPerConnection]() {
+        std::vector<std::thread> writers;
+        for (int i = 0; i < connections; ++i) {
+            int fd = accept(sourceFd, nullptr, nullptr);
+            if (fd < 0) {
+                break;
+            }
+            writers.emplace_back([fd, bytesPerConnection]() {
+                std::vector<char> buf(64 * 1024, 'x');
+                quint64 sent = 0;
+                while (sent < bytesPerConnection) {
+                    size_t chunk = std::min<quint64>(buf.size(), bytesPerConnection - sent);
+                    if (!sendAll(fd, buf.data(), chunk)) {
+                        break;
+                    }
+                    sent += chunk;
+                }
+                close(fd);
+            });
+        }
+        for (auto &writer : writers) {
+            writer.join();
+        }
+    });
+
+    QScopedPointer<HttpProxyServer::HttpProxyServer> httpProxy;
+    QScopedPointer<SocksProxyServer::SocksProxyServer> socksProxy;
+    quint16 proxyPort;
+    if (type == ProxyType::kHttp) {
+        httpProxy.reset(new HttpProxyServer::HttpProxyServer(nullptr));
+        if (!httpProxy->startServer(0)) {
+            return -1;
+        }
+        proxyPort = httpProxy->serverPort();
+    } else {
+        socksProxy.reset(new SocksProxyServer::SocksProxyServer(nullptr));
+        if (!socksProxy->startServer(0)) {
+            return -1;
+        }
+        proxyPort = socksProxy->serverPort();
+    }
+
+    std::atomic<int> finished(0);
+    std::atomic<int> failed(0);
+    std::atomic<quint64> received(0);
+    std::vector<std::thread> clients;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < connections; ++i) {
+        clients.emplace_back([&, type]() {
+            int fd = connectLoopback(proxyPort, isIPv6);
+            bool isOk = fd >= 0 && proxyConnect(fd, type == ProxyType::kHttp, sourcePort, isIPv6);
+
+            // don't wait for EOF, the SOCKS proxy doesn't close the client side when the target disconnects
+            quint64 got = 0;
+            std::vector<char> buf(64 * 1024);
+            while (isOk && got < bytesPerConnection) {
+                ssize_t n = recv(fd, buf.data(), buf.size(), 0);
+                if (n <= 0) {
+                    break;
+                }
+                got += n;
+                if (clientReadDelayUs > 0) {
+                    usleep(clientReadDelayUs);
+                }
+            }
+            if (!isOk || got != bytesPerConnection) {
+                failed++;
+            }
+            received += got;
+            if (fd >= 0) {
+                close(fd);
+            }
+            finished++;
+        });
+    }
+
+    // the proxy servers accept connections on this thread's event loop
+    bool isDone = QTest::qWaitFor([&]() {
+        peakRss = qMax(peakRss, currentRss());
+        return finished == connections;
+    }, 300000);
+    if (outPeakRssGrowth) {
+        *outPeakRssGrowth = peakRss - initialRss;
+    }
+    const qint64 elapsedMs = timer.elapsed();
+
+    for (auto &client : clients) {
+        client.join();
+    }
+    shutdown(sourceFd, SHUT_RDWR);
+    close(sourceFd);
+    source.join();
+    if (httpProxy) {
+        httpProxy->closeActiveConnections();
+        httpProxy->stopServer();
+    }
+    if (socksProxy) {
+        socksProxy->closeActiveConnections();
+        socksProxy->stopServer();
+    }
+
+    if (!isDone || failed > 0 || elapsedMs == 0) {
+        return -1;
+    }
+    return (received / (1024.0 * 1024.0)) / (elapsedMs / 1000.0);
+}
+
+std::vector<double> VpnShareBenchmark_test::measureRoundTrips(ProxyType type, int count, bool isIPv6)
+{
+    std::vector<double> result;
+
+    // the echo server answers every byte of a single connection
+    quint16 echoPort;
+    int echoFd = listenLoopback(echoPort, isIPv6);
+    if (echoFd < 0) {
+        return result;
+    }
+    std::thread echo([echoFd]() {
+        int fd = accept(echoFd, nullptr, nullptr);
+        if (fd < 0) {
+            return;
+        }
+        char c;
+        while (recv(fd, &c, 1, 0) == 1 && sendAll(fd, &c, 1)) {
+        }
+        close(fd);
+    });
+
+    QScopedPointer<HttpProxyServer::HttpProxyServer> httpProxy;
+    QScopedPointer<SocksProxyServer::SocksProxyServer> socksProxy;
+    quint16 proxyPort = 0;
+    if (type == ProxyType::kHttp) {
+        httpProxy.reset(new HttpProxyServer::HttpProxyServer(nullptr));
+        if (httpProxy->startServer(0)) {
+            proxyPort = httpProxy->serverPort();
+        }
+    } else {
+        socksProxy.reset(new SocksProxyServer::SocksProxyServer(nullptr));
+        if (socksProxy->startServer(0)) {
+            proxyPort = socksProxy->serverPort();
+        }
+    }
+
+    std::atomic<bool> isDone(false);
+    std::thread client([&]() {
+        int fd = proxyPort != 0 ? connectLoopback(proxyPort, isIPv6) : -1;
+        if (fd >= 0 && proxyConnect(fd, type == ProxyType::kHttp, echoPort, isIPv6)) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            QElapsedTimer timer;
+            for (int i = 0; i < count; ++i) {
+                char c = 'x';
+                timer.start();
+                if (!sendAll(fd, &c, 1) || !recvExactly(fd, &c, 1)) {
+                    result.clear();
+                    break;
+                }
+                result.push_back(timer.nsecsElapsed() / 1000.0);
+            }
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        isDone = true;
+    });
+
+    // the proxy servers accept connections on this thread's event loop
+    QTest::qWaitFor([&]() { return isDone.load(); }, 60000);
+    client.join();
+    shutdown(echoFd, SHUT_RDWR);
+    close(echoFd);
+    echo.join();
+    if (httpProxy) {
+        httpProxy->closeActiveConnections();
+        httpProxy->stopServer();
+    }
+    if (socksProxy) {
+        socksProxy->closeActiveConnections();
+        socksProxy->stopServer();
+    }
+
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+QTEST_MAIN(VpnShareBenchmark_test)
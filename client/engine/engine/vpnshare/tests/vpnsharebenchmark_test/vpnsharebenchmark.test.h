@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QObject>
+#include <vector>
+
+// Loopback benchmarks of the vpnshare proxies. It's actually a manual test: the numbers are printed, not checked.
+class VpnShareBenchmark_test : public QObject
+{
+    Q_OBJECT
+
+public:
+    VpnShareBenchmark_test();
+
+private slots:
+    void benchmarkHttpConnectRelay_data();
+    void benchmarkHttpConnectRelay();
+    void benchmarkSocksRelay_data();
+    void benchmarkSocksRelay();
+    void stressSlowConsumer();
+    void benchmarkSocksUdpRelay_data();
+    void benchmarkSocksUdpRelay();
+    void loadManyConnections_data();
+    void loadManyConnections();
+    void benchmarkTrafficAccounting_data();
+    void benchmarkTrafficAccounting();
+    void benchmarkTrafficCounters();
+    void checkRateLimit();
+    void checkPeerAddressFilter();
+    void benchmarkIPv6Loopback_data();
+    void benchmarkIPv6Loopback();
+
+private:
+    enum class ProxyType { kHttp, kSocks };
+
+    // downloads bytesPerConnection through the proxy on every connection in parallel, returns MB/s or -1 on failure;
+    // the clients sleep clientReadDelayUs after every read, outPeakRssGrowth receives the peak growth of the process RSS;
+    // with isIPv6 the clients, the proxy and the source talk over ::1
+    double runRelay(ProxyType type, int connections, quint64 bytesPerConnection, int clientReadDelayUs = 0,
+                    qint64 *outPeakRssGrowth = nullptr, bool isIPv6 = false);
+    // round trips of one byte through the proxy to an echo server, in microseconds sorted ascending; empty on failure
+    std::vector<double> measureRoundTrips(ProxyType type, int count, bool isIPv6);
+};
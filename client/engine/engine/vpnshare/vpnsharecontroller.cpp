@@ -4,6 +4,8 @@
 #include <QSettings>
 
 #include "engine/connectionmanager/availableport.h"
+#include "socketutils/peeraddress.h"
+#include "utils/extraconfig.h"
 #include "utils/network_utils/network_utils.h"
 #include "utils/utils.h"
 #include "utils/ws_assert.h"
@@ -11,7 +13,9 @@
 VpnShareController::VpnShareController(QObject *parent, IHelper *helper) : QObject(parent),
     helper_(helper),
     httpProxyServer_(NULL),
-    socksProxyServer_(NULL)
+    socksProxyServer_(NULL),
+    nativeProxyServer_(NULL),
+    nativeProxyType_(PROXY_SHARING_HTTP)
 #ifdef Q_OS_WIN
     ,wifiSharing_(NULL)
 #endif
@@ -27,6 +31,7 @@ VpnShareController::~VpnShareController()
 {
     SAFE_DELETE(httpProxyServer_);
     SAFE_DELETE(socksProxyServer_);
+    SAFE_DELETE(nativeProxyServer_);
 #ifdef Q_OS_WIN
     SAFE_DELETE(wifiSharing_);
 #endif
@@ -38,7 +43,30 @@ void VpnShareController::startProxySharing(PROXY_SHARING_TYPE proxyType)
 
     SAFE_DELETE(httpProxyServer_);
     SAFE_DELETE(socksProxyServer_);
-    if (proxyType == PROXY_SHARING_HTTP)
+    SAFE_DELETE(nativeProxyServer_);
+    ClientTrafficStats::instance().reset();
+    if (ExtraConfig::instance().getVpnShareNativeProxy() && (proxyType == PROXY_SHARING_HTTP || proxyType == PROXY_SHARING_SOCKS))
+    {
+        nativeProxyServer_ = new NativeProxyServer::NativeProxyServer(this, proxyType == PROXY_SHARING_HTTP ?
+                                                                      NativeProxyServer::NativeProxyProtocol::kHttp :
+                                                                      NativeProxyServer::NativeProxyProtocol::kSocks);
+        nativeProxyType_ = proxyType;
+        connect(nativeProxyServer_, &NativeProxyServer::NativeProxyServer::usersCountChanged, this, &VpnShareController::onProxyUsersCountChanged);
+
+        uint port;
+        bool isStarted = false;
+        if (getLastSavedPort(port))
+        {
+            isStarted = nativeProxyServer_->startServer(port);
+        }
+        if (!isStarted)
+        {
+            uint randomPort = AvailablePort::getAvailablePort(18888);
+            nativeProxyServer_->startServer(randomPort);
+            saveLastPort(randomPort);
+        }
+    }
+    else if (proxyType == PROXY_SHARING_HTTP)
     {
         httpProxyServer_ = new HttpProxyServer::HttpProxyServer(this);
         connect(httpProxyServer_, &HttpProxyServer::HttpProxyServer::usersCountChanged, this, &VpnShareController::onProxyUsersCountChanged);
@@ -85,12 +113,13 @@ void VpnShareController::stopProxySharing()
     QMutexLocker locker(&mutex_);
     SAFE_DELETE_LATER(httpProxyServer_);
     SAFE_DELETE_LATER(socksProxyServer_);
+    SAFE_DELETE_LATER(nativeProxyServer_);
 }
 
 bool VpnShareController::isProxySharingEnabled()
 {
     QMutexLocker locker(&mutex_);
-    return httpProxyServer_ != NULL || socksProxyServer_ != NULL;
+    return httpProxyServer_ != NULL || socksProxyServer_ != NULL || nativeProxyServer_ != NULL;
 }
 
 bool VpnShareController::isWifiSharingEnabled()
@@ -116,10 +145,35 @@ QString VpnShareController::getProxySharingAddress()
     {
         return NetworkUtils::getLocalIP() + ":" + QString::number(socksProxyServer_->serverPort());
     }
+    else if (nativeProxyServer_)
+    {
+        return NetworkUtils::getLocalIP() + ":" + QString::number(nativeProxyServer_->serverPort());
+    }
     WS_ASSERT(false);
     return "Unknown";
 }
 
+QVector<types::ProxySharingClientStats> VpnShareController::getProxySharingClientsStats()
+{
+    return ClientTrafficStats::instance().snapshot();
+}
+
+void VpnShareController::setProxySharingRateLimit(const QString &address, quint32 kbytesPerSec)
+{
+    if (address.isEmpty())
+    {
+        ClientTrafficStats::instance().setDefaultRateLimit(kbytesPerSec);
+    }
+    else
+    {
+        const QHostAddress hostAddress(address);
+        if (!hostAddress.isNull())
+        {
+            ClientTrafficStats::instance().setRateLimit(PeerAddress::normalized(hostAddress), kbytesPerSec);
+        }
+    }
+}
+
 void VpnShareController::onWifiUsersCountChanged()
 {
     QMutexLocker locker(&mutex_);
@@ -150,6 +204,11 @@ void VpnShareController::onProxyUsersCountChanged()
         cntUsers += socksProxyServer_->getConnectedUsersCount();
         emit connectedProxyUsersChanged(isProxySharingEnabled(), PROXY_SHARING_SOCKS, getProxySharingAddress(), cntUsers);
     }
+    else if (nativeProxyServer_)
+    {
+        cntUsers += nativeProxyServer_->getConnectedUsersCount();
+        emit connectedProxyUsersChanged(isProxySharingEnabled(), nativeProxyType_, getProxySharingAddress(), cntUsers);
+    }
 }
 
 void VpnShareController::startWifiSharing(const QString &ssid, const QString &password)
@@ -197,10 +256,14 @@ QString VpnShareController::getCurrentCaption()
         {
             s += " + HTTP";
         }
-        else if (socksProxyServer_)
+        else if (socksProxyServer_ || (nativeProxyServer_ && nativeProxyType_ == PROXY_SHARING_SOCKS))
         {
             s += " + SOCKS";
         }
+        else if (nativeProxyServer_)
+        {
+            s += " + HTTP";
+        }
 
         return s;
     }
@@ -210,10 +273,14 @@ QString VpnShareController::getCurrentCaption()
         {
             return "HTTP";
         }
-        else if (socksProxyServer_)
+        else if (socksProxyServer_ || (nativeProxyServer_ && nativeProxyType_ == PROXY_SHARING_SOCKS))
         {
             return "SOCKS";
         }
+        else if (nativeProxyServer_)
+        {
+            return "HTTP";
+        }
     }
     return "";
 }
@@ -249,6 +316,10 @@ void VpnShareController::onConnectedToVPNEvent(const QString &vpnAdapterName)
     {
         socksProxyServer_->closeActiveConnections();
     }
+    if (nativeProxyServer_)
+    {
+        nativeProxyServer_->closeActiveConnections();
+    }
 }
 
 void VpnShareController::onDisconnectedFromVPNEvent()
@@ -268,6 +339,10 @@ void VpnShareController::onDisconnectedFromVPNEvent()
     {
         socksProxyServer_->closeActiveConnections();
     }
+    if (nativeProxyServer_)
+    {
+        nativeProxyServer_->closeActiveConnections();
+    }
 }
 
 bool VpnShareController::getLastSavedPort(uint &outPort)
@@ -4,6 +4,8 @@
 #include <QMutex>
 #include "httpproxyserver/httpproxyserver.h"
 #include "socksproxyserver/socksproxyserver.h"
+#include "nativeproxyserver/nativeproxyserver.h"
+#include "clienttrafficstats.h"
 #include "engine/helper/ihelper.h"
 #include "types/enums.h"
 
@@ -34,6 +36,10 @@ public:
     QString getCurrentCaption();
     QString getProxySharingAddress();
 
+    QVector<types::ProxySharingClientStats> getProxySharingClientsStats();
+    // an empty address sets the limit of all the clients without their own; 0 means unlimited
+    void setProxySharingRateLimit(const QString &address, quint32 kbytesPerSec);
+
 signals:
     void connectedWifiUsersChanged(bool bEnabled, const QString &ssid, int usersCount);
     void connectedProxyUsersChanged(bool bEnabled, PROXY_SHARING_TYPE type, const QString &address, int usersCount);
@@ -48,6 +54,9 @@ private:
     IHelper *helper_;
     HttpProxyServer::HttpProxyServer *httpProxyServer_;
     SocksProxyServer::SocksProxyServer *socksProxyServer_;
+    // used instead of the two above when ws-vpn-share-native-proxy is set in the advanced parameters
+    NativeProxyServer::NativeProxyServer *nativeProxyServer_;
+    PROXY_SHARING_TYPE nativeProxyType_;
 #ifdef Q_OS_WIN
     WifiSharing *wifiSharing_;
 #endif
@@ -246,6 +246,16 @@ void Backend::stopProxySharing()
     engine_->stopProxySharing();
 }
 
+QVector<types::ProxySharingClientStats> Backend::getProxySharingClientsStats()
+{
+    return engine_->getProxySharingClientsStats();
+}
+
+void Backend::setProxySharingRateLimit(const QString &address, quint32 kbytesPerSec)
+{
+    engine_->setProxySharingRateLimit(address, kbytesPerSec);
+}
+
 void Backend::setIPv6StateInOS(bool bEnabled)
 {
     engine_->setIPv6EnabledInOS(bEnabled);
@@ -652,6 +662,7 @@ void Backend::onEngineLocationsModelCustomConfigItemsUpdated(QSharedPointer<type
 void Backend::onEngineLocationsModelPingChangedChanged(const LocationID &id, PingTime timeMs)
 {
     locationsModelManager_->changeConnectionSpeed(id, timeMs);
+    emit locationPingTimeChanged(id, timeMs);
 }
 
 void Backend::onEngineMacAddrSpoofingChanged(const types::EngineSettings &engineSettings)
@@ -13,6 +13,7 @@
 #include "preferences/preferenceshelper.h"
 #include "types/locationid.h"
 #include "types/protocolstatus.h"
+#include "types/proxysharingclientstats.h"
 #include "types/proxysharinginfo.h"
 #include "types/splittunneling.h"
 #include "types/upgrademodetype.h"
@@ -60,6 +61,8 @@ public:
     void stopWifiSharing();
     void startProxySharing(PROXY_SHARING_TYPE proxySharingMode);
     void stopProxySharing();
+    QVector<types::ProxySharingClientStats> getProxySharingClientsStats();
+    void setProxySharingRateLimit(const QString &address, quint32 kbytesPerSec);
 
     void setIPv6StateInOS(bool bEnabled);
     void getAndUpdateIPv6StateInOS();
@@ -207,6 +210,7 @@ signals:
     void confirmEmailResult(bool bSuccess);
     void debugLogResult(bool bSuccess);
     void statisticsUpdated(quint64 bytesIn, quint64 bytesOut, bool isTotalBytes);
+    void locationPingTimeChanged(const LocationID &id, PingTime timeMs);
 
     void proxySharingInfoChanged(const types::ProxySharingInfo &psi);
     void wifiSharingInfoChanged(const types::WifiSharingInfo &wsi);
@@ -5,6 +5,7 @@
 #include "ipc/server.h"
 #include "ipc/clicommands.h"
 #include "backend/persistentstate.h"
+#include "locations/locationsmodel_roles.h"
 
 LocalIPCServer::LocalIPCServer(Backend *backend, QObject *parent) : QObject(parent)
   , backend_(backend)
@@ -13,6 +14,9 @@ LocalIPCServer::LocalIPCServer(Backend *backend, QObject *parent) : QObject(pare
     connect(backend_, &Backend::firewallStateChanged, this, &LocalIPCServer::onBackendFirewallStateChanged);
     connect(backend_, &Backend::loginFinished, this, &LocalIPCServer::onBackendLoginFinished);
     connect(backend_, &Backend::signOutFinished, this, &LocalIPCServer::onBackendSignOutFinished);
+    connect(backend_, &Backend::statisticsUpdated, this, &LocalIPCServer::onBackendStatisticsUpdated);
+    connect(backend_, &Backend::locationPingTimeChanged, this, &LocalIPCServer::onBackendLocationPingTimeChanged);
+    connect(backend_, &Backend::lostConnectionToHelper, this, &LocalIPCServer::onBackendLostConnectionToHelper);
 }
 
 LocalIPCServer::~LocalIPCServer()
@@ -62,7 +66,7 @@ void LocalIPCServer::onServerCallbackAcceptFunction(IPC::Connection *connection)
     connect(connection, &IPC::Connection::stateChanged, this, &LocalIPCServer::onConnectionStateCallback);
 }
 
-void LocalIPCServer::onConnectionCommandCallback(IPC::Command *command, IPC::Connection * /*connection*/)
+void LocalIPCServer::onConnectionCommandCallback(IPC::Command *command, IPC::Connection *connection)
 {
     if (command->getStringId() ==IPC::CliCommands::ShowLocations::getCommandStringId())
     {
@@ -188,6 +192,27 @@ void LocalIPCServer::onConnectionCommandCallback(IPC::Command *command, IPC::Con
             notifyCliSignOutFinished();
         }
     }
+    else if (command->getStringId() == IPC::CliCommands::GetSharingClients::getCommandStringId())
+    {
+        IPC::CliCommands::SharingClients cmd;
+        cmd.clients_ = backend_->getProxySharingClientsStats();
+        sendCommand(cmd);
+    }
+    else if (command->getStringId() == IPC::CliCommands::SetSharingRateLimit::getCommandStringId())
+    {
+        IPC::CliCommands::SetSharingRateLimit *cmd = static_cast<IPC::CliCommands::SetSharingRateLimit *>(command);
+        backend_->setProxySharingRateLimit(cmd->address_, cmd->rateLimitKBps_);
+
+        IPC::CliCommands::SharingClients cmd_send;
+        cmd_send.clients_ = backend_->getProxySharingClientsStats();
+        sendCommand(cmd_send);
+    }
+    else if (command->getStringId() == IPC::CliCommands::Subscribe::getCommandStringId())
+    {
+        qCDebug(LOG_CLI_IPC) << "CLI subscribed to events:" << connection;
+        eventPublisher_.setFirewallState(backend_->isFirewallEnabled(), backend_->isFirewallAlwaysOn());
+        eventPublisher_.addSubscriber(connection);
+    }
 }
 
 void LocalIPCServer::onConnectionStateCallback(int state, IPC::Connection *connection)
@@ -196,6 +221,7 @@ void LocalIPCServer::onConnectionStateCallback(int state, IPC::Connection *conne
     {
         qCDebug(LOG_BASIC) << "CLI disconnected from GUI server";
         connections_.removeOne(connection);
+        eventPublisher_.removeSubscriber(connection);
         connection->close();
         delete connection;
     }
@@ -203,6 +229,7 @@ void LocalIPCServer::onConnectionStateCallback(int state, IPC::Connection *conne
     {
         qCDebug(LOG_BASIC) << "CLI disconnected from GUI server with error";
         connections_.removeOne(connection);
+        eventPublisher_.removeSubscriber(connection);
         connection->close();
         delete connection;
     }
@@ -214,6 +241,16 @@ void LocalIPCServer::onBackendConnectStateChanged(const types::ConnectState &con
     IPC::CliCommands::ConnectStateChanged cmd;
     cmd.connectState = connectState;
     sendCommand(cmd);
+
+    // the last ping of the location, until the next one comes
+    const LocationID location = pingLocation(connectState.location);
+    const QModelIndex index = location.isValid() ? backend_->locationsModelManager()->getIndexByLocationId(location) : QModelIndex();
+    eventPublisher_.setPing(index.isValid() ? index.data(gui_locations::kPingTime).toInt() : PingTime::NO_PING_INFO);
+    eventPublisher_.setConnectState(connectState);
+    if (connectState.connectError != NO_CONNECT_ERROR)
+    {
+        eventPublisher_.reportError("Connect error: " + CONNECT_ERROR_toString(connectState.connectError));
+    }
 }
 
 void LocalIPCServer::onBackendFirewallStateChanged(bool isEnabled)
@@ -222,6 +259,7 @@ void LocalIPCServer::onBackendFirewallStateChanged(bool isEnabled)
     cmd.isFirewallEnabled_ = isEnabled;
     cmd.isFirewallAlwaysOn_ = backend_->isFirewallAlwaysOn();
     sendCommand(cmd);
+    eventPublisher_.setFirewallState(isEnabled, cmd.isFirewallAlwaysOn_);
 }
 
 void LocalIPCServer::onBackendLoginFinished(bool /*isLoginFromSavedSettings*/)
@@ -234,6 +272,25 @@ void LocalIPCServer::onBackendSignOutFinished()
     isLoggedIn_ = false;
 }
 
+void LocalIPCServer::onBackendStatisticsUpdated(quint64 bytesIn, quint64 bytesOut, bool isTotalBytes)
+{
+    eventPublisher_.addTraffic(bytesIn, bytesOut, isTotalBytes);
+}
+
+void LocalIPCServer::onBackendLocationPingTimeChanged(const LocationID &id, PingTime timeMs)
+{
+    const LocationID location = pingLocation(backend_->currentLocation());
+    if (location.isValid() && id == location)
+    {
+        eventPublisher_.setPing(timeMs.toInt());
+    }
+}
+
+void LocalIPCServer::onBackendLostConnectionToHelper()
+{
+    eventPublisher_.reportError("Lost connection to the helper");
+}
+
 void LocalIPCServer::sendCommand(const IPC::Command &command)
 {
     for (IPC::Connection * connection : connections_)
@@ -260,6 +317,15 @@ void LocalIPCServer::notifyCliSignOutFinished()
     sendCommand(cmd);
 }
 
+LocationID LocalIPCServer::pingLocation(const LocationID &id)
+{
+    if (id.isValid() && id.isBestLocation())
+    {
+        return id.bestLocationToApiLocation();
+    }
+    return id;
+}
+
 void LocalIPCServer::sendLoginResult(bool isLoggedIn, const QString &errorMessage)
 {
     disconnect(backend_, &Backend::loginFinished, this, &LocalIPCServer::notifyCliLoginFinished);
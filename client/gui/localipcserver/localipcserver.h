@@ -3,6 +3,7 @@
 #include <QVector>
 #include "ipc/server.h"
 #include "ipc/connection.h"
+#include "ipc/clieventpublisher.h"
 #include "backend/backend.h"
 
 // Local server for receive and execute commands from local processes (currently only from the CLI).
@@ -30,6 +31,9 @@ private slots:
     void onBackendFirewallStateChanged(bool isEnabled);
     void onBackendLoginFinished(bool isLoginFromSavedSettings);
     void onBackendSignOutFinished();
+    void onBackendStatisticsUpdated(quint64 bytesIn, quint64 bytesOut, bool isTotalBytes);
+    void onBackendLocationPingTimeChanged(const LocationID &id, PingTime timeMs);
+    void onBackendLostConnectionToHelper();
     void notifyCliSignOutFinished();
     void notifyCliLoginFinished();
     void notifyCliLoginFailed(LOGIN_RET loginError, const QString &errorMessage);
@@ -39,7 +43,11 @@ private:
     IPC::Server *server_ = nullptr;
     QVector<IPC::Connection *> connections_;
     bool isLoggedIn_ = false;
+    // for windscribe-cli watch
+    IPC::CliEventPublisher eventPublisher_;
 
     void sendCommand(const IPC::Command &command);
     void sendLoginResult(bool isLoggedIn, const QString &errorMessage);
+    // the ping of the best location is the one of its API location
+    static LocationID pingLocation(const LocationID &id);
 };
@@ -98,15 +98,13 @@ void LogViewerWindow::onExportClick()
     QString fileName = QFileDialog::getSaveFileName(this, tr("Save log"), QString(), tr("Text files (*.txt)"));
     if (!fileName.isEmpty())
     {
-        QString log = MergeLog::mergePrevLogs(true);
-        log += "================================================================================================================================================================================================\n";
-        log += "================================================================================================================================================================================================\n";
-        log += MergeLog::mergeLogs(true);
-
         QFile file(fileName);
         if (file.open(QIODevice::WriteOnly))
         {
-            file.write(log.toLocal8Bit());
+            MergeLog::mergePrevLogs(&file, true);
+            file.write("================================================================================================================================================================================================\n");
+            file.write("================================================================================================================================================================================================\n");
+            MergeLog::mergeLogs(&file, true);
         }
         else
         {
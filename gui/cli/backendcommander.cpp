@@ -1,10 +1,14 @@
 #include "backendcommander.h"
 
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocale>
 #include <QTimer>
 
 #include "ipc/clicommands.h"
 #include "ipc/connection.h"
 #include "types/locationid.h"
+#include "types/pingtime.h"
 #include "utils/logger.h"
 #include "utils/utils.h"
 
@@ -84,7 +88,9 @@ void BackendCommander::onConnectionNewCommand(IPC::Command *command, IPC::Connec
             onLoginStateResponse(command);
         }
     }
-    else if (command->getStringId() == IPC::CliCommands::FirewallStateChanged::getCommandStringId()) {
+    else if (command->getStringId() == IPC::CliCommands::FirewallStateChanged::getCommandStringId() &&
+             (cliArgs_.cliCommand() == CLI_COMMAND_FIREWALL_ON || cliArgs_.cliCommand() == CLI_COMMAND_FIREWALL_OFF)) {
+        // the answer to a firewall command; the other commands, watch included, don't end on a change by someone else
         IPC::CliCommands::FirewallStateChanged *cmd = static_cast<IPC::CliCommands::FirewallStateChanged *>(command);
         if (cmd->isFirewallEnabled_) {
             if (cmd->isFirewallAlwaysOn_) {
@@ -98,10 +104,19 @@ void BackendCommander::onConnectionNewCommand(IPC::Command *command, IPC::Connec
             emit finished(0, tr("Firewall is OFF"));
         }
     }
-    else if (bCommandSent_ && command->getStringId() == IPC::CliCommands::SignedOut::getCommandStringId()) {
+    else if (bCommandSent_ && command->getStringId() == IPC::CliCommands::SharingClients::getCommandStringId()) {
+        onSharingClientsResponse(command);
+    }
+    else if (bCommandSent_ && command->getStringId() == IPC::CliCommands::Event::getCommandStringId()) {
+        onEvent(command);
+    }
+    // the answers to sign out and login; they go to every CLI connection, so they don't end the other commands
+    else if (bCommandSent_ && command->getStringId() == IPC::CliCommands::SignedOut::getCommandStringId() &&
+             cliArgs_.cliCommand() == CLI_COMMAND_SIGN_OUT) {
         emit finished(0, tr("Signed out"));
     }
-    else if (bCommandSent_ && command->getStringId() == IPC::CliCommands::LoginResult::getCommandStringId()) {
+    else if (bCommandSent_ && command->getStringId() == IPC::CliCommands::LoginResult::getCommandStringId() &&
+             cliArgs_.cliCommand() == CLI_COMMAND_LOGIN) {
         IPC::CliCommands::LoginResult *cmd = static_cast<IPC::CliCommands::LoginResult *>(command);
         if (cmd->isLoggedIn_) {
             emit finished(0, tr("login successful"));
@@ -122,7 +137,13 @@ void BackendCommander::onConnectionStateChanged(int state, IPC::Connection * /*c
         qCDebug(LOG_BASIC) << "Connected to GUI server";
         ipcState_ = IPC_CONNECTED;
         loggedInTimer_.start();
-        sendStateCommand();
+        if (cliArgs_.cliCommand() == CLI_COMMAND_WATCH) {
+            // the events don't depend on the login
+            sendCommand();
+        }
+        else {
+            sendStateCommand();
+        }
     }
     else if (state == IPC::CONNECTION_DISCONNECTED) {
         qCDebug(LOG_BASIC) << "Disconnected from GUI server";
@@ -188,6 +209,20 @@ void BackendCommander::sendCommand()
     else if (cliArgs_.cliCommand() == CLI_COMMAND_STATUS) {
         sendStateCommand();
     }
+    else if (cliArgs_.cliCommand() == CLI_COMMAND_SHARING_CLIENTS) {
+        IPC::CliCommands::GetSharingClients cmd;
+        connection_->sendCommand(cmd);
+    }
+    else if (cliArgs_.cliCommand() == CLI_COMMAND_SHARING_LIMIT) {
+        IPC::CliCommands::SetSharingRateLimit cmd;
+        cmd.address_ = cliArgs_.sharingAddress();
+        cmd.rateLimitKBps_ = cliArgs_.sharingRateLimit();
+        connection_->sendCommand(cmd);
+    }
+    else if (cliArgs_.cliCommand() == CLI_COMMAND_WATCH) {
+        IPC::CliCommands::Subscribe cmd;
+        connection_->sendCommand(cmd);
+    }
 
     bCommandSent_ = true;
 }
@@ -256,21 +291,7 @@ void BackendCommander::onStatusResponse(IPC::Command *command)
         msg = tr("Signed out");
     }
     else {
-        switch (cmd->connectState_) {
-        case CONNECT_STATE_DISCONNECTED:
-            msg = tr("Disconnected");
-            break;
-        case CONNECT_STATE_CONNECTED:
-            msg = tr("Connected");
-            break;
-        case CONNECT_STATE_CONNECTING:
-            msg = tr("Connecting");
-            break;
-        case CONNECT_STATE_DISCONNECTING:
-            msg = tr("Disconnecting");
-            break;
-        }
-
+        msg = connectStateString(cmd->connectState_);
         if (cmd->location_.isValid()) {
             msg += QString(": %1").arg(cmd->location_.city());
         }
@@ -278,3 +299,105 @@ void BackendCommander::onStatusResponse(IPC::Command *command)
 
     emit finished(0, msg);
 }
+
+void BackendCommander::onSharingClientsResponse(IPC::Command *command)
+{
+    IPC::CliCommands::SharingClients *cmd = static_cast<IPC::CliCommands::SharingClients *>(command);
+
+    if (cmd->clients_.isEmpty()) {
+        emit finished(0, tr("No clients have used the shared connection"));
+        return;
+    }
+
+    QString msg = QString("%1 %2 %3 %4 %5").arg(tr("Client"), -40).arg(tr("Connections"), 16)
+                  .arg(tr("Uploaded"), 12).arg(tr("Downloaded"), 12).arg(tr("Limit"), 10);
+    for (const types::ProxySharingClientStats &client : cmd->clients_) {
+        const QString connections = QString("%1/%2").arg(client.activeConnections).arg(client.totalConnections);
+        const QString limit = client.rateLimitKBps > 0 ? QString("%1 KB/s").arg(client.rateLimitKBps) : tr("none");
+        msg += QString("\n%1 %2 %3 %4 %5").arg(client.address, -40).arg(connections, 16)
+               .arg(QLocale::c().formattedDataSize(client.bytesUploaded), 12)
+               .arg(QLocale::c().formattedDataSize(client.bytesDownloaded), 12).arg(limit, 10);
+    }
+    emit finished(0, msg);
+}
+
+void BackendCommander::onEvent(IPC::Command *command)
+{
+    IPC::CliCommands::Event *cmd = static_cast<IPC::CliCommands::Event *>(command);
+
+    if (cliArgs_.isJsonOutput()) {
+        QJsonObject json;
+        if (cmd->changes_ & IPC::CliCommands::Event::CHANGE_CONNECT_STATE) {
+            static const char *kStates[] = { "disconnected", "connected", "connecting", "disconnecting" };
+            const LocationID &location = cmd->connectState_.location;
+            json["state"] = cmd->connectState_.connectState <= CONNECT_STATE_DISCONNECTING ? kStates[cmd->connectState_.connectState] : "unknown";
+            json["location"] = !location.isValid() ? QString() : (location.isBestLocation() ? "Best Location" : location.city());
+            json["connectError"] = CONNECT_ERROR_toString(cmd->connectState_.connectError);
+        }
+        if (cmd->changes_ & IPC::CliCommands::Event::CHANGE_TRAFFIC) {
+            json["bytesIn"] = (qint64)cmd->bytesIn_;
+            json["bytesOut"] = (qint64)cmd->bytesOut_;
+            json["bytesInPerSec"] = (qint64)cmd->bytesInPerSec_;
+            json["bytesOutPerSec"] = (qint64)cmd->bytesOutPerSec_;
+        }
+        if (cmd->changes_ & IPC::CliCommands::Event::CHANGE_PING) {
+            json["pingMs"] = cmd->pingMs_ >= 0 ? QJsonValue(cmd->pingMs_) : QJsonValue();
+        }
+        if (cmd->changes_ & IPC::CliCommands::Event::CHANGE_ERROR) {
+            json["error"] = cmd->error_;
+        }
+        if (cmd->changes_ & IPC::CliCommands::Event::CHANGE_FIREWALL) {
+            json["firewall"] = cmd->isFirewallEnabled_;
+            json["firewallAlwaysOn"] = cmd->isFirewallAlwaysOn_;
+        }
+        emit watchEvent(QString::fromUtf8(QJsonDocument(json).toJson(QJsonDocument::Compact)));
+        return;
+    }
+
+    if (cmd->changes_ & IPC::CliCommands::Event::CHANGE_CONNECT_STATE) {
+        QString msg = connectStateString(cmd->connectState_.connectState);
+        if (cmd->connectState_.location.isValid()) {
+            msg += QString(": %1").arg(cmd->connectState_.location.isBestLocation() ? tr("Best Location") : cmd->connectState_.location.city());
+        }
+        emit watchEvent(msg);
+    }
+    if (cmd->changes_ & IPC::CliCommands::Event::CHANGE_TRAFFIC) {
+        emit watchEvent(tr("Traffic: %1 in (%2/s), %3 out (%4/s)")
+                   .arg(QLocale::c().formattedDataSize(cmd->bytesIn_), QLocale::c().formattedDataSize(cmd->bytesInPerSec_),
+                        QLocale::c().formattedDataSize(cmd->bytesOut_), QLocale::c().formattedDataSize(cmd->bytesOutPerSec_)));
+    }
+    if (cmd->changes_ & IPC::CliCommands::Event::CHANGE_PING) {
+        if (cmd->pingMs_ >= 0) {
+            emit watchEvent(tr("Ping: %1 ms").arg(cmd->pingMs_));
+        }
+        else {
+            emit watchEvent(cmd->pingMs_ == PingTime::PING_FAILED ? tr("Ping: failed") : tr("Ping: unknown"));
+        }
+    }
+    if (cmd->changes_ & IPC::CliCommands::Event::CHANGE_ERROR) {
+        emit watchEvent(tr("Error: %1").arg(cmd->error_));
+    }
+    if (cmd->changes_ & IPC::CliCommands::Event::CHANGE_FIREWALL) {
+        if (!cmd->isFirewallEnabled_) {
+            emit watchEvent(tr("Firewall: OFF"));
+        }
+        else {
+            emit watchEvent(cmd->isFirewallAlwaysOn_ ? tr("Firewall: ON (Always On)") : tr("Firewall: ON"));
+        }
+    }
+}
+
+QString BackendCommander::connectStateString(CONNECT_STATE connectState) const
+{
+    switch (connectState) {
+    case CONNECT_STATE_DISCONNECTED:
+        return tr("Disconnected");
+    case CONNECT_STATE_CONNECTED:
+        return tr("Connected");
+    case CONNECT_STATE_CONNECTING:
+        return tr("Connecting");
+    case CONNECT_STATE_DISCONNECTING:
+        return tr("Disconnecting");
+    }
+    return QString();
+}
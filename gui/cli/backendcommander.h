@@ -6,6 +6,7 @@
 #include "cliarguments.h"
 #include "ipc/command.h"
 #include "ipc/connection.h"
+#include "types/enums.h"
 
 class BackendCommander : public QObject
 {
@@ -19,6 +20,8 @@ public:
 signals:
     void finished(int returnCode, const QString &errorMsg);
     void report(const QString &msg);
+    // an event of watch, not logged
+    void watchEvent(const QString &msg);
 
 private slots:
     void onConnectionNewCommand(IPC::Command *command, IPC::Connection *connection);
@@ -43,4 +46,7 @@ private:
 
     void onLoginStateResponse(IPC::Command *command);
     void onStatusResponse(IPC::Command *command);
+    void onSharingClientsResponse(IPC::Command *command);
+    void onEvent(IPC::Command *command);
+    QString connectStateString(CONNECT_STATE connectState) const;
 };
@@ -1,4 +1,5 @@
 #include <QCoreApplication>
+#include <QHostAddress>
 //#include <iostream>
 
 #include "cliarguments.h"
@@ -94,6 +95,37 @@ void CliArguments::processArguments()
         {
             cliCommand_ = CLI_COMMAND_STATUS;
         }
+        else if (arg1 == "sharing" && args.length() > 2)
+        {
+            QString arg2 = args[2].toLower();
+            if (arg2 == "clients")
+            {
+                cliCommand_ = CLI_COMMAND_SHARING_CLIENTS;
+            }
+            else if (arg2 == "limit" && args.length() > 4)
+            {
+                bool isOk;
+                sharingRateLimit_ = args[4].toUInt(&isOk);
+                const bool isAll = args[3].toLower() == "all";
+                if (isOk && (isAll || !QHostAddress(args[3]).isNull()))
+                {
+                    sharingAddress_ = isAll ? QString() : args[3];
+                    cliCommand_ = CLI_COMMAND_SHARING_LIMIT;
+                }
+            }
+        }
+        else if (arg1 == "watch")
+        {
+            if (args.length() == 2)
+            {
+                cliCommand_ = CLI_COMMAND_WATCH;
+            }
+            else if (args.length() == 3 && args[2].toLower() == "--json")
+            {
+                isJsonOutput_ = true;
+                cliCommand_ = CLI_COMMAND_WATCH;
+            }
+        }
     }
 }
 
@@ -126,3 +158,18 @@ bool CliArguments::keepFirewallOn() const
 {
     return keepFirewallOn_;
 }
+
+const QString &CliArguments::sharingAddress() const
+{
+    return sharingAddress_;
+}
+
+quint32 CliArguments::sharingRateLimit() const
+{
+    return sharingRateLimit_;
+}
+
+bool CliArguments::isJsonOutput() const
+{
+    return isJsonOutput_;
+}
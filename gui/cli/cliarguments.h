@@ -14,7 +14,10 @@ enum CliCommand {
     CLI_COMMAND_LOCATIONS,
     CLI_COMMAND_LOGIN,
     CLI_COMMAND_SIGN_OUT,
-    CLI_COMMAND_STATUS
+    CLI_COMMAND_STATUS,
+    CLI_COMMAND_SHARING_CLIENTS,
+    CLI_COMMAND_SHARING_LIMIT,
+    CLI_COMMAND_WATCH
 };
 
 class CliArguments
@@ -29,6 +32,11 @@ public:
     const QString &password() const;
     const QString &code2fa() const;
     bool keepFirewallOn() const;
+    // empty for all the clients
+    const QString &sharingAddress() const;
+    quint32 sharingRateLimit() const;
+    // the events of watch as JSON lines
+    bool isJsonOutput() const;
 
 private:
     CliCommand cliCommand_ = CLI_COMMAND_NONE;
@@ -37,4 +45,7 @@ private:
     QString password_;
     QString code2fa_;
     bool keepFirewallOn_ = false;
+    QString sharingAddress_;
+    quint32 sharingRateLimit_ = 0;
+    bool isJsonOutput_ = false;
 };
@@ -66,8 +66,11 @@ int main(int argc, char *argv[])
         std::cout << "firewall on|off             - Turn firewall ON/OFF" << std::endl;
         std::cout << "locations                   - View a list of available locations" << std::endl;
         std::cout << "login \"username\" \"password\" [2FA code] - login with given username and password, and optional two-factor authentication code" << std::endl;
+        std::cout << "sharing clients             - View the traffic of the clients using the shared connection" << std::endl;
+        std::cout << "sharing limit \"address\"|all KB/s - Limit the rate of a client of the shared connection, or of all of them; 0 removes the limit" << std::endl;
         std::cout << "signout [on|off]            - Sign out of the application, and optionally leave the firewall ON/OFF" << std::endl;
         std::cout << "status                      - View the connected/disconnected state of the application" << std::endl;
+        std::cout << "watch [--json]              - Follow the connect state, firewall, traffic, ping and errors of the application as they change, optionally as JSON lines" << std::endl;
         return 0;
     }
 
@@ -84,6 +87,10 @@ int main(int argc, char *argv[])
         logAndCout(msg);
     });
 
+    QObject::connect(backendCommander, &BackendCommander::watchEvent, [&](const QString &msg) {
+        std::cout << msg.toStdString() << std::endl;
+    });
+
     if (Utils::isGuiAlreadyRunning())
     {
         qCDebug(LOG_BASIC) << "GUI detected -- attempting Engine connect";
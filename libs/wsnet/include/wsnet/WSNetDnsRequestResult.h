@@ -13,6 +13,8 @@ public:
 
     virtual std::vector<std::string> ips() = 0;
     virtual std::uint32_t elapsedMs() = 0;
+    // the minimum TTL of the returned records in seconds, 0 if unknown (for example, the hosts file)
+    virtual std::uint32_t ttl() = 0;
     virtual bool isError() = 0;
     virtual std::string errorString() = 0;
 };
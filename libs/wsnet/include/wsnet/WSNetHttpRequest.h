@@ -62,6 +62,12 @@ public:
     // true by default
     virtual void setIsWhiteListIps(bool isWhiteListIps) = 0;
     virtual bool isWhiteListIps() const = 0;
+
+    // Requests only these bytes of the content, like "100-199" or "100-", and turns off compression for the request.
+    // The server may ignore it and send all of the content.
+    // empty by default
+    virtual void setRange(const std::string &range) = 0;
+    virtual std::string range() const = 0;
 };
 
 } // namespace wsnet
@@ -15,6 +15,7 @@ enum class UpdateChannel { kRelease = 0, kBeta, kGuineaPig, kInternal };
 
 typedef std::function<void(std::uint32_t num, std::uint32_t count)> WSNetTryingBackupEndpointCallback;
 typedef std::function<void(ServerApiRetCode serverApiRetCode, const std::string &jsonData)> WSNetRequestFinishedCallback;
+typedef std::function<void(const std::string &hostname)> WSNetHostnameCallback;
 
 class WSNetServerAPI : public scapix_object<WSNetServerAPI>
 {
@@ -67,6 +68,10 @@ public:
     virtual std::shared_ptr<WSNetCancelableCallback> staticIps(const std::string &authHash, const std::string &platform, const std::string &deviceId, WSNetRequestFinishedCallback callback) = 0;
 
     virtual std::shared_ptr<WSNetCancelableCallback> pingTest(std::uint32_t timeoutMs, WSNetRequestFinishedCallback callback) = 0;
+    // The hostname pingTest() would be sent to now: the tunnel test subdomain of the manual API address, of the primary
+    // domain when connected to the VPN, or of the domain of the failover in use.
+    // Empty if that is an IP address, or a failover that needs SNI or ECH, which a plain request to the hostname lacks.
+    virtual std::shared_ptr<WSNetCancelableCallback> tunnelTestHostname(WSNetHostnameCallback callback) = 0;
 
     // pcpid parameter is optional and can be empty string
     virtual std::shared_ptr<WSNetCancelableCallback> notifications(const std::string &authHash, const std::string &pcpid, WSNetRequestFinishedCallback callback) = 0;
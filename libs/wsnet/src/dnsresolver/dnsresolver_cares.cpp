@@ -174,7 +174,11 @@ void DnsResolver_cares::run()
             arg->this_ = this;
             arg->qi = qi;
             arg->qi.startTime = std::chrono::steady_clock::now();
-            ares_gethostbyname(channel, arg->qi.hostname.c_str(), AF_INET, caresCallback, arg);
+            // ares_getaddrinfo reports the TTL of the records, unlike ares_gethostbyname
+            struct ares_addrinfo_hints hints;
+            memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_INET;
+            ares_getaddrinfo(channel, arg->qi.hostname.c_str(), NULL, &hints, caresCallback, arg);
             localQueue.pop();
         }
 
@@ -196,7 +200,7 @@ void DnsResolver_cares::run()
     ares_destroy(channel);
 }
 
-void DnsResolver_cares::caresCallback(void *arg, int status, int timeouts, hostent *host)
+void DnsResolver_cares::caresCallback(void *arg, int status, int timeouts, ares_addrinfo *res)
 {
     ArgToCaresCallback *pars = (ArgToCaresCallback *)arg;
 
@@ -212,10 +216,17 @@ void DnsResolver_cares::caresCallback(void *arg, int status, int timeouts, hoste
 
     std::shared_ptr<DnsRequestResult> result = std::make_shared<DnsRequestResult>();
     if (status == ARES_SUCCESS) {
-        for (char **p = host->h_addr_list; *p; p++) {
+        for (ares_addrinfo_node *node = res->nodes; node; node = node->ai_next) {
+            if (node->ai_family != AF_INET) {
+                continue;
+            }
             char addr_buf[46] = "??";
-            ares_inet_ntop(host->h_addrtype, *p, addr_buf, sizeof(addr_buf));
+            ares_inet_ntop(node->ai_family, &((const sockaddr_in *)node->ai_addr)->sin_addr, addr_buf, sizeof(addr_buf));
             result->ips_.push_back(addr_buf);
+            // the minimum of all records, entries from the hosts file have no TTL
+            if (node->ai_ttl > 0 && (result->ttl_ == 0 || (std::uint32_t)node->ai_ttl < result->ttl_)) {
+                result->ttl_ = node->ai_ttl;
+            }
         }
         result->isError_ = false;
     } else {
@@ -224,6 +235,9 @@ void DnsResolver_cares::caresCallback(void *arg, int status, int timeouts, hoste
     }
 
     result->elapsedMs_ = (unsigned int)utils::since(pars->qi.startTime).count();
+    if (res) {
+        ares_freeaddrinfo(res);
+    }
 
     // if the channel was destroyed, then do not call a callback function
     if (status != ARES_EDESTRUCTION) {
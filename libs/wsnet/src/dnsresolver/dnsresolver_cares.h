@@ -31,7 +31,7 @@ public:
 
 private:
     void run();
-    static void caresCallback(void *arg, int status, int timeouts, struct hostent *host);
+    static void caresCallback(void *arg, int status, int timeouts, struct ares_addrinfo *res);
 
     // 200 ms settled for faster switching to the next try (next server)
     // this does not mean that the current request will be limited to 200ms,
@@ -60,11 +60,13 @@ private:
     public:
         std::vector<std::string> ips() override { return ips_; }
         std::uint32_t elapsedMs() override { return elapsedMs_; }
+        std::uint32_t ttl() override { return ttl_; }
         bool isError() override { return isError_; }
         std::string errorString() override { return errorString_; }
 
         std::vector<std::string> ips_;
         unsigned int elapsedMs_;
+        std::uint32_t ttl_ = 0;
         bool isError_;
         std::string errorString_;
     };
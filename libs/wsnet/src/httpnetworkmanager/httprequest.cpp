@@ -18,6 +18,7 @@ struct HttpRequest::Impl
     bool isExtraTLSPadding = false;
     std::string overrideIp;
     bool isWhiteListIps = true;
+    std::string range;
     skyr::url skyrUrl;
 };
 
@@ -167,5 +168,15 @@ bool HttpRequest::isWhiteListIps() const
     return pImpl_->isWhiteListIps;
 }
 
+void HttpRequest::setRange(const std::string &range)
+{
+    pImpl_->range = range;
+}
+
+std::string HttpRequest::range() const
+{
+    return pImpl_->range;
+}
+
 } // namespace wsnet
 
@@ -58,6 +58,10 @@ public:
     void setIsWhiteListIps(bool isWhiteListIps) override;
     bool isWhiteListIps() const override;
 
+    // empty by default
+    void setRange(const std::string &range) override;
+    std::string range() const override;
+
 private:
     // internal implementation class (to hide include skyr/url.hpp from this header, there were compilation errors in Windows)
     struct Impl;
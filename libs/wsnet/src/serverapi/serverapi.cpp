@@ -192,6 +192,13 @@ std::shared_ptr<WSNetCancelableCallback> ServerAPI::pingTest(std::uint32_t timeo
     return cancelableCallback;
 }
 
+std::shared_ptr<WSNetCancelableCallback> ServerAPI::tunnelTestHostname(WSNetHostnameCallback callback)
+{
+    auto cancelableCallback = std::make_shared<CancelableCallback<WSNetHostnameCallback>>(callback);
+    boost::asio::post(io_context_, [this, cancelableCallback] { cancelableCallback->call(impl_->tunnelTestHostname()); });
+    return cancelableCallback;
+}
+
 std::shared_ptr<WSNetCancelableCallback> ServerAPI::notifications(const std::string &authHash, const std::string &pcpid, WSNetRequestFinishedCallback callback)
 {
     auto cancelableCallback = std::make_shared<CancelableCallback<WSNetRequestFinishedCallback>>(callback);
@@ -2,6 +2,7 @@
 #include <spdlog/spdlog.h>
 #include "settings.h"
 #include "serverapi_utils.h"
+#include "utils/utils.h"
 
 namespace wsnet {
 
@@ -188,6 +189,28 @@ void ServerAPI_impl::executeWaitingInQueueRequests()
     }
 }
 
+std::string ServerAPI_impl::tunnelTestHostname() const
+{
+    // the same choice as executeRequest() makes
+    std::string domain = Settings::instance().primaryServerDomain();
+    if (!apiResolutionSettings_.isAutomatic && !apiResolutionSettings_.manualAddress.empty()) {
+        domain = apiResolutionSettings_.manualAddress;
+    } else if (isConnectedToVpn_) {
+        domain = hostnameForConnectedState();
+    } else if ((failoverState_ == FailoverState::kReady || failoverState_ == FailoverState::kFromSettingsReady) &&
+               failoverData_.has_value() && !failoverData_->isExpired()) {
+        if (!failoverData_->sniDomain().empty() || !failoverData_->echConfig().empty()) {
+            return std::string();
+        }
+        domain = failoverData_->domain();
+    }
+
+    if (utils::isIpAddress(domain)) {
+        return std::string();
+    }
+    return Settings::instance().serverTunnelTestSubdomain() + "." + domain;
+}
+
 std::string ServerAPI_impl::hostnameForConnectedState() const
 {
     return Settings::instance().primaryServerDomain();
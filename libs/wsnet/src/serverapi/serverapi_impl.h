@@ -34,6 +34,7 @@ public:
     void setTryingBackupEndpointCallback(std::shared_ptr<CancelableCallback<WSNetTryingBackupEndpointCallback>> tryingBackupEndpointCallback);
 
     void executeRequest(std::unique_ptr<BaseRequest> request);
+    std::string tunnelTestHostname() const;
 
 private:
     WSNetHttpNetworkManager *httpNetworkManager_;